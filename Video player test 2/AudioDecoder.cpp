@@ -1,42 +1,32 @@
 #include "AudioDecoder.h"
 #include "AudioFrame.h"
+#include "AudioSampleConverter.h"
 
 #include "Options.h"
 #include "OptionNames.h"
 #include "IntOptionAdapter.h"
+#include "BoolOptionAdapter.h"
 
 extern "C"
 {
 #include <libavcodec/avcodec.h>
 }
 
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 
-struct AudioChunkData
-{
-    AVFrame* frame;
-    char* outputData;
-    int bytesPerSample;
-};
-
-void SelectSampleConverter(void(**convertChunk)(AudioChunkData), int& bytesPerSample, int sampleFormat);
-void ConvertNoneChunk(AudioChunkData data);
-void ConvertU8Chunk(AudioChunkData data);
-void ConvertS16Chunk(AudioChunkData data);
-void ConvertS32Chunk(AudioChunkData data);
-void ConvertFLTChunk(AudioChunkData data);
-void ConvertDBLChunk(AudioChunkData data);
-void ConvertU8PlanarChunk(AudioChunkData data);
-void ConvertS16PlanarChunk(AudioChunkData data);
-void ConvertS32PlanarChunk(AudioChunkData data);
-void ConvertFLTPlanarChunk(AudioChunkData data);
-void ConvertDBLPlanarChunk(AudioChunkData data);
-
 AudioDecoder::AudioDecoder(const MediaStream& stream)
+    : _chunkPool(std::make_shared<FrameBufferPool>(64))
 {
     AVCodec* codec = avcodec_find_decoder(stream.GetParams()->codec_id);
     _codecContext = avcodec_alloc_context3(codec);
     avcodec_parameters_to_context(_codecContext, stream.GetParams());
+    // Threading can't be changed on an open codec, so these options apply to newly created decoders
+    int threadCount = IntOptionAdapter(Options::Instance()->GetValue(OPTIONS_AUDIO_DECODER_THREADS), 1).Value();
+    bool frameThreading = BoolOptionAdapter(Options::Instance()->GetValue(OPTIONS_DECODER_FRAME_THREADING), true).Value();
+    bool sliceThreading = BoolOptionAdapter(Options::Instance()->GetValue(OPTIONS_DECODER_SLICE_THREADING), true).Value();
+    _SetupThreading(_codecContext, threadCount, frameThreading, sliceThreading);
     avcodec_open2(_codecContext, codec, NULL);
 
     _timebase = stream.timeBase;
@@ -49,33 +39,25 @@ AudioDecoder::AudioDecoder(const MediaStream& stream)
 
 AudioDecoder::~AudioDecoder()
 {
-    _decoderThreadStop = true;
-    if (_decoderThread.joinable())
-        _decoderThread.join();
+    _StopDecoding();
     avcodec_close(_codecContext);
     avcodec_free_context(&_codecContext);
 }
 
 void AudioDecoder::_DecoderThread()
 {
-    // Set up audio data convertion variables
-    int bytesPerSample = av_get_bytes_per_sample(_codecContext->sample_fmt);
-    if (bytesPerSample < 0)
-    {
-        // This should not occur, checking just for paranoia
-        printf("Failed to calculate data size\n");
-        exit(1);
-    }
-
     int currentSampleFormat = _codecContext->sample_fmt;
-    void(*convertChunk)(AudioChunkData) = nullptr;
-    SelectSampleConverter(&convertChunk, bytesPerSample, _codecContext->sample_fmt);
-    //if (!convertChunk) return;
+    AudioSampleConverter::Kernel converterKernel = AudioSampleConverter::BestKernel();
+    std::cout << "[AudioDecoder] Using " << AudioSampleConverter::KernelName(converterKernel) << " sample conversion" << std::endl;
 
     AVFrame* frame = av_frame_alloc();
 
     bool discontinuity = true;
 
+    // Packet taken from the queue but not yet accepted by the decoder
+    MediaPacket packet;
+    bool packetHeld = false;
+
     Clock threadClock = Clock(0);
 
     while (!_decoderThreadStop)
@@ -88,6 +70,7 @@ void AudioDecoder::_DecoderThread()
             _lastOptionCheck = threadClock.Now();
             _LoadOptions();
         }
+        _UpdateStats(threadClock.Now(), "audio", _codecContext);
 
         // Seek
         if (_decoderThreadFlush)
@@ -99,50 +82,52 @@ void AudioDecoder::_DecoderThread()
 
             ClearPackets();
             ClearFrames();
+            packet = MediaPacket();
+            packetHeld = false;
+            _pendingChunk = PendingChunk();
             _decoderThreadFlush = false;
             discontinuity = true;
             continue;
         }
 
-        // Limit loaded frame count
-        if (_frames.size() >= _MAX_FRAME_QUEUE_SIZE)
+        // Wait for a packet and free frame space
+        if (_frames.Full() || (!packetHeld && _packets.Empty()))
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            // Don't hold back a partial chunk while starved of packets
+            if (!_frames.Full() && _pendingChunk.samples)
+            {
+                _PushPendingChunk();
+                continue;
+            }
+            _WaitForWork(packetHeld);
             continue;
         }
-
-        // If finished, wait for seek command/new packets
-        _m_packets.lock(); // Prevent packet flushing on seek
-        if (_packets.empty())
+        if (!packetHeld)
         {
-            _m_packets.unlock();
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-            continue;
+            _packets.TryPop(packet);
+            packetHeld = true;
         }
 
         // If packet is last, immediatelly send it to frame queue
-        if (_packets.front().last)
+        if (packet.last)
         {
-            _packets.pop();
-            _m_packets.unlock();
+            packet = MediaPacket();
+            packetHeld = false;
 
+            _PushPendingChunk();
             IMediaFrame* lastFrame = new IMediaFrame(-1);
             lastFrame->last = true;
-            _m_frames.lock();
-            _frames.push(lastFrame);
-            _m_frames.unlock();
-
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            _PushFrame(lastFrame);
             continue;
         }
 
-        int response = avcodec_send_packet(_codecContext, _packets.front().GetPacket());
+        int response = avcodec_send_packet(_codecContext, packet.GetPacket());
         if (response != AVERROR(EAGAIN))
         {
-            _packets.pop();
+            packet = MediaPacket();
+            packetHeld = false;
         }
-        _m_packets.unlock();
-        if (response < 0)
+        if (response < 0 && response != AVERROR(EAGAIN))
         {
             printf("Packet decode error %d\n", response);
             continue;
@@ -163,269 +148,83 @@ void AudioDecoder::_DecoderThread()
         if (currentSampleFormat != frame->format)
         {
             currentSampleFormat = frame->format;
-            SelectSampleConverter(&convertChunk, bytesPerSample, frame->format);
             discontinuity = true;
             std::cout << "[AudioDecoder] Sample format changed to " << av_get_sample_fmt_name((AVSampleFormat)currentSampleFormat) << std::endl;
         }
 
-        // The format accepted by XAudio is signed 16 bit, hence the 2 (bytes) at the end
-        int chunkSize = frame->nb_samples * frame->channels * 2;
-        char* audioData = new char[chunkSize];
-
-        // Convert chunk
-        convertChunk({ frame, audioData, bytesPerSample });
-
-        // Create AudioFrame
         long long int timestamp = av_rescale_q(frame->pts, _timebase, { 1, AV_TIME_BASE });
-        AudioFrame* af = new AudioFrame(frame->nb_samples, frame->channels, frame->sample_rate, timestamp, discontinuity);
-        discontinuity = false;
-        af->SetBytes(audioData);
-
-        _m_frames.lock();
-        _frames.push((IMediaFrame*)af);
-        _m_frames.unlock();
 
-        delete[] audioData;
+        // Finish the current chunk if this frame can't continue it
+        if (_pendingChunk.samples)
+        {
+            long long int chunkEnd = _pendingChunk.timestamp + _pendingChunk.sampleCount * 1000000LL / _pendingChunk.sampleRate;
+            bool formatChanged = frame->channels != _pendingChunk.channels
+                || frame->channel_layout != _pendingChunk.channelLayout
+                || frame->sample_rate != _pendingChunk.sampleRate;
+            // Small gaps are timestamp rounding (e.g. millisecond time bases)
+            bool timestampGap = std::abs(timestamp - chunkEnd) > 5000;
+            bool noSpace = _pendingChunk.sampleCount + frame->nb_samples > _pendingChunk.planeStride;
+            if (discontinuity || formatChanged || timestampGap || noSpace)
+                _PushPendingChunk();
+        }
+
+        // Start a new chunk
+        if (!_pendingChunk.samples)
+        {
+            int targetSampleCount = (int)(frame->sample_rate * _chunkDuration.GetDuration(MICROSECONDS) / 1000000);
+            int capacity = std::max(targetSampleCount, frame->nb_samples);
+            _pendingChunk.samples = _chunkPool->AcquireAtLeast((size_t)capacity * frame->channels * sizeof(float));
+            _pendingChunk.planeStride = (int)(_pendingChunk.samples.Size() / ((size_t)frame->channels * sizeof(float)));
+            _pendingChunk.sampleCount = 0;
+            _pendingChunk.targetSampleCount = targetSampleCount;
+            _pendingChunk.channels = frame->channels;
+            _pendingChunk.channelLayout = frame->channel_layout;
+            _pendingChunk.sampleRate = frame->sample_rate;
+            _pendingChunk.timestamp = timestamp;
+            _pendingChunk.first = discontinuity;
+            discontinuity = false;
+        }
+
+        // Convert to float planes (a plain copy for most codecs, which decode to float planar already)
+        float* dest = (float*)_pendingChunk.samples.Data() + _pendingChunk.sampleCount;
+        AudioSampleConverter::Convert(frame, dest, _pendingChunk.planeStride, converterKernel);
+        _pendingChunk.sampleCount += frame->nb_samples;
+        _framesDecoded++;
+
+        if (_pendingChunk.sampleCount >= _pendingChunk.targetSampleCount)
+            _PushPendingChunk();
     }
 
     av_frame_unref(frame);
     av_frame_free(&frame);
 }
 
-void AudioDecoder::_LoadOptions()
-{
-    // Frame buffer size
-    std::wstring optStr = Options::Instance()->GetValue(OPTIONS_MAX_AUDIO_FRAMES);
-    _MAX_FRAME_QUEUE_SIZE = IntOptionAdapter(optStr, 100).Value();
-
-    // Packet buffer size
-    _MAX_PACKET_QUEUE_SIZE = 500;
-}
-
-void SelectSampleConverter(void(**convertChunk)(AudioChunkData), int& bytesPerSample, int sampleFormat)
-{
-    switch (sampleFormat)
-    {
-    case AV_SAMPLE_FMT_U8:
-        (*convertChunk) = &ConvertU8Chunk;
-        bytesPerSample = 1;
-        break;
-    case AV_SAMPLE_FMT_S16:
-        (*convertChunk) = &ConvertS16Chunk;
-        bytesPerSample = 2;
-        break;
-    case AV_SAMPLE_FMT_S32:
-        (*convertChunk) = &ConvertS32Chunk;
-        bytesPerSample = 4;
-        break;
-    case AV_SAMPLE_FMT_FLT:
-        (*convertChunk) = &ConvertFLTChunk;
-        bytesPerSample = 4;
-        break;
-    case AV_SAMPLE_FMT_DBL:
-        (*convertChunk) = &ConvertDBLChunk;
-        bytesPerSample = 8;
-        break;
-    case AV_SAMPLE_FMT_U8P:
-        (*convertChunk) = &ConvertU8PlanarChunk;
-        bytesPerSample = 1;
-        break;
-    case AV_SAMPLE_FMT_S16P:
-        (*convertChunk) = &ConvertS16PlanarChunk;
-        bytesPerSample = 2;
-        break;
-    case AV_SAMPLE_FMT_S32P:
-        (*convertChunk) = &ConvertS32PlanarChunk;
-        bytesPerSample = 4;
-        break;
-    case AV_SAMPLE_FMT_FLTP:
-        (*convertChunk) = &ConvertFLTPlanarChunk;
-        bytesPerSample = 4;
-        break;
-    case AV_SAMPLE_FMT_DBLP:
-        (*convertChunk) = &ConvertDBLPlanarChunk;
-        bytesPerSample = 8;
-        break;
-    default:
-        (*convertChunk) = &ConvertNoneChunk;
-        break;
-    }
-}
-
-void ConvertNoneChunk(AudioChunkData data)
+void AudioDecoder::_PushPendingChunk()
 {
-    std::fill_n(
-        data.frame->data[0],
-        data.frame->nb_samples * data.frame->channels * 2,
-        (int8_t)0
-    );
-}
-
-void ConvertU8Chunk(AudioChunkData data)
-{
-    static constexpr int16_t num = std::numeric_limits<int16_t>::max();
-    static constexpr int16_t den = std::numeric_limits<int8_t>::max();
-    static constexpr int16_t ratio = num / den;
-
-    int curPos = 0;
-    for (int i = 0; i < data.frame->nb_samples; i++)
-    {
-        for (int ch = 0; ch < data.frame->channels; ch++)
-        {
-            uint8_t uval = *(uint8_t*)(data.frame->data[0] + data.bytesPerSample * data.frame->channels * i + data.bytesPerSample * ch);
-            int8_t sval = (int8_t)(uval - 128);
-            int16_t value = (int16_t)(sval * ratio);
-            *(int16_t*)(data.outputData + curPos) = value;
-            curPos += 2;
-        }
-    }
-}
+    if (!_pendingChunk.samples)
+        return;
 
-void ConvertS16Chunk(AudioChunkData data)
-{
-    std::copy_n(
-        data.frame->data[0],
-        data.frame->nb_samples * data.frame->channels * 2,
-        data.outputData
+    AudioFrame* af = new AudioFrame(
+        std::move(_pendingChunk.samples),
+        _pendingChunk.planeStride,
+        _pendingChunk.sampleCount,
+        _pendingChunk.channels,
+        _pendingChunk.sampleRate,
+        _pendingChunk.timestamp,
+        _pendingChunk.first,
+        false,
+        _pendingChunk.channelLayout
     );
+    _pendingChunk = PendingChunk();
+    _PushFrame((IMediaFrame*)af);
 }
 
-void ConvertS32Chunk(AudioChunkData data)
-{
-    static constexpr int32_t num = std::numeric_limits<int32_t>::max();
-    static constexpr int32_t den = std::numeric_limits<int16_t>::max();
-    static constexpr int32_t ratio = num / den;
-
-    int curPos = 0;
-    for (int i = 0; i < data.frame->nb_samples; i++)
-    {
-        for (int ch = 0; ch < data.frame->channels; ch++)
-        {
-            int32_t val = *(int32_t*)(data.frame->data[0] + data.bytesPerSample * data.frame->channels * i + data.bytesPerSample * ch);
-            int16_t value = (int16_t)(val / ratio);
-            *(int16_t*)(data.outputData + curPos) = value;
-            curPos += 2;
-        }
-    }
-}
-
-void ConvertFLTChunk(AudioChunkData data)
-{
-    int curPos = 0;
-    for (int i = 0; i < data.frame->nb_samples; i++)
-    {
-        for (int ch = 0; ch < data.frame->channels; ch++)
-        {
-            float val = *(float*)(data.frame->data[0] + data.bytesPerSample * data.frame->channels * i + data.bytesPerSample * ch);
-            if (val < -1.0f) val = -1.0f;
-            else if (val > 1.0f) val = 1.0f;
-            int16_t value = (int16_t)(val * 32767.0f);
-            *(int16_t*)(data.outputData + curPos) = value;
-            curPos += 2;
-        }
-    }
-}
-
-void ConvertDBLChunk(AudioChunkData data)
-{
-    int curPos = 0;
-    for (int i = 0; i < data.frame->nb_samples; i++)
-    {
-        for (int ch = 0; ch < data.frame->channels; ch++)
-        {
-            double val = *(double*)(data.frame->data[0] + data.bytesPerSample * data.frame->channels * i + data.bytesPerSample * ch);
-            if (val < -1.0) val = -1.0;
-            else if (val > 1.0) val = 1.0;
-            int16_t value = (int16_t)(val * 32767.0);
-            *(int16_t*)(data.outputData + curPos) = value;
-            curPos += 2;
-        }
-    }
-}
-
-void ConvertU8PlanarChunk(AudioChunkData data)
-{
-    static constexpr int16_t num = std::numeric_limits<int16_t>::max();
-    static constexpr int16_t den = std::numeric_limits<int8_t>::max();
-    static constexpr int16_t ratio = num / den;
-
-    int curPos = 0;
-    for (int i = 0; i < data.frame->nb_samples; i++)
-    {
-        for (int ch = 0; ch < data.frame->channels; ch++)
-        {
-            uint8_t uval = *(uint8_t*)(data.frame->data[ch] + data.bytesPerSample * i);
-            int8_t sval = (int8_t)(uval - 128);
-            int16_t value = (int16_t)(sval * ratio);
-            *(int16_t*)(data.outputData + curPos) = value;
-            curPos += 2;
-        }
-    }
-}
-
-void ConvertS16PlanarChunk(AudioChunkData data)
-{
-    int curPos = 0;
-    for (int i = 0; i < data.frame->nb_samples; i++)
-    {
-        for (int ch = 0; ch < data.frame->channels; ch++)
-        {
-            int16_t val = *(int16_t*)(data.frame->data[ch] + data.bytesPerSample * i);
-            *(int16_t*)(data.outputData + curPos) = val;
-            curPos += 2;
-        }
-    }
-}
-
-void ConvertS32PlanarChunk(AudioChunkData data)
-{
-    static constexpr int32_t num = std::numeric_limits<int32_t>::max();
-    static constexpr int32_t den = std::numeric_limits<int16_t>::max();
-    static constexpr int32_t ratio = num / den;
-
-    int curPos = 0;
-    for (int i = 0; i < data.frame->nb_samples; i++)
-    {
-        for (int ch = 0; ch < data.frame->channels; ch++)
-        {
-            int32_t val = *(int32_t*)(data.frame->data[ch] + data.bytesPerSample * i);
-            int16_t value = (int16_t)(val / ratio);
-            *(int16_t*)(data.outputData + curPos) = value;
-            curPos += 2;
-        }
-    }
-}
-
-void ConvertFLTPlanarChunk(AudioChunkData data)
+void AudioDecoder::_LoadOptions()
 {
-    int curPos = 0;
-    for (int i = 0; i < data.frame->nb_samples; i++)
-    {
-        for (int ch = 0; ch < data.frame->channels; ch++)
-        {
-            float val = *(float*)(data.frame->data[ch] + data.bytesPerSample * i);
-            if (val < -1.0f) val = -1.0f;
-            else if (val > 1.0f) val = 1.0f;
-            int16_t value = (int16_t)(val * 32767.0f);
-            *(int16_t*)(data.outputData + curPos) = value;
-            curPos += 2;
-        }
-    }
-}
+    // Chunk buffer size (in chunks of '_chunkDuration')
+    std::wstring optStr = Options::Instance()->GetValue(OPTIONS_MAX_AUDIO_CHUNKS);
+    _frames.SetCapacity(IntOptionAdapter(optStr, 30).Value());
 
-void ConvertDBLPlanarChunk(AudioChunkData data)
-{
-    int curPos = 0;
-    for (int i = 0; i < data.frame->nb_samples; i++)
-    {
-        for (int ch = 0; ch < data.frame->channels; ch++)
-        {
-            double val = *(double*)(data.frame->data[ch] + data.bytesPerSample * i);
-            if (val < -1.0) val = -1.0;
-            else if (val > 1.0) val = 1.0;
-            int16_t value = (int16_t)(val * 32767.0f);
-            *(int16_t*)(data.outputData + curPos) = value;
-            curPos += 2;
-        }
-    }
+    // Packet buffer size
+    _packets.SetCapacity(500);
 }
\ No newline at end of file
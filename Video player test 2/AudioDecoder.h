@@ -1,6 +1,7 @@
 #pragma once
 
 #include "IMediaDecoder.h"
+#include "FrameBufferPool.h"
 
 struct AVCodecContext;
 
@@ -8,6 +9,25 @@ class AudioDecoder : public IMediaDecoder
 {
     AVCodecContext* _codecContext;
 
+    // Consecutive decoded frames are merged into chunks of '_chunkDuration',
+    // so the output receives fewer, larger frames. Chunk memory is recycled
+    // through '_chunkPool' once the output is done with it.
+    struct PendingChunk
+    {
+        FrameBuffer samples;
+        int planeStride = 0;
+        int sampleCount = 0;
+        int targetSampleCount = 0;
+        int channels = 0;
+        uint64_t channelLayout = 0;
+        int sampleRate = 0;
+        long long int timestamp = 0;
+        bool first = false;
+    };
+    PendingChunk _pendingChunk;
+    std::shared_ptr<FrameBufferPool> _chunkPool;
+    Duration _chunkDuration = Duration(80, MILLISECONDS);
+
 public:
     AudioDecoder(const MediaStream& stream);
     ~AudioDecoder();
@@ -18,4 +38,5 @@ public:
 private:
     void _DecoderThread();
     void _LoadOptions();
+    void _PushPendingChunk();
 };
\ No newline at end of file
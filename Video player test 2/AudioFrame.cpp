@@ -1,16 +1,32 @@
 #include "AudioFrame.h"
 
 #include <algorithm>
+#include <cstring>
 
-AudioFrame::AudioFrame(int sampleCount, int channelCount, int sampleRate, long long int timestamp, bool first, bool last)
+AudioFrame::AudioFrame(int sampleCount, int channelCount, int sampleRate, long long int timestamp, bool first, bool last, uint64_t channelLayout)
     : IMediaFrame(TimePoint(timestamp, MICROSECONDS)),
-    _samples(sampleCount),
+    _samples(std::make_unique<unsigned char[]>((size_t)sampleCount * channelCount * sizeof(float)), (size_t)sampleCount * channelCount * sizeof(float)),
+    _planeStride(sampleCount),
+    _sampleCount(sampleCount),
     _channels(channelCount),
+    _channelLayout(channelLayout),
     _sampleRate(sampleRate),
     _timestamp(timestamp),
     _first(first),
-    _last(last),
-    _bytes(std::make_unique<char[]>(sampleCount * channelCount * 2))
+    _last(last)
+{}
+
+AudioFrame::AudioFrame(FrameBuffer samples, int planeStride, int sampleCount, int channelCount, int sampleRate, long long int timestamp, bool first, bool last, uint64_t channelLayout)
+    : IMediaFrame(TimePoint(timestamp, MICROSECONDS)),
+    _samples(std::move(samples)),
+    _planeStride(planeStride),
+    _sampleCount(sampleCount),
+    _channels(channelCount),
+    _channelLayout(channelLayout),
+    _sampleRate(sampleRate),
+    _timestamp(timestamp),
+    _first(first),
+    _last(last)
 {}
 
 AudioFrame::~AudioFrame() {}
@@ -18,26 +34,26 @@ AudioFrame::~AudioFrame() {}
 AudioFrame::AudioFrame(const AudioFrame& ad)
     : IMediaFrame(TimePoint(ad._timestamp, MICROSECONDS))
 {
-    _samples = ad._samples;
-    _channels = ad._channels;
-    _sampleRate = ad._sampleRate;
-    _timestamp = ad._timestamp;
-    int size = _samples * _channels * 2;
-    _bytes = std::make_unique<char[]>(size);
-    std::copy(ad._bytes.get(), ad._bytes.get() + size, _bytes.get());
+    *this = ad;
 }
 
 AudioFrame& AudioFrame::operator=(const AudioFrame& ad)
 {
     if (this != &ad)
     {
-        _samples = ad._samples;
+        _sampleCount = ad._sampleCount;
         _channels = ad._channels;
+        _channelLayout = ad._channelLayout;
         _sampleRate = ad._sampleRate;
         _timestamp = ad._timestamp;
-        int size = _samples * _channels * 2;
-        _bytes = std::make_unique<char[]>(size);
-        std::copy(ad._bytes.get(), ad._bytes.get() + size, _bytes.get());
+        _first = ad._first;
+        _last = ad._last;
+        // Copies are not pooled and have tightly packed planes
+        _planeStride = _sampleCount;
+        size_t size = (size_t)_sampleCount * _channels * sizeof(float);
+        _samples = FrameBuffer(std::unique_ptr<unsigned char[]>(new unsigned char[size]), size);
+        for (int ch = 0; ch < _channels; ch++)
+            std::memcpy(GetPlane(ch), ad.GetPlane(ch), _sampleCount * sizeof(float));
     }
     return *this;
 }
@@ -45,99 +61,71 @@ AudioFrame& AudioFrame::operator=(const AudioFrame& ad)
 AudioFrame::AudioFrame(AudioFrame&& ad) noexcept
     : IMediaFrame(TimePoint(ad._timestamp, MICROSECONDS))
 {
-    _samples = ad._samples;
-    _channels = ad._channels;
-    _sampleRate = ad._sampleRate;
-    _timestamp = ad._timestamp;
-    _bytes = std::move(ad._bytes);
-    ad._samples = 0;
-    ad._channels = 0;
-    ad._sampleRate = 0;
-    ad._timestamp = 0;
+    *this = std::move(ad);
 }
 
 AudioFrame& AudioFrame::operator=(AudioFrame&& ad) noexcept
 {
     if (this != &ad)
     {
-        _samples = ad._samples;
+        _planeStride = ad._planeStride;
+        _sampleCount = ad._sampleCount;
         _channels = ad._channels;
+        _channelLayout = ad._channelLayout;
         _sampleRate = ad._sampleRate;
         _timestamp = ad._timestamp;
-        _bytes = std::move(ad._bytes);
-        ad._samples = 0;
+        _first = ad._first;
+        _last = ad._last;
+        _samples = std::move(ad._samples);
+        ad._planeStride = 0;
+        ad._sampleCount = 0;
         ad._channels = 0;
+        ad._channelLayout = 0;
         ad._sampleRate = 0;
         ad._timestamp = 0;
     }
     return *this;
 }
 
-const char* AudioFrame::GetBytes() const
+float* AudioFrame::GetData()
 {
-    return _bytes.get();
+    return (float*)_samples.Data();
 }
 
-std::unique_ptr<char[]> AudioFrame::GetBytesWithHeader() const
+const float* AudioFrame::GetData() const
 {
-    int dataSize = _samples * _channels * 2;
-    auto fullData = std::make_unique<char[]>(dataSize + sizeof(WaveHeader));
-
-    WaveHeader header;
-    header.chunkID = 0x46464952;
-    header.format = 0x45564157;
-    header.subChunk1ID = 0x20746d66;
-    header.subChunk1Size = 16;
-    header.audioFormat = 1;
-    header.numChannels = _channels;
-    header.sampleRate = _sampleRate;
-    header.byteRate = header.sampleRate * header.numChannels * 2;
-    header.blockAlign = header.numChannels * 2;
-    header.bitsPerSample = 2 * 8;
-    header.subChunk2ID = 0x61746164;
-    header.subChunk2Size = dataSize;
-    header.chunkSize = 4 + (8 + header.subChunk1Size) + (8 + header.subChunk2Size);
-
-    std::copy_n((char*)&header, sizeof(WaveHeader), fullData.get());
-    std::copy_n(_bytes.get(), dataSize, fullData.get() + sizeof(WaveHeader));
-    return fullData;
+    return (const float*)_samples.Data();
 }
 
-WaveHeader AudioFrame::GetHeader() const
+float* AudioFrame::GetPlane(int channel)
 {
-    int dataSize = _samples * _channels * 2;
+    return GetData() + (size_t)channel * _planeStride;
+}
 
-    WaveHeader header;
-    header.chunkID = 0x46464952;
-    header.format = 0x45564157;
-    header.subChunk1ID = 0x20746d66;
-    header.subChunk1Size = 16;
-    header.audioFormat = 1;
-    header.numChannels = _channels;
-    header.sampleRate = _sampleRate;
-    header.byteRate = header.sampleRate * header.numChannels * 2;
-    header.blockAlign = header.numChannels * 2;
-    header.bitsPerSample = 2 * 8;
-    header.subChunk2ID = 0x61746164;
-    header.subChunk2Size = dataSize;
-    header.chunkSize = 4 + (8 + header.subChunk1Size) + (8 + header.subChunk2Size);
+const float* AudioFrame::GetPlane(int channel) const
+{
+    return GetData() + (size_t)channel * _planeStride;
+}
 
-    return header;
+int AudioFrame::GetPlaneStride() const
+{
+    return _planeStride;
 }
 
-void AudioFrame::SetBytes(const char* bytes)
+size_t AudioFrame::DataSize() const
 {
-    std::copy_n(bytes, _samples * _channels * 2, _bytes.get());
+    return (size_t)_sampleCount * _channels * sizeof(float);
 }
 
-void AudioFrame::ClearBytes()
+void AudioFrame::ClearData()
 {
-    std::fill_n(_bytes.get(), _samples * _channels * 2, 0);
+    for (int ch = 0; ch < _channels; ch++)
+        std::fill_n(GetPlane(ch), _sampleCount, 0.0f);
 }
 
 int AudioFrame::GetSampleCount() const
 {
-    return _samples;
+    return _sampleCount;
 }
 
 int AudioFrame::GetChannelCount() const
@@ -145,6 +133,11 @@ int AudioFrame::GetChannelCount() const
     return _channels;
 }
 
+uint64_t AudioFrame::GetChannelLayout() const
+{
+    return _channelLayout;
+}
+
 int AudioFrame::GetSampleRate() const
 {
     return _sampleRate;
@@ -167,5 +160,5 @@ bool AudioFrame::Last() const
 
 Duration AudioFrame::CalculateDuration() const
 {
-    return Duration((_samples * 1000000) / _sampleRate, MICROSECONDS);
+    return Duration((_sampleCount * 1000000LL) / _sampleRate, MICROSECONDS);
 }
\ No newline at end of file
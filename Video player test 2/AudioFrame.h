@@ -2,6 +2,7 @@
 
 #include "IMediaFrame.h"
 #include "GameTime.h"
+#include "FrameBufferPool.h"
 
 #include <cstdint>
 #include <memory>
@@ -25,31 +26,43 @@ struct WaveHeader
     uint32_t subChunk2Size; // numSamples * numChannels * bitsPerSample/8 (this is the actual data size in bytes)
 };
 
+// Decoded audio in the player's internal format: 32 bit float planes,
+// one per channel, 'GetPlaneStride()' values apart. Conversion to the output
+// device format (channel layout, sample rate) happens in AudioResampler.
 class AudioFrame : IMediaFrame
 {
-    std::unique_ptr<char[]> _bytes;
-    int _samples;
+    FrameBuffer _samples;
+    int _planeStride;
+    int _sampleCount;
     int _channels;
+    uint64_t _channelLayout;
     int _sampleRate;
     long long int _timestamp;
     bool _first;
     bool _last;
 
 public:
-    AudioFrame(int sampleCount, int channelCount, int sampleRate, long long int timestamp, bool first = false, bool last = false);
+    // A channel layout of 0 means the default layout for the channel count
+    AudioFrame(int sampleCount, int channelCount, int sampleRate, long long int timestamp, bool first = false, bool last = false, uint64_t channelLayout = 0);
+    // Takes over (usually pooled) sample memory holding 'channelCount' planes of 'planeStride' floats
+    AudioFrame(FrameBuffer samples, int planeStride, int sampleCount, int channelCount, int sampleRate, long long int timestamp, bool first = false, bool last = false, uint64_t channelLayout = 0);
     ~AudioFrame();
     AudioFrame(const AudioFrame& fd);
     AudioFrame& operator=(const AudioFrame& fd);
     AudioFrame(AudioFrame&& fd) noexcept;
     AudioFrame& operator=(AudioFrame&& fd) noexcept;
 
-    const char* GetBytes() const;
-    std::unique_ptr<char[]> GetBytesWithHeader() const;
-    WaveHeader GetHeader() const;
-    void SetBytes(const char* bytes);
-    void ClearBytes();
+    // Start of the first plane; each plane holds 'GetSampleCount()' values
+    float* GetData();
+    const float* GetData() const;
+    float* GetPlane(int channel);
+    const float* GetPlane(int channel) const;
+    int GetPlaneStride() const;
+    size_t DataSize() const;
+    void ClearData();
     int GetSampleCount() const;
     int GetChannelCount() const;
+    uint64_t GetChannelLayout() const;
     int GetSampleRate() const;
     long long int GetTimestamp() const;
     bool First() const;
@@ -0,0 +1,322 @@
+#include "AudioOutputEngine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+AudioOutputEngine::AudioOutputEngine(std::unique_ptr<IAudioSink> sink, int channelCount, int sampleRate)
+    : _sink(std::move(sink)),
+    _channelCount(_sink->Channels()),
+    _sampleRate(_sink->SampleRate()),
+    // 2 seconds of audio, the player only buffers a few hundred ms ahead
+    _samples((size_t)_sink->SampleRate() * _sink->Channels() * 2),
+    _markers(1024),
+    _playedSampleQueue(1000),
+    _correctionInterval(_sink->SampleRate())
+{
+    _playbackTimer.Stop();
+    Reset(channelCount, sampleRate);
+}
+
+AudioOutputEngine::~AudioOutputEngine()
+{
+    _sink->Close();
+}
+
+void AudioOutputEngine::Reset(int channelCount, int sampleRate)
+{
+    Pause();
+
+    if (channelCount == -1 && sampleRate == -1)
+        return;
+
+    if (!_sinkOpen)
+    {
+        _sinkOpen = _sink->Open([this](float* output, int sampleCount) { _Render(output, sampleCount); });
+        if (!_sinkOpen)
+            std::cout << "[AudioOutputEngine] Failed to open audio sink" << std::endl;
+    }
+
+    // The sink is stopped, so both rings can be cleared
+    _samples.Clear();
+    _markers.Clear();
+    _currentMarker = ClockMarker();
+    _audioTimeValid = false;
+    _audioClockBase = 0;
+    _audioTimeLimit = 0;
+    _driftController.Reset();
+    _audioBufferEnd = 0;
+    _correctionPosition = 0;
+    _resampler.Reset();
+
+    _playbackTimer = Clock();
+    _playbackTimer.Stop();
+}
+
+void AudioOutputEngine::AddRawData(const AudioFrame& frame)
+{
+    if (!_sinkOpen)
+        return;
+
+    // Remix/resample to the sink format
+    if (!_resampler.Configure(frame.GetChannelCount(), frame.GetChannelLayout(), frame.GetSampleRate(), _channelCount, 0, _sampleRate))
+        return;
+
+    int64_t timestamp = frame.GetTimestamp();
+    int64_t audioTime = AudioTime();
+    uint64_t readPosition = _samples.ReadPosition() / _channelCount;
+
+    // Positive - audio ahead, negative - audio behind
+    int64_t offset = 0;
+    bool canCorrect = audioTime != -1 && readPosition >= _correctionPosition;
+    if (canCorrect)
+    {
+        _playbackTimer.Update();
+        offset = audioTime - _playbackTimer.Now().GetTime();
+    }
+    bool hardCorrection = canCorrect && std::abs(offset) > _offsetTolerance;
+
+    // Follow the playback rate, nudged by the drift controller
+    double rate = _playbackRate;
+    if (canCorrect && !hardCorrection)
+        rate *= _driftController.Update(Duration(offset, MICROSECONDS), frame.CalculateDuration());
+    _resampler.SetRateAdjustment(rate);
+
+    int maxOutputSamples = _resampler.MaxOutputSamples(frame.GetSampleCount());
+    _resampledData.resize((size_t)maxOutputSamples * _channelCount);
+    int64_t outputSamples = _resampler.Process(frame, _resampledData.data(), maxOutputSamples);
+    if (outputSamples == 0)
+        return;
+
+    // Large offsets (e.g. after the timer jumps) are corrected by inserting silence or cutting audio
+    int64_t samplesToCut = 0;
+    if (hardCorrection)
+    {
+        _driftController.Reset();
+        if (offset > 0)
+        {
+            // Add a silent chunk (up to 500ms)
+            int64_t silenceDuration = std::min(offset, (int64_t)500000);
+            size_t silenceSamples = (size_t)(silenceDuration * _sampleRate / 1000000);
+            ClockMarker marker;
+            marker.position = _samples.WritePosition() / _channelCount;
+            marker.timestamp = timestamp - silenceDuration;
+            _markers.Write(&marker, 1);
+            _samples.Fill(0.0f, std::min(silenceSamples, _FreeSamples()) * _channelCount);
+            std::cout << "[AudioOutputEngine] SYNC: Added silent chunk of length " << silenceDuration << "us" << std::endl;
+        }
+        else
+        {
+            samplesToCut = std::min(-offset * _sampleRate / 1000000, outputSamples);
+            std::cout << "[AudioOutputEngine] SYNC: Cut chunk of length " << samplesToCut * 1000000 / _sampleRate << "us" << std::endl;
+        }
+        _correctionPosition = _samples.WritePosition() / _channelCount + _correctionInterval;
+    }
+
+    int64_t cutDuration = samplesToCut * 1000000 / _sampleRate;
+    _WriteSamples(_resampledData.data() + samplesToCut * _channelCount, outputSamples - samplesToCut, timestamp + cutDuration);
+    _audioBufferEnd = timestamp + outputSamples * 1000000 / _sampleRate;
+}
+
+void AudioOutputEngine::_WriteSamples(const float* samples, size_t sampleCount, int64_t timestamp)
+{
+    if (sampleCount == 0)
+        return;
+
+    ClockMarker marker;
+    marker.position = _samples.WritePosition() / _channelCount;
+    marker.timestamp = timestamp;
+    if (_markers.Write(&marker, 1) == 0)
+        std::cout << "[AudioOutputEngine] Clock marker ring full" << std::endl;
+
+    size_t written = _samples.Write(samples, std::min(sampleCount, _FreeSamples()) * _channelCount) / _channelCount;
+    if (written < sampleCount)
+        std::cout << "[AudioOutputEngine] Sample ring full, dropped " << sampleCount - written << " samples" << std::endl;
+}
+
+size_t AudioOutputEngine::_FreeSamples() const
+{
+    return _samples.Free() / _channelCount;
+}
+
+void AudioOutputEngine::_Render(float* output, int sampleCount)
+{
+    // The block starts playing now; the clock advances through it in real time
+    bool wasValid = _audioTimeValid;
+    int64_t startTime = _AdvanceClock(_samples.ReadPosition() / _channelCount);
+    int64_t now = _SteadyTime();
+
+    size_t valueCount = (size_t)sampleCount * _channelCount;
+    size_t read = _samples.Read(output, valueCount);
+    if (read < valueCount)
+    {
+        std::fill(output + read, output + valueCount, 0.0f);
+        _underruns++;
+    }
+
+    int64_t endTime = _AdvanceClock(_samples.ReadPosition() / _channelCount);
+    if (_audioTimeValid)
+    {
+        // The first marker can be in the middle of the block
+        if (!wasValid)
+            startTime = endTime - (int64_t)(read / _channelCount) * 1000000 / _sampleRate;
+        _audioClockBase = startTime - now;
+        // Underruns stop the clock
+        _audioTimeLimit = endTime;
+    }
+
+    // Recent samples for visualization (skipped rather than blocking the sink thread)
+    std::unique_lock<std::mutex> lock(_m_playedSamples, std::try_to_lock);
+    for (int i = 0; lock.owns_lock() && i < sampleCount; i++)
+    {
+        IAudioOutputAdapter::SampleData data;
+        data.channels = _channelCount < 8 ? _channelCount : 8;
+        data.sampleRate = _sampleRate;
+        for (int ch = 0; ch < data.channels; ch++)
+        {
+            float value = output[(size_t)i * _channelCount + ch];
+            value = value > -1.0f ? value : -1.0f;
+            value = value < 1.0f ? value : 1.0f;
+            data.data[ch] = (int16_t)(value * 32767.0f);
+        }
+        _playedSampleQueue.Push(data);
+    }
+    if (lock.owns_lock())
+        lock.unlock();
+
+    // Volume and balance
+    float volumeL = _volume;
+    float volumeR = _volume;
+    if (_channelCount == 2)
+    {
+        float balance = _balance;
+        if (balance < 0.0f)
+            volumeR *= 1.0f + balance;
+        if (balance > 0.0f)
+            volumeL *= 1.0f - balance;
+    }
+    for (size_t i = 0; i < valueCount; i += _channelCount)
+    {
+        output[i] *= volumeL;
+        for (int ch = 1; ch < _channelCount; ch++)
+            output[i + ch] *= ch == 1 ? volumeR : volumeL;
+    }
+}
+
+int64_t AudioOutputEngine::_AdvanceClock(uint64_t position)
+{
+    while (const ClockMarker* marker = _markers.Peek())
+    {
+        if (marker->position > position)
+            break;
+        _currentMarker = *marker;
+        _markers.Skip(1);
+        _audioTimeValid = true;
+    }
+    return _currentMarker.timestamp + (int64_t)(position - _currentMarker.position) * 1000000 / _sampleRate;
+}
+
+int64_t AudioOutputEngine::_SteadyTime()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::vector<IAudioOutputAdapter::SampleData> AudioOutputEngine::GetRecentSampleData()
+{
+    std::lock_guard<std::mutex> lock(_m_playedSamples);
+    std::vector<SampleData> sdata;
+    sdata.resize(_playedSampleQueue.Size());
+    for (int i = 0; i < _playedSampleQueue.Size(); i++)
+        sdata[i] = _playedSampleQueue[i];
+    return sdata;
+}
+
+void AudioOutputEngine::Play()
+{
+    if (!_sinkOpen)
+        return;
+
+    if (_paused)
+    {
+        _sink->Start();
+        _playbackTimer.Update();
+        _playbackTimer.Start();
+        _paused = false;
+    }
+}
+
+void AudioOutputEngine::Pause()
+{
+    if (!_sinkOpen)
+        return;
+
+    if (!_paused)
+    {
+        _sink->Stop();
+        _playbackTimer.Update();
+        _playbackTimer.Stop();
+        _paused = true;
+    }
+}
+
+bool AudioOutputEngine::Paused() const
+{
+    return _paused;
+}
+
+void AudioOutputEngine::SetVolume(float volume)
+{
+    if (volume > 1.0f) volume = 1.0f;
+    if (volume < 0.0f) volume = 0.0f;
+    _volume = volume;
+}
+
+void AudioOutputEngine::SetPlaybackRate(double rate)
+{
+    _playbackRate = rate;
+    _playbackTimer.Update();
+    _playbackTimer.SetSpeed(rate);
+}
+
+void AudioOutputEngine::SetBalance(float balance)
+{
+    if (balance > 1.0f) balance = 1.0f;
+    if (balance < -1.0f) balance = -1.0f;
+    _balance = balance;
+}
+
+int64_t AudioOutputEngine::CurrentTime()
+{
+    _playbackTimer.Update();
+    return _playbackTimer.Now().GetTime();
+}
+
+void AudioOutputEngine::SetTime(int64_t time)
+{
+    _playbackTimer.Update();
+    _playbackTimer.SetTime(TimePoint(time, MICROSECONDS));
+}
+
+int64_t AudioOutputEngine::BufferLength() const
+{
+    return (int64_t)(_samples.Size() / _channelCount) * 1000000 / _sampleRate;
+}
+
+int64_t AudioOutputEngine::BufferEndTime() const
+{
+    return _audioBufferEnd;
+}
+
+int64_t AudioOutputEngine::AudioTime() const
+{
+    if (!_audioTimeValid)
+        return -1;
+    int64_t time = _SteadyTime() + _audioClockBase.load();
+    return std::min(time, _audioTimeLimit.load());
+}
+
+uint64_t AudioOutputEngine::Underruns() const
+{
+    return _underruns.load();
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "IAudioOutputAdapter.h"
+#include "IAudioSink.h"
+#include "AudioResampler.h"
+#include "SampleRing.h"
+#include "DriftController.h"
+
+#include "GameTime.h"
+#include "FixedQueue.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+// Portable audio output: decoded frames are resampled to the sink format on
+// the player thread and handed to the sink thread through a lock-free ring.
+//
+// The audio clock is derived from the samples the sink has consumed, so it is
+// the same for every sink (device, file or none). Sync correction compares it
+// to the playback timer set by the player.
+class AudioOutputEngine : public IAudioOutputAdapter
+{
+    // Maps a position in the sample stream to a media timestamp
+    struct ClockMarker
+    {
+        uint64_t position = 0; // In samples (per channel)
+        int64_t timestamp = 0; // In microseconds
+    };
+
+    std::unique_ptr<IAudioSink> _sink;
+    bool _sinkOpen = false;
+    // Sink format
+    int _channelCount = 0;
+    int _sampleRate = 0;
+
+    // Player thread -> sink thread
+    SampleRing<float> _samples;
+    SampleRing<ClockMarker> _markers;
+
+    AudioResampler _resampler;
+    std::vector<float> _resampledData;
+    int64_t _audioBufferEnd = 0;
+
+    // Sink thread state
+    ClockMarker _currentMarker;
+    std::atomic<bool> _audioTimeValid = false;
+    // Audio time = steady time + base, up to the end of the last rendered block
+    std::atomic<int64_t> _audioClockBase = 0;
+    std::atomic<int64_t> _audioTimeLimit = 0;
+    std::atomic<uint64_t> _underruns = 0;
+    std::atomic<float> _volume = 0.05f;
+    std::atomic<float> _balance = 0.0f;
+
+    FixedQueue<IAudioOutputAdapter::SampleData> _playedSampleQueue;
+    std::mutex _m_playedSamples;
+
+    Clock _playbackTimer;
+    // Small offsets are corrected by adjusting the resampling rate
+    DriftController _driftController = DriftController(0.2, 0.01, 0.05, Duration(2, MILLISECONDS));
+    double _playbackRate = 1.0;
+    // Larger offsets are corrected by inserting silence or cutting audio
+    int64_t _offsetTolerance = 200000; // In microseconds
+    // A correction waits until the previous one has been played for '_correctionInterval' samples
+    uint64_t _correctionPosition = 0;
+    uint64_t _correctionInterval;
+
+    bool _paused = true;
+
+public:
+    // 'channelCount' and 'sampleRate' of -1 mean there is no audio stream
+    AudioOutputEngine(std::unique_ptr<IAudioSink> sink, int channelCount = -1, int sampleRate = -1);
+    ~AudioOutputEngine();
+    AudioOutputEngine(const AudioOutputEngine&) = delete;
+    AudioOutputEngine& operator=(const AudioOutputEngine&) = delete;
+
+    void Reset(int channelCount, int sampleRate);
+    void AddRawData(const AudioFrame& frame);
+    std::vector<SampleData> GetRecentSampleData();
+    void Play();
+    void Pause();
+    bool Paused() const;
+    void SetVolume(float volume);
+    void SetBalance(float balance);
+    void SetPlaybackRate(double rate);
+    int64_t CurrentTime();
+    void SetTime(int64_t time);
+    int64_t BufferLength() const;
+    int64_t BufferEndTime() const;
+
+    // Timestamp of the next sample the sink will consume, -1 if nothing was played yet
+    int64_t AudioTime() const;
+    // Number of render calls which ran out of samples while playing
+    uint64_t Underruns() const;
+
+private:
+    // Called on the sink thread
+    void _Render(float* output, int sampleCount);
+    // Moves past the clock markers up to 'position' and returns its timestamp
+    int64_t _AdvanceClock(uint64_t position);
+    static int64_t _SteadyTime();
+    void _WriteSamples(const float* samples, size_t sampleCount, int64_t timestamp);
+    // Free space in whole samples (all channels), so channels never shift in the ring
+    size_t _FreeSamples() const;
+};
\ No newline at end of file
@@ -0,0 +1,151 @@
+#include "AudioResampler.h"
+
+extern "C"
+{
+#include <libavutil/channel_layout.h>
+#include <libswresample/swresample.h>
+}
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+AudioResampler::AudioResampler()
+{
+
+}
+
+AudioResampler::~AudioResampler()
+{
+    Reset();
+}
+
+bool AudioResampler::Configure(int inChannels, uint64_t inChannelLayout, int inSampleRate, int outChannels, uint64_t outChannelLayout, int outSampleRate)
+{
+    if (inChannelLayout == 0)
+        inChannelLayout = av_get_default_channel_layout(inChannels);
+    if (outChannelLayout == 0)
+        outChannelLayout = av_get_default_channel_layout(outChannels);
+
+    if (_swrContext &&
+        inChannels == _inChannels &&
+        inChannelLayout == _inChannelLayout &&
+        inSampleRate == _inSampleRate &&
+        outChannels == _outChannels &&
+        outChannelLayout == _outChannelLayout &&
+        outSampleRate == _outSampleRate)
+    {
+        return true;
+    }
+
+    Reset();
+
+    _swrContext = swr_alloc_set_opts(
+        nullptr,
+        outChannelLayout,
+        AV_SAMPLE_FMT_FLT,
+        outSampleRate,
+        inChannelLayout,
+        AV_SAMPLE_FMT_FLTP,
+        inSampleRate,
+        0,
+        nullptr
+    );
+    if (!_swrContext || swr_init(_swrContext) < 0)
+    {
+        std::cout << "[AudioResampler] Failed to initialize swresample" << std::endl;
+        swr_free(&_swrContext);
+        _swrContext = nullptr;
+        return false;
+    }
+
+    _inChannels = inChannels;
+    _inChannelLayout = inChannelLayout;
+    _inSampleRate = inSampleRate;
+    _outChannels = outChannels;
+    _outChannelLayout = outChannelLayout;
+    _outSampleRate = outSampleRate;
+    _compensating = false;
+
+    std::cout << "[AudioResampler] " << inChannels << "ch " << inSampleRate << "Hz -> "
+        << outChannels << "ch " << outSampleRate << "Hz" << std::endl;
+    return true;
+}
+
+bool AudioResampler::Configured() const
+{
+    return _swrContext != nullptr;
+}
+
+void AudioResampler::Reset()
+{
+    if (_swrContext)
+        swr_free(&_swrContext);
+    _swrContext = nullptr;
+    _compensating = false;
+}
+
+int AudioResampler::MaxOutputSamples(int inSamples) const
+{
+    if (!_swrContext)
+        return 0;
+
+    // Leave room for compensation
+    int maxOutSamples = swr_get_out_samples(_swrContext, inSamples);
+    return maxOutSamples + maxOutSamples / 8 + 32;
+}
+
+int AudioResampler::Process(const AudioFrame& frame, float* output, int maxOutputSamples)
+{
+    if (!_swrContext || frame.GetChannelCount() != _inChannels)
+        return 0;
+
+    int inSamples = frame.GetSampleCount();
+
+    // Spread the rate adjustment over the output of this frame
+    if (_rateAdjustment != 1.0 || _compensating)
+    {
+        int expectedSamples = (int)((int64_t)inSamples * _outSampleRate / _inSampleRate);
+        int delta = (int)std::lround(expectedSamples / _rateAdjustment) - expectedSamples;
+        if (expectedSamples > 0)
+            swr_set_compensation(_swrContext, delta, expectedSamples);
+        _compensating = _rateAdjustment != 1.0;
+    }
+
+    _inPlanes.resize(_inChannels);
+    for (int ch = 0; ch < _inChannels; ch++)
+        _inPlanes[ch] = (const uint8_t*)frame.GetPlane(ch);
+
+    uint8_t* outPlanes[1] = { (uint8_t*)output };
+    int outSamples = swr_convert(_swrContext, outPlanes, maxOutputSamples, _inPlanes.data(), inSamples);
+    if (outSamples < 0)
+        outSamples = 0;
+    return outSamples;
+}
+
+void AudioResampler::SetRateAdjustment(double ratio)
+{
+    _rateAdjustment = std::clamp(ratio, 0.9, 1.1);
+}
+
+double AudioResampler::GetRateAdjustment() const
+{
+    return _rateAdjustment;
+}
+
+int64_t AudioResampler::Delay() const
+{
+    if (!_swrContext)
+        return 0;
+    return swr_get_delay(_swrContext, _outSampleRate);
+}
+
+int AudioResampler::OutputChannels() const
+{
+    return _outChannels;
+}
+
+int AudioResampler::OutputSampleRate() const
+{
+    return _outSampleRate;
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "AudioFrame.h"
+
+#include <cstdint>
+#include <vector>
+
+struct SwrContext;
+
+// The single conversion stage between decoded audio and the output device.
+// Remixes channels (e.g. 5.1/7.1 downmix to stereo), converts the sample rate
+// and applies small playback rate adjustments, which allows sync correction
+// without dropping or inserting samples.
+//
+// Input is float planar (AudioFrame), output is interleaved float.
+class AudioResampler
+{
+    SwrContext* _swrContext = nullptr;
+
+    int _inChannels = 0;
+    uint64_t _inChannelLayout = 0;
+    int _inSampleRate = 0;
+    int _outChannels = 0;
+    uint64_t _outChannelLayout = 0;
+    int _outSampleRate = 0;
+
+    double _rateAdjustment = 1.0;
+    bool _compensating = false;
+
+    std::vector<const uint8_t*> _inPlanes;
+
+public:
+    AudioResampler();
+    ~AudioResampler();
+    AudioResampler(const AudioResampler&) = delete;
+    AudioResampler& operator=(const AudioResampler&) = delete;
+
+    // Does nothing if the formats are unchanged. Channel layouts of 0 mean
+    // the default layout for the channel count. Returns false on failure.
+    bool Configure(int inChannels, uint64_t inChannelLayout, int inSampleRate, int outChannels, uint64_t outChannelLayout, int outSampleRate);
+    bool Configured() const;
+    // Drops buffered samples; the next Configure() call reinitializes the stage
+    void Reset();
+
+    // Upper bound of the samples (per channel) Process() can produce from 'inSamples'
+    int MaxOutputSamples(int inSamples) const;
+    // Writes interleaved samples to 'output', which must hold 'maxOutputSamples' samples
+    // (see MaxOutputSamples()). Returns the number of samples (per channel) written.
+    int Process(const AudioFrame& frame, float* output, int maxOutputSamples);
+
+    // Playback speed multiplier. Above 1 plays faster (produces fewer samples).
+    // Meant for small corrections, the ratio is limited to [0.9, 1.1].
+    void SetRateAdjustment(double ratio);
+    double GetRateAdjustment() const;
+
+    // Samples buffered inside the resampler, in output samples
+    int64_t Delay() const;
+
+    int OutputChannels() const;
+    int OutputSampleRate() const;
+};
\ No newline at end of file
@@ -0,0 +1,406 @@
+#include "AudioSampleConverter.h"
+#include "CpuFeatures.h"
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+}
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include <immintrin.h>
+
+using Kernel = AudioSampleConverter::Kernel;
+
+namespace
+{
+    // Packed formats are converted in blocks of this many samples per channel,
+    // so the intermediate buffer stays in L1 cache before being deinterleaved
+    constexpr int BLOCK_SAMPLES = 256;
+
+    // Each source format provides a scalar conversion of a single sample,
+    // an SSE2 conversion of 4 samples and an AVX2 conversion of 8 samples.
+    // Integer formats are scaled to [-1, 1); the same float operations are
+    // used in all kernels, so the results are identical.
+
+    struct SourceU8
+    {
+        using Type = uint8_t;
+
+        static float Scalar(uint8_t value)
+        {
+            return (float)(value - 128) * (1.0f / 128.0f);
+        }
+
+        static __m128 SSE2(const uint8_t* src)
+        {
+            int bytes;
+            std::memcpy(&bytes, src, 4);
+            __m128i x = _mm_cvtsi32_si128(bytes);
+            x = _mm_unpacklo_epi8(x, _mm_setzero_si128());
+            x = _mm_unpacklo_epi16(x, _mm_setzero_si128());
+            x = _mm_sub_epi32(x, _mm_set1_epi32(128));
+            return _mm_mul_ps(_mm_cvtepi32_ps(x), _mm_set1_ps(1.0f / 128.0f));
+        }
+
+        CPU_TARGET("avx2") static __m256 AVX2(const uint8_t* src)
+        {
+            __m256i x = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)src));
+            x = _mm256_sub_epi32(x, _mm256_set1_epi32(128));
+            return _mm256_mul_ps(_mm256_cvtepi32_ps(x), _mm256_set1_ps(1.0f / 128.0f));
+        }
+    };
+
+    struct SourceS16
+    {
+        using Type = int16_t;
+
+        static float Scalar(int16_t value)
+        {
+            return (float)value * (1.0f / 32768.0f);
+        }
+
+        static __m128 SSE2(const int16_t* src)
+        {
+            __m128i x = _mm_loadl_epi64((const __m128i*)src);
+            // Sign extend
+            x = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+            return _mm_mul_ps(_mm_cvtepi32_ps(x), _mm_set1_ps(1.0f / 32768.0f));
+        }
+
+        CPU_TARGET("avx2") static __m256 AVX2(const int16_t* src)
+        {
+            __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)src));
+            return _mm256_mul_ps(_mm256_cvtepi32_ps(x), _mm256_set1_ps(1.0f / 32768.0f));
+        }
+    };
+
+    struct SourceS32
+    {
+        using Type = int32_t;
+
+        static float Scalar(int32_t value)
+        {
+            return (float)value * (1.0f / 2147483648.0f);
+        }
+
+        static __m128 SSE2(const int32_t* src)
+        {
+            __m128i x = _mm_loadu_si128((const __m128i*)src);
+            return _mm_mul_ps(_mm_cvtepi32_ps(x), _mm_set1_ps(1.0f / 2147483648.0f));
+        }
+
+        CPU_TARGET("avx2") static __m256 AVX2(const int32_t* src)
+        {
+            __m256i x = _mm256_loadu_si256((const __m256i*)src);
+            return _mm256_mul_ps(_mm256_cvtepi32_ps(x), _mm256_set1_ps(1.0f / 2147483648.0f));
+        }
+    };
+
+    // Not clamped, the resampling stage needs the headroom
+    struct SourceFLT
+    {
+        using Type = float;
+
+        static float Scalar(float value)
+        {
+            return value;
+        }
+
+        static __m128 SSE2(const float* src)
+        {
+            return _mm_loadu_ps(src);
+        }
+
+        CPU_TARGET("avx2") static __m256 AVX2(const float* src)
+        {
+            return _mm256_loadu_ps(src);
+        }
+    };
+
+    struct SourceDBL
+    {
+        using Type = double;
+
+        static float Scalar(double value)
+        {
+            return (float)value;
+        }
+
+        static __m128 SSE2(const double* src)
+        {
+            __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(src));
+            __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(src + 2));
+            return _mm_movelh_ps(lo, hi);
+        }
+
+        CPU_TARGET("avx2") static __m256 AVX2(const double* src)
+        {
+            __m128 lo = _mm256_cvtpd_ps(_mm256_loadu_pd(src));
+            __m128 hi = _mm256_cvtpd_ps(_mm256_loadu_pd(src + 4));
+            return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+        }
+    };
+
+    // Converts whole groups of 8 samples, returns the number of samples done
+    template<class Source>
+    CPU_TARGET("avx2") int _ConvertRangeAVX2(const typename Source::Type* src, float* dest, int count)
+    {
+        int i = 0;
+        for (; i + 8 <= count; i += 8)
+            _mm256_storeu_ps(dest + i, Source::AVX2(src + i));
+        return i;
+    }
+
+    // Converts 'count' consecutive samples
+    template<class Source>
+    void _ConvertRange(const typename Source::Type* src, float* dest, int count, Kernel kernel)
+    {
+        int i = 0;
+        if (kernel == Kernel::AVX2)
+            i = _ConvertRangeAVX2<Source>(src, dest, count);
+        if (kernel != Kernel::SCALAR)
+        {
+            for (; i + 4 <= count; i += 4)
+                _mm_storeu_ps(dest + i, Source::SSE2(src + i));
+        }
+        for (; i < count; i++)
+            dest[i] = Source::Scalar(src[i]);
+    }
+
+    // Deinterleaves 4 samples of every channel with 4x4 transposes, one per group of 4 channels.
+    // Rows are loaded 4 channels wide, so they can read into the next sample (or past the last
+    // channel); only real channels are stored. Returns the number of samples done.
+    int _DeinterleaveSSE2(const float* src, int channels, int count, float* dest, int planeStride)
+    {
+        int lastGroup = (channels - 1) / 4 * 4;
+        int i = 0;
+        for (; (i + 3) * channels + lastGroup + 4 <= count * channels; i += 4)
+        {
+            for (int group = 0; group <= lastGroup; group += 4)
+            {
+                const float* in = src + i * channels + group;
+                __m128 r0 = _mm_loadu_ps(in);
+                __m128 r1 = _mm_loadu_ps(in + channels);
+                __m128 r2 = _mm_loadu_ps(in + 2 * channels);
+                __m128 r3 = _mm_loadu_ps(in + 3 * channels);
+                _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+                __m128 columns[4] = { r0, r1, r2, r3 };
+                int groupChannels = std::min(4, channels - group);
+                for (int ch = 0; ch < groupChannels; ch++)
+                    _mm_storeu_ps(dest + (size_t)(group + ch) * planeStride + i, columns[ch]);
+            }
+        }
+        return i;
+    }
+
+    // Same as _DeinterleaveSSE2() with 8x8 transposes of 8 samples and 8 channels
+    CPU_TARGET("avx2") int _DeinterleaveAVX2(const float* src, int channels, int count, float* dest, int planeStride)
+    {
+        int lastGroup = (channels - 1) / 8 * 8;
+        int i = 0;
+        for (; (i + 7) * channels + lastGroup + 8 <= count * channels; i += 8)
+        {
+            for (int group = 0; group <= lastGroup; group += 8)
+            {
+                const float* in = src + i * channels + group;
+                __m256 r[8];
+                for (int row = 0; row < 8; row++)
+                    r[row] = _mm256_loadu_ps(in + row * channels);
+
+                __m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+                __m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+                __m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+                __m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+                __m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+                __m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+                __m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+                __m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+
+                __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+                __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+                __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+                __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+                __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+                __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+                __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+                __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+                // 128 bit lanes hold samples 0-3 and 4-7
+                __m256 columns[8] = {
+                    _mm256_permute2f128_ps(s0, s4, 0x20),
+                    _mm256_permute2f128_ps(s1, s5, 0x20),
+                    _mm256_permute2f128_ps(s2, s6, 0x20),
+                    _mm256_permute2f128_ps(s3, s7, 0x20),
+                    _mm256_permute2f128_ps(s0, s4, 0x31),
+                    _mm256_permute2f128_ps(s1, s5, 0x31),
+                    _mm256_permute2f128_ps(s2, s6, 0x31),
+                    _mm256_permute2f128_ps(s3, s7, 0x31)
+                };
+                int groupChannels = std::min(8, channels - group);
+                for (int ch = 0; ch < groupChannels; ch++)
+                    _mm256_storeu_ps(dest + (size_t)(group + ch) * planeStride + i, columns[ch]);
+            }
+        }
+        return i;
+    }
+
+    // Splits 'count' interleaved samples into planes which are 'planeStride' values apart
+    void _Deinterleave(const float* src, int channels, int count, float* dest, int planeStride, Kernel kernel)
+    {
+        int i = 0;
+        if (kernel != Kernel::SCALAR && channels == 2)
+        {
+            float* left = dest;
+            float* right = dest + planeStride;
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128 a = _mm_loadu_ps(src + i * 2);
+                __m128 b = _mm_loadu_ps(src + i * 2 + 4);
+                _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+                _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+            }
+        }
+        else if (kernel != Kernel::SCALAR && channels >= 3)
+        {
+            if (kernel == Kernel::AVX2)
+                i = _DeinterleaveAVX2(src, channels, count, dest, planeStride);
+            i += _DeinterleaveSSE2(src + i * channels, channels, count - i, dest + i, planeStride);
+        }
+        for (; i < count; i++)
+            for (int ch = 0; ch < channels; ch++)
+                dest[ch * planeStride + i] = src[i * channels + ch];
+    }
+
+    template<class Source>
+    void _ConvertPacked(const AVFrame* frame, float* dest, int planeStride, Kernel kernel)
+    {
+        using Type = typename Source::Type;
+        int channels = frame->channels;
+        int sampleCount = frame->nb_samples;
+        const Type* src = (const Type*)frame->data[0];
+
+        if (channels == 1)
+        {
+            _ConvertRange<Source>(src, dest, sampleCount, kernel);
+            return;
+        }
+
+        thread_local std::vector<float> blockBuffer;
+        if (blockBuffer.size() < (size_t)BLOCK_SAMPLES * channels)
+            blockBuffer.resize((size_t)BLOCK_SAMPLES * channels);
+
+        for (int start = 0; start < sampleCount; start += BLOCK_SAMPLES)
+        {
+            int count = std::min(BLOCK_SAMPLES, sampleCount - start);
+            const Type* blockSrc = src + (size_t)start * channels;
+            const float* interleaved;
+            if constexpr (std::is_same_v<Source, SourceFLT>)
+            {
+                // Already in the output format
+                interleaved = blockSrc;
+            }
+            else
+            {
+                _ConvertRange<Source>(blockSrc, blockBuffer.data(), count * channels, kernel);
+                interleaved = blockBuffer.data();
+            }
+            _Deinterleave(interleaved, channels, count, dest + start, planeStride, kernel);
+        }
+    }
+
+    template<class Source>
+    void _ConvertPlanar(const AVFrame* frame, float* dest, int planeStride, Kernel kernel)
+    {
+        using Type = typename Source::Type;
+        for (int ch = 0; ch < frame->channels; ch++)
+        {
+            const Type* src = (const Type*)frame->extended_data[ch];
+            float* plane = dest + (size_t)ch * planeStride;
+            if constexpr (std::is_same_v<Source, SourceFLT>)
+                std::memcpy(plane, src, frame->nb_samples * sizeof(float));
+            else
+                _ConvertRange<Source>(src, plane, frame->nb_samples, kernel);
+        }
+    }
+}
+
+AudioSampleConverter::Kernel AudioSampleConverter::BestKernel()
+{
+    static const Kernel kernel = CpuFeatures::AVX2() ? Kernel::AVX2 : Kernel::SSE2;
+    return kernel;
+}
+
+const char* AudioSampleConverter::KernelName(Kernel kernel)
+{
+    switch (kernel)
+    {
+    case Kernel::AVX2: return "AVX2";
+    case Kernel::SSE2: return "SSE2";
+    default: return "Scalar";
+    }
+}
+
+bool AudioSampleConverter::Supported(int sampleFormat)
+{
+    switch (sampleFormat)
+    {
+    case AV_SAMPLE_FMT_U8:
+    case AV_SAMPLE_FMT_S16:
+    case AV_SAMPLE_FMT_S32:
+    case AV_SAMPLE_FMT_FLT:
+    case AV_SAMPLE_FMT_DBL:
+    case AV_SAMPLE_FMT_U8P:
+    case AV_SAMPLE_FMT_S16P:
+    case AV_SAMPLE_FMT_S32P:
+    case AV_SAMPLE_FMT_FLTP:
+    case AV_SAMPLE_FMT_DBLP:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void AudioSampleConverter::Convert(const AVFrame* frame, float* dest, int planeStride, Kernel kernel)
+{
+    switch (frame->format)
+    {
+    case AV_SAMPLE_FMT_U8:
+        _ConvertPacked<SourceU8>(frame, dest, planeStride, kernel);
+        break;
+    case AV_SAMPLE_FMT_S16:
+        _ConvertPacked<SourceS16>(frame, dest, planeStride, kernel);
+        break;
+    case AV_SAMPLE_FMT_S32:
+        _ConvertPacked<SourceS32>(frame, dest, planeStride, kernel);
+        break;
+    case AV_SAMPLE_FMT_FLT:
+        _ConvertPacked<SourceFLT>(frame, dest, planeStride, kernel);
+        break;
+    case AV_SAMPLE_FMT_DBL:
+        _ConvertPacked<SourceDBL>(frame, dest, planeStride, kernel);
+        break;
+    case AV_SAMPLE_FMT_U8P:
+        _ConvertPlanar<SourceU8>(frame, dest, planeStride, kernel);
+        break;
+    case AV_SAMPLE_FMT_S16P:
+        _ConvertPlanar<SourceS16>(frame, dest, planeStride, kernel);
+        break;
+    case AV_SAMPLE_FMT_S32P:
+        _ConvertPlanar<SourceS32>(frame, dest, planeStride, kernel);
+        break;
+    case AV_SAMPLE_FMT_FLTP:
+        _ConvertPlanar<SourceFLT>(frame, dest, planeStride, kernel);
+        break;
+    case AV_SAMPLE_FMT_DBLP:
+        _ConvertPlanar<SourceDBL>(frame, dest, planeStride, kernel);
+        break;
+    default:
+        for (int ch = 0; ch < frame->channels; ch++)
+            std::fill_n(dest + (size_t)ch * planeStride, frame->nb_samples, 0.0f);
+        break;
+    }
+}
\ No newline at end of file
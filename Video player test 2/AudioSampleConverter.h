@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+struct AVFrame;
+
+// Conversion of decoded audio (any packed or planar FFmpeg sample format)
+// to 32 bit float planes. The SSE2 and AVX2 kernels produce exactly the same
+// output as the scalar one.
+class AudioSampleConverter
+{
+public:
+    enum class Kernel
+    {
+        SCALAR,
+        SSE2,
+        AVX2
+    };
+
+    // Fastest kernel supported by the CPU (checked once)
+    static Kernel BestKernel();
+    static const char* KernelName(Kernel kernel);
+
+    static bool Supported(int sampleFormat);
+
+    // Converts all samples of the frame. Each plane of 'dest' must hold nb_samples values,
+    // planes start 'planeStride' values apart. Unsupported formats produce silence.
+    static void Convert(const AVFrame* frame, float* dest, int planeStride, Kernel kernel);
+};
\ No newline at end of file
@@ -1,5 +1,9 @@
 #include "BasePlaybackController.h"
 
+#include "Network.h"
+
+#include <algorithm>
+
 BasePlaybackController::BasePlaybackController(IMediaDataProvider* dataProvider)
     : _dataProvider(dataProvider), _timerController(true)
 {
@@ -48,6 +52,54 @@ void BasePlaybackController::Update()
     }
 }
 
+TimePoint BasePlaybackController::_SharedTime() const
+{
+    return APP_NETWORK->SharedTime();
+}
+
+bool BasePlaybackController::_SharedTimeSynced() const
+{
+    return APP_NETWORK->SharedTimeSynced();
+}
+
+void BasePlaybackController::_ScheduleAt(TimePoint sharedTime, std::string name, std::function<void()> action)
+{
+    if (!_SharedTimeSynced())
+    {
+        action();
+        return;
+    }
+
+    // A time far in the future would stall playback until it's reached
+    TimePoint latest = _SharedTime() + Duration(_commandDelay.GetTicks() * _MAX_COMMAND_DELAYS_AHEAD);
+    if (sharedTime.GetTicks() > latest.GetTicks())
+        sharedTime = latest;
+
+    auto it = _scheduledActions.begin();
+    while (it != _scheduledActions.end() && it->sharedTime.GetTicks() <= sharedTime.GetTicks())
+        it++;
+    _scheduledActions.insert(it, { sharedTime, std::move(name), std::move(action) });
+    _RunScheduledActions();
+}
+
+void BasePlaybackController::_CancelScheduled(std::string name)
+{
+    auto it = std::remove_if(_scheduledActions.begin(), _scheduledActions.end(), [&](const _ScheduledAction& action) { return action.name == name; });
+    _scheduledActions.erase(it, _scheduledActions.end());
+}
+
+void BasePlaybackController::_RunScheduledActions()
+{
+    TimePoint now = _SharedTime();
+    while (!_scheduledActions.empty() && _scheduledActions.front().sharedTime.GetTicks() <= now.GetTicks())
+    {
+        // The action may schedule/cancel others, so remove it first
+        auto action = std::move(_scheduledActions.front().action);
+        _scheduledActions.erase(_scheduledActions.begin());
+        action();
+    }
+}
+
 void BasePlaybackController::Play()
 {
     _paused = false;
@@ -5,6 +5,7 @@
 #include "MediaPlayer.h"
 #include "IMediaDataProvider.h"
 
+#include <functional>
 #include <set>
 
 class BasePlaybackController : public IPlaybackController
@@ -207,6 +208,32 @@ protected:
 
     _TimerController _timerController;
 
+    // Actions which must happen at a specific shared time (see _SharedTime()),
+    // ordered by time. Used to make all users play/pause/resume at the same moment.
+    struct _ScheduledAction
+    {
+        TimePoint sharedTime;
+        std::string name;
+        std::function<void()> action;
+    };
+    std::vector<_ScheduledAction> _scheduledActions;
+    // How far ahead commands are scheduled, must cover the one-way latency to the receivers
+    Duration _commandDelay = Duration(150, MILLISECONDS);
+    // Times further ahead than this many command delays are treated as clock errors
+    static constexpr int _MAX_COMMAND_DELAYS_AHEAD = 4;
+
+    // Time of the clock shared by all users (equal to local time when offline)
+    TimePoint _SharedTime() const;
+    // False while the shared clock isn't synchronized with the server yet
+    bool _SharedTimeSynced() const;
+    // Runs 'action' once _SharedTime() reaches 'sharedTime' (immediately, if it already has).
+    // Without a synchronized clock the time is meaningless, so the action runs immediately.
+    void _ScheduleAt(TimePoint sharedTime, std::string name, std::function<void()> action);
+    // Drops all scheduled actions with the specified name
+    void _CancelScheduled(std::string name);
+    // Must be called every update by controllers which schedule actions
+    void _RunScheduledActions();
+
 public:
     BasePlaybackController(IMediaDataProvider* dataProvider);
     // WARNING:
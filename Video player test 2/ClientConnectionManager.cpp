@@ -658,7 +658,7 @@ void znet::ClientConnectionManager::_ManageConnections()
                 latency += packetLatencies[i].GetDuration();
             latency /= packetLatencies.Size();
 
-            App::Instance()->events.RaiseEvent(NetworkStatsEvent{ timeElapsed, (int64_t)bytesSentSinceLastPrint, (int64_t)bytesReceivedSinceLastPrint, latency });
+            App::Instance()->events.RaiseEvent(NetworkStatsEvent{ timeElapsed, (int64_t)bytesSentSinceLastPrint, (int64_t)bytesReceivedSinceLastPrint, latency, -1, -1, -1 });
 
             lastPrintTime = ztime::Main();
             std::cout << "[INFO] Avg. send speed: " << bytesSentSinceLastPrint / timeElapsed.GetDuration(MILLISECONDS) << "kb/s" << std::endl;
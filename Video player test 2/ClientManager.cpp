@@ -58,11 +58,11 @@ void znet::ClientManager::_Connect(std::string ip, uint16_t port)
         {
             PacketBuilder builder;
             builder.Add(_password.data(), _password.length());
-            connection->Send(Packet(builder.Release(), builder.UsedBytes(), (int)PacketType::PASSWORD), std::numeric_limits<int>::max());
+            connection->Send(Packet(builder.Release(), builder.UsedBytes(), (int)PacketType::PASSWORD), std::numeric_limits<int>::max(), Channel::CONTROL);
         }
         else
         {
-            connection->Send(Packet((int)PacketType::PASSWORD), std::numeric_limits<int>::max());
+            connection->Send(Packet((int)PacketType::PASSWORD), std::numeric_limits<int>::max(), Channel::CONTROL);
         }
 
         // Wait for assigned id to arrive
@@ -176,6 +176,16 @@ int64_t znet::ClientManager::ThisUserId()
     return _thisUser.id;
 }
 
+TimePoint znet::ClientManager::SharedTime()
+{
+    return _clockSync.ToShared(ClockSync::LocalTime());
+}
+
+bool znet::ClientManager::SharedTimeSynced()
+{
+    return _clockSync.Synced();
+}
+
 void znet::ClientManager::Send(Packet&& packet, std::vector<int64_t> userIds, int priority)
 {
     // Immediatelly distribute self-addressed packets
@@ -408,6 +418,8 @@ void znet::ClientManager::_ManageConnections()
     {
         if (_SendLatencyProbePackets(data))
             break;
+        if (_SendClockSyncProbePackets(data))
+            break;
         if (_CheckIfConnectionExists(data))
             break;
         if (_ProcessIncomingPackets(data))
@@ -439,7 +451,7 @@ bool znet::ClientManager::_SendLatencyProbePackets(_ManagerThreadData& data)
     {
         if (ztime::Main() - data.latencyPacketReceiveTime >= data.latencyPacketInterval)
         {
-            data.connection->Send(znet::Packet((int)znet::PacketType::LATENCY_PROBE).From(0), 1024 /* Arbitrarily large priority */);
+            data.connection->Send(znet::Packet((int)znet::PacketType::LATENCY_PROBE).From(0), 1024 /* Arbitrarily large priority */, Channel::CONTROL);
             data.latencyPacketInTransmission = true;
             data.latencyPacketSendTime = ztime::Main();
         }
@@ -448,6 +460,20 @@ bool znet::ClientManager::_SendLatencyProbePackets(_ManagerThreadData& data)
     return false;
 }
 
+bool znet::ClientManager::_SendClockSyncProbePackets(_ManagerThreadData& data)
+{
+    // Probes are independent (each carries its own send time),
+    // so there is no need to wait for the previous one to return
+    Duration interval = _clockSync.Synced() ? data.clockSyncProbeInterval : data.clockSyncInitialProbeInterval;
+    if (ztime::Main() - data.clockSyncProbeSendTime >= interval)
+    {
+        data.connection->Send(znet::Packet((int)znet::PacketType::CLOCK_SYNC_PROBE).From(ClockSync::LocalTime().GetTicks()), 1024 /* Arbitrarily large priority */, Channel::CONTROL);
+        data.clockSyncProbeSendTime = ztime::Main();
+    }
+
+    return false;
+}
+
 bool znet::ClientManager::_CheckIfConnectionExists(_ManagerThreadData& data)
 {
     if (!data.connection->Connected())
@@ -476,14 +502,10 @@ bool znet::ClientManager::_ProcessIncomingPackets(_ManagerThreadData& data)
         Packet pack1 = data.connection->GetPacket();
         if (pack1.id == (int32_t)PacketType::BYTE_CONFIRMATION)
         {
-            data.bytesUnconfirmed -= pack1.Cast<size_t>();
             // Increment connection speed counter
             data.bytesSentSinceLastPrint += pack1.Cast<size_t>();
-            // Calculate latency
             data.threadTimer.Update();
-            TimePoint returnTime = data.threadTimer.Now();
-            TimePoint sendTime = data.packetsInTransmittion.front();
-            data.packetsInTransmittion.pop();
+            data.congestion.OnConfirmed(pack1.Cast<size_t>(), data.threadTimer.Now());
         }
         else if (pack1.id == (int32_t)PacketType::KEEP_ALIVE)
         {
@@ -495,6 +517,15 @@ bool znet::ClientManager::_ProcessIncomingPackets(_ManagerThreadData& data)
             data.latencyPacketInTransmission = false;
             data.packetLatencies.Push(data.latencyPacketReceiveTime - data.latencyPacketSendTime);
         }
+        else if (pack1.id == (int32_t)PacketType::CLOCK_SYNC_PROBE)
+        {
+            TimePoint t3 = ClockSync::LocalTime();
+            PacketReader reader(pack1.Bytes(), pack1.size);
+            TimePoint t0 = reader.Get<int64_t>();
+            TimePoint t1 = reader.Get<int64_t>();
+            TimePoint t2 = reader.Get<int64_t>();
+            _clockSync.AddProbe(t0, t1, t2, t3);
+        }
         else if (pack1.id == (int32_t)PacketType::DISCONNECT_REQUEST)
         {
             data.connection->Disconnect();
@@ -545,7 +576,8 @@ bool znet::ClientManager::_ProcessIncomingPackets(_ManagerThreadData& data)
                 data.bytesReceivedSinceLastPrint += pack2.size;
 
                 // Send confirmation packet
-                data.connection->Send(Packet((int)PacketType::BYTE_CONFIRMATION).From(pack2.size), 1);
+                if (IsBulkPacket(pack2.id))
+                    data.connection->Send(Packet((int)PacketType::BYTE_CONFIRMATION).From(pack2.size), 1, Channel::CONTROL);
 
                 // Process split packets
                 if (pack2.id == (int)PacketType::SPLIT_PACKET_HEAD)
@@ -558,56 +590,48 @@ bool znet::ClientManager::_ProcessIncomingPackets(_ManagerThreadData& data)
                         size_t packetSize;
                     };
                     auto headData = pack2.Cast<SplitHead>();
-                    data.splitPackets.push_back({ headData.splitId, headData.packetId, headData.partCount, headData.packetSize });
+                    auto& split = data.splitPackets[headData.splitId];
+                    split.packetId = headData.packetId;
+                    split.partCount = headData.partCount;
+                    split.packetSize = headData.packetSize;
+                    split.bytes = PacketBufferPool::Instance()->Acquire(headData.packetSize);
                 }
                 else if (pack2.id == (int)PacketType::SPLIT_PACKET_PART)
                 {
                     int64_t splitId = pack2.Cast<int64_t>();
-                    int index = -1;
-                    for (int i = 0; i < data.splitPackets.size(); i++)
+                    auto it = data.splitPackets.find(splitId);
+                    if (it != data.splitPackets.end())
                     {
-                        if (data.splitPackets[i].splitId == splitId)
+                        // Copy the part into place
+                        auto& split = it->second;
+                        size_t partDataOffset = sizeof(int64_t) + sizeof(int32_t);
+                        size_t byteCount = pack2.size - partDataOffset;
+                        if (pack2.size < partDataOffset || split.bytesReceived + byteCount > split.packetSize)
                         {
-                            data.splitPackets[i].parts.push_back(pack2.Reference());
-                            index = i;
-                            break;
+                            data.splitPackets.erase(it);
                         }
-                    }
-
-                    // Check if all parts received
-                    if (index != -1)
-                    {
-                        if (data.splitPackets[index].parts.size() == data.splitPackets[index].partCount)
+                        else
                         {
-                            // Combine
-                            auto bytes = std::make_unique<int8_t[]>(data.splitPackets[index].packetSize);
-                            size_t bytePos = 0;
-                            size_t partDataOffset = sizeof(int64_t) + sizeof(int32_t);
-                            for (auto& part : data.splitPackets[index].parts)
+                            std::copy_n(pack2.Bytes() + partDataOffset, byteCount, split.bytes.get() + split.bytesReceived);
+                            split.bytesReceived += byteCount;
+                            split.partsReceived++;
+
+                            // Check if all parts received
+                            if (split.partsReceived == split.partCount)
                             {
-                                size_t byteCount = part.size - partDataOffset;
-                                std::copy_n(part.Bytes() + partDataOffset, byteCount, bytes.get() + bytePos);
-                                bytePos += byteCount;
-                            }
-                            Packet combined = Packet(std::move(bytes), data.splitPackets[index].packetSize, data.splitPackets[index].packetId);
-                            data.splitPackets.erase(data.splitPackets.begin() + index);
+                                Packet combined = Packet(std::move(split.bytes), split.bytesReceived, split.packetId);
+                                data.splitPackets.erase(it);
 
-                            // Pass to handler
-                            _packetReceivedHandler(std::move(combined), pack1.Cast<int64_t>());
+                                // Pass to handler
+                                _packetReceivedHandler(std::move(combined), pack1.Cast<int64_t>());
+                            }
                         }
                     }
                 }
                 else if (pack2.id == (int)PacketType::SPLIT_PACKET_ABORT)
                 {
                     int64_t splitId = pack2.Cast<int64_t>();
-                    for (int i = 0; i < data.splitPackets.size(); i++)
-                    {
-                        if (data.splitPackets[i].splitId == splitId)
-                        {
-                            data.splitPackets.erase(data.splitPackets.begin() + i);
-                            break;
-                        }
-                    }
+                    data.splitPackets.erase(splitId);
                 }
                 else
                 {
@@ -643,21 +667,11 @@ bool znet::ClientManager::_ProcessOutgoingPackets(_ManagerThreadData& data)
 
         PacketView view = _outPackets[i].first.packet.View();
 
-        // Heavy packets will be postponed until unconfirmed byte count is below a certain value
-        bool heavyPacket = (
-            view.id == (int32_t)PacketType::SPLIT_PACKET_PART ||
-            view.id == (int32_t)PacketType::VIDEO_PACKET ||
-            view.id == (int32_t)PacketType::AUDIO_PACKET ||
-            view.id == (int32_t)PacketType::SUBTITLE_PACKET ||
-            view.id == (int32_t)PacketType::VIDEO_STREAM ||
-            view.id == (int32_t)PacketType::AUDIO_STREAM ||
-            view.id == (int32_t)PacketType::SUBTITLE_STREAM ||
-            view.id == (int32_t)PacketType::ATTACHMENT_STREAM ||
-            view.id == (int32_t)PacketType::DATA_STREAM ||
-            view.id == (int32_t)PacketType::UNKNOWN_STREAM
-            );
+        // Bulk packets will be postponed until the congestion window allows them
+        bool bulkPacket = IsBulkPacket(view.id);
 
-        if (heavyPacket && data.bytesUnconfirmed > data.maxUnconfirmedBytes)
+        data.threadTimer.Update();
+        if (bulkPacket && !data.congestion.CanSend(data.threadTimer.Now()))
             continue;
 
         _PacketData pdata = std::move(_outPackets[i].first);
@@ -665,9 +679,8 @@ bool znet::ClientManager::_ProcessOutgoingPackets(_ManagerThreadData& data)
         _outPackets.erase(_outPackets.begin() + i);
         lock.unlock();
 
-        data.bytesUnconfirmed += pdata.packet.size;
-        data.threadTimer.Update();
-        data.packetsInTransmittion.push(data.threadTimer.Now());
+        if (bulkPacket)
+            data.congestion.OnSent(pdata.packet.size, data.threadTimer.Now());
 
         // Some packet types don't need a prefix
         bool prefixed = !(
@@ -683,7 +696,7 @@ bool znet::ClientManager::_ProcessOutgoingPackets(_ManagerThreadData& data)
             data.connection->AddToQueue(Packet(builder.Release(), builder.UsedBytes(), (int)PacketType::USER_ID));
         }
         data.connection->AddToQueue(std::move(pdata.packet));
-        data.connection->SendQueue(priority);
+        data.connection->SendQueue(priority, bulkPacket ? Channel::BULK : Channel::CONTROL);
 
         break;
     }
@@ -701,7 +714,11 @@ void znet::ClientManager::_PrintNetworkStats(_ManagerThreadData& data)
             latency += data.packetLatencies[i].GetDuration();
         latency /= data.packetLatencies.Size();
 
-        App::Instance()->events.RaiseEvent(NetworkStatsEvent{ timeElapsed, (int64_t)data.bytesSentSinceLastPrint, (int64_t)data.bytesReceivedSinceLastPrint, latency });
+        int64_t roundTrip = -1;
+        if (data.congestion.RoundTrip().GetTicks() >= 0)
+            roundTrip = data.congestion.RoundTrip().GetDuration(MICROSECONDS);
+
+        App::Instance()->events.RaiseEvent(NetworkStatsEvent{ timeElapsed, (int64_t)data.bytesSentSinceLastPrint, (int64_t)data.bytesReceivedSinceLastPrint, latency, data.congestion.Window(), roundTrip, data.congestion.Bandwidth() });
 
         data.lastPrintTime = ztime::Main();
         data.bytesSentSinceLastPrint = 0;
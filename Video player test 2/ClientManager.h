@@ -2,10 +2,13 @@
 
 #include "INetworkManager.h"
 #include "PacketTypes.h"
+#include "CongestionController.h"
 
 #include "FixedQueue.h"
 #include "GameTime.h"
 
+#include <unordered_map>
+
 namespace znet
 {
     class ClientManager : public INetworkManager
@@ -19,6 +22,8 @@ namespace znet
         std::vector<int64_t> UserIds(bool includeSelf);
         User ThisUser();
         int64_t ThisUserId();
+        TimePoint SharedTime();
+        bool SharedTimeSynced();
 
         void Send(Packet&& packet, std::vector<int64_t> userIds, int priority = 0);
         void AddToQueue(Packet&& packet);
@@ -31,6 +36,7 @@ namespace znet
         std::wstring FailMessage() const { return _failMessage; }
         int FailCode() const { return _failCode; }
         bool Online() const { return _online; }
+        bool ClockSynced() const { return _clockSync.Synced(); }
 
     private:
         struct _PacketData
@@ -70,25 +76,27 @@ namespace znet
         std::deque<_PacketData> _packetQueue;
         int64_t _splitIdCounter = 0;
 
+        ClockSync _clockSync;
+
         struct _ManagerThreadData
         {
+            // Parts are copied into 'bytes' as they arrive
             struct SplitPacket
             {
-                int64_t splitId;
                 int32_t packetId;
                 int32_t partCount;
+                int32_t partsReceived = 0;
                 size_t packetSize;
-                std::vector<znet::Packet> parts;
+                size_t bytesReceived = 0;
+                std::shared_ptr<int8_t[]> bytes;
             };
 
             TCPClientRef& connection;
 
             Clock threadTimer = Clock();
 
-            std::vector<SplitPacket> splitPackets;
-            size_t bytesUnconfirmed = 0;
-            size_t maxUnconfirmedBytes = 250000; // 1 MB
-            std::queue<TimePoint> packetsInTransmittion;
+            std::unordered_map<int64_t, SplitPacket> splitPackets; // key - split id
+            CongestionController congestion;
 
             TimePoint latencyPacketSendTime = ztime::Main();
             TimePoint latencyPacketReceiveTime = ztime::Main();
@@ -103,6 +111,11 @@ namespace znet
             bool printStats = true;
 
             TimePoint lastKeepAliveReceiveTime = ztime::Main();
+
+            // Probes are sent quickly until the first estimate is available
+            TimePoint clockSyncProbeSendTime = ztime::Main();
+            Duration clockSyncProbeInterval = Duration(1, SECONDS);
+            Duration clockSyncInitialProbeInterval = Duration(100, MILLISECONDS);
         };
 
         // Places the packets in the outgoing packet queue,
@@ -114,6 +127,7 @@ namespace znet
 
         void _ManageConnections();
         bool _SendLatencyProbePackets(_ManagerThreadData& data);
+        bool _SendClockSyncProbePackets(_ManagerThreadData& data);
         bool _CheckIfConnectionExists(_ManagerThreadData& data);
         bool _ProcessIncomingPackets(_ManagerThreadData& data);
         bool _ProcessOutgoingPackets(_ManagerThreadData& data);
@@ -0,0 +1,138 @@
+#include "ClockSync.h"
+
+#include <algorithm>
+#include <chrono>
+
+znet::ClockSync::ClockSync(size_t windowSize, size_t maxSamples)
+    : _windowSize(windowSize), _maxSamples(maxSamples)
+{}
+
+TimePoint znet::ClockSync::LocalTime()
+{
+    return TimePoint(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void znet::ClockSync::AddProbe(TimePoint t0, TimePoint t1, TimePoint t2, TimePoint t3)
+{
+    _Sample sample;
+    sample.roundTrip = (t3.GetTicks() - t0.GetTicks()) - (t2.GetTicks() - t1.GetTicks());
+    sample.offset = ((t1.GetTicks() - t0.GetTicks()) + (t2.GetTicks() - t3.GetTicks())) / 2;
+    sample.localTime = t3.GetTicks();
+    // Server processing took longer than the whole round trip, the timestamps are broken
+    if (sample.roundTrip < 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(_m_samples);
+    _window.push_back(sample);
+    if (_window.size() >= _windowSize)
+    {
+        auto best = std::min_element(_window.begin(), _window.end(), [](const _Sample& a, const _Sample& b) { return a.roundTrip < b.roundTrip; });
+        _samples.push_back(*best);
+        if (_samples.size() > _maxSamples)
+            _samples.pop_front();
+        _window.clear();
+    }
+    _UpdateEstimate();
+}
+
+void znet::ClockSync::Reset()
+{
+    std::lock_guard<std::mutex> lock(_m_samples);
+    _window.clear();
+    _samples.clear();
+    _baseTime = 0;
+    _baseOffset = 0.0;
+    _skew = 0.0;
+    _roundTrip = 0;
+    _synced = false;
+}
+
+bool znet::ClockSync::Synced() const
+{
+    std::lock_guard<std::mutex> lock(_m_samples);
+    return _synced;
+}
+
+Duration znet::ClockSync::Offset(TimePoint localTime) const
+{
+    std::lock_guard<std::mutex> lock(_m_samples);
+    return Duration((int64_t)(_baseOffset + _skew * (localTime.GetTicks() - _baseTime)));
+}
+
+double znet::ClockSync::Skew() const
+{
+    std::lock_guard<std::mutex> lock(_m_samples);
+    return _skew;
+}
+
+Duration znet::ClockSync::RoundTrip() const
+{
+    std::lock_guard<std::mutex> lock(_m_samples);
+    return Duration(_roundTrip);
+}
+
+TimePoint znet::ClockSync::ToShared(TimePoint localTime) const
+{
+    return localTime + Offset(localTime);
+}
+
+TimePoint znet::ClockSync::ToLocal(TimePoint sharedTime) const
+{
+    // Skew is tiny, so evaluating the offset at the shared time is accurate enough
+    return sharedTime - Offset(sharedTime);
+}
+
+void znet::ClockSync::_UpdateEstimate()
+{
+    // Filtered samples, plus the best one of the unfinished window,
+    // so the estimate is available before the first window completes
+    std::vector<_Sample> points(_samples.begin(), _samples.end());
+    if (!_window.empty())
+    {
+        auto best = std::min_element(_window.begin(), _window.end(), [](const _Sample& a, const _Sample& b) { return a.roundTrip < b.roundTrip; });
+        points.push_back(*best);
+    }
+    if (points.empty())
+        return;
+
+    _synced = !_samples.empty() || _window.size() >= 3;
+
+    auto best = std::min_element(points.begin(), points.end(), [](const _Sample& a, const _Sample& b) { return a.roundTrip < b.roundTrip; });
+    _roundTrip = best->roundTrip;
+
+    // Too short a span for a meaningful slope, use the most accurate offset
+    int64_t span = points.back().localTime - points.front().localTime;
+    if (points.size() < 4 || span < Duration(30, SECONDS).GetTicks())
+    {
+        _baseTime = best->localTime;
+        _baseOffset = (double)best->offset;
+        _skew = 0.0;
+        return;
+    }
+
+    // Least squares fit, relative to the first point to keep the values small
+    int64_t origin = points.front().localTime;
+    double meanTime = 0.0;
+    double meanOffset = 0.0;
+    for (auto& point : points)
+    {
+        meanTime += (double)(point.localTime - origin);
+        meanOffset += (double)point.offset;
+    }
+    meanTime /= points.size();
+    meanOffset /= points.size();
+
+    double covariance = 0.0;
+    double variance = 0.0;
+    for (auto& point : points)
+    {
+        double dt = (double)(point.localTime - origin) - meanTime;
+        covariance += dt * ((double)point.offset - meanOffset);
+        variance += dt * dt;
+    }
+
+    _baseTime = origin + (int64_t)meanTime;
+    _baseOffset = meanOffset;
+    // Real crystal drift is well below 500 ppm, anything more is noise
+    _skew = std::clamp(variance > 0.0 ? covariance / variance : 0.0, -500e-6, 500e-6);
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "GameTime.h"
+
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace znet
+{
+    // Estimates the offset and skew of the server clock relative to this machine's clock
+    // from NTP-style probes:
+    //  t0 - probe sent by the client
+    //  t1 - probe received by the server
+    //  t2 - reply sent by the server
+    //  t3 - reply received by the client
+    //
+    // Queuing delays only ever increase the round trip time and skew the offset,
+    // so only the probe with the lowest round trip from every window is kept.
+    // The skew is the slope of a least squares fit over the kept offsets.
+    class ClockSync
+    {
+    public:
+        ClockSync(size_t windowSize = 8, size_t maxSamples = 32);
+
+        // Monotonic time of this machine, in which all probe times are measured
+        static TimePoint LocalTime();
+
+        void AddProbe(TimePoint t0, TimePoint t1, TimePoint t2, TimePoint t3);
+        void Reset();
+
+        // Whether enough probes were received for the estimate to be usable
+        bool Synced() const;
+        // How far the server clock is ahead of the local clock at 'localTime'
+        Duration Offset(TimePoint localTime) const;
+        // Server clock drift relative to local clock (1e-6 = 1 ppm)
+        double Skew() const;
+        // Lowest round trip in the current estimate
+        Duration RoundTrip() const;
+
+        TimePoint ToShared(TimePoint localTime) const;
+        TimePoint ToLocal(TimePoint sharedTime) const;
+
+    private:
+        struct _Sample
+        {
+            int64_t localTime;
+            int64_t offset;
+            int64_t roundTrip;
+        };
+
+        void _UpdateEstimate();
+
+        mutable std::mutex _m_samples;
+        std::vector<_Sample> _window;
+        size_t _windowSize;
+        std::deque<_Sample> _samples;
+        size_t _maxSamples;
+
+        // offset(t) = _baseOffset + _skew * (t - _baseTime)
+        int64_t _baseTime = 0;
+        double _baseOffset = 0.0;
+        double _skew = 0.0;
+        int64_t _roundTrip = 0;
+        bool _synced = false;
+    };
+}
\ No newline at end of file
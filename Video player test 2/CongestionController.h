@@ -0,0 +1,207 @@
+#pragma once
+
+#include "GameTime.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+
+namespace znet
+{
+    // Limits the unconfirmed bytes sent to one peer, based on BYTE_CONFIRMATION timing.
+    //
+    // Delay based (LEDBAT-like): the lowest round trip seen recently is the path delay,
+    // anything above it is queuing. The window grows while the queuing delay is below
+    // the target and shrinks when above, so the send buffers stay short and control
+    // packets aren't stuck behind seconds of media. Starts by doubling every round trip
+    // until queuing appears. Delivery rate samples (BBR-like) give the bandwidth estimate.
+    //
+    // A continuously full queue would hide the path delay, so every 10s the window is cut
+    // to a quarter for a round trip (like BBR's ProbeRTT) to measure it again.
+    //
+    // Confirmations must arrive in the order the packets were sent, so only
+    // bulk channel packets are counted (see IsBulkPacket()).
+    class CongestionController
+    {
+        struct _InFlight
+        {
+            TimePoint sendTime;
+            int64_t bytes;
+            int64_t deliveredAtSend;
+            bool windowLimited;
+        };
+        std::deque<_InFlight> _inFlight;
+        int64_t _bytesInFlight = 0;
+        int64_t _delivered = 0;
+
+        int64_t _window;
+        int64_t _minWindow;
+        int64_t _maxWindow;
+        Duration _targetDelay;
+        bool _slowStart = true;
+
+        // Lowest round trip of the current and previous 10s period
+        TimePoint _minRttPeriodStart = TimePoint(0);
+        TimePoint _probeEndTime = TimePoint(0);
+        Duration _minRtt = Duration(-1);
+        Duration _prevPeriodMinRtt = Duration(-1);
+        Duration _smoothedRtt = Duration(-1);
+        // Most recent samples, the lowest one filters out single delayed confirmations
+        std::deque<Duration> _recentRtts;
+
+        // Highest delivery rate of the current and previous 1s period, bytes/s
+        TimePoint _bandwidthPeriodStart = TimePoint(0);
+        int64_t _bandwidth = 0;
+        int64_t _prevPeriodBandwidth = 0;
+
+        // Approximate size of a single heavy packet, the unit of linear window growth
+        static constexpr int64_t _SEGMENT_SIZE = 50000;
+
+    public:
+        CongestionController(int64_t initialWindow = 250000, int64_t minWindow = 64000, int64_t maxWindow = 64000000, Duration targetDelay = Duration(50, MILLISECONDS))
+            : _window(initialWindow), _minWindow(minWindow), _maxWindow(maxWindow), _targetDelay(targetDelay)
+        {}
+
+        // Whether another bulk packet can be sent now
+        bool CanSend(TimePoint now) const
+        {
+            if (now < _probeEndTime)
+                return _bytesInFlight <= std::max(_minWindow, _window / 4);
+            return _bytesInFlight <= _window;
+        }
+
+        void OnSent(int64_t bytes, TimePoint now)
+        {
+            _inFlight.push_back({ now, bytes, _delivered, _bytesInFlight + bytes >= _window / 2 });
+            _bytesInFlight += bytes;
+        }
+
+        void OnConfirmed(int64_t bytes, TimePoint now)
+        {
+            // Match the confirmation with the packets it covers
+            _InFlight newest;
+            bool packetConfirmed = false;
+            int64_t bytesLeft = bytes;
+            while (bytesLeft > 0 && !_inFlight.empty())
+            {
+                _InFlight& packet = _inFlight.front();
+                int64_t confirmed = std::min(bytesLeft, packet.bytes);
+                packet.bytes -= confirmed;
+                bytesLeft -= confirmed;
+                if (packet.bytes > 0)
+                    break;
+                newest = packet;
+                packetConfirmed = true;
+                _inFlight.pop_front();
+            }
+            _bytesInFlight = std::max(_bytesInFlight - bytes, (int64_t)0);
+            _delivered += bytes;
+            if (!packetConfirmed)
+                return;
+
+            Duration rtt = now - newest.sendTime;
+            _UpdateRtt(rtt, now);
+            _UpdateBandwidth(newest, now);
+
+            // The window only grows while the sender is using it
+            Duration queuingDelay = _QueuingDelay();
+            if (_slowStart)
+            {
+                if (queuingDelay.GetTicks() > _targetDelay.GetTicks() / 2)
+                    _slowStart = false;
+                else if (newest.windowLimited)
+                    _window += bytes;
+            }
+            else
+            {
+                double offTarget = (_targetDelay.GetTicks() - queuingDelay.GetTicks()) / (double)_targetDelay.GetTicks();
+                offTarget = std::clamp(offTarget, -1.0, 1.0);
+                if (offTarget < 0.0 || newest.windowLimited)
+                {
+                    // At most one segment growth per window (round trip); shrinking is
+                    // proportional, so a full window of late confirmations at most halves it
+                    double change = offTarget > 0.0
+                        ? offTarget * bytes * _SEGMENT_SIZE / (double)_window
+                        : offTarget * bytes * 0.5;
+                    _window += (int64_t)change;
+                }
+            }
+            _window = std::clamp(_window, _minWindow, _maxWindow);
+        }
+
+        int64_t Window() const
+        {
+            return _window;
+        }
+
+        int64_t BytesInFlight() const
+        {
+            return _bytesInFlight;
+        }
+
+        // Smoothed round trip of confirmations, -1 if unknown
+        Duration RoundTrip() const
+        {
+            return _smoothedRtt;
+        }
+
+        // Recent delivery rate, bytes/s
+        int64_t Bandwidth() const
+        {
+            return std::max(_bandwidth, _prevPeriodBandwidth);
+        }
+
+    private:
+        void _UpdateRtt(Duration rtt, TimePoint now)
+        {
+            if (_smoothedRtt.GetTicks() < 0)
+                _smoothedRtt = rtt;
+            else
+                _smoothedRtt = Duration((_smoothedRtt.GetTicks() * 7 + rtt.GetTicks()) / 8);
+
+            _recentRtts.push_back(rtt);
+            if (_recentRtts.size() > 4)
+                _recentRtts.pop_front();
+
+            if ((now - _minRttPeriodStart) >= Duration(10, SECONDS))
+            {
+                _minRttPeriodStart = now;
+                _prevPeriodMinRtt = _minRtt;
+                _minRtt = rtt;
+                _probeEndTime = now + std::max(Duration(200, MILLISECONDS), _smoothedRtt);
+            }
+            else if (_minRtt.GetTicks() < 0 || rtt < _minRtt)
+            {
+                _minRtt = rtt;
+            }
+        }
+
+        void _UpdateBandwidth(const _InFlight& packet, TimePoint now)
+        {
+            int64_t elapsed = (now - packet.sendTime).GetDuration(MICROSECONDS);
+            if (elapsed <= 0)
+                return;
+            int64_t rate = (_delivered - packet.deliveredAtSend) * 1000000 / elapsed;
+
+            if ((now - _bandwidthPeriodStart) >= Duration(1, SECONDS))
+            {
+                _bandwidthPeriodStart = now;
+                _prevPeriodBandwidth = _bandwidth;
+                _bandwidth = rate;
+            }
+            else
+            {
+                _bandwidth = std::max(_bandwidth, rate);
+            }
+        }
+
+        Duration _QueuingDelay() const
+        {
+            Duration baseRtt = _minRtt;
+            if (_prevPeriodMinRtt.GetTicks() >= 0 && _prevPeriodMinRtt < baseRtt)
+                baseRtt = _prevPeriodMinRtt;
+            Duration currentRtt = *std::min_element(_recentRtts.begin(), _recentRtts.end());
+            return currentRtt - baseRtt;
+        }
+    };
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include "CpuFeatures.h"
+
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+namespace
+{
+    struct Features
+    {
+        bool sse41 = false;
+        bool avx2 = false;
+    };
+
+    // XGETBV is only executed once CPUID reports OSXSAVE
+    CPU_TARGET("xsave") Features _DetectFeatures()
+    {
+        Features features;
+
+        int info[4] = { 0, 0, 0, 0 };
+#ifdef _MSC_VER
+        __cpuid(info, 0);
+        int maxLeaf = info[0];
+        __cpuid(info, 1);
+#else
+        int maxLeaf = __get_cpuid_max(0, nullptr);
+        __cpuid(1, info[0], info[1], info[2], info[3]);
+#endif
+        features.sse41 = info[2] & (1 << 19);
+        bool osxsave = info[2] & (1 << 27);
+        bool avx = info[2] & (1 << 28);
+
+        if (maxLeaf >= 7 && osxsave && avx)
+        {
+            // OS must save the YMM registers
+            unsigned long long xcr0 = _xgetbv(0);
+            if ((xcr0 & 6) == 6)
+            {
+#ifdef _MSC_VER
+                __cpuidex(info, 7, 0);
+#else
+                __cpuid_count(7, 0, info[0], info[1], info[2], info[3]);
+#endif
+                features.avx2 = info[1] & (1 << 5);
+            }
+        }
+
+        return features;
+    }
+
+    const Features& _Features()
+    {
+        static const Features features = _DetectFeatures();
+        return features;
+    }
+}
+
+bool CpuFeatures::SSE41()
+{
+    return _Features().sse41;
+}
+
+bool CpuFeatures::AVX2()
+{
+    return _Features().avx2;
+}
\ No newline at end of file
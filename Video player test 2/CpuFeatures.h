@@ -0,0 +1,20 @@
+#pragma once
+
+// Lets GCC/Clang emit SSE4.1/AVX2 instructions in a single function, so the
+// rest of the file keeps the SSE2 baseline and only runs after CPU detection.
+// MSVC accepts intrinsics for any instruction set without it.
+#if defined(__GNUC__)
+#define CPU_TARGET(isa) __attribute__((target(isa)))
+#else
+#define CPU_TARGET(isa)
+#endif
+
+// Instruction set extensions available to hand-vectorized code.
+// Detected once, on first use. SSE2 is always available on x64.
+class CpuFeatures
+{
+public:
+    static bool SSE41();
+    // Also checks that the OS saves the YMM registers
+    static bool AVX2();
+};
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "DecoderCache.h"
+
+DecoderCache::DecoderCache(size_t capacity)
+    : _capacity(capacity)
+{
+
+}
+
+DecoderCache::~DecoderCache()
+{
+    Clear();
+}
+
+std::string DecoderCache::MakeKey(const MediaStream& stream)
+{
+    std::string key;
+    auto append = [&](const void* data, size_t size)
+    {
+        key.append((const char*)data, size);
+    };
+
+    append(&stream.type, sizeof(stream.type));
+    append(&stream.timeBase, sizeof(stream.timeBase));
+    append(&stream.channels, sizeof(stream.channels));
+    append(&stream.sampleRate, sizeof(stream.sampleRate));
+
+    const AVCodecParameters* params = stream.GetParams();
+    if (params)
+    {
+        append(&params->codec_type, sizeof(params->codec_type));
+        append(&params->codec_id, sizeof(params->codec_id));
+        append(&params->codec_tag, sizeof(params->codec_tag));
+        append(&params->format, sizeof(params->format));
+        append(&params->profile, sizeof(params->profile));
+        append(&params->level, sizeof(params->level));
+        append(&params->width, sizeof(params->width));
+        append(&params->height, sizeof(params->height));
+        append(&params->sample_rate, sizeof(params->sample_rate));
+        append(&params->bits_per_coded_sample, sizeof(params->bits_per_coded_sample));
+        append(&params->extradata_size, sizeof(params->extradata_size));
+        if (params->extradata && params->extradata_size > 0)
+            append(params->extradata, params->extradata_size);
+    }
+
+    return key;
+}
+
+void DecoderCache::Store(const std::string& key, IMediaDecoder* decoder)
+{
+    if (!decoder)
+        return;
+
+    if (_capacity == 0)
+    {
+        delete decoder;
+        return;
+    }
+
+    // Drop the frames/packets of the old stream in the background
+    decoder->Flush();
+    decoder->SetIdle(true);
+    _entries.push_front({ key, decoder });
+    _Trim();
+}
+
+IMediaDecoder* DecoderCache::Take(const std::string& key)
+{
+    for (auto it = _entries.begin(); it != _entries.end(); it++)
+    {
+        if (it->key == key)
+        {
+            IMediaDecoder* decoder = it->decoder;
+            _entries.erase(it);
+            decoder->SetIdle(false);
+            _hits++;
+            return decoder;
+        }
+    }
+    _misses++;
+    return nullptr;
+}
+
+void DecoderCache::Clear()
+{
+    for (auto& entry : _entries)
+        delete entry.decoder;
+    _entries.clear();
+}
+
+size_t DecoderCache::Size() const
+{
+    return _entries.size();
+}
+
+void DecoderCache::SetCapacity(size_t capacity)
+{
+    _capacity = capacity;
+    _Trim();
+}
+
+uint64_t DecoderCache::Hits() const
+{
+    return _hits;
+}
+
+uint64_t DecoderCache::Misses() const
+{
+    return _misses;
+}
+
+void DecoderCache::_Trim()
+{
+    while (_entries.size() > _capacity)
+    {
+        delete _entries.back().decoder;
+        _entries.pop_back();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "IMediaDecoder.h"
+#include "MediaStream.h"
+
+#include <list>
+#include <string>
+
+// Keeps decoders of recently used streams alive after a stream switch.
+// Switching back to a stream (or to any stream with identical codec parameters)
+// then reuses an already opened codec context and decoder thread, instead of
+// paying for codec setup (and for subtitles, libass and font loading) again.
+//
+// Stored decoders are flushed and marked idle. The cache owns them until they are taken back.
+class DecoderCache
+{
+    struct Entry
+    {
+        std::string key;
+        IMediaDecoder* decoder;
+    };
+    // Most recently stored first
+    std::list<Entry> _entries;
+    size_t _capacity;
+
+    uint64_t _hits = 0;
+    uint64_t _misses = 0;
+
+public:
+    DecoderCache(size_t capacity = 2);
+    ~DecoderCache();
+    DecoderCache(const DecoderCache&) = delete;
+    DecoderCache& operator=(const DecoderCache&) = delete;
+
+    // Builds a key from the stream properties the decoder depends on
+    static std::string MakeKey(const MediaStream& stream);
+
+    // Takes ownership of the decoder. If the cache is full, the least recently stored decoder is destroyed.
+    void Store(const std::string& key, IMediaDecoder* decoder);
+    // Returns a matching decoder (ownership is passed to the caller), or nullptr if there is none
+    IMediaDecoder* Take(const std::string& key);
+    void Clear();
+
+    size_t Size() const;
+    void SetCapacity(size_t capacity);
+    uint64_t Hits() const;
+    uint64_t Misses() const;
+
+private:
+    void _Trim();
+};
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "GameTime.h"
+
+#include <algorithm>
+#include <cmath>
+
+// PI loop which turns the offset between two clocks into a playback rate
+// for the clock being corrected. Drift is removed by playing slightly faster
+// or slower, instead of jumping (pausing, cutting, inserting silence).
+//
+// Offsets within the dead band count as zero, so measurement noise
+// doesn't make the rate wander.
+class DriftController
+{
+    double _kp;
+    double _ki;
+    double _maxCorrection;
+    double _deadBand;
+    double _integral = 0.0;
+    double _rate = 1.0;
+
+public:
+    // 'kp' - rate change per second of offset
+    // 'ki' - rate change per second of offset, per second
+    // 'maxCorrection' - largest allowed deviation from a rate of 1 (0.05 = +-5%)
+    DriftController(double kp = 0.1, double ki = 0.003, double maxCorrection = 0.05, Duration deadBand = Duration(30, MILLISECONDS))
+        : _kp(kp), _ki(ki), _maxCorrection(maxCorrection), _deadBand(deadBand.GetDuration(MICROSECONDS) / 1000000.0)
+    {}
+
+    // 'offset' - how far ahead the corrected clock is
+    // 'elapsed' - time since the previous update
+    // Returns the rate multiplier; below 1 when the clock is ahead
+    double Update(Duration offset, Duration elapsed)
+    {
+        double error = offset.GetDuration(MICROSECONDS) / 1000000.0;
+        if (std::abs(error) < _deadBand)
+            error = 0.0;
+        else
+            error -= error > 0.0 ? _deadBand : -_deadBand;
+
+        double dt = elapsed.GetDuration(MICROSECONDS) / 1000000.0;
+        double correction = _kp * error + _ki * (_integral + error * dt);
+        // Don't wind up the integral while saturated
+        if (std::abs(correction) < _maxCorrection)
+            _integral += error * dt;
+        correction = std::clamp(correction, -_maxCorrection, _maxCorrection);
+
+        _rate = 1.0 - correction;
+        return _rate;
+    }
+
+    double Rate() const
+    {
+        return _rate;
+    }
+
+    void Reset()
+    {
+        _integral = 0.0;
+        _rate = 1.0;
+    }
+};
\ No newline at end of file
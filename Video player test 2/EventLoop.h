@@ -0,0 +1,252 @@
+#pragma once
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace znet
+{
+    // A single thread which waits on all sockets at once (epoll) and runs their
+    // read/write handlers and timers. Used instead of per-connection polling threads on POSIX.
+    //
+    // Callbacks run on the loop thread while holding a dispatch lock, which Remove()/RemoveTimer()
+    // (and Sync()) also take when called from other threads. Once they return, the callback
+    // is not running and won't be called again. Because of this, callers must not hold
+    // any lock which the callbacks take.
+    class EventLoop
+    {
+    public:
+        // Receives the epoll event flags
+        using Handler = std::function<void(uint32_t events)>;
+        using Clock = std::chrono::steady_clock;
+
+    private:
+        struct _Timer
+        {
+            int64_t id;
+            Clock::time_point due;
+            Clock::duration interval;
+            std::shared_ptr<std::function<void()>> callback;
+        };
+
+        int _epoll = -1;
+        int _wakeEvent = -1;
+        std::thread _thread;
+
+        // Held while callbacks run
+        std::recursive_mutex _m_dispatch;
+        // Guards handler/timer registration
+        std::mutex _m_handlers;
+        std::unordered_map<int, std::shared_ptr<Handler>> _handlers;
+        std::vector<_Timer> _timers;
+        int64_t _timerIdCounter = 0;
+
+        EventLoop()
+        {
+            _epoll = epoll_create1(EPOLL_CLOEXEC);
+            _wakeEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = _wakeEvent;
+            epoll_ctl(_epoll, EPOLL_CTL_ADD, _wakeEvent, &event);
+
+            _thread = std::thread(&EventLoop::Run, this);
+        }
+
+    public:
+        // Created on first use and lives until the process exits
+        static EventLoop* Instance()
+        {
+            static EventLoop* instance = new EventLoop();
+            return instance;
+        }
+        EventLoop(const EventLoop&) = delete;
+        EventLoop& operator=(const EventLoop&) = delete;
+
+        bool InLoopThread() const
+        {
+            return std::this_thread::get_id() == _thread.get_id();
+        }
+
+        // Starts delivering 'events' (EPOLLIN/EPOLLOUT) of 'socket' to 'handler'.
+        // Errors and hang ups are always delivered.
+        bool Add(int socket, uint32_t events, Handler handler)
+        {
+            std::lock_guard<std::mutex> lock(_m_handlers);
+            epoll_event event{};
+            event.events = events | EPOLLRDHUP;
+            event.data.fd = socket;
+            if (epoll_ctl(_epoll, EPOLL_CTL_ADD, socket, &event) == -1)
+                return false;
+            _handlers[socket] = std::make_shared<Handler>(std::move(handler));
+            return true;
+        }
+
+        // Changes the delivered events of a registered socket
+        void Modify(int socket, uint32_t events)
+        {
+            std::lock_guard<std::mutex> lock(_m_handlers);
+            if (_handlers.find(socket) == _handlers.end())
+                return;
+            epoll_event event{};
+            event.events = events | EPOLLRDHUP;
+            event.data.fd = socket;
+            epoll_ctl(_epoll, EPOLL_CTL_MOD, socket, &event);
+        }
+
+        // Must be called before the socket is closed
+        void Remove(int socket)
+        {
+            {
+                std::lock_guard<std::mutex> lock(_m_handlers);
+                if (_handlers.erase(socket) == 0)
+                    return;
+                epoll_ctl(_epoll, EPOLL_CTL_DEL, socket, nullptr);
+            }
+            Sync();
+        }
+
+        // Calls 'callback' every 'interval' on the loop thread
+        int64_t AddTimer(Clock::duration interval, std::function<void()> callback)
+        {
+            int64_t id;
+            {
+                std::lock_guard<std::mutex> lock(_m_handlers);
+                id = ++_timerIdCounter;
+                _timers.push_back({ id, Clock::now() + interval, interval, std::make_shared<std::function<void()>>(std::move(callback)) });
+            }
+            // Let the loop recalculate its wait time
+            Wake();
+            return id;
+        }
+
+        void RemoveTimer(int64_t id)
+        {
+            {
+                std::lock_guard<std::mutex> lock(_m_handlers);
+                auto it = std::find_if(_timers.begin(), _timers.end(), [&](const _Timer& timer) { return timer.id == id; });
+                if (it == _timers.end())
+                    return;
+                _timers.erase(it);
+            }
+            Sync();
+        }
+
+        // Waits for the currently running callbacks to finish (no-op on the loop thread)
+        void Sync()
+        {
+            if (!InLoopThread())
+            {
+                std::lock_guard<std::recursive_mutex> lock(_m_dispatch);
+            }
+        }
+
+        // Interrupts the wait for events
+        void Wake()
+        {
+            uint64_t value = 1;
+            write(_wakeEvent, &value, sizeof(value));
+        }
+
+    private:
+        void Run()
+        {
+            std::vector<epoll_event> events(64);
+            while (true)
+            {
+                int eventCount = epoll_wait(_epoll, events.data(), (int)events.size(), NextTimeout());
+                if (eventCount == -1)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    std::cout << "[EventLoop: epoll_wait error (" << errno << ")]\n";
+                    break;
+                }
+
+                std::lock_guard<std::recursive_mutex> lock(_m_dispatch);
+                for (int i = 0; i < eventCount; i++)
+                {
+                    int socket = events[i].data.fd;
+                    if (socket == _wakeEvent)
+                    {
+                        uint64_t value;
+                        read(_wakeEvent, &value, sizeof(value));
+                        continue;
+                    }
+
+                    // The handler may have been removed by a previous one
+                    std::shared_ptr<Handler> handler;
+                    _m_handlers.lock();
+                    auto it = _handlers.find(socket);
+                    if (it != _handlers.end())
+                        handler = it->second;
+                    _m_handlers.unlock();
+
+                    if (handler)
+                        (*handler)(events[i].events);
+                }
+                RunTimers();
+            }
+        }
+
+        void RunTimers()
+        {
+            Clock::time_point now = Clock::now();
+
+            std::vector<int64_t> dueTimers;
+            _m_handlers.lock();
+            for (auto& timer : _timers)
+                if (timer.due <= now)
+                    dueTimers.push_back(timer.id);
+            _m_handlers.unlock();
+
+            for (int64_t id : dueTimers)
+            {
+                // The timer may have been removed by a previous callback
+                std::shared_ptr<std::function<void()>> callback;
+                _m_handlers.lock();
+                auto it = std::find_if(_timers.begin(), _timers.end(), [&](const _Timer& timer) { return timer.id == id; });
+                if (it != _timers.end())
+                {
+                    callback = it->callback;
+                    it->due += it->interval;
+                    if (it->due < now)
+                        it->due = now + it->interval;
+                }
+                _m_handlers.unlock();
+
+                if (callback)
+                    (*callback)();
+            }
+        }
+
+        // Milliseconds until the next timer is due, -1 if there are no timers
+        int NextTimeout()
+        {
+            std::lock_guard<std::mutex> lock(_m_handlers);
+            if (_timers.empty())
+                return -1;
+
+            Clock::time_point next = _timers.front().due;
+            for (auto& timer : _timers)
+                if (timer.due < next)
+                    next = timer.due;
+
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next - Clock::now()).count();
+            // Round up, so the timer isn't checked slightly before it's due
+            return wait < 0 ? 0 : (int)wait + 1;
+        }
+    };
+}
\ No newline at end of file
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class FrameBufferPool;
+
+// Pixel memory of a single frame.
+// If the buffer came from a pool, it is returned there on destruction.
+class FrameBuffer
+{
+    std::unique_ptr<unsigned char[]> _data;
+    size_t _size = 0;
+    std::shared_ptr<FrameBufferPool> _pool;
+
+public:
+    FrameBuffer() {}
+    // Takes ownership of unpooled memory
+    FrameBuffer(std::unique_ptr<unsigned char[]> data, size_t size)
+        : _data(std::move(data)), _size(size)
+    {}
+    FrameBuffer(std::unique_ptr<unsigned char[]> data, size_t size, std::shared_ptr<FrameBufferPool> pool)
+        : _data(std::move(data)), _size(size), _pool(std::move(pool))
+    {}
+    ~FrameBuffer()
+    {
+        Reset();
+    }
+    FrameBuffer(FrameBuffer&& other) noexcept = default;
+    FrameBuffer& operator=(FrameBuffer&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Reset();
+            _data = std::move(other._data);
+            _size = other._size;
+            _pool = std::move(other._pool);
+            other._size = 0;
+        }
+        return *this;
+    }
+    FrameBuffer(const FrameBuffer&) = delete;
+    FrameBuffer& operator=(const FrameBuffer&) = delete;
+
+    unsigned char* Data() const
+    {
+        return _data.get();
+    }
+
+    size_t Size() const
+    {
+        return _size;
+    }
+
+    explicit operator bool() const
+    {
+        return _data != nullptr;
+    }
+
+    inline void Reset();
+};
+
+// Recycles equally sized frame buffers, so the decoder doesn't allocate
+// a new image for every frame. All buffers handed out at once have the same
+// size; requesting a different size (resolution change) drops the free ones.
+//
+// Must be owned by a shared_ptr, since buffers keep the pool alive.
+class FrameBufferPool : public std::enable_shared_from_this<FrameBufferPool>
+{
+    std::vector<std::unique_ptr<unsigned char[]>> _freeBuffers;
+    size_t _bufferSize = 0;
+    size_t _maxFreeBuffers;
+    std::mutex _m_buffers;
+
+    std::atomic<uint64_t> _hits{ 0 };
+    std::atomic<uint64_t> _misses{ 0 };
+
+public:
+    FrameBufferPool(size_t maxFreeBuffers = 32) : _maxFreeBuffers(maxFreeBuffers) {}
+    FrameBufferPool(const FrameBufferPool&) = delete;
+    FrameBufferPool& operator=(const FrameBufferPool&) = delete;
+
+    FrameBuffer Acquire(size_t size)
+    {
+        std::unique_lock<std::mutex> lock(_m_buffers);
+        if (size != _bufferSize)
+        {
+            _freeBuffers.clear();
+            _bufferSize = size;
+        }
+        if (!_freeBuffers.empty())
+        {
+            auto data = std::move(_freeBuffers.back());
+            _freeBuffers.pop_back();
+            lock.unlock();
+
+            _hits.fetch_add(1);
+            return FrameBuffer(std::move(data), size, shared_from_this());
+        }
+        lock.unlock();
+
+        // Not using make_unique, because zero-initializing the image is a waste
+        _misses.fetch_add(1);
+        return FrameBuffer(std::unique_ptr<unsigned char[]>(new unsigned char[size]), size, shared_from_this());
+    }
+
+    // For variable sized data (e.g. audio chunks): keeps handing out buffers of the
+    // largest size requested so far, so small size changes don't drop the free ones.
+    // The returned buffer's Size() can be larger than 'size'.
+    FrameBuffer AcquireAtLeast(size_t size)
+    {
+        std::unique_lock<std::mutex> lock(_m_buffers);
+        size_t bufferSize = std::max(size, _bufferSize);
+        lock.unlock();
+        return Acquire(bufferSize);
+    }
+
+    // Number of buffers reused from the pool
+    uint64_t Hits() const
+    {
+        return _hits.load();
+    }
+
+    // Number of buffers that had to be allocated
+    uint64_t Misses() const
+    {
+        return _misses.load();
+    }
+
+private:
+    friend class FrameBuffer;
+
+    void _Return(std::unique_ptr<unsigned char[]> data, size_t size)
+    {
+        std::lock_guard<std::mutex> lock(_m_buffers);
+        if (size == _bufferSize && _freeBuffers.size() < _maxFreeBuffers)
+            _freeBuffers.push_back(std::move(data));
+    }
+};
+
+void FrameBuffer::Reset()
+{
+    if (_pool && _data)
+        _pool->_Return(std::move(_data), _size);
+    _data.reset();
+    _pool.reset();
+    _size = 0;
+}
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "OverlayScene.h"
 
 #include "Permissions.h"
+#include "PacketBuilder.h"
 
 HostPlaybackController::HostPlaybackController(IMediaDataProvider* dataProvider, std::vector<int64_t> participants)
     : BasePlaybackController(dataProvider)
@@ -17,6 +18,8 @@ HostPlaybackController::HostPlaybackController(IMediaDataProvider* dataProvider,
     _seekFinishedReceiver = std::make_unique<znet::PacketReceiver>(znet::PacketType::SEEK_FINISHED);
     _playbackPositionReceiver = std::make_unique<znet::PacketReceiver>(znet::PacketType::PLAYBACK_POSITION);
     _syncPauseReceiver = std::make_unique<znet::PacketReceiver>(znet::PacketType::SYNC_PAUSE);
+    _lateJoinReceiver = std::make_unique<znet::PacketReceiver>(znet::PacketType::LATE_JOIN_REQUEST);
+    _controllerReadyReceiver = std::make_unique<znet::PacketReceiver>(znet::PacketType::CONTROLLER_READY);
 
     _StartSeeking();
 }
@@ -37,6 +40,10 @@ void HostPlaybackController::Update()
     _CheckForSeekFinished();
     _CheckForPlaybackPosition();
     _CheckForSyncPause();
+    _CheckForLateJoins();
+    _CheckForControllerReady();
+
+    _RunScheduledActions();
 
     if (_loading)
     {
@@ -97,8 +104,7 @@ void HostPlaybackController::_CheckForPlayRequest()
         if (!user || !user->GetPermission(PERMISSION_MANIPULATE_PLAYBACK))
             continue;
 
-        _Play();
-        APP_NETWORK->Send(znet::Packet((int)znet::PacketType::RESUME).From(senderId), _GetUserIds(), 1);
+        _SchedulePlay(senderId);
 
         // Show notification
         zcom::NotificationInfo ninfo;
@@ -126,8 +132,7 @@ void HostPlaybackController::_CheckForPauseRequest()
         if (!user || !user->GetPermission(PERMISSION_MANIPULATE_PLAYBACK))
             continue;
 
-        _Pause();
-        APP_NETWORK->Send(znet::Packet((int)znet::PacketType::PAUSE).From(senderId), _GetUserIds(), 1);
+        _SchedulePause(senderId);
 
         // Show notification
         zcom::NotificationInfo ninfo;
@@ -272,6 +277,14 @@ void HostPlaybackController::_CheckForSeekFinished()
             if (user.id == packetPair.second)
             {
                 user.seekCompleted = true;
+
+                // A late joiner resumes on its own, unless a seek is in progress (then it resumes with everyone)
+                if (user.lateJoin && !_seeking)
+                {
+                    TimePoint resumeTime = _SharedTime() + _commandDelay;
+                    APP_NETWORK->Send(znet::Packet((int)znet::PacketType::HOST_SEEK_FINISHED).From(resumeTime.GetTicks()), { user.id }, 1);
+                }
+                user.lateJoin = false;
                 break;
             }
         }
@@ -334,17 +347,77 @@ void HostPlaybackController::_CheckForSeekFinished()
         }
         else
         {
-            // Resume playback
+            // Resume playback on all users at the same time
             std::cout << "Playback Resumed" << std::endl;
-            _timerController.RemoveStop("seeking");
             _seeking = false;
+            TimePoint resumeTime = _SharedTime() + _commandDelay;
+            _ScheduleAt(resumeTime, "seekresume", [&]() { _timerController.RemoveStop("seeking"); });
 
-            APP_NETWORK->Send(znet::Packet((int)znet::PacketType::HOST_SEEK_FINISHED), _GetUserIds(), 1);
+            APP_NETWORK->Send(znet::Packet((int)znet::PacketType::HOST_SEEK_FINISHED).From(resumeTime.GetTicks()), _GetUserIds(), 1);
             _lastSeek = ztime::Main();
         }
     }
 }
 
+void HostPlaybackController::_CheckForLateJoins()
+{
+    if (!_lateJoinReceiver)
+        return;
+
+    while (_lateJoinReceiver->PacketCount() > 0)
+    {
+        auto packetPair = _lateJoinReceiver->GetPacket();
+        int64_t userId = packetPair.second;
+
+        auto user = std::find_if(_destinationUsers.begin(), _destinationUsers.end(), [&](const _UserData& user) { return user.id == userId; });
+        if (user == _destinationUsers.end())
+        {
+            _destinationUsers.push_back({ userId, 0 });
+            user = _destinationUsers.end() - 1;
+        }
+        user->seekCompleted = false;
+        user->positionUpdated = false;
+        user->timeOffset = 0;
+        user->lateJoin = true;
+        std::cout << "Late joiner " << userId << " added to playback" << std::endl;
+
+        if (_earlyControllerReady.erase(userId) > 0)
+            _SendLateJoinReady(userId);
+    }
+}
+
+void HostPlaybackController::_CheckForControllerReady()
+{
+    if (!_controllerReadyReceiver)
+        return;
+
+    while (_controllerReadyReceiver->PacketCount() > 0)
+    {
+        auto packetPair = _controllerReadyReceiver->GetPacket();
+        int64_t userId = packetPair.second;
+
+        // Only late joiners need a reply, everyone else got HOST_CONTROLLER_READY on attach.
+        // If the join request hasn't arrived yet, the reply is sent once it does.
+        auto user = std::find_if(_destinationUsers.begin(), _destinationUsers.end(), [&](const _UserData& user) { return user.id == userId; });
+        if (user == _destinationUsers.end() || !user->lateJoin)
+        {
+            _earlyControllerReady.insert(userId);
+            continue;
+        }
+
+        _SendLateJoinReady(userId);
+    }
+}
+
+void HostPlaybackController::_SendLateJoinReady(int64_t userId)
+{
+    // The receiver starts at the current position, and reports SEEK_FINISHED once loaded.
+    // The time it spends loading is corrected by the usual sync.
+    PacketBuilder builder = PacketBuilder(sizeof(int64_t) + sizeof(int8_t));
+    builder.Add(_player->TimerPosition().GetTicks()).Add(int8_t(_paused ? 1 : 0));
+    APP_NETWORK->Send(znet::Packet(builder.Release(), builder.UsedBytes(), (int)znet::PacketType::HOST_CONTROLLER_READY), { userId }, 1);
+}
+
 void HostPlaybackController::_CheckForPlaybackPosition()
 {
     if (!_playbackPositionReceiver)
@@ -353,14 +426,28 @@ void HostPlaybackController::_CheckForPlaybackPosition()
     while (_playbackPositionReceiver->PacketCount() > 0)
     {
         auto packetPair = _playbackPositionReceiver->GetPacket();
+        PacketReader reader(packetPair.first.Bytes(), packetPair.first.size);
+        TimePoint position = reader.Get<int64_t>();
+        TimePoint measureTime = reader.RemainingBytes() >= sizeof(int64_t) ? TimePoint(reader.Get<int64_t>()) : _SharedTime();
+
+        // Compare against where the host was when the position was taken,
+        // so the transmission delay doesn't show up as an offset
+        TimePoint hostPosition = _player->TimerPosition();
+        if (_player->TimerRunning())
+        {
+            Duration age = _SharedTime() - measureTime;
+            if (age.GetTicks() > 0 && age < Duration(1, SECONDS))
+                hostPosition -= Duration((int64_t)(age.GetTicks() * _player->PlaybackRate()));
+        }
 
         for (auto& user : _destinationUsers)
         {
             if (user.id == packetPair.second)
             {
-                user.currentTime = TimePoint(packetPair.first.Cast<int64_t>());
+                user.currentTime = position;
                 user.receiveTime = ztime::Main();
-                user.timeOffset = user.currentTime - _player->TimerPosition();
+                user.timeOffset = user.currentTime - hostPosition;
+                user.positionUpdated = true;
                 break;
             }
         }
@@ -385,16 +472,35 @@ void HostPlaybackController::_CheckForSyncPause()
 
 void HostPlaybackController::Play()
 {
-    _Play();
-    int64_t thisId = APP_NETWORK->ThisUser().id;
-    APP_NETWORK->Send(znet::Packet((int)znet::PacketType::RESUME).From(thisId), _GetUserIds(), 1);
+    _SchedulePlay(APP_NETWORK->ThisUser().id);
 }
 
 void HostPlaybackController::Pause()
 {
-    _Pause();
-    int64_t thisId = APP_NETWORK->ThisUser().id;
-    APP_NETWORK->Send(znet::Packet((int)znet::PacketType::PAUSE).From(thisId), _GetUserIds(), 1);
+    _SchedulePause(APP_NETWORK->ThisUser().id);
+}
+
+void HostPlaybackController::_SchedulePlay(int64_t issuerId)
+{
+    // '_paused' is set right away, so the UI reflects the command immediately
+    _paused = false;
+    TimePoint playTime = _SharedTime() + _commandDelay;
+    _ScheduleAt(playTime, "playpause", [&]() { _Play(); });
+
+    PacketBuilder builder = PacketBuilder(2 * sizeof(int64_t));
+    builder.Add(issuerId).Add(playTime.GetTicks());
+    APP_NETWORK->Send(znet::Packet(builder.Release(), builder.UsedBytes(), (int)znet::PacketType::RESUME), _GetUserIds(), 1);
+}
+
+void HostPlaybackController::_SchedulePause(int64_t issuerId)
+{
+    _paused = true;
+    TimePoint pauseTime = _SharedTime() + _commandDelay;
+    _ScheduleAt(pauseTime, "playpause", [&]() { _Pause(); });
+
+    PacketBuilder builder = PacketBuilder(2 * sizeof(int64_t));
+    builder.Add(issuerId).Add(pauseTime.GetTicks());
+    APP_NETWORK->Send(znet::Packet(builder.Release(), builder.UsedBytes(), (int)znet::PacketType::PAUSE), _GetUserIds(), 1);
 }
 
 void HostPlaybackController::_Play()
@@ -593,6 +699,7 @@ void HostPlaybackController::_StartSeeking()
     _timerController.ClearTimers();
     _timerController.ClearPlayTimers();
     _timerController.AddStop("seeking");
+    _CancelScheduled("seekresume");
     _seeking = true;
     for (auto& user : _destinationUsers)
         user.seekCompleted = false;
@@ -602,10 +709,37 @@ void HostPlaybackController::_SyncPlayback()
 {
     // Do not sync if playback isn't happening
     if (!_CanPlay())
+    {
+        _ResetPlaybackRates();
         return;
+    }
     // Do not sync for a couple of seconds after seeking
     if ((ztime::Main() - _lastSeek).GetDuration(SECONDS) < 2)
+    {
+        _ResetPlaybackRates();
         return;
+    }
+
+    // Let users which drifted slightly play faster/slower until they catch up
+    for (auto& user : _destinationUsers)
+    {
+        if (!user.positionUpdated || user.lateJoin)
+            continue;
+        user.positionUpdated = false;
+
+        Duration elapsed = Duration(1, SECONDS);
+        if (user.lastRateUpdate.GetTicks() != -1)
+            elapsed = user.receiveTime - user.lastRateUpdate;
+        user.lastRateUpdate = user.receiveTime;
+
+        double rate = user.driftController.Update(user.timeOffset, elapsed);
+        if (std::abs(rate - user.playbackRate) >= 0.001)
+        {
+            user.playbackRate = rate;
+            APP_NETWORK->Send(znet::Packet((int)znet::PacketType::SYNC_RATE).From(rate), { user.id }, 2);
+        }
+    }
+
     // Do not sync again right after syncing
     if ((ztime::Main() - _lastSync).GetDuration(SECONDS) < 5)
         return;
@@ -617,6 +751,8 @@ void HostPlaybackController::_SyncPlayback()
     int indexBehind = -1;
     for (int i = 0; i < _destinationUsers.size(); i++)
     {
+        if (_destinationUsers[i].lateJoin)
+            continue;
         if (_destinationUsers[i].timeOffset > mostAheadOffset)
         {
             mostAheadOffset = _destinationUsers[i].timeOffset;
@@ -631,7 +767,7 @@ void HostPlaybackController::_SyncPlayback()
 
     // Fix large offsets
     Duration deltaOffset = mostAheadOffset - mostBehindOffset;
-    if (deltaOffset.GetDuration(MILLISECONDS) > 1000)
+    if (deltaOffset > _pauseSyncThreshold)
     {
         std::cout << "Fix offset of " << deltaOffset.GetDuration(MILLISECONDS) << "ms" << std::endl;
 
@@ -647,7 +783,7 @@ void HostPlaybackController::_SyncPlayback()
         // Pause others
         for (int i = 0; i < _destinationUsers.size(); i++)
         {
-            if (i == indexBehind)
+            if (i == indexBehind || _destinationUsers[i].lateJoin)
                 continue;
 
             int64_t pauseTicks = (_destinationUsers[i].timeOffset - mostBehindOffset).GetTicks();
@@ -655,10 +791,26 @@ void HostPlaybackController::_SyncPlayback()
                 znet::Packet((int)znet::PacketType::SYNC_PAUSE).From(pauseTicks), { _destinationUsers[i].id }, 2);
         }
 
+        _ResetPlaybackRates();
         _lastSync = ztime::Main();
     }
 }
 
+void HostPlaybackController::_ResetPlaybackRates()
+{
+    for (auto& user : _destinationUsers)
+    {
+        user.positionUpdated = false;
+        user.lastRateUpdate = -1;
+        user.driftController.Reset();
+        if (user.playbackRate != 1.0)
+        {
+            user.playbackRate = 1.0;
+            APP_NETWORK->Send(znet::Packet((int)znet::PacketType::SYNC_RATE).From(1.0), { user.id }, 2);
+        }
+    }
+}
+
 std::wstring HostPlaybackController::_UsernameFromId(int64_t id)
 {
     std::wstringstream username(L"");
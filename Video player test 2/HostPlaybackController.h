@@ -3,6 +3,7 @@
 #include "BasePlaybackController.h"
 #include "MediaHostDataProvider.h"
 #include "Network.h"
+#include "DriftController.h"
 
 class HostPlaybackController : public BasePlaybackController
 {
@@ -14,10 +15,20 @@ protected:
         TimePoint receiveTime; // Time at which 'currentTime' was received
         Duration timeOffset; // How far ahead the user is
         bool seekCompleted;
+        bool positionUpdated = false;
+        // Gradual correction of 'timeOffset' through the user's playback rate
+        DriftController driftController;
+        double playbackRate = 1.0;
+        TimePoint lastRateUpdate = -1;
+        // Joined after playback started and is still loading, not synced until it finishes
+        bool lateJoin = false;
     };
     //struct _SeekData
 
     std::vector<_UserData> _destinationUsers;
+    // CONTROLLER_READY can overtake LATE_JOIN_REQUEST (they are sent from different threads),
+    // so it is remembered until the join request arrives
+    std::set<int64_t> _earlyControllerReady;
     std::vector<int64_t> _GetUserIds()
     {
         std::vector<int64_t> ids;
@@ -32,11 +43,15 @@ protected:
     std::unique_ptr<znet::PacketReceiver> _seekFinishedReceiver;
     std::unique_ptr<znet::PacketReceiver> _playbackPositionReceiver;
     std::unique_ptr<znet::PacketReceiver> _syncPauseReceiver;
+    std::unique_ptr<znet::PacketReceiver> _lateJoinReceiver;
+    std::unique_ptr<znet::PacketReceiver> _controllerReadyReceiver;
 
     IMediaDataProvider::SeekData _bufferedSeekData;
     bool _seeking = false;
     TimePoint _lastSeek = 0;
     TimePoint _lastSync = 0;
+    // Offsets up to this are corrected by changing playback rates, larger ones by pausing
+    Duration _pauseSyncThreshold = Duration(3, SECONDS);
 
     bool _buffering = false;
 
@@ -55,6 +70,9 @@ private: // Packet handlers
     void _CheckForSeekFinished();
     void _CheckForPlaybackPosition();
     void _CheckForSyncPause();
+    void _CheckForLateJoins();
+    void _CheckForControllerReady();
+    void _SendLateJoinReady(int64_t userId);
 
 public:
     void Play();
@@ -62,6 +80,9 @@ public:
 private:
     void _Play();
     void _Pause();
+    // Play/pause on all users at the same shared time
+    void _SchedulePlay(int64_t issuerId);
+    void _SchedulePause(int64_t issuerId);
     bool _CanPlay() const;
 public:
     void Seek(TimePoint time);
@@ -75,5 +96,6 @@ public:
 private:
     void _StartSeeking();
     void _SyncPlayback();
+    void _ResetPlaybackRates();
     std::wstring _UsernameFromId(int64_t id);
 };
\ No newline at end of file
@@ -69,6 +69,8 @@ public:
     virtual bool Paused() const = 0;
     virtual void SetVolume(float volume) = 0;
     virtual void SetBalance(float balance) = 0;
+    // Speed of the playback timer; the audio is resampled to follow it
+    virtual void SetPlaybackRate(double rate) = 0;
     virtual int64_t CurrentTime() = 0;
     virtual void SetTime(int64_t time) = 0;
     virtual int64_t BufferLength() const = 0;
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <functional>
+
+// Destination of the audio rendered by AudioOutputEngine (a device, a file, nothing).
+// The sink owns the playback thread and pulls interleaved float samples
+// in its own format through the render callback.
+class IAudioSink
+{
+public:
+    // Must fill 'sampleCount' samples (per channel). Called from the sink's thread.
+    using RenderCallback = std::function<void(float* output, int sampleCount)>;
+
+    IAudioSink() {}
+    virtual ~IAudioSink() {}
+
+    // Output format, fixed for the lifetime of the sink
+    virtual int Channels() const = 0;
+    virtual int SampleRate() const = 0;
+
+    // Starts the playback thread (stopped). Returns false if the sink is unavailable.
+    virtual bool Open(RenderCallback render) = 0;
+    virtual void Close() = 0;
+
+    // Start/stop pulling samples. When Stop() returns, the render callback is not running.
+    virtual void Start() = 0;
+    virtual void Stop() = 0;
+    virtual bool Running() const = 0;
+};
\ No newline at end of file
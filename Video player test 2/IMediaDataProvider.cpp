@@ -55,12 +55,17 @@ Duration IMediaDataProvider::BufferedDuration(bool ignoreSubtitles)
 
 Duration IMediaDataProvider::_BufferedDuration(MediaData& mediaData)
 {
-    std::unique_lock<std::mutex> lock(mediaData.mtx);
-    if (mediaData.currentStream == -1)
     {
-        return Duration::Max();
+        // Streams are switched on the packet reading thread
+        std::lock_guard lock(mediaData.mtx);
+        if (mediaData.currentStream == -1)
+        {
+            return Duration::Max();
+        }
     }
-    return mediaData.lastPts > mediaData.lastDts ? mediaData.lastPts.GetTicks() : mediaData.lastDts.GetTicks();
+    int64_t lastPts = mediaData.lastPts.load();
+    int64_t lastDts = mediaData.lastDts.load();
+    return lastPts > lastDts ? lastPts : lastDts;
 }
 
 Duration IMediaDataProvider::MediaDuration()
@@ -195,7 +200,7 @@ bool IMediaDataProvider::SubtitleMemoryExceeded()
 bool IMediaDataProvider::_MemoryExceeded(const MediaData& mediaData)
 {
     _UpdateMemoryLimits();
-    return mediaData.totalMemoryUsed > mediaData.allowedMemory;
+    return mediaData.packets.MemoryUsed() > mediaData.allowedMemory || mediaData.packets.Full();
 }
 
 void IMediaDataProvider::_UpdateMemoryLimits(bool force)
@@ -457,7 +462,7 @@ size_t IMediaDataProvider::SubtitlePacketCount() const
 
 size_t IMediaDataProvider::_PacketCount(const MediaData& mediaData) const
 {
-    return mediaData.packets.size();
+    return mediaData.packets.Size();
 }
 
 MediaPacket IMediaDataProvider::GetVideoPacket()
@@ -479,27 +484,34 @@ MediaPacket IMediaDataProvider::_GetPacket(MediaData& mediaData)
 {
     _UpdateMemoryLimits();
 
-    std::unique_lock<std::mutex> lock(mediaData.mtx);
+    PacketRing& packets = mediaData.packets;
+    if (!packets.BeginRead())
+        return MediaPacket(); // Packets are being cleared
 
     // Keep memory usage in check
     size_t softCap = mediaData.allowedMemory * 0.8;
-    while (mediaData.totalMemoryUsed > softCap)
+    size_t slotCap = packets.Capacity() / 4 * 3;
+    bool trimmed = false;
+    while (packets.MemoryUsed() > softCap || packets.UsedSlots() > slotCap)
     {
-        if (mediaData.currentPacket == 0) break;
-
-        auto& packet = mediaData.packets.front();
-        if (!packet.flush && packet.Valid())
-            mediaData.totalMemoryUsed -= packet.GetPacket()->size;
-
-        mediaData.packets.pop_front();
-        mediaData.currentPacket--;
+        if (packets.HistorySize() == 0) break;
+        packets.TrimOldest();
+        trimmed = true;
     }
 
     // Return packet
-    if (mediaData.currentPacket >= mediaData.packets.size())
-        return MediaPacket();
-    else
-        return mediaData.packets[mediaData.currentPacket++].Reference();
+    MediaPacket packet;
+    MediaPacket* next = packets.Peek();
+    if (next)
+    {
+        packet = next->Reference();
+        packets.Advance();
+    }
+    packets.EndRead();
+
+    if (trimmed)
+        _packetSpaceSignal.Notify();
+    return packet;
 }
 
 bool IMediaDataProvider::FlushVideoPacketNext()
@@ -519,56 +531,74 @@ bool IMediaDataProvider::FlushSubtitlePacketNext()
 
 bool IMediaDataProvider::_FlushPacketNext(MediaData& mediaData)
 {
-    std::unique_lock<std::mutex> lock(mediaData.mtx);
-    if (mediaData.currentPacket >= mediaData.packets.size())
-    {
+    PacketRing& packets = mediaData.packets;
+    if (!packets.BeginRead())
         return false;
-    }
-    else
-    {
-        return mediaData.packets[mediaData.currentPacket].flush;
-    }
+
+    MediaPacket* next = packets.Peek();
+    bool flush = next && next->flush;
+    packets.EndRead();
+    return flush;
+}
+
+bool IMediaDataProvider::WaitForPackets(Duration timeout)
+{
+    uint64_t sequence = _packetsAddedSignal.Sequence();
+    if (_PacketCount(_videoData) > 0 || _PacketCount(_audioData) > 0 || _PacketCount(_subtitleData) > 0)
+        return true;
+    return _packetsAddedSignal.WaitFor(sequence, timeout);
 }
 
-void IMediaDataProvider::_AddVideoPacket(MediaPacket packet)
+bool IMediaDataProvider::_AddVideoPacket(MediaPacket&& packet)
 {
-    _AddPacket(_videoData, std::move(packet));
+    return _AddPacket(_videoData, packet);
 }
 
-void IMediaDataProvider::_AddAudioPacket(MediaPacket packet)
+bool IMediaDataProvider::_AddAudioPacket(MediaPacket&& packet)
 {
-    _AddPacket(_audioData, std::move(packet));
+    return _AddPacket(_audioData, packet);
 }
 
-void IMediaDataProvider::_AddSubtitlePacket(MediaPacket packet)
+bool IMediaDataProvider::_AddSubtitlePacket(MediaPacket&& packet)
 {
-    _AddPacket(_subtitleData, std::move(packet));
+    return _AddPacket(_subtitleData, packet);
 }
 
-void IMediaDataProvider::_AddPacket(MediaData& mediaData, MediaPacket packet)
+bool IMediaDataProvider::_AddPacket(MediaData& mediaData, MediaPacket& packet)
 {
-    std::unique_lock<std::mutex> lock(mediaData.mtx);
+    // Callers check memory limits (which include a full ring) before adding,
+    // so this only happens if the consumer stops reading
+    if (mediaData.packets.Full())
+        return false;
+
     if (!packet.flush && packet.Valid())
     {
+        // Only contended when streams are being added
+        std::unique_lock<std::mutex> lock(mediaData.mtx);
         AVRational timebase = mediaData.streams[mediaData.currentStream].timeBase;
+        lock.unlock();
+
         if (packet.GetPacket()->pts != AV_NOPTS_VALUE)
         {
             TimePoint pts = TimePoint(av_rescale_q(packet.GetPacket()->pts, timebase, { 1, AV_TIME_BASE }), MICROSECONDS);
-            if (pts > mediaData.lastPts) mediaData.lastPts = pts;
+            if (pts.GetTicks() > mediaData.lastPts.load()) mediaData.lastPts.store(pts.GetTicks());
         }
         if (packet.GetPacket()->dts != AV_NOPTS_VALUE)
         {
             TimePoint dts = TimePoint(av_rescale_q(packet.GetPacket()->dts, timebase, { 1, AV_TIME_BASE }), MICROSECONDS);
-            if (dts > mediaData.lastDts) mediaData.lastDts = dts;
+            if (dts.GetTicks() > mediaData.lastDts.load()) mediaData.lastDts.store(dts.GetTicks());
         }
-        mediaData.totalMemoryUsed += packet.GetPacket()->size;
     }
     else if (packet.last)
     {
-        mediaData.lastPts = TimePoint::Max();
-        mediaData.lastDts = TimePoint::Max();
+        mediaData.lastPts.store(TimePoint::Max().GetTicks());
+        mediaData.lastDts.store(TimePoint::Max().GetTicks());
     }
-    mediaData.packets.push_back(std::move(packet));
+
+    // Single producer, so the ring can't have filled up since the check
+    mediaData.packets.Push(packet);
+    _packetsAddedSignal.Notify();
+    return true;
 }
 
 void IMediaDataProvider::_AddFlushPackets()
@@ -593,10 +623,27 @@ void IMediaDataProvider::_ClearSubtitlePackets()
 
 void IMediaDataProvider::_ClearPackets(MediaData& mediaData)
 {
-    std::unique_lock<std::mutex> lock(mediaData.mtx);
-    mediaData.packets.clear();
-    mediaData.lastPts = TimePoint::Min();
-    mediaData.lastDts = TimePoint::Min();
-    mediaData.currentPacket = 0;
-    mediaData.totalMemoryUsed = 0;
+    mediaData.packets.Clear();
+    mediaData.lastPts.store(TimePoint::Min().GetTicks());
+    mediaData.lastDts.store(TimePoint::Min().GetTicks());
+}
+
+uint64_t IMediaDataProvider::_PacketSpaceSequence() const
+{
+    return _packetSpaceSignal.Sequence();
+}
+
+void IMediaDataProvider::_WaitForPacketSpace(uint64_t sequence, Duration timeout)
+{
+    _packetSpaceSignal.WaitFor(sequence, timeout);
+}
+
+void IMediaDataProvider::_WakePacketReader()
+{
+    _packetSpaceSignal.Notify();
+}
+
+bool IMediaDataProvider::_PacketStoreFull(const MediaData& mediaData) const
+{
+    return mediaData.packets.Full();
 }
\ No newline at end of file
@@ -4,11 +4,14 @@
 #include "MediaPacket.h"
 #include "MediaStream.h"
 #include "MediaChapter.h"
+#include "PacketRing.h"
+#include "WaitSignal.h"
 
 #include <vector>
 #include <deque>
 #include <thread>
 #include <mutex>
+#include <atomic>
 
 enum StreamSelection
 {
@@ -31,12 +34,15 @@ public:
         int currentStream = -1;
 
         // Packet data
-        std::deque<MediaPacket> packets;
-        TimePoint lastPts = TimePoint::Min();
-        TimePoint lastDts = TimePoint::Min();
-        int currentPacket = 0;
-        size_t totalMemoryUsed = 0;
-        size_t allowedMemory = 100'000'000;
+        // Written by a single packet reading thread and read by a single consumer.
+        // The read position inside the ring replaces the old 'currentPacket' index,
+        // with already read packets kept as history until memory needs to be freed.
+        PacketRing packets;
+        // TimePoint ticks
+        std::atomic<int64_t> lastPts = TimePoint::Min().GetTicks();
+        std::atomic<int64_t> lastDts = TimePoint::Min().GetTicks();
+        std::atomic<size_t> allowedMemory = 100'000'000;
+        // Guards stream metadata and the current stream index, packet storage does not use it
         std::mutex mtx;
     };
 
@@ -143,10 +149,11 @@ public:
     bool VideoMemoryExceeded();
     bool AudioMemoryExceeded();
     bool SubtitleMemoryExceeded();
+protected:
+    bool _MemoryExceeded(const MediaData& mediaData);
 private:
     void _SetAllowedMemory(MediaData& mediaData, size_t bytes);
     size_t _GetAllowedMemory(const MediaData& mediaData) const;
-    bool _MemoryExceeded(const MediaData& mediaData);
     void _UpdateMemoryLimits(bool force = false);
     bool _autoUpdateMemory = true;
     TimePoint _lastMemoryUpdate = -1;
@@ -225,23 +232,41 @@ public:
     bool FlushVideoPacketNext();
     bool FlushAudioPacketNext();
     bool FlushSubtitlePacketNext();
+    // Blocks until a packet is added to any stream or the timeout expires.
+    // Returns true if packets are available.
+    bool WaitForPackets(Duration timeout);
 protected:
     size_t _PacketCount(const MediaData& mediaData) const;
     MediaPacket _GetPacket(MediaData& mediaData);
     bool _FlushPacketNext(MediaData& mediaData);
+    // Signaled on every added packet
+    WaitSignal _packetsAddedSignal;
 
 
     // PACKET MANIPULATION
 protected:
-    void _AddVideoPacket(MediaPacket packet);
-    void _AddAudioPacket(MediaPacket packet);
-    void _AddSubtitlePacket(MediaPacket packet);
+    // If the packet ring is full, these return false and leave the packet untouched
+    bool _AddVideoPacket(MediaPacket&& packet);
+    bool _AddAudioPacket(MediaPacket&& packet);
+    bool _AddSubtitlePacket(MediaPacket&& packet);
     // A stub for now.
     void _AddFlushPackets();
     void _ClearVideoPackets();
     void _ClearAudioPackets();
     void _ClearSubtitlePackets();
-    void _AddPacket(MediaData& mediaData, MediaPacket packet);
+    bool _AddPacket(MediaData& mediaData, MediaPacket& packet);
     void _ClearPackets(MediaData& mediaData);
+    // Should be used by packet reading threads instead of sleeping when
+    // memory limits are reached. Returns early when packet memory is freed,
+    // or _WakePacketReader() is called (seek/stop).
+    // 'sequence' must be read with _PacketSpaceSequence() before checking the limits,
+    // so memory freed in between isn't missed.
+    uint64_t _PacketSpaceSequence() const;
+    void _WaitForPacketSpace(uint64_t sequence, Duration timeout);
+    void _WakePacketReader();
+    bool _PacketStoreFull(const MediaData& mediaData) const;
+private:
+    // Signaled when packet memory gets freed
+    WaitSignal _packetSpaceSignal;
 
 };
\ No newline at end of file
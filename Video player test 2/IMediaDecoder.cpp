@@ -1,5 +1,13 @@
 #include "IMediaDecoder.h"
 
+#include "App.h"
+#include "PlaybackEvents.h"
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+}
+
 IMediaDecoder::IMediaDecoder()
 {
 
@@ -13,55 +21,45 @@ IMediaDecoder::~IMediaDecoder()
 
 bool IMediaDecoder::PacketQueueFull() const
 {
-    return _packets.size() >= _MAX_PACKET_QUEUE_SIZE;
+    return _packets.Full();
 }
 
 size_t IMediaDecoder::PacketQueueSize() const
 {
-    return _packets.size();
+    return _packets.Size();
 }
 
 void IMediaDecoder::AddPacket(MediaPacket packet)
 {
-    std::lock_guard<std::mutex> lock(_m_packets);
-    _packets.push(std::move(packet));
+    _packets.Push(std::move(packet));
 }
 
 size_t IMediaDecoder::FrameCount() const
 {
-    return _frames.size();
+    return _frames.Size();
 }
 
 std::unique_ptr<IMediaFrame> IMediaDecoder::GetFrame()
 {
-    std::lock_guard<std::mutex> lock(_m_frames);
-    if (_frames.empty()) return nullptr;
-    std::unique_ptr<IMediaFrame> frame(_frames.front());
-    _frames.pop();
+    std::unique_ptr<IMediaFrame> frame;
+    _frames.TryPop(frame);
     return frame;
 }
 
 void IMediaDecoder::Flush()
 {
     _decoderThreadFlush = true;
+    _stageSignal.Notify();
 }
 
 void IMediaDecoder::ClearPackets()
 {
-    _m_packets.lock();
-    while (!_packets.empty()) _packets.pop();
-    _m_packets.unlock();
+    _packets.Clear();
 }
 
 void IMediaDecoder::ClearFrames()
 {
-    _m_frames.lock();
-    while (!_frames.empty())
-    {
-        delete _frames.front();
-        _frames.pop();
-    }
-    _m_frames.unlock();
+    _frames.Clear();
 }
 
 bool IMediaDecoder::Flushing() const
@@ -69,6 +67,26 @@ bool IMediaDecoder::Flushing() const
     return _decoderThreadFlush;
 }
 
+void IMediaDecoder::SetIdle(bool idle)
+{
+    _idle = idle;
+}
+
+bool IMediaDecoder::Idle() const
+{
+    return _idle;
+}
+
+PipelineChannelStats IMediaDecoder::PacketQueueStats() const
+{
+    return _packets.GetStats();
+}
+
+PipelineChannelStats IMediaDecoder::FrameQueueStats() const
+{
+    return _frames.GetStats();
+}
+
 void IMediaDecoder::_StartDecoding()
 {
     _decoderThreadStop = false;
@@ -78,5 +96,68 @@ void IMediaDecoder::_StartDecoding()
 void IMediaDecoder::_StopDecoding()
 {
     _decoderThreadStop = true;
+    _stageSignal.Notify();
     if (_decoderThread.joinable()) _decoderThread.join();
 }
+
+void IMediaDecoder::_WaitForWork(bool packetPending, Duration timeout)
+{
+    uint64_t sequence = _stageSignal.Sequence();
+    if (_decoderThreadStop || _decoderThreadFlush)
+        return;
+    if ((packetPending || !_packets.Empty()) && !_frames.Full())
+        return;
+    _stageSignal.WaitFor(sequence, timeout);
+}
+
+void IMediaDecoder::_PushFrame(IMediaFrame* frame)
+{
+    _frames.Push(std::unique_ptr<IMediaFrame>(frame));
+}
+
+
+void IMediaDecoder::_SetupThreading(AVCodecContext* codecContext, int threadCount, bool frameThreading, bool sliceThreading)
+{
+    codecContext->thread_count = threadCount;
+    codecContext->thread_type = 0;
+    if (frameThreading)
+        codecContext->thread_type |= FF_THREAD_FRAME;
+    if (sliceThreading)
+        codecContext->thread_type |= FF_THREAD_SLICE;
+    if (codecContext->thread_type == 0)
+        codecContext->thread_count = 1;
+}
+
+void IMediaDecoder::_UpdateStats(TimePoint now, const char* decoderName, const AVCodecContext* codecContext)
+{
+    if (_lastStatsReport.GetTicks() == -1)
+    {
+        _lastStatsReport = now;
+        _framesDecoded = 0;
+        return;
+    }
+    if (now - _lastStatsReport < _statsInterval)
+        return;
+    if (_idle)
+    {
+        _lastStatsReport = now;
+        _framesDecoded = 0;
+        return;
+    }
+
+    DecoderStatsEvent ev;
+    ev.decoder = decoderName;
+    ev.timeInterval = now - _lastStatsReport;
+    ev.framesDecoded = _framesDecoded;
+    ev.threadCount = codecContext->thread_count;
+    if (codecContext->active_thread_type & FF_THREAD_FRAME)
+        ev.threadType = "frame";
+    else if (codecContext->active_thread_type & FF_THREAD_SLICE)
+        ev.threadType = "slice";
+    else
+        ev.threadType = "none";
+    App::Instance()->events.RaiseEvent(ev);
+
+    _lastStatsReport = now;
+    _framesDecoded = 0;
+}
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <queue>
 #include <memory>
 #include <mutex>
+#include <atomic>
 #include "ChiliWin.h"
 
 #include "GameTime.h"
@@ -14,24 +15,31 @@
 #include "MediaStream.h"
 #include "MediaPacket.h"
 #include "IMediaFrame.h"
+#include "PipelineChannel.h"
+
+struct AVCodecContext;
 
 class IMediaDecoder
 {
 protected:
-    std::queue<MediaPacket> _packets;
-    std::queue<IMediaFrame*> _frames;
-    std::mutex _m_packets;
-    std::mutex _m_frames;
-
-    size_t _MAX_FRAME_QUEUE_SIZE;
-    size_t _MAX_PACKET_QUEUE_SIZE;
+    // Notified on any packet/frame channel change and on flush/stop requests
+    WaitSignal _stageSignal;
+    PipelineChannel<MediaPacket> _packets{ 30, &_stageSignal };
+    PipelineChannel<std::unique_ptr<IMediaFrame>> _frames{ 12, &_stageSignal };
 
-    bool _decoderThreadStop = false;
-    bool _decoderThreadFlush = false;
+    std::atomic<bool> _decoderThreadStop = false;
+    std::atomic<bool> _decoderThreadFlush = false;
+    // Set while the decoder is parked in a DecoderCache
+    std::atomic<bool> _idle = false;
     std::thread _decoderThread;
 
     AVRational _timebase;
 
+    // Frames produced since the last stats report
+    int64_t _framesDecoded = 0;
+    TimePoint _lastStatsReport = -1;
+    Duration _statsInterval = Duration(1, SECONDS);
+
 public:
     IMediaDecoder();
     virtual ~IMediaDecoder();
@@ -48,8 +56,27 @@ public:
     void ClearFrames();
     bool Flushing() const;
 
+    // Idle decoders don't report stats
+    void SetIdle(bool idle);
+    bool Idle() const;
+
+    PipelineChannelStats PacketQueueStats() const;
+    PipelineChannelStats FrameQueueStats() const;
+
+protected:
+    void _StopDecoding();
+    // Blocks the decoder thread until there is work to do: a flush/stop request,
+    // or an input packet ('packetPending' or queued) together with free frame space.
+    // The timeout allows periodic work (like reloading options) to keep running.
+    void _WaitForWork(bool packetPending = false, Duration timeout = Duration(100, MILLISECONDS));
+    void _PushFrame(IMediaFrame* frame);
+
+    // Must be called before avcodec_open2. A thread count of 0 lets FFmpeg pick one per core.
+    static void _SetupThreading(AVCodecContext* codecContext, int threadCount, bool frameThreading, bool sliceThreading);
+    // Raises a DecoderStatsEvent every '_statsInterval'
+    void _UpdateStats(TimePoint now, const char* decoderName, const AVCodecContext* codecContext);
+
 private:
     void _StartDecoding();
-    void _StopDecoding();
     virtual void _DecoderThread() = 0;
 };
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "NetBase2.h"
+#include "ClockSync.h"
 
 namespace znet
 {
@@ -19,6 +20,11 @@ namespace znet
         virtual std::vector<int64_t> UserIds(bool includeSelf) = 0;
         virtual User ThisUser() = 0;
         virtual int64_t ThisUserId() = 0;
+        // Time of the clock shared by all users (the server clock).
+        // Used to make every user execute a command at the same moment.
+        virtual TimePoint SharedTime() { return ClockSync::LocalTime(); }
+        // Whether SharedTime() follows the server clock yet. Until then it is an unrelated local clock.
+        virtual bool SharedTimeSynced() { return true; }
 
         virtual void Send(Packet&& packet, std::vector<int64_t> userIds, int priority = 0) = 0;
         virtual void AddToQueue(Packet&& packet) = 0;
@@ -98,6 +98,7 @@ void LocalFileDataProvider::Start()
 void LocalFileDataProvider::Stop()
 {
     _packetThreadController.Set("stop", true);
+    _WakePacketReader();
     _abortSourceAdd = true;
     if (_packetReadingThread.joinable())
         _packetReadingThread.join();
@@ -249,6 +250,7 @@ void LocalFileDataProvider::_AddLocalMedia(std::string path, int streams)
 void LocalFileDataProvider::_Seek(SeekData seekData)
 {
     _packetThreadController.Set("seek", seekData);
+    _WakePacketReader();
 }
 
 void LocalFileDataProvider::_Seek(TimePoint time)
@@ -256,6 +258,7 @@ void LocalFileDataProvider::_Seek(TimePoint time)
     IMediaDataProvider::SeekData seekData;
     seekData.time = time;
     _packetThreadController.Set("seek", seekData);
+    _WakePacketReader();
     //_packetThreadController.Set("seek", time.GetTime());
 }
 
@@ -265,6 +268,7 @@ void LocalFileDataProvider::_SetVideoStream(int index, TimePoint time)
     seekData.time = time;
     seekData.videoStreamIndex = index;
     _packetThreadController.Set("seek", seekData);
+    _WakePacketReader();
     //_packetThreadController.Set("stream", StreamChangeDesc{ index, &_videoData, time });
 }
 
@@ -274,6 +278,7 @@ void LocalFileDataProvider::_SetAudioStream(int index, TimePoint time)
     seekData.time = time;
     seekData.audioStreamIndex = index;
     _packetThreadController.Set("seek", seekData);
+    _WakePacketReader();
     //_packetThreadController.Set("stream", StreamChangeDesc{ index, &_audioData, time });
 }
 
@@ -283,6 +288,7 @@ void LocalFileDataProvider::_SetSubtitleStream(int index, TimePoint time)
     seekData.time = time;
     seekData.subtitleStreamIndex = index;
     _packetThreadController.Set("seek", seekData);
+    _WakePacketReader();
     //_packetThreadController.Set("stream", StreamChangeDesc{ index, &_subtitleData, time });
 }
 
@@ -450,13 +456,22 @@ void LocalFileDataProvider::_ReadPackets()
 
             std::unique_lock lock(_m_sources);
 
-            // Change streams
+            // Change streams (under the stream lock, the buffered duration is read from other threads)
             if (seekData.videoStreamIndex != std::numeric_limits<int>::min())
+            {
+                std::lock_guard streamLock(_videoData.mtx);
                 _videoData.currentStream = seekData.videoStreamIndex;
+            }
             if (seekData.audioStreamIndex != std::numeric_limits<int>::min())
+            {
+                std::lock_guard streamLock(_audioData.mtx);
                 _audioData.currentStream = seekData.audioStreamIndex;
+            }
             if (seekData.subtitleStreamIndex != std::numeric_limits<int>::min())
+            {
+                std::lock_guard streamLock(_subtitleData.mtx);
                 _subtitleData.currentStream = seekData.subtitleStreamIndex;
+            }
 
             if (_videoData.currentStream != -1 && _videoData.currentStream < _videoStreamSourceIndex.size())
                 activeSourceIndices.insert(_videoStreamSourceIndex[_videoData.currentStream]);
@@ -523,6 +538,8 @@ void LocalFileDataProvider::_ReadPackets()
 
         std::unique_lock lockSources(_m_sources);
 
+        // Read before the memory checks, so space freed after them still wakes the wait below
+        uint64_t spaceSequence = _PacketSpaceSequence();
         bool sleep = true;
 
         // Read from active sources
@@ -612,9 +629,6 @@ void LocalFileDataProvider::_ReadPackets()
                 av_packet_free(&packet);
                 if (result == AVERROR_EOF && !eof)
                 {
-                    eof = true;
-                    _packetThreadController.Set("eof", true);
-
                     // Determine which streams this source provides packets to
                     bool videoStream = false;
                     bool audioStream = false;
@@ -644,6 +658,18 @@ void LocalFileDataProvider::_ReadPackets()
                         }
                     }
 
+                    // Stream end packets must not be lost, so wait until they fit.
+                    // Reading again returns EOF again.
+                    if ((videoStream && _PacketStoreFull(_videoData))
+                        || (audioStream && _PacketStoreFull(_audioData))
+                        || (subtitleStream && _PacketStoreFull(_subtitleData)))
+                    {
+                        continue;
+                    }
+
+                    eof = true;
+                    _packetThreadController.Set("eof", true);
+
                     // Add stream end packets to the streams
                     if (videoStream)
                     {
@@ -672,8 +698,9 @@ void LocalFileDataProvider::_ReadPackets()
 
         lockSources.unlock();
 
+        // Wakes up as soon as the consumer frees packet memory, or a seek/stop arrives
         if (sleep)
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            _WaitForPacketSpace(spaceSequence, Duration(10, MILLISECONDS));
     }
 
     // Clear held packets
@@ -14,6 +14,7 @@
 #include <memory>
 
 #include "Options.h"
+#include "WorkerPool.h"
 #include "OptionNames.h"
 #include "BoolOptionAdapter.h"
 #include "NetBase2.h"
@@ -96,6 +97,9 @@ int WINAPI wWinMain(HINSTANCE hInst, HINSTANCE, LPWSTR cmdLine, INT)
     // Load options
     Options::Init();
 
+    // Start shared worker threads
+    WorkerPool::Init();
+
     // Create window
     DisplayWindow window(hInst, cmdLine, L"class");
 
@@ -1,10 +1,12 @@
 #include "MediaHostDataProvider.h"
 
+#include "App.h"
 #include "Network.h"
 #include "Options.h"
 #include "OptionNames.h"
 #include "IntOptionAdapter.h"
 
+#include <algorithm>
 #include <iostream>
 
 MediaHostDataProvider::MediaHostDataProvider(std::unique_ptr<LocalFileDataProvider> localDataProvider, std::vector<int64_t> participants)
@@ -13,11 +15,15 @@ MediaHostDataProvider::MediaHostDataProvider(std::unique_ptr<LocalFileDataProvid
     _videoMemoryPacketReceiver = std::make_unique<znet::PacketReceiver>(znet::PacketType::VIDEO_MEMORY_LIMIT);
     _audioMemoryPacketReceiver = std::make_unique<znet::PacketReceiver>(znet::PacketType::AUDIO_MEMORY_LIMIT);
     _subtitleMemoryPacketReceiver = std::make_unique<znet::PacketReceiver>(znet::PacketType::SUBTITLE_MEMORY_LIMIT);
-    // Update manually with input from clients
-    AutoUpdateMemoryFromSettings(false);
+    _lateJoinReceiver = std::make_unique<znet::PacketReceiver>(znet::PacketType::LATE_JOIN_REQUEST);
+    _playbackPositionReceiver = std::make_unique<znet::PacketReceiver>(znet::PacketType::PLAYBACK_POSITION);
+    _userDisconnectedReceiver = std::make_unique<EventReceiver<UserDisconnectedEvent>>(&App::Instance()->events);
 
     _localDataProvider = std::move(localDataProvider);
     _destinationUsers = participants;
+    _InitLog(_videoLog, znet::PacketType::VIDEO_PACKET, _videoData);
+    _InitLog(_audioLog, znet::PacketType::AUDIO_PACKET, _audioData);
+    _InitLog(_subtitleLog, znet::PacketType::SUBTITLE_PACKET, _subtitleData);
 
     _initializing = true;
     _INIT_THREAD_STOP = false;
@@ -82,6 +88,7 @@ void MediaHostDataProvider::_SetSubtitleStream(int index, TimePoint time)
 void MediaHostDataProvider::_Initialize()
 {
     std::cout << "Init started.." << std::endl;
+    std::vector<int64_t> users = GetDestinationUsers();
 
     // Set small memory limits, since this class is unable to directly manage
     // packet reading in local file data provider
@@ -116,7 +123,7 @@ void MediaHostDataProvider::_Initialize()
         {
             return _users.empty();
         }
-    } metadataTracker(_destinationUsers);
+    } metadataTracker(users);
 
     // Create controller ready confirmation receiver
     class ControllerTracker : public znet::PacketSubscriber
@@ -143,8 +150,22 @@ void MediaHostDataProvider::_Initialize()
         {
             return _users.empty();
         }
-    } controllerTracker(_destinationUsers);
+    } controllerTracker(users);
 
+    _SendMetadata(users);
+
+    // Wait for confirmation
+    while (!metadataTracker.AllReceived() && !_INIT_THREAD_STOP)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    std::cout << "Metadata receive confirmed!" << std::endl;
+
+    _initializing = false;
+
+    std::cout << "Init success!" << std::endl;
+}
+
+void MediaHostDataProvider::_SendMetadata(std::vector<int64_t> users)
+{
     // Create stream metadata struct
     struct StreamMetadata
     {
@@ -173,7 +194,7 @@ void MediaHostDataProvider::_Initialize()
     };
 
     // Send stream metadata
-    APP_NETWORK->Send(znet::Packet((int)znet::PacketType::STREAM_METADATA).From(streamMetadata), _destinationUsers);
+    APP_NETWORK->Send(znet::Packet((int)znet::PacketType::STREAM_METADATA).From(streamMetadata), users);
 
     // Send streams
     for (int i = 0; i < _videoData.streams.size(); i++)
@@ -182,7 +203,7 @@ void MediaHostDataProvider::_Initialize()
         auto bytes = std::make_unique<int8_t[]>(serializedData.Size());
         std::copy_n(serializedData.Bytes(), serializedData.Size(), bytes.get());
         znet::Packet streamPacket(std::move(bytes), serializedData.Size(), (int)znet::PacketType::VIDEO_STREAM);
-        APP_NETWORK->Send(std::move(streamPacket), _destinationUsers);
+        APP_NETWORK->Send(std::move(streamPacket), users);
     }
     for (int i = 0; i < _audioData.streams.size(); i++)
     {
@@ -190,7 +211,7 @@ void MediaHostDataProvider::_Initialize()
         auto bytes = std::make_unique<int8_t[]>(serializedData.Size());
         std::copy_n(serializedData.Bytes(), serializedData.Size(), bytes.get());
         znet::Packet streamPacket(std::move(bytes), serializedData.Size(), (int)znet::PacketType::AUDIO_STREAM);
-        APP_NETWORK->Send(std::move(streamPacket), _destinationUsers);
+        APP_NETWORK->Send(std::move(streamPacket), users);
     }
     for (int i = 0; i < _subtitleData.streams.size(); i++)
     {
@@ -198,7 +219,7 @@ void MediaHostDataProvider::_Initialize()
         auto bytes = std::make_unique<int8_t[]>(serializedData.Size());
         std::copy_n(serializedData.Bytes(), serializedData.Size(), bytes.get());
         znet::Packet streamPacket(std::move(bytes), serializedData.Size(), (int)znet::PacketType::SUBTITLE_STREAM);
-        APP_NETWORK->Send(std::move(streamPacket), _destinationUsers);
+        APP_NETWORK->Send(std::move(streamPacket), users);
     }
     for (int i = 0; i < _attachmentStreams.size(); i++)
     {
@@ -206,7 +227,7 @@ void MediaHostDataProvider::_Initialize()
         auto bytes = std::make_unique<int8_t[]>(serializedData.Size());
         std::copy_n(serializedData.Bytes(), serializedData.Size(), bytes.get());
         znet::Packet streamPacket(std::move(bytes), serializedData.Size(), (int)znet::PacketType::ATTACHMENT_STREAM);
-        APP_NETWORK->Send(std::move(streamPacket), _destinationUsers);
+        APP_NETWORK->Send(std::move(streamPacket), users);
     }
     for (int i = 0; i < _dataStreams.size(); i++)
     {
@@ -214,7 +235,7 @@ void MediaHostDataProvider::_Initialize()
         auto bytes = std::make_unique<int8_t[]>(serializedData.Size());
         std::copy_n(serializedData.Bytes(), serializedData.Size(), bytes.get());
         znet::Packet streamPacket(std::move(bytes), serializedData.Size(), (int)znet::PacketType::DATA_STREAM);
-        APP_NETWORK->Send(std::move(streamPacket), _destinationUsers);
+        APP_NETWORK->Send(std::move(streamPacket), users);
     }
     for (int i = 0; i < _unknownStreams.size(); i++)
     {
@@ -222,7 +243,7 @@ void MediaHostDataProvider::_Initialize()
         auto bytes = std::make_unique<int8_t[]>(serializedData.Size());
         std::copy_n(serializedData.Bytes(), serializedData.Size(), bytes.get());
         znet::Packet streamPacket(std::move(bytes), serializedData.Size(), (int)znet::PacketType::UNKNOWN_STREAM);
-        APP_NETWORK->Send(std::move(streamPacket), _destinationUsers);
+        APP_NETWORK->Send(std::move(streamPacket), users);
     }
     // Send chapters
     for (int i = 0; i < _chapters.size(); i++)
@@ -231,45 +252,20 @@ void MediaHostDataProvider::_Initialize()
         auto bytes = std::make_unique<int8_t[]>(serializedData.Size());
         std::copy_n(serializedData.Bytes(), serializedData.Size(), bytes.get());
         znet::Packet chapterPacket(std::move(bytes), serializedData.Size(), (int)znet::PacketType::CHAPTER);
-        APP_NETWORK->Send(std::move(chapterPacket), _destinationUsers);
+        APP_NETWORK->Send(std::move(chapterPacket), users);
     }
-
-    // Wait for confirmation
-    while (!metadataTracker.AllReceived() && !_INIT_THREAD_STOP)
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    std::cout << "Metadata receive confirmed!" << std::endl;
-
-    _initializing = false;
-
-    std::cout << "Init success!" << std::endl;
 }
 
 void MediaHostDataProvider::_ReadPackets()
 {
-    using namespace znet;
-
-    MediaPacket videoPacket;
-    MediaPacket audioPacket;
-    MediaPacket subtitlePacket;
-
-    TimePoint lastMemoryUpdate = -1;
-    Duration memoryUpdateInterval = Duration(2, SECONDS);
-    Clock threadClock = Clock(0);
-
     while (!_PACKET_THREAD_STOP)
     {
-        threadClock.Update();
-
-        // Periodically update memory limits in case options change
-        if (threadClock.Now() >= lastMemoryUpdate + memoryUpdateInterval)
-        {
-            lastMemoryUpdate = threadClock.Now();
-            _UpdateSelfMemoryLimit();
-        }
-
-        _CheckForVideoMemoryPackets();
-        _CheckForAudioMemoryPackets();
-        _CheckForSubtitleMemoryPackets();
+        _CheckForDisconnects();
+        _CheckForLateJoins();
+        _CheckForPlaybackPositions();
+        _CheckForMemoryPackets(_videoMemoryPacketReceiver.get(), _videoLog);
+        _CheckForMemoryPackets(_audioMemoryPacketReceiver.get(), _audioLog);
+        _CheckForMemoryPackets(_subtitleMemoryPacketReceiver.get(), _subtitleLog);
 
         std::unique_lock<std::mutex> lock(_m_seek);
         if (_waitForDiscontinuity)
@@ -277,26 +273,29 @@ void MediaHostDataProvider::_ReadPackets()
             // Wait until all packet types are flush
             if (!_localDataProvider->FlushVideoPacketNext())
             {
-                std::this_thread::sleep_for(std::chrono::milliseconds(0));
+                _localDataProvider->WaitForPackets(Duration(1, MILLISECONDS));
                 continue;
             }
             if (!_localDataProvider->FlushAudioPacketNext())
             {
-                std::this_thread::sleep_for(std::chrono::milliseconds(0));
+                _localDataProvider->WaitForPackets(Duration(1, MILLISECONDS));
                 continue;
             }
             if (!_localDataProvider->FlushSubtitlePacketNext())
             {
-                std::this_thread::sleep_for(std::chrono::milliseconds(0));
+                _localDataProvider->WaitForPackets(Duration(1, MILLISECONDS));
                 continue;
             }
 
-            videoPacket = _localDataProvider->GetVideoPacket();
-            audioPacket = _localDataProvider->GetAudioPacket();
-            subtitlePacket = _localDataProvider->GetSubtitlePacket();
+            MediaPacket videoPacket = _localDataProvider->GetVideoPacket();
+            MediaPacket audioPacket = _localDataProvider->GetAudioPacket();
+            MediaPacket subtitlePacket = _localDataProvider->GetSubtitlePacket();
             _ClearVideoPackets();
             _ClearAudioPackets();
             _ClearSubtitlePackets();
+            _ClearLog(_videoLog);
+            _ClearLog(_audioLog);
+            _ClearLog(_subtitleLog);
 
             // Clear outgoing packets
             APP_NETWORK->AbortSend((int32_t)znet::PacketType::VIDEO_PACKET);
@@ -305,78 +304,68 @@ void MediaHostDataProvider::_ReadPackets()
 
             // Send seek order
             //znet::NetworkInterface::Instance()->Send(znet::Packet((int)znet::PacketType::INITIATE_SEEK).From(_seekData), { _destinationUsers });
-            APP_NETWORK->Send(znet::Packet((int)znet::PacketType::SEEK_DISCONTINUITY)/*.From(_seekData)*/, { _destinationUsers });
+            APP_NETWORK->Send(znet::Packet((int)znet::PacketType::SEEK_DISCONTINUITY)/*.From(_seekData)*/, GetDestinationUsers());
             std::cout << "Seek order sent" << std::endl;
 
+            // Flush packets go out right after the discontinuity
+            _AppendToLog(_videoLog, std::move(videoPacket));
+            _AppendToLog(_audioLog, std::move(audioPacket));
+            _AppendToLog(_subtitleLog, std::move(subtitlePacket));
+
             _waitForDiscontinuity = false;
         }
         lock.unlock();
 
-        // Read packets
-        if (!videoPacket.Valid() && !videoPacket.flush)
-            videoPacket = _localDataProvider->GetVideoPacket();
-        if (!audioPacket.Valid() && !audioPacket.flush)
-            audioPacket = _localDataProvider->GetAudioPacket();
-        if (!subtitlePacket.Valid() && !subtitlePacket.flush)
-            subtitlePacket = _localDataProvider->GetSubtitlePacket();
-
+        // Read before the log checks, so space freed after them still wakes the wait below
+        uint64_t spaceSequence = _PacketSpaceSequence();
 
-        // Pass packets to receivers and data provider
-        bool packetPassed = false;
-        if (videoPacket.Valid() || videoPacket.flush || videoPacket.last)
+        // Read packets into the logs
+        bool packetRead = false;
+        if (!_LogFull(_videoLog))
         {
-            if (!VideoMemoryExceeded())
+            MediaPacket packet = _localDataProvider->GetVideoPacket();
+            if (packet.Valid() || packet.flush || packet.last)
             {
-                packetPassed = true;
-
-                // Send packet to all receivers
-                auto data = videoPacket.Serialize();
-                auto bytes = std::make_unique<int8_t[]>(data.Size());
-                std::copy_n(data.Bytes(), data.Size(), bytes.get());
-                APP_NETWORK->Send(Packet(std::move(bytes), data.Size(), (int)PacketType::VIDEO_PACKET), _destinationUsers);
-
-                // Add packet to local playback
-                _AddVideoPacket(std::move(videoPacket));
+                _AppendToLog(_videoLog, std::move(packet));
+                packetRead = true;
             }
         }
-
-        if (audioPacket.Valid() || audioPacket.flush || audioPacket.last)
+        if (!_LogFull(_audioLog))
         {
-            if (!AudioMemoryExceeded())
+            MediaPacket packet = _localDataProvider->GetAudioPacket();
+            if (packet.Valid() || packet.flush || packet.last)
             {
-                packetPassed = true;
-
-                // Send packet to all receivers
-                auto data = audioPacket.Serialize();
-                auto bytes = std::make_unique<int8_t[]>(data.Size());
-                std::copy_n(data.Bytes(), data.Size(), bytes.get());
-                APP_NETWORK->Send(Packet(std::move(bytes), data.Size(), (int)PacketType::AUDIO_PACKET), _destinationUsers);
-
-                // Add packet to local playback
-                _AddAudioPacket(std::move(audioPacket));
+                _AppendToLog(_audioLog, std::move(packet));
+                packetRead = true;
             }
         }
-
-        if (subtitlePacket.Valid() || subtitlePacket.flush || subtitlePacket.last)
+        if (!_LogFull(_subtitleLog))
         {
-            if (!SubtitleMemoryExceeded())
+            MediaPacket packet = _localDataProvider->GetSubtitlePacket();
+            if (packet.Valid() || packet.flush || packet.last)
             {
-                packetPassed = true;
-
-                // Send packet to all receivers
-                auto data = subtitlePacket.Serialize();
-                auto bytes = std::make_unique<int8_t[]>(data.Size());
-                std::copy_n(data.Bytes(), data.Size(), bytes.get());
-                APP_NETWORK->Send(Packet(std::move(bytes), data.Size(), (int)PacketType::SUBTITLE_PACKET), _destinationUsers);
-
-                // Add packet to local playback
-                _AddSubtitlePacket(std::move(subtitlePacket));
+                _AppendToLog(_subtitleLog, std::move(packet));
+                packetRead = true;
             }
         }
 
-        if (!packetPassed)
+        // Pass packets to local playback and receivers
+        bool packetPassed = false;
+        if (_DistributeLog(_videoLog)) packetPassed = true;
+        if (_DistributeLog(_audioLog)) packetPassed = true;
+        if (_DistributeLog(_subtitleLog)) packetPassed = true;
+        _TrimLog(_videoLog);
+        _TrimLog(_audioLog);
+        _TrimLog(_subtitleLog);
+
+        if (!packetRead && !packetPassed)
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            // Logs are full, wait for playback to free memory
+            if (_LogFull(_videoLog) || _LogFull(_audioLog) || _LogFull(_subtitleLog))
+                _WaitForPacketSpace(spaceSequence, Duration(10, MILLISECONDS));
+            // Wait for the local file reader
+            else
+                _localDataProvider->WaitForPackets(Duration(10, MILLISECONDS));
         }
     }
 }
@@ -386,118 +375,313 @@ void MediaHostDataProvider::_ManageNetwork()
 
 }
 
-void MediaHostDataProvider::_CheckForVideoMemoryPackets()
+void MediaHostDataProvider::_InitLog(_PacketLog& log, znet::PacketType packetType, MediaData& localData)
 {
-    if (!_videoMemoryPacketReceiver)
-        return;
+    log.packetType = packetType;
+    log.localData = &localData;
+    // Until receivers report their limits, assume they match the host
+    for (auto userId : _destinationUsers)
+        log.cursors.push_back({ userId, 0, 0, 0, (int64_t)localData.allowedMemory.load(), false });
+}
 
-    if (_videoMemoryPacketReceiver->PacketCount() > 0)
+void MediaHostDataProvider::_ClearLog(_PacketLog& log)
+{
+    log.entries.clear();
+    log.firstIndex = 0;
+    log.totalBytes = 0;
+    log.localPosition = 0;
+    for (auto& cursor : log.cursors)
     {
-        // Process packet
-        auto packetPair = _videoMemoryPacketReceiver->GetPacket();
-        znet::Packet packet = std::move(packetPair.first);
-        int64_t userId = packetPair.second;
+        cursor.position = 0;
+        cursor.receiverPosition = 0;
+        cursor.receiverOffset = 0;
+        cursor.catchingUp = false;
+    }
+}
 
-        if (packet.size == sizeof(size_t))
+bool MediaHostDataProvider::_LogFull(const _PacketLog& log)
+{
+    int64_t maxWindow = (int64_t)log.localData->allowedMemory.load();
+    for (auto& cursor : log.cursors)
+        maxWindow = std::max(maxWindow, cursor.window);
+
+    // The receiver with the largest window has enough buffered
+    int64_t bytesAhead = log.totalBytes - log.Offset(_PlaybackPosition(log));
+    if (bytesAhead >= maxWindow)
+        return true;
+
+    // Memory budget, which includes packets kept for receivers behind playback
+    int64_t bytesStored = log.totalBytes - log.Offset(log.firstIndex);
+    return bytesStored >= maxWindow * 2;
+}
+
+void MediaHostDataProvider::_AppendToLog(_PacketLog& log, MediaPacket packet)
+{
+    // Serialize straight into the buffer the network sends from
+    size_t capacity = packet.MaxSerializedSize();
+    auto bytes = znet::PacketBufferPool::Instance()->Acquire(capacity);
+    size_t size = packet.SerializeTo((uchar*)bytes.get(), capacity);
+    znet::Packet serializedPacket(std::move(bytes), size, (int)log.packetType);
+
+    TimePoint time = log.entries.empty() ? TimePoint::Min() : log.entries.back().time;
+    if (!packet.flush && packet.Valid())
+    {
+        int64_t timestamp = packet.GetPacket()->dts != AV_NOPTS_VALUE ? packet.GetPacket()->dts : packet.GetPacket()->pts;
+        std::unique_lock<std::mutex> lock(log.localData->mtx);
+        if (timestamp != AV_NOPTS_VALUE && log.localData->currentStream >= 0 && log.localData->currentStream < log.localData->streams.size())
         {
-            size_t bytes = packet.Cast<size_t>();
-            _videoMemoryLimits[userId] = bytes;
-            _UpdateSelfMemoryLimit();
+            AVRational timebase = log.localData->streams[log.localData->currentStream].timeBase;
+            time = TimePoint(av_rescale_q(timestamp, timebase, { 1, AV_TIME_BASE }), MICROSECONDS);
         }
     }
+
+    bool startPoint = packet.flush || (packet.Valid() && (packet.GetPacket()->flags & AV_PKT_FLAG_KEY));
+    log.entries.push_back({ std::move(packet), std::move(serializedPacket), log.totalBytes, time, startPoint });
+    log.totalBytes += size;
 }
 
-void MediaHostDataProvider::_CheckForAudioMemoryPackets()
+bool MediaHostDataProvider::_DistributeLog(_PacketLog& log)
 {
-    if (!_audioMemoryPacketReceiver)
-        return;
+    bool packetPassed = false;
 
-    if (_audioMemoryPacketReceiver->PacketCount() > 0)
+    // Add packets to local playback
+    while (log.localPosition < log.EndIndex() && !_MemoryExceeded(*log.localData))
     {
-        // Process packet
-        auto packetPair = _audioMemoryPacketReceiver->GetPacket();
-        znet::Packet packet = std::move(packetPair.first);
-        int64_t userId = packetPair.second;
+        if (!_AddPacket(*log.localData, log.entries[log.localPosition - log.firstIndex].mediaPacket))
+            break;
+        log.localPosition++;
+        packetPassed = true;
+    }
 
-        if (packet.size == sizeof(size_t))
+    // Receivers are sent at most their window ahead of their own playback
+    auto canSend = [&](const _LogCursor& cursor)
+    {
+        return cursor.position < log.EndIndex() && log.Offset(cursor.position) - cursor.receiverOffset < cursor.window;
+    };
+
+    int64_t playbackPosition = _PlaybackPosition(log);
+    std::vector<int64_t> users;
+    std::vector<int64_t> catchingUpUsers;
+    while (true)
+    {
+        // Send the earliest pending packet, to every receiver waiting for it at once
+        int64_t position = log.EndIndex();
+        for (auto& cursor : log.cursors)
+            if (canSend(cursor) && cursor.position < position)
+                position = cursor.position;
+        if (position == log.EndIndex())
+            break;
+
+        users.clear();
+        catchingUpUsers.clear();
+        for (auto& cursor : log.cursors)
         {
-            size_t bytes = packet.Cast<size_t>();
-            _audioMemoryLimits[userId] = bytes;
-            _UpdateSelfMemoryLimit();
+            if (cursor.position == position && canSend(cursor))
+            {
+                if (cursor.catchingUp)
+                    catchingUpUsers.push_back(cursor.userId);
+                else
+                    users.push_back(cursor.userId);
+                cursor.position++;
+                if (cursor.position > playbackPosition)
+                    cursor.catchingUp = false;
+            }
+        }
+        const znet::Packet& packet = log.entries[position - log.firstIndex].packet;
+        if (!users.empty())
+            APP_NETWORK->Send(packet.Reference(), users);
+        // Goes ahead of live packets already queued for the late joiners
+        if (!catchingUpUsers.empty())
+            APP_NETWORK->Send(packet.Reference(), catchingUpUsers, 1);
+        packetPassed = true;
+    }
+
+    return packetPassed;
+}
+
+void MediaHostDataProvider::_TrimLog(_PacketLog& log)
+{
+    int64_t catchUpPosition = _CatchUpPosition(log);
+
+    // A receiver which stopped making progress would otherwise hold the log until reading stops
+    // for everyone. It continues from the last keyframe, like a late joiner.
+    int64_t maxWindow = (int64_t)log.localData->allowedMemory.load();
+    for (auto& cursor : log.cursors)
+        maxWindow = std::max(maxWindow, cursor.window);
+    if (log.totalBytes - log.Offset(log.firstIndex) >= maxWindow * 2)
+    {
+        for (auto& cursor : log.cursors)
+        {
+            if (cursor.position < catchUpPosition)
+            {
+                std::cout << "Receiver " << cursor.userId << " fell behind, continuing from the last keyframe" << std::endl;
+                cursor.position = catchUpPosition;
+                cursor.receiverPosition = catchUpPosition;
+                cursor.receiverOffset = log.Offset(catchUpPosition);
+                cursor.catchingUp = true;
+            }
         }
     }
+
+    int64_t trimPosition = catchUpPosition;
+    for (auto& cursor : log.cursors)
+        trimPosition = std::min(trimPosition, cursor.position);
+
+    while (log.firstIndex < trimPosition)
+    {
+        log.entries.pop_front();
+        log.firstIndex++;
+    }
 }
 
-void MediaHostDataProvider::_CheckForSubtitleMemoryPackets()
+int64_t MediaHostDataProvider::_PlaybackPosition(const _PacketLog& log) const
 {
-    if (!_subtitleMemoryPacketReceiver)
+    // Packets passed to local playback, minus the ones it hasn't read yet
+    int64_t position = log.localPosition - (int64_t)log.localData->packets.Size();
+    return std::max(position, log.firstIndex);
+}
+
+int64_t MediaHostDataProvider::_CatchUpPosition(const _PacketLog& log) const
+{
+    int64_t playbackPosition = _PlaybackPosition(log);
+    for (int64_t i = std::min(playbackPosition, log.EndIndex() - 1); i >= log.firstIndex; i--)
+        if (log.entries[i - log.firstIndex].startPoint)
+            return i;
+    return playbackPosition;
+}
+
+void MediaHostDataProvider::_CheckForMemoryPackets(znet::PacketReceiver* receiver, _PacketLog& log)
+{
+    if (!receiver)
         return;
 
-    if (_subtitleMemoryPacketReceiver->PacketCount() > 0)
+    while (receiver->PacketCount() > 0)
     {
         // Process packet
-        auto packetPair = _subtitleMemoryPacketReceiver->GetPacket();
+        auto packetPair = receiver->GetPacket();
         znet::Packet packet = std::move(packetPair.first);
         int64_t userId = packetPair.second;
 
         if (packet.size == sizeof(size_t))
         {
             size_t bytes = packet.Cast<size_t>();
-            _subtitleMemoryLimits[userId] = bytes;
-            _UpdateSelfMemoryLimit();
+            for (auto& cursor : log.cursors)
+                if (cursor.userId == userId)
+                    cursor.window = (int64_t)bytes;
         }
     }
 }
 
-void MediaHostDataProvider::_UpdateSelfMemoryLimit()
+void MediaHostDataProvider::_CheckForLateJoins()
 {
-    size_t MIN_VIDEO_MEMORY = 100000000; // 100 mb
-    size_t MIN_AUDIO_MEMORY = 10000000; // 10 mb
-    size_t MIN_SUBTITLE_MEMORY = 1000000; // 1 mb
+    if (!_lateJoinReceiver)
+        return;
 
-    // Calculate allowed video memory
-    size_t allowedVideoMemory = IntOptionAdapter(Options::Instance()->GetValue(OPTIONS_MAX_VIDEO_MEMORY), 250).Value() * 1000000;
-    for (auto& pair : _videoMemoryLimits)
+    while (_lateJoinReceiver->PacketCount() > 0)
     {
-        if (pair.second < allowedVideoMemory)
+        auto packetPair = _lateJoinReceiver->GetPacket();
+        int64_t userId = packetPair.second;
+
+        std::unique_lock<std::mutex> lock(_m_destinationUsers);
+        if (std::find(_destinationUsers.begin(), _destinationUsers.end(), userId) == _destinationUsers.end())
+            _destinationUsers.push_back(userId);
+        lock.unlock();
+
+        _SendMetadata({ userId });
+        _AddLateJoiner(_videoLog, userId);
+        _AddLateJoiner(_audioLog, userId);
+        _AddLateJoiner(_subtitleLog, userId);
+        std::cout << "Late joiner added" << std::endl;
+    }
+}
+
+void MediaHostDataProvider::_AddLateJoiner(_PacketLog& log, int64_t userId)
+{
+    // Start from retained history, no need to read the file again
+    int64_t position = _CatchUpPosition(log);
+    int64_t offset = log.Offset(position);
+    for (auto& cursor : log.cursors)
+    {
+        if (cursor.userId == userId)
         {
-            allowedVideoMemory = pair.second;
+            cursor.position = position;
+            cursor.receiverPosition = position;
+            cursor.receiverOffset = offset;
+            cursor.catchingUp = true;
+            return;
         }
     }
-    if (allowedVideoMemory < MIN_VIDEO_MEMORY)
-        allowedVideoMemory = MIN_VIDEO_MEMORY;
+    log.cursors.push_back({ userId, position, position, offset, (int64_t)log.localData->allowedMemory.load(), true });
+}
 
-    // Calculate allowed audio memory
-    size_t allowedAudioMemory = IntOptionAdapter(Options::Instance()->GetValue(OPTIONS_MAX_AUDIO_MEMORY), 10).Value() * 1000000;
-    for (auto& pair : _audioMemoryLimits)
+void MediaHostDataProvider::_CheckForPlaybackPositions()
+{
+    if (!_playbackPositionReceiver)
+        return;
+
+    while (_playbackPositionReceiver->PacketCount() > 0)
     {
-        if (pair.second < allowedAudioMemory)
+        auto packetPair = _playbackPositionReceiver->GetPacket();
+        if (packetPair.first.size < sizeof(int64_t))
+            continue;
+        TimePoint position = TimePoint(packetPair.first.Cast<int64_t>());
+
+        _UpdateReceiverPosition(_videoLog, packetPair.second, position);
+        _UpdateReceiverPosition(_audioLog, packetPair.second, position);
+        _UpdateReceiverPosition(_subtitleLog, packetPair.second, position);
+    }
+}
+
+void MediaHostDataProvider::_UpdateReceiverPosition(_PacketLog& log, int64_t userId, TimePoint position)
+{
+    for (auto& cursor : log.cursors)
+    {
+        if (cursor.userId != userId)
+            continue;
+
+        // Packets decoded before the reported position have left the receiver's buffer.
+        // Trimmed packets were passed by every cursor, so moving past the first kept one
+        // means they were played as well.
+        int64_t index = std::max(cursor.receiverPosition, log.firstIndex);
+        bool advanced = false;
+        while (index < cursor.position && log.entries[index - log.firstIndex].time <= position)
         {
-            allowedVideoMemory = pair.second;
+            index++;
+            advanced = true;
         }
+        if (advanced)
+        {
+            cursor.receiverPosition = index;
+            cursor.receiverOffset = log.Offset(index);
+        }
+        return;
     }
-    if (allowedAudioMemory < MIN_AUDIO_MEMORY)
-        allowedAudioMemory = MIN_AUDIO_MEMORY;
+}
 
-    // Calculate allowed subtitle memory
-    size_t allowedSubtitleMemory = IntOptionAdapter(Options::Instance()->GetValue(OPTIONS_MAX_SUBTITLE_MEMORY), 1).Value() * 1000000;
-    for (auto& pair : _subtitleMemoryLimits)
+void MediaHostDataProvider::_CheckForDisconnects()
+{
+    if (!_userDisconnectedReceiver)
+        return;
+
+    while (_userDisconnectedReceiver->EventCount() > 0)
     {
-        if (pair.second < allowedSubtitleMemory)
+        int64_t userId = _userDisconnectedReceiver->GetEvent().userId;
+
+        std::unique_lock<std::mutex> lock(_m_destinationUsers);
+        _destinationUsers.erase(std::remove(_destinationUsers.begin(), _destinationUsers.end(), userId), _destinationUsers.end());
+        lock.unlock();
+
+        // Stops holding back log trimming
+        for (auto log : { &_videoLog, &_audioLog, &_subtitleLog })
         {
-            allowedSubtitleMemory = pair.second;
+            auto& cursors = log->cursors;
+            cursors.erase(std::remove_if(cursors.begin(), cursors.end(), [&](const _LogCursor& cursor) { return cursor.userId == userId; }), cursors.end());
         }
     }
-    if (allowedSubtitleMemory < MIN_SUBTITLE_MEMORY)
-        allowedSubtitleMemory = MIN_SUBTITLE_MEMORY;
-
-    SetAllowedVideoMemory(allowedVideoMemory);
-    SetAllowedAudioMemory(allowedAudioMemory);
-    SetAllowedSubtitleMemory(allowedSubtitleMemory);
 }
 
 std::vector<int64_t> MediaHostDataProvider::GetDestinationUsers()
 {
-    // TODO: needs thread safety here
+    std::lock_guard<std::mutex> lock(_m_destinationUsers);
     return _destinationUsers;
 }
\ No newline at end of file
@@ -2,8 +2,10 @@
 
 #include "LocalFileDataProvider.h"
 #include "PacketSubscriber.h"
+#include "EventSubscriber.h"
+#include "NetworkEvents.h"
 
-#include <unordered_map>
+#include <deque>
 
 class MediaHostDataProvider : public IMediaDataProvider
 {
@@ -18,19 +20,82 @@ class MediaHostDataProvider : public IMediaDataProvider
     std::mutex _m_seek;
 
     std::vector<int64_t> _destinationUsers;
+    std::mutex _m_destinationUsers;
+
+    // Read position of a single receiver in a packet log
+    struct _LogCursor
+    {
+        int64_t userId;
+        // Log index of the next packet to send
+        int64_t position;
+        // Log index and offset the receiver's playback has reached, from its PLAYBACK_POSITION
+        // reports. Packets are only sent up to 'window' bytes past it, so the backlog of a
+        // slow receiver stays bounded instead of piling up in the outgoing network queues.
+        int64_t receiverPosition;
+        int64_t receiverOffset;
+        // How many bytes the receiver can buffer ahead of playback (its memory limit)
+        int64_t window;
+        // Set for late joiners until they reach the playback position,
+        // their packets are sent with elevated priority
+        bool catchingUp;
+    };
+
+    // Packets of one stream, shared by local playback and all receivers.
+    // Each receiver reads the log through its own cursor, so a fast receiver can
+    // buffer ahead while a slow one catches up. Packets are dropped from the log
+    // once playback and every cursor have passed them.
+    struct _PacketLog
+    {
+        struct Entry
+        {
+            // Moved to local playback when it reaches the entry
+            MediaPacket mediaPacket;
+            // Serialized packet, the bytes are shared with the outgoing network queues
+            znet::Packet packet;
+            // Total size of all preceding packets
+            int64_t offset;
+            // Decode time of the packet, packets without one take the time of the previous
+            TimePoint time;
+            // Decoding can start at this packet (keyframe or flush)
+            bool startPoint;
+        };
+        std::deque<Entry> entries;
+        // Log index of the front entry
+        int64_t firstIndex = 0;
+        int64_t totalBytes = 0;
+        // Log index of the next packet to pass to local playback
+        int64_t localPosition = 0;
+        std::vector<_LogCursor> cursors;
+
+        znet::PacketType packetType;
+        MediaData* localData;
+
+        int64_t EndIndex() const { return firstIndex + (int64_t)entries.size(); }
+        // Total size of packets before 'index'
+        int64_t Offset(int64_t index) const
+        {
+            if (index >= EndIndex())
+                return totalBytes;
+            return entries[index - firstIndex].offset;
+        }
+    };
+    _PacketLog _videoLog;
+    _PacketLog _audioLog;
+    _PacketLog _subtitleLog;
 
     std::unique_ptr<znet::PacketReceiver> _videoMemoryPacketReceiver = nullptr;
     std::unique_ptr<znet::PacketReceiver> _audioMemoryPacketReceiver = nullptr;
     std::unique_ptr<znet::PacketReceiver> _subtitleMemoryPacketReceiver = nullptr;
-    std::unordered_map<int64_t, size_t> _videoMemoryLimits;
-    std::unordered_map<int64_t, size_t> _audioMemoryLimits;
-    std::unordered_map<int64_t, size_t> _subtitleMemoryLimits;
+    std::unique_ptr<znet::PacketReceiver> _lateJoinReceiver = nullptr;
+    std::unique_ptr<znet::PacketReceiver> _playbackPositionReceiver = nullptr;
+    std::unique_ptr<EventReceiver<UserDisconnectedEvent>> _userDisconnectedReceiver = nullptr;
 
 public:
     MediaHostDataProvider(std::unique_ptr<LocalFileDataProvider> localDataProvider, std::vector<int64_t> participants);
     ~MediaHostDataProvider();
 private:
     void _Initialize();
+    void _SendMetadata(std::vector<int64_t> users);
 public:
     void Start();
     void Stop();
@@ -45,10 +110,29 @@ private:
     void _ReadPackets();
     void _ManageNetwork();
 
-    void _CheckForVideoMemoryPackets();
-    void _CheckForAudioMemoryPackets();
-    void _CheckForSubtitleMemoryPackets();
-    void _UpdateSelfMemoryLimit();
+    void _InitLog(_PacketLog& log, znet::PacketType packetType, MediaData& localData);
+    void _ClearLog(_PacketLog& log);
+    // Whether the log should stop reading packets from the file
+    bool _LogFull(const _PacketLog& log);
+    void _AppendToLog(_PacketLog& log, MediaPacket packet);
+    // Passes packets to local playback and to every receiver with space in its window.
+    // Returns true if any packet was passed.
+    bool _DistributeLog(_PacketLog& log);
+    // Drops packets passed by playback and every cursor. If the log is over its memory
+    // budget, receivers too far behind are moved forward to the catch-up position.
+    void _TrimLog(_PacketLog& log);
+    // Log index of the packet local playback is at
+    int64_t _PlaybackPosition(const _PacketLog& log) const;
+    // Log index of the last start point at or before the playback position.
+    // History is kept back to it, so late joiners can start decoding there.
+    int64_t _CatchUpPosition(const _PacketLog& log) const;
+
+    void _CheckForMemoryPackets(znet::PacketReceiver* receiver, _PacketLog& log);
+    void _CheckForLateJoins();
+    void _AddLateJoiner(_PacketLog& log, int64_t userId);
+    void _CheckForPlaybackPositions();
+    void _UpdateReceiverPosition(_PacketLog& log, int64_t userId, TimePoint position);
+    void _CheckForDisconnects();
 
     // Host specific
 public:
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ISerializable.h"
+#include "WireFormat.h"
 
 extern "C"
 {
@@ -9,6 +10,7 @@ extern "C"
 }
 
 #include <atomic>
+#include <memory>
 
 #include <stdexcept>
 
@@ -91,50 +93,94 @@ public:
         return newPacket;
     }
 
+    // Wire format:
+    //  uint8 - format version
+    //  uint8 - flags (_WIRE_* values)
+    //  if the AVPacket exists:
+    //   signed varint - stream index
+    //   signed varint - AVPacket flags
+    //   signed varint - dts (if present)
+    //   signed varint - pts, relative to dts if both are present
+    //   signed varint - duration
+    //   varint - side data count, followed by that many:
+    //    signed varint - side data type
+    //    block - side data
+    //   block - packet data
+    // Packet data comes last, so a receive buffer padded after the message
+    // can be given to the decoder in place (see DeserializeInPlace()).
     SerializedData Serialize() const
     {
-        SerializedData packetBytes;
-        SerializedData otherBytes;
+        size_t capacity = MaxSerializedSize();
+        auto bytes = std::make_unique<uchar[]>(capacity);
+        size_t size = SerializeTo(bytes.get(), capacity);
+        return { size, std::move(bytes) };
+    }
+
+    // Upper bound of the serialized size
+    size_t MaxSerializedSize() const
+    {
+        size_t size = 2;
         if (_packet)
         {
-            packetBytes = _SerializeAVPacket();
+            size += 7 * WireWriter::MAX_VARINT_SIZE + _packet->size;
+            for (int i = 0; i < _packet->side_data_elems; i++)
+                size += 2 * WireWriter::MAX_VARINT_SIZE + _packet->side_data[i].size;
         }
-        otherBytes = _SerializeRemainingFields();
-
-        // First byte indicates wether '_packet' exists or not
-        size_t totalSize = 1;
-        totalSize += packetBytes.Size();
-        totalSize += otherBytes.Size();
-        auto bytes = std::make_unique<uchar[]>(totalSize);
-        size_t memPos = 0;
-
-        std::fill_n(bytes.get() + memPos, 1, _packet ? (uchar)1 : (uchar)0);
-        memPos += 1;
-        std::copy_n(packetBytes.Bytes(), packetBytes.Size(), bytes.get() + memPos);
-        memPos += packetBytes.Size();
-        std::copy_n(otherBytes.Bytes(), otherBytes.Size(), bytes.get() + memPos);
-        memPos += otherBytes.Size();
-
-        return { totalSize, std::move(bytes) };
+        return size;
     }
 
-    size_t Deserialize(SerializedData data)
+    // Serializes directly into 'buffer', which must hold at least MaxSerializedSize() bytes.
+    // Returns the number of bytes written.
+    size_t SerializeTo(uchar* buffer, size_t capacity) const
     {
-        Reset();
-
-        uchar packetExists;
-        _SafeCopy(data.Bytes(), 0, &packetExists, 1, data.Size());
+        WireWriter writer(buffer, capacity);
 
-        size_t usedBytes1 = 0;
-        size_t usedBytes2 = 0;
+        uint8_t flags = 0;
+        if (_packet) flags |= _WIRE_HAS_PACKET;
+        if (last) flags |= _WIRE_LAST;
+        if (flush) flags |= _WIRE_FLUSH;
+        if (_packet && _packet->pts != AV_NOPTS_VALUE) flags |= _WIRE_HAS_PTS;
+        if (_packet && _packet->dts != AV_NOPTS_VALUE) flags |= _WIRE_HAS_DTS;
+        writer.WriteByte(_WIRE_VERSION);
+        writer.WriteByte(flags);
 
-        if (packetExists == 1)
+        if (_packet)
         {
-            usedBytes1 = _DeserializeAVPacket(data.Bytes() + 1, data.Size() - 1);
+            writer.WriteSignedVarint(_packet->stream_index);
+            writer.WriteSignedVarint(_packet->flags);
+            if (flags & _WIRE_HAS_DTS)
+                writer.WriteSignedVarint(_packet->dts);
+            // Usually only a few frames apart, so the difference is short
+            if ((flags & _WIRE_HAS_PTS) && (flags & _WIRE_HAS_DTS))
+                writer.WriteSignedVarint((int64_t)((uint64_t)_packet->pts - (uint64_t)_packet->dts));
+            else if (flags & _WIRE_HAS_PTS)
+                writer.WriteSignedVarint(_packet->pts);
+            writer.WriteSignedVarint(_packet->duration);
+            writer.WriteVarint(_packet->side_data_elems);
+            for (int i = 0; i < _packet->side_data_elems; i++)
+            {
+                writer.WriteSignedVarint((int)_packet->side_data[i].type);
+                writer.WriteBlock(_packet->side_data[i].data, _packet->side_data[i].size);
+            }
+            writer.WriteBlock(_packet->data, _packet->size);
         }
-        usedBytes2 = _DeserializeRemainingFields(data.Bytes() + 1 + usedBytes1, data.Size() - 1 - usedBytes1);
 
-        return usedBytes1 + usedBytes2;
+        return writer.Size();
+    }
+
+    // Returns the number of bytes used, 0 if the data is invalid
+    size_t Deserialize(SerializedData data)
+    {
+        return _Deserialize(data.Bytes(), data.Size(), nullptr);
+    }
+
+    // Deserializes without copying the packet data: the AVPacket references 'data'
+    // directly and keeps 'owner' alive until the decoder releases it.
+    // 'data' must be followed by AV_INPUT_BUFFER_PADDING_SIZE readable, zeroed bytes.
+    // Returns the number of bytes used, 0 if the data is invalid.
+    size_t DeserializeInPlace(const uchar* data, size_t size, std::shared_ptr<void> owner)
+    {
+        return _Deserialize(data, size, &owner);
     }
 
     void Reset()
@@ -171,151 +217,101 @@ public:
     }
 
 private:
-    SerializedData _SerializeAVPacket() const
-    {
-        size_t avpSize = sizeof(AVPacket);
-        size_t avpsdSize = sizeof(AVPacketSideData);
-        size_t totalSize = avpSize + _packet->size;
-        // Calculate side data size
-        AVPacketSideData* ptr = _packet->side_data;
-        for (int i = 0; i < _packet->side_data_elems; i++)
-        {
-            totalSize += avpsdSize;
-            totalSize += ptr->size;
-            ptr++;
-        }
-        auto bytes = std::make_unique<uchar[]>(totalSize);
-        size_t memPos = 0;
-        
-        std::copy_n((uchar*)_packet, avpSize, bytes.get());
-        memPos += avpSize;
-        std::copy_n(_packet->data, _packet->size, bytes.get() + memPos);
-        memPos += _packet->size;
-        ptr = _packet->side_data;
-        for (int i = 0; i < _packet->side_data_elems; i++)
-        {
-            std::copy_n((uchar*)ptr, avpsdSize, bytes.get() + memPos);
-            memPos += avpsdSize;
-            std::copy_n(ptr->data, ptr->size, bytes.get() + memPos);
-            memPos += ptr->size;
-            ptr++;
-        }
-
-        return { totalSize, std::move(bytes) };
-    }
-
-    SerializedData _SerializeRemainingFields() const
+    static constexpr uint8_t _WIRE_VERSION = 3; // 1 was a raw copy of the structs, 2 had the data before side data
+    static constexpr uint8_t _WIRE_HAS_PACKET = 0x01;
+    static constexpr uint8_t _WIRE_LAST = 0x02;
+    static constexpr uint8_t _WIRE_FLUSH = 0x04;
+    static constexpr uint8_t _WIRE_HAS_PTS = 0x08;
+    static constexpr uint8_t _WIRE_HAS_DTS = 0x10;
+
+    size_t _Deserialize(const uchar* data, size_t size, const std::shared_ptr<void>* owner)
     {
-        size_t thisSize = sizeof(*this);
-        size_t fieldSize = thisSize - sizeof(_packet);
-        auto bytes = std::make_unique<uchar[]>(fieldSize);
-        size_t memPos = sizeof(_packet);
-
-        std::copy_n((uchar*)this + memPos, fieldSize, bytes.get());
-        memPos += fieldSize;
-
-        return { fieldSize, std::move(bytes) };
-    }
-
-    size_t _DeserializeAVPacket(uchar* data, size_t dataSize)
-    {
-        size_t avpSize = sizeof(AVPacket);
-        size_t avpsdSize = sizeof(AVPacketSideData);
-        size_t memPos = 0;
+        Reset();
 
+        WireReader reader(data, size);
         AVPacket* packet = nullptr;
-        AVPacketSideData* sideData = nullptr;
-
         try
         {
-            packet = av_packet_alloc();
-            //av_packet_free_side_data();
-            //packet = (AVPacket*)av_mallocz(avpSize);
-            _SafeCopy(data, memPos, (uchar*)packet, avpSize, dataSize);
-            memPos += avpSize;
-            packet->data = (uint8_t*)av_malloc(packet->size);
-            _SafeCopy(data, memPos, packet->data, packet->size, dataSize);
-            memPos += packet->size;
-
-            if (packet->side_data_elems > 0)
+            if (reader.ReadByte() != _WIRE_VERSION)
+                return 0;
+            uint8_t flags = reader.ReadByte();
+
+            if (flags & _WIRE_HAS_PACKET)
             {
-                sideData = (AVPacketSideData*)av_mallocz(avpsdSize * packet->side_data_elems);
-                for (int i = 0; i < packet->side_data_elems; i++)
-                {
-                    _SafeCopy(data, memPos, (uchar*)&sideData[i], avpsdSize, dataSize);
-                    memPos += avpsdSize;
-                    sideData[i].data = (uint8_t*)av_mallocz(sideData[i].size + AV_INPUT_BUFFER_PADDING_SIZE);
-                    _SafeCopy(data, memPos, sideData[i].data, sideData[i].size, dataSize);
-                    memPos += sideData[i].size;
-                }
+                packet = av_packet_alloc();
+                _DeserializeAVPacket(reader, flags, packet, owner);
             }
-            packet->side_data = sideData;
-            packet->buf = nullptr;
-
-            // 'av_packet_make_refcounted' for some fucking reason just copies packet->data
-            // and overwrites the pointer to it without deletion, resulting in a memory leak.
-            // I'm probably using av_packet_make_refcounted() wrong but w/e
-            uint8_t* data = packet->data;
-            av_packet_make_refcounted(packet);
-            av_free(data);
 
             _packet = packet;
+            last = flags & _WIRE_LAST;
+            flush = flags & _WIRE_FLUSH;
         }
         catch (std::out_of_range)
         {
-            // Clean up side data
-            if (sideData)
-            {
-                for (int i = 0; i < packet->side_data_elems; i++)
-                {
-                    if (sideData[i].data)
-                    {
-                        av_free(sideData[i].data);
-                    }
-                    else
-                    {
-                        break;
-                    }
-                }
-                av_free(sideData);
-            }
-
-            // Clean up packet
-            if (packet->data)
-            {
-                av_free(packet->data);
-            }
-            av_packet_free(&packet);
-
+            if (packet)
+                av_packet_free(&packet);
             return 0;
         }
 
-        return memPos;
+        return reader.Position();
     }
 
-    size_t _DeserializeRemainingFields(uchar* data, size_t dataSize)
+    // Throws std::out_of_range on invalid data, 'packet' is left for the caller to free
+    static void _DeserializeAVPacket(WireReader& reader, uint8_t flags, AVPacket* packet, const std::shared_ptr<void>* owner)
     {
-        size_t thisSize = sizeof(*this);
-        size_t fieldSize = thisSize - sizeof(_packet);
-        
-        try
+        packet->stream_index = reader.ReadInt();
+        packet->flags = reader.ReadInt();
+        if (flags & _WIRE_HAS_DTS)
+            packet->dts = reader.ReadSignedVarint();
+        if (flags & _WIRE_HAS_PTS)
         {
-            AVPacket* copy = _packet;
-            _SafeCopy(data, 0, (uchar*)this + sizeof(_packet), fieldSize, dataSize);
-            _packet = copy;
+            int64_t pts = reader.ReadSignedVarint();
+            packet->pts = (flags & _WIRE_HAS_DTS) ? (int64_t)((uint64_t)packet->dts + (uint64_t)pts) : pts;
         }
-        catch (std::out_of_range)
+        packet->duration = reader.ReadSignedVarint();
+
+        const uchar* bytes;
+        uint64_t sideDataCount = reader.ReadVarint();
+        // Every entry takes at least 2 bytes
+        if (sideDataCount > reader.Remaining() / 2)
+            throw std::out_of_range("Side data count exceeds data");
+        for (uint64_t i = 0; i < sideDataCount; i++)
         {
-            return 0;
+            int type = reader.ReadInt();
+            size_t sideDataSize = reader.ReadBlock(bytes);
+            uint8_t* sideData = av_packet_new_side_data(packet, (AVPacketSideDataType)type, sideDataSize);
+            if (!sideData)
+                throw std::out_of_range("Side data allocation failed");
+            std::copy_n(bytes, sideDataSize, sideData);
+        }
+
+        size_t size = reader.ReadBlock(bytes);
+        if (size > INT32_MAX - AV_INPUT_BUFFER_PADDING_SIZE)
+            throw std::out_of_range("Packet too large");
+
+        // The padding after the message is only there if the data ends the message
+        if (owner && reader.Remaining() == 0)
+        {
+            auto ownerRef = new std::shared_ptr<void>(*owner);
+            packet->buf = av_buffer_create((uint8_t*)bytes, (int)size, _ReleaseOwner, ownerRef, AV_BUFFER_FLAG_READONLY);
+            if (!packet->buf)
+            {
+                delete ownerRef;
+                throw std::out_of_range("Buffer allocation failed");
+            }
+            packet->data = packet->buf->data;
+            packet->size = (int)size;
+            return;
         }
 
-        return fieldSize;
+        // Allocates a padded, reference counted buffer
+        if (av_new_packet(packet, (int)size) < 0)
+            throw std::out_of_range("Packet allocation failed");
+        std::copy_n(bytes, size, packet->data);
     }
 
-    // Throws an exception if copy will result in an access violation
-    void _SafeCopy(const uchar* src, size_t offset, uchar* dest, size_t count, size_t allocated)
+    static void _ReleaseOwner(void* opaque, uint8_t* data)
     {
-        if (offset + count > allocated) throw std::out_of_range("Possible access violation");
-        std::copy_n(src + offset, count, dest);
+        delete (std::shared_ptr<void>*)opaque;
     }
 };
\ No newline at end of file
@@ -22,23 +22,25 @@ MediaPlayer::MediaPlayer(
     std::unique_ptr<MediaStream> audioStream = _dataProvider->CurrentAudioStream();
     std::unique_ptr<MediaStream> subtitleStream = _dataProvider->CurrentSubtitleStream();
 
-    if (videoStream) _videoData.decoder = new VideoDecoder(*videoStream);
-    if (audioStream) _audioData.decoder = new AudioDecoder(*audioStream);
+    // Video decoders hold the most memory, so only the last one is kept around
+    _videoData.decoderCache.SetCapacity(1);
+    _audioData.decoderCache.SetCapacity(4);
+    _subtitleData.decoderCache.SetCapacity(4);
+
+    if (videoStream)
+    {
+        _videoData.decoder = new VideoDecoder(*videoStream);
+        _videoData.decoderKey = DecoderCache::MakeKey(*videoStream);
+    }
+    if (audioStream)
+    {
+        _audioData.decoder = new AudioDecoder(*audioStream);
+        _audioData.decoderKey = DecoderCache::MakeKey(*audioStream);
+    }
     if (subtitleStream)
     {
-        SubtitleDecoder* decoder = new SubtitleDecoder(*subtitleStream);
-        auto fontStreams = _dataProvider->GetFontStreams();
-        std::vector<SubtitleDecoder::FontDesc> fonts;
-        for (auto& stream : fontStreams)
-        {
-            SubtitleDecoder::FontDesc font;
-            font.data = (char*)stream.GetParams()->extradata;
-            font.dataSize = stream.GetParams()->extradata_size;
-            font.name = (char*)"";
-            fonts.push_back(font);
-        }
-        decoder->AddFonts(fonts);
-        _subtitleData.decoder = decoder;
+        _subtitleData.decoder = _CreateSubtitleDecoder(*subtitleStream);
+        _subtitleData.decoderKey = DecoderCache::MakeKey(*subtitleStream);
     }
 
     _recovering = true;
@@ -65,8 +67,10 @@ int MediaPlayer::_PassPacket(MediaData& mediaData, MediaPacket packet)
         if (mediaData.expectingStream)
         {
             std::cout << "Decoder reset\n";
-            delete mediaData.decoder;
+            // Keep the old decoder, in case the stream is switched back
+            mediaData.decoderCache.Store(mediaData.decoderKey, mediaData.decoder);
             mediaData.decoder = nullptr;
+            mediaData.decoderKey.clear();
             mediaData.expectingStream = false;
             return 3;
         }
@@ -86,6 +90,32 @@ int MediaPlayer::_PassPacket(MediaData& mediaData, MediaPacket packet)
     return 0;
 }
 
+IMediaDecoder* MediaPlayer::_TakeCachedDecoder(MediaData& mediaData, const MediaStream& stream)
+{
+    mediaData.decoderKey = DecoderCache::MakeKey(stream);
+    IMediaDecoder* decoder = mediaData.decoderCache.Take(mediaData.decoderKey);
+    if (decoder)
+        std::cout << "Cached decoder reused\n";
+    return decoder;
+}
+
+SubtitleDecoder* MediaPlayer::_CreateSubtitleDecoder(const MediaStream& stream)
+{
+    SubtitleDecoder* decoder = new SubtitleDecoder(stream);
+    auto fontStreams = _dataProvider->GetFontStreams();
+    std::vector<SubtitleDecoder::FontDesc> fonts;
+    for (auto& fontStream : fontStreams)
+    {
+        SubtitleDecoder::FontDesc font;
+        font.data = (char*)fontStream.GetParams()->extradata;
+        font.dataSize = fontStream.GetParams()->extradata_size;
+        font.name = (char*)"";
+        fonts.push_back(font);
+    }
+    decoder->AddFonts(fonts);
+    return decoder;
+}
+
 void MediaPlayer::Update(double timeLimit)
 {
     _playbackTimer.Update();
@@ -121,7 +151,21 @@ void MediaPlayer::Update(double timeLimit)
                 if (passResult == 2 || passResult == 3) _videoData.nextFrame.reset(nullptr);
                 if (passResult == 3)
                 {
-                    if (_videoData.pendingStream) _videoData.decoder = new VideoDecoder(*_videoData.pendingStream);
+                    if (_videoData.pendingStream)
+                    {
+                        _videoData.decoder = _TakeCachedDecoder(_videoData, *_videoData.pendingStream);
+                        if (!_videoData.decoder)
+                            _videoData.decoder = new VideoDecoder(*_videoData.pendingStream);
+                    }
+                }
+                // Don't output (or fully decode) frames before the seek target
+                if ((passResult == 2 || passResult == 3) && _videoData.decoder)
+                {
+                    TimePoint recoveryTarget = _playbackTimer.Now();
+                    if (_targetSeekTime.GetTicks() != -1)
+                        recoveryTarget = _targetSeekTime;
+                    // The video slot only ever holds a VideoDecoder
+                    static_cast<VideoDecoder*>(_videoData.decoder)->SkipUntil(recoveryTarget);
                 }
                 packetGot += passResult;
             }
@@ -135,7 +179,12 @@ void MediaPlayer::Update(double timeLimit)
                 if (passResult == 2 || passResult == 3) _audioData.nextFrame.reset(nullptr);
                 if (passResult == 3)
                 {
-                    if (_audioData.pendingStream) _audioData.decoder = new AudioDecoder(*_audioData.pendingStream);
+                    if (_audioData.pendingStream)
+                    {
+                        _audioData.decoder = _TakeCachedDecoder(_audioData, *_audioData.pendingStream);
+                        if (!_audioData.decoder)
+                            _audioData.decoder = new AudioDecoder(*_audioData.pendingStream);
+                    }
                 }
                 packetGot += passResult;
             }
@@ -157,19 +206,9 @@ void MediaPlayer::Update(double timeLimit)
                 {
                     if (_subtitleData.pendingStream)
                     {
-                        SubtitleDecoder* decoder = new SubtitleDecoder(*_subtitleData.pendingStream);
-                        auto fontStreams = _dataProvider->GetFontStreams();
-                        std::vector<SubtitleDecoder::FontDesc> fonts;
-                        for (auto& stream : fontStreams)
-                        {
-                            SubtitleDecoder::FontDesc font;
-                            font.data = (char*)stream.GetParams()->extradata;
-                            font.dataSize = stream.GetParams()->extradata_size;
-                            font.name = (char*)"";
-                            fonts.push_back(font);
-                        }
-                        decoder->AddFonts(fonts);
-                        _subtitleData.decoder = decoder;
+                        _subtitleData.decoder = _TakeCachedDecoder(_subtitleData, *_subtitleData.pendingStream);
+                        if (!_subtitleData.decoder)
+                            _subtitleData.decoder = _CreateSubtitleDecoder(*_subtitleData.pendingStream);
                     }
                 }
                 packetGot += passResult;
@@ -437,6 +476,18 @@ void MediaPlayer::SetBalance(float balance)
     _audioOutputAdapter->SetBalance(balance);
 }
 
+void MediaPlayer::SetPlaybackRate(double rate)
+{
+    _playbackTimer.Update();
+    _playbackTimer.SetSpeed(rate);
+    _audioOutputAdapter->SetPlaybackRate(rate);
+}
+
+double MediaPlayer::PlaybackRate() const
+{
+    return _playbackTimer.GetSpeed();
+}
+
 void MediaPlayer::SetVideoStream(std::unique_ptr<MediaStream> stream)
 {
     _SetStream(_videoData, std::move(stream));
@@ -4,6 +4,7 @@
 #include "VideoDecoder.h"
 #include "AudioDecoder.h"
 #include "SubtitleDecoder.h"
+#include "DecoderCache.h"
 #include "VideoOutputAdapter.h"
 #include "SubtitleOutputAdapter.h"
 #include "IAudioOutputAdapter.h"
@@ -19,6 +20,11 @@ class MediaPlayer
 
         std::unique_ptr<MediaStream> pendingStream = nullptr;
         bool expectingStream = false;
+
+        // DecoderCache key of the stream the current decoder was opened for
+        std::string decoderKey;
+        // Decoders of previously used streams
+        DecoderCache decoderCache;
     };
 
     IMediaDataProvider* _dataProvider = nullptr;
@@ -71,6 +77,9 @@ public:
 private:
     // 0 - no packet to pass, 1 - packed passed, 2 - flush packet received
     int _PassPacket(MediaData& mediaData, MediaPacket packet);
+    // Returns a cached decoder for the stream, or nullptr if a new one must be created
+    IMediaDecoder* _TakeCachedDecoder(MediaData& mediaData, const MediaStream& stream);
+    SubtitleDecoder* _CreateSubtitleDecoder(const MediaStream& stream);
 public:
     void Update(double timeLimit = 0.01666666);
 
@@ -86,6 +95,9 @@ public:
     TimePoint TimerPosition() const;
     void SetVolume(float volume);
     void SetBalance(float balance);
+    // Used for gradual sync correction; video follows the timer, audio is resampled
+    void SetPlaybackRate(double rate);
+    double PlaybackRate() const;
 
     void SetVideoStream(std::unique_ptr<MediaStream> stream);
     void SetAudioStream(std::unique_ptr<MediaStream> stream);
@@ -2,7 +2,7 @@
 
 #include <iostream>
 
-MediaReceiverDataProvider::MediaReceiverDataProvider(int64_t hostId)
+MediaReceiverDataProvider::MediaReceiverDataProvider(int64_t hostId, bool lateJoin)
     : IMediaDataProvider(),
     _metadataReceiver(_streamMetadata, hostId),
     _videoStreamReceiver(znet::PacketType::VIDEO_STREAM, hostId),
@@ -26,6 +26,7 @@ MediaReceiverDataProvider::MediaReceiverDataProvider(int64_t hostId)
     });
 
     _hostId = hostId;
+    _lateJoin = lateJoin;
     _initializing = true;
     _INIT_THREAD_STOP = false;
     _initializationThread = std::thread(&MediaReceiverDataProvider::_Initialize, this);
@@ -82,6 +83,10 @@ void MediaReceiverDataProvider::_Initialize()
 {
     std::cout << "Init started.." << std::endl;
 
+    // Receivers are subscribed by now, so nothing sent in reply is missed
+    if (_lateJoin)
+        APP_NETWORK->Send(znet::Packet((int)znet::PacketType::LATE_JOIN_REQUEST), { _hostId });
+
     // Wait for stream metadata
     while (!_metadataReceiver.received && !_INIT_THREAD_STOP)
         std::this_thread::sleep_for(std::chrono::milliseconds(10));
@@ -172,17 +177,17 @@ void MediaReceiverDataProvider::_ReadPackets()
 
             std::cout << "Packets cleared" << std::endl;
 
-            while (!_bufferedVideoPackets.empty())
+            while (!_bufferedVideoPackets.empty() && !_PacketStoreFull(_videoData))
             {
                 _AddVideoPacket(std::move(_bufferedVideoPackets.front()));
                 _bufferedVideoPackets.pop();
             }
-            while (!_bufferedAudioPackets.empty())
+            while (!_bufferedAudioPackets.empty() && !_PacketStoreFull(_audioData))
             {
                 _AddAudioPacket(std::move(_bufferedAudioPackets.front()));
                 _bufferedAudioPackets.pop();
             }
-            while (!_bufferedSubtitlePackets.empty())
+            while (!_bufferedSubtitlePackets.empty() && !_PacketStoreFull(_subtitleData))
             {
                 _AddSubtitlePacket(std::move(_bufferedSubtitlePackets.front()));
                 _bufferedSubtitlePackets.pop();
@@ -201,12 +206,44 @@ void MediaReceiverDataProvider::_ReadPackets()
         }
         else
         {
-            if (_videoPacketReceiver.PacketCount() > 0)
-                _AddVideoPacket(_videoPacketReceiver.GetPacket());
-            if (_audioPacketReceiver.PacketCount() > 0)
-                _AddAudioPacket(_audioPacketReceiver.GetPacket());
-            if (_subtitlePacketReceiver.PacketCount() > 0)
-                _AddSubtitlePacket(_subtitlePacketReceiver.GetPacket());
+            // Packets buffered during a seek go first. If a packet ring is full,
+            // packets stay in the receivers until the player reads some.
+            if (!_PacketStoreFull(_videoData))
+            {
+                if (!_bufferedVideoPackets.empty())
+                {
+                    _AddVideoPacket(std::move(_bufferedVideoPackets.front()));
+                    _bufferedVideoPackets.pop();
+                }
+                else if (_videoPacketReceiver.PacketCount() > 0)
+                {
+                    _AddVideoPacket(_videoPacketReceiver.GetPacket());
+                }
+            }
+            if (!_PacketStoreFull(_audioData))
+            {
+                if (!_bufferedAudioPackets.empty())
+                {
+                    _AddAudioPacket(std::move(_bufferedAudioPackets.front()));
+                    _bufferedAudioPackets.pop();
+                }
+                else if (_audioPacketReceiver.PacketCount() > 0)
+                {
+                    _AddAudioPacket(_audioPacketReceiver.GetPacket());
+                }
+            }
+            if (!_PacketStoreFull(_subtitleData))
+            {
+                if (!_bufferedSubtitlePackets.empty())
+                {
+                    _AddSubtitlePacket(std::move(_bufferedSubtitlePackets.front()));
+                    _bufferedSubtitlePackets.pop();
+                }
+                else if (_subtitlePacketReceiver.PacketCount() > 0)
+                {
+                    _AddSubtitlePacket(_subtitlePacketReceiver.GetPacket());
+                }
+            }
         }
         lock.unlock();
 
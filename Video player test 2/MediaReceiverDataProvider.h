@@ -119,11 +119,12 @@ class MediaReceiverDataProvider : public IMediaDataProvider
 
         void _OnPacketReceived(znet::Packet packet, int64_t userId)
         {
+            // The decoder reads the packet data straight from the network buffer,
+            // which stays alive until the decoder releases the AVPacket
+            static_assert(znet::PacketBufferPool::PADDING >= AV_INPUT_BUFFER_PADDING_SIZE);
+            auto networkPacket = std::make_shared<znet::Packet>(std::move(packet));
             MediaPacket mediaPacket;
-            auto bytes = std::make_unique<uchar[]>(packet.size);
-            std::copy_n(packet.Bytes(), packet.size, bytes.get());
-            SerializedData data(packet.size, std::move(bytes));
-            mediaPacket.Deserialize(std::move(data));
+            mediaPacket.DeserializeInPlace((const uchar*)networkPacket->Bytes(), networkPacket->size, networkPacket);
 
             std::lock_guard<std::mutex> lock(_m_packets);
             _packets.push(std::move(mediaPacket));
@@ -185,6 +186,7 @@ class MediaReceiverDataProvider : public IMediaDataProvider
     bool _PACKET_THREAD_STOP = false;
 
     int64_t _hostId = 0;
+    bool _lateJoin = false;
     StreamMetadata _streamMetadata;
     StreamMetadataReceiver _metadataReceiver;
     StreamReceiver _videoStreamReceiver;
@@ -207,7 +209,9 @@ class MediaReceiverDataProvider : public IMediaDataProvider
     bool _waitingForSeek = false;
 
 public:
-    MediaReceiverDataProvider(int64_t hostId);
+    // lateJoin: playback has already started, request the metadata and
+    // packets from the host's current position instead of waiting for them
+    MediaReceiverDataProvider(int64_t hostId, bool lateJoin = false);
     ~MediaReceiverDataProvider();
 private:
     void _Initialize();
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ISerializable.h"
+#include "WireFormat.h"
 
 extern "C"
 {
@@ -105,37 +106,56 @@ public:
         return _params;
     }
 
+    // Wire format:
+    //  uint8 - format version
+    //  codec parameters, as signed varints, except for the tag and channel layout (varints)
+    //  and the extradata (block)
+    //  stream fields, as signed varints
+    //  varint - metadata count, followed by that many key and value blocks
     SerializedData Serialize() const
     {
         if (!_params) return { };
 
-        SerializedData paramBytes = _SerializeCodecParams();
-        SerializedData otherBytes = _SerializeRemainingFields();
+        size_t sizeEstimate = 128 + _params->extradata_size;
+        for (auto& pair : metadata)
+            sizeEstimate += pair.key.length() + pair.value.length() + 4;
+        WireWriter writer(sizeEstimate);
 
-        size_t totalSize = 0;
-        totalSize += paramBytes.Size();
-        totalSize += otherBytes.Size();
-        auto bytes = std::make_unique<uchar[]>(totalSize);
-        size_t memPos = 0;
+        writer.WriteByte(_WIRE_VERSION);
+        _SerializeCodecParams(writer);
+        _SerializeRemainingFields(writer);
 
-        std::copy_n(paramBytes.Bytes(), paramBytes.Size(), bytes.get() + memPos);
-        memPos += paramBytes.Size();
-        std::copy_n(otherBytes.Bytes(), otherBytes.Size(), bytes.get() + memPos);
-        memPos += otherBytes.Size();
-
-        return { totalSize, std::move(bytes) };
+        return writer.Release();
     }
 
+    // Returns the number of bytes used, 0 if the data is invalid
     size_t Deserialize(SerializedData data)
     {
         _FreeParams();
 
-        size_t usedBytes1 = _DeserializeCodecParams(data.Bytes(), data.Size());
-        if (usedBytes1 == 0) return 0;
-        size_t usedBytes2 = _DeserializeRemainingFields(data.Bytes() + usedBytes1, data.Size() - usedBytes1);
-        if (usedBytes2 == 0) return 0;
+        WireReader reader(data.Bytes(), data.Size());
+        AVCodecParameters* params = avcodec_parameters_alloc();
+        // Keep the current fields in case deserialization fails
+        MediaStream stream;
+        stream.CopyFields(*this);
+
+        try
+        {
+            if (reader.ReadByte() != _WIRE_VERSION)
+                throw std::out_of_range("Unknown format version");
+            _DeserializeCodecParams(reader, params);
+            _DeserializeRemainingFields(reader);
+        }
+        catch (std::out_of_range)
+        {
+            // Also frees extradata
+            avcodec_parameters_free(&params);
+            CopyFields(stream);
+            return 0;
+        }
 
-        return usedBytes1 + usedBytes2;
+        _params = params;
+        return reader.Position();
     }
 
 private:
@@ -180,163 +200,145 @@ public:
     }
 
 private:
-    SerializedData _SerializeCodecParams() const
-    {
-        size_t avcpSize = sizeof(AVCodecParameters);
-        size_t totalSize = avcpSize + _params->extradata_size;
-        auto bytes = std::make_unique<uchar[]>(totalSize);
-        size_t memPos = 0;
-
-        std::copy_n((uchar*)_params, avcpSize, bytes.get() + memPos);
-        memPos += avcpSize;
-        std::copy_n(_params->extradata, _params->extradata_size, bytes.get() + memPos);
-        memPos += _params->extradata_size;
+    static constexpr uint8_t _WIRE_VERSION = 2; // 1 was a raw copy of the structs
 
-        return { totalSize, std::move(bytes) };
+    void _SerializeCodecParams(WireWriter& writer) const
+    {
+        writer.WriteSignedVarint((int)_params->codec_type);
+        writer.WriteSignedVarint((int)_params->codec_id);
+        writer.WriteVarint(_params->codec_tag);
+        writer.WriteBlock(_params->extradata, _params->extradata_size);
+        writer.WriteSignedVarint(_params->format);
+        writer.WriteSignedVarint(_params->bit_rate);
+        writer.WriteSignedVarint(_params->bits_per_coded_sample);
+        writer.WriteSignedVarint(_params->bits_per_raw_sample);
+        writer.WriteSignedVarint(_params->profile);
+        writer.WriteSignedVarint(_params->level);
+        writer.WriteSignedVarint(_params->width);
+        writer.WriteSignedVarint(_params->height);
+        writer.WriteSignedVarint(_params->sample_aspect_ratio.num);
+        writer.WriteSignedVarint(_params->sample_aspect_ratio.den);
+        writer.WriteSignedVarint((int)_params->field_order);
+        writer.WriteSignedVarint((int)_params->color_range);
+        writer.WriteSignedVarint((int)_params->color_primaries);
+        writer.WriteSignedVarint((int)_params->color_trc);
+        writer.WriteSignedVarint((int)_params->color_space);
+        writer.WriteSignedVarint((int)_params->chroma_location);
+        writer.WriteSignedVarint(_params->video_delay);
+        writer.WriteVarint(_params->channel_layout);
+        writer.WriteSignedVarint(_params->channels);
+        writer.WriteSignedVarint(_params->sample_rate);
+        writer.WriteSignedVarint(_params->block_align);
+        writer.WriteSignedVarint(_params->frame_size);
+        writer.WriteSignedVarint(_params->initial_padding);
+        writer.WriteSignedVarint(_params->trailing_padding);
+        writer.WriteSignedVarint(_params->seek_preroll);
     }
 
-    SerializedData _SerializeRemainingFields() const
+    void _SerializeRemainingFields(WireWriter& writer) const
     {
-        /// <summary>
-        /// serialized 'metadata' contains, in order:
-        /// X - a 64 bit number, vector element count
-        /// X times:
-        ///     N - a 64 bit number, string character count
-        ///     a N byte length data block of the string data
-        ///     M - a 64 bit number, string character count
-        ///     a M byte length data block of the string data
-        /// </summary>
-        size_t metadataSize = sizeof(size_t);
-        for (size_t i = 0; i < metadata.size(); i++)
-        {
-            metadataSize += sizeof(size_t);
-            metadataSize += metadata[i].key.length();
-            metadataSize += sizeof(size_t);
-            metadataSize += metadata[i].value.length();
-        }
-
-        size_t thisSize = sizeof(*this);
-        size_t fieldOffset = (size_t)&index - (size_t)this;
-        size_t fieldSize = thisSize - fieldOffset;
-        size_t totalSize = fieldSize + metadataSize;
-        auto bytes = std::make_unique<uchar[]>(totalSize);
-        size_t memPos = 0;
-
-        std::copy_n((uchar*)this + fieldOffset, fieldSize, bytes.get() + memPos);
-        memPos += fieldSize;
-        // Serialize 'metadata'
-        size_t metadataCount = metadata.size();
-        std::copy_n((uchar*)&metadataCount, sizeof(metadataCount), bytes.get() + memPos);
-        memPos += sizeof(metadataCount);
-        for (size_t i = 0; i < metadata.size(); i++)
+        writer.WriteSignedVarint(index);
+        writer.WriteSignedVarint(packetCount);
+        writer.WriteSignedVarint(startTime);
+        writer.WriteSignedVarint(duration);
+        writer.WriteSignedVarint(timeBase.num);
+        writer.WriteSignedVarint(timeBase.den);
+        writer.WriteSignedVarint(width);
+        writer.WriteSignedVarint(height);
+        writer.WriteSignedVarint(channels);
+        writer.WriteSignedVarint(sampleRate);
+        writer.WriteSignedVarint((int)type);
+
+        writer.WriteVarint(metadata.size());
+        for (auto& pair : metadata)
         {
-            // Key
-            size_t keyLength = metadata[i].key.length();
-            std::copy_n((uchar*)&keyLength, sizeof(keyLength), bytes.get() + memPos);
-            memPos += sizeof(keyLength);
-            std::copy_n((uchar*)metadata[i].key.data(), keyLength, bytes.get() + memPos);
-            memPos += keyLength;
-            // Value
-            size_t valueLength = metadata[i].value.length();
-            std::copy_n((uchar*)&valueLength, sizeof(valueLength), bytes.get() + memPos);
-            memPos += sizeof(valueLength);
-            std::copy_n((uchar*)metadata[i].value.data(), valueLength, bytes.get() + memPos);
-            memPos += valueLength;
+            writer.WriteBlock(pair.key.data(), pair.key.length());
+            writer.WriteBlock(pair.value.data(), pair.value.length());
         }
-
-        return { totalSize, std::move(bytes) };
     }
 
-    size_t _DeserializeCodecParams(uchar* data, size_t dataSize)
+    // Throws std::out_of_range on invalid data
+    static void _DeserializeCodecParams(WireReader& reader, AVCodecParameters* params)
     {
-        size_t avcpSize = sizeof(AVCodecParameters);
-        size_t memPos = 0;
-
-        AVCodecParameters* params = nullptr;
-
-        try
+        params->codec_type = (AVMediaType)reader.ReadInt();
+        params->codec_id = (AVCodecID)reader.ReadInt();
+        uint64_t codecTag = reader.ReadVarint();
+        if (codecTag > UINT32_MAX)
+            throw std::out_of_range("Value out of range");
+        params->codec_tag = (uint32_t)codecTag;
+
+        const uchar* extradata;
+        size_t extradataSize = reader.ReadBlock(extradata);
+        if (extradataSize > INT32_MAX - AV_INPUT_BUFFER_PADDING_SIZE)
+            throw std::out_of_range("Extradata too large");
+        if (extradataSize > 0)
         {
-            params = avcodec_parameters_alloc();
-            _SafeCopy(data, memPos, (uchar*)params, avcpSize, dataSize);
-            memPos += avcpSize;
-            params->extradata = (uint8_t*)av_mallocz(params->extradata_size + AV_INPUT_BUFFER_PADDING_SIZE);
-            _SafeCopy(data, memPos, params->extradata, params->extradata_size, dataSize);
-            memPos += params->extradata_size;
-
-            _params = params;
-        }
-        catch (std::out_of_range)
-        {
-            // Free extradata
-            if (params->extradata)
-            {
-                av_freep(&params->extradata);
-            }
-
-            // Free codec parameters
-            avcodec_parameters_free(&params);
-
-            return 0;
+            params->extradata = (uint8_t*)av_mallocz(extradataSize + AV_INPUT_BUFFER_PADDING_SIZE);
+            if (!params->extradata)
+                throw std::out_of_range("Extradata allocation failed");
+            std::copy_n(extradata, extradataSize, params->extradata);
+            params->extradata_size = (int)extradataSize;
         }
 
-        return memPos;
+        params->format = reader.ReadInt();
+        params->bit_rate = reader.ReadSignedVarint();
+        params->bits_per_coded_sample = reader.ReadInt();
+        params->bits_per_raw_sample = reader.ReadInt();
+        params->profile = reader.ReadInt();
+        params->level = reader.ReadInt();
+        params->width = reader.ReadInt();
+        params->height = reader.ReadInt();
+        params->sample_aspect_ratio.num = reader.ReadInt();
+        params->sample_aspect_ratio.den = reader.ReadInt();
+        params->field_order = (AVFieldOrder)reader.ReadInt();
+        params->color_range = (AVColorRange)reader.ReadInt();
+        params->color_primaries = (AVColorPrimaries)reader.ReadInt();
+        params->color_trc = (AVColorTransferCharacteristic)reader.ReadInt();
+        params->color_space = (AVColorSpace)reader.ReadInt();
+        params->chroma_location = (AVChromaLocation)reader.ReadInt();
+        params->video_delay = reader.ReadInt();
+        params->channel_layout = reader.ReadVarint();
+        params->channels = reader.ReadInt();
+        params->sample_rate = reader.ReadInt();
+        params->block_align = reader.ReadInt();
+        params->frame_size = reader.ReadInt();
+        params->initial_padding = reader.ReadInt();
+        params->trailing_padding = reader.ReadInt();
+        params->seek_preroll = reader.ReadInt();
     }
 
-    size_t _DeserializeRemainingFields(uchar* data, size_t dataSize)
+    // Throws std::out_of_range on invalid data
+    void _DeserializeRemainingFields(WireReader& reader)
     {
-        size_t thisSize = sizeof(*this);
-        size_t fieldOffset = (size_t)&index - (size_t)this;
-        size_t fieldSize = thisSize - fieldOffset;
-        size_t memPos = 0;
-
-        // Create a copy of current fields in case deserialization fails
-        MediaStream stream;
-        stream.CopyFields(*this);
+        index = reader.ReadInt();
+        packetCount = reader.ReadInt();
+        startTime = reader.ReadSignedVarint();
+        duration = reader.ReadSignedVarint();
+        timeBase.num = reader.ReadInt();
+        timeBase.den = reader.ReadInt();
+        width = reader.ReadInt();
+        height = reader.ReadInt();
+        channels = reader.ReadInt();
+        sampleRate = reader.ReadInt();
+        int streamType = reader.ReadInt();
+        if (streamType < (int)MediaStreamType::NONE || streamType > (int)MediaStreamType::UNKNOWN)
+            throw std::out_of_range("Invalid stream type");
+        type = (MediaStreamType)streamType;
 
-        try
+        metadata.clear();
+        uint64_t metadataCount = reader.ReadVarint();
+        // Every pair takes at least 2 bytes
+        if (metadataCount > reader.Remaining() / 2)
+            throw std::out_of_range("Metadata count exceeds data");
+        for (uint64_t i = 0; i < metadataCount; i++)
         {
-            _SafeCopy(data, memPos, (uchar*)this + fieldOffset, fieldSize, dataSize);
-            memPos += fieldSize;
-            // Deserialize 'metadata'
-            metadata.clear();
-            size_t metadataCount;
-            _SafeCopy(data, memPos, (uchar*)&metadataCount, sizeof(metadataCount), dataSize);
-            memPos += sizeof(metadataCount);
-            for (size_t i = 0; i < metadataCount; i++)
-            {
-                MediaMetadataPair pair;
-                // Key
-                size_t keyLength;
-                _SafeCopy(data, memPos, (uchar*)&keyLength, sizeof(keyLength), dataSize);
-                memPos += sizeof(keyLength);
-                pair.key.resize(keyLength);
-                _SafeCopy(data, memPos, (uchar*)pair.key.data(), keyLength, dataSize);
-                memPos += keyLength;
-                // Value
-                size_t valueLength;
-                _SafeCopy(data, memPos, (uchar*)&valueLength, sizeof(valueLength), dataSize);
-                memPos += sizeof(valueLength);
-                pair.value.resize(valueLength);
-                _SafeCopy(data, memPos, (uchar*)pair.value.data(), valueLength, dataSize);
-                memPos += valueLength;
-                metadata.push_back(pair);
-            }
+            MediaMetadataPair pair;
+            const uchar* bytes;
+            size_t length = reader.ReadBlock(bytes);
+            pair.key.assign((const char*)bytes, length);
+            length = reader.ReadBlock(bytes);
+            pair.value.assign((const char*)bytes, length);
+            metadata.push_back(std::move(pair));
         }
-        catch (std::out_of_range)
-        {
-            // Return fields to old state
-            CopyFields(stream);
-
-            return 0;
-        }
-
-        return memPos;
-    }
-
-    // Throws an exception if copy will result in an access violation
-    void _SafeCopy(const uchar* src, size_t offset, uchar* dest, size_t count, size_t allocated)
-    {
-        if (offset + count > allocated) throw std::out_of_range("Possible access violation");
-        std::copy_n(src + offset, count, dest);
     }
 };
\ No newline at end of file
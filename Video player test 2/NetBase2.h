@@ -1,7 +1,11 @@
 #pragma once
 
+#ifdef _WIN32
 #include <WS2tcpip.h>
 #pragma comment(lib, "ws2_32.lib")
+#else
+#include "PosixSockets.h"
+#endif
 
 #include <iostream>
 #include <vector>
@@ -9,7 +13,15 @@
 #include <queue>
 #include <mutex>
 #include <atomic>
+#include <array>
 #include <functional>
+#include <cmath>
+
+#include "PacketBufferPool.h"
+
+#ifndef _WIN32
+#include "EventLoop.h"
+#endif
 
 // Less verbose locking of a mutex
 #define LOCK_GUARD(varname, mutexname) std::lock_guard<std::mutex> varname(mutexname)
@@ -24,6 +36,10 @@
 // for packets from other clients to arrive in the middle, since a single queue for all incoming packets is used.
 // The packet itself contains a single 32-bit value which represents how many packets after this one to combine.
 #define MULTIPLE_PACKETS 0x0FFFFFFE
+// Packet type which specifies the channel that the upcoming packets belong to (until the next switch).
+// Frames of different channels are interleaved, so each channel is reassembled separately.
+// The packet itself contains a single 32-bit value with the channel index.
+#define SWITCH_CHANNEL 0x0FFFFFFD
 
 namespace znet
 {
@@ -45,7 +61,7 @@ namespace znet
     inline bool operator==(const sockaddr_in& sin1, const sockaddr_in& sin2)
     {
         return (sin1.sin_port == sin2.sin_port)
-            && (sin1.sin_addr.S_un.S_addr == sin2.sin_addr.S_un.S_addr);
+            && (sin1.sin_addr.s_addr == sin2.sin_addr.s_addr);
     }
 
     // // // //
@@ -69,6 +85,10 @@ namespace znet
         Packet(std::unique_ptr<int8_t[]>&& bytes, size_t size, int id)
             : _bytes(std::move(bytes)), size(size), id(id)
         {}
+        // 'bytes' can be shared with other owners (e.g. pooled memory)
+        Packet(std::shared_ptr<int8_t[]> bytes, size_t size, int id)
+            : _bytes(std::move(bytes)), size(size), id(id)
+        {}
         Packet(int packetId)
             : _bytes(nullptr), size(0), id(packetId)
         {}
@@ -95,6 +115,7 @@ namespace znet
 
         // Creates a packet pointing to the same memory
         // NOTE: changes to one packets data will be seen in the other packets data
+        // Sending never modifies the data, so one packet can be referenced by many connections
         Packet Reference() const
         {
             Packet refPacket;
@@ -149,23 +170,97 @@ namespace znet
         {
             return _bytes.get();
         }
+
+        const int8_t* Bytes() const
+        {
+            return _bytes.get();
+        }
+    };
+
+    // Outgoing packets of the control channel are always sent first, even in the middle of
+    // a large packet of the bulk channel, so commands don't wait behind media transfers.
+    // Packet order is only kept within a channel, so packets ordered relative to media
+    // must go on the bulk channel as well (see IsBulkPacket()).
+    enum class Channel
+    {
+        BULK,
+        CONTROL
     };
 
     //////////////////////////
     // TCP CONNECTION CLASS //
     //////////////////////////
+    // On Windows each connection runs a receiving and a sending thread.
+    // On POSIX all connections are driven by the shared EventLoop.
     class TCPConnection
     {
-        SOCKET _socket;
+        static constexpr int _CHANNEL_COUNT = 2;
+
+        std::atomic<SOCKET> _socket;
         std::deque<Packet> _inPackets;
-        std::deque<std::pair<Packet, int>> _outPackets; // outgoing packets have priority
+        std::deque<std::pair<Packet, int>> _outPackets[_CHANNEL_COUNT]; // outgoing packets have priority
+#ifdef _WIN32
         std::thread _inPacketHandler;
         std::thread _outPacketHandler;
+#else
+        EventLoop* _loop = nullptr;
+        std::function<void()> _onDisconnect;
+        // Whether the event loop waits for the socket to become writable (guarded by _m_outPackets)
+        bool _writeEventsEnabled = false;
+
+        // Partially received frame: the size and id, then the data (received directly
+        // into the memory returned by BeginFrame)
+        int32_t _inHeader[2];
+        int8_t* _inData = nullptr;
+        size_t _inDataSize = 0;
+        size_t _inBufUsed = 0;
+
+#endif
+        // Packets taken from '_outPackets' of a channel and the progress of describing them as frames
+        struct _SendState
+        {
+            std::vector<Packet> packets;
+            size_t packetIndex = 0;
+            size_t packetOffset = 0;
+            bool splitInfo = false;
+        };
+        _SendState _sendStates[_CHANNEL_COUNT];
+        // Channel of the last sent frames
+        int _sendChannel = 0;
+
+        // Frames being written, as header/payload segments. Payload segments point
+        // directly into the bytes of the sent packets, headers into '_frameHeaders'.
+        struct _Segment
+        {
+            const int8_t* data;
+            size_t size;
+        };
+        static constexpr size_t _MAX_BATCH_FRAMES = 32;
+        std::array<int32_t, _MAX_BATCH_FRAMES * 5> _frameHeaders;
+        std::vector<_Segment> _segments;
+        size_t _segmentIndex = 0;
+        size_t _segmentOffset = 0;
         std::mutex _m_inPackets;
         std::mutex _m_outPackets;
         std::queue<Packet> _packetQueue;
         bool _blockPackets = false;
 
+        // Incoming packet reassembly of a channel
+        struct _ReceiveState
+        {
+            alignas(int64_t) int8_t controlData[16];
+            std::shared_ptr<int8_t[]> frameBuffer;
+            std::shared_ptr<int8_t[]> splitBuffer;
+            size_t splitCapacity = 0;
+            size_t splitSize = 0;
+            int splitPartsLeft = 0;
+            std::vector<Packet> packetBufferMultiple;
+            int queueSizeMultiple = 0;
+        };
+        _ReceiveState _receiveStates[_CHANNEL_COUNT];
+        // Channel of the incoming frames
+        int _receiveChannel = 0;
+
         const size_t _MAX_PACKET_SIZE;
 
     public:
@@ -181,8 +276,18 @@ namespace znet
             u_long mode = 1;
             ioctlsocket(_socket, FIONBIO, &mode);
 
+#ifdef _WIN32
             _inPacketHandler = std::thread(&TCPConnection::HandleIncomingPackets, this);
             _outPacketHandler = std::thread(&TCPConnection::HandleOutgoingPackets, this);
+#else
+#ifdef TCP_NOTSENT_LOWAT
+            // Keep unsent data in '_outPackets' instead of the socket buffer, where control packets can't overtake it
+            int notSentLowWatermark = 128 * 1024;
+            setsockopt(_socket, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &notSentLowWatermark, sizeof(notSentLowWatermark));
+#endif
+            _loop = EventLoop::Instance();
+            _loop->Add(_socket, EPOLLIN, [this](uint32_t events) { HandleEvents(events); });
+#endif
         }
         ~TCPConnection()
         {
@@ -196,6 +301,7 @@ namespace znet
 
         void Disconnect()
         {
+#ifdef _WIN32
             if (_socket != SOCKET_ERROR)
             {
                 closesocket(_socket);
@@ -203,8 +309,27 @@ namespace znet
             }
             if (_inPacketHandler.joinable()) _inPacketHandler.join();
             if (_outPacketHandler.joinable()) _outPacketHandler.join();
+#else
+            SOCKET socket = _socket.exchange(SOCKET_ERROR);
+            if (socket != SOCKET_ERROR)
+            {
+                _loop->Remove(socket);
+                closesocket(socket);
+            }
+            // The event loop may have closed the socket itself and still be running the handler
+            if (_loop)
+                _loop->Sync();
+#endif
         }
 
+#ifndef _WIN32
+        // Called on the event loop thread when the connection breaks (not after Disconnect())
+        void SetOnDisconnect(std::function<void()> handler)
+        {
+            _onDisconnect = std::move(handler);
+        }
+#endif
+
         size_t PacketCount()
         {
             LOCK_GUARD(lock, _m_inPackets);
@@ -247,24 +372,27 @@ namespace znet
         }
 
         // Packets are placed in queue after all packets of the same or higher priority
-        void Send(Packet&& packet, int priority = 0)
+        void Send(Packet&& packet, int priority = 0, Channel channel = Channel::BULK)
         {
             if (!Connected()) return;
 
             LOCK_GUARD(lock, _m_outPackets);
+            auto& outPackets = _outPackets[(int)channel];
             if (priority != 0)
             {
-                for (int i = 0; i < _outPackets.size(); i++)
+                for (int i = 0; i < outPackets.size(); i++)
                 {
-                    if (_outPackets[i].second < priority)
+                    if (outPackets[i].second < priority)
                     {
-                        _outPackets.insert(_outPackets.begin() + i, { std::move(packet), priority });
+                        outPackets.insert(outPackets.begin() + i, { std::move(packet), priority });
+                        EnableWriteEvents();
                         return;
                     }
                 }
             }
 
-            _outPackets.push_back({ std::move(packet), priority });
+            outPackets.push_back({ std::move(packet), priority });
+            EnableWriteEvents();
 
 
             //if (priority == 0)
@@ -295,40 +423,56 @@ namespace znet
         }
 
         // Packets are placed in queue after all packets of the same or higher priority
-        void SendQueue(int priority = 0)
+        void SendQueue(int priority = 0, Channel channel = Channel::BULK)
         {
             if (!Connected()) return;
             if (_packetQueue.empty()) return;
 
             LOCK_GUARD(lock, _m_outPackets);
+            auto& outPackets = _outPackets[(int)channel];
             if (priority != 0)
             {
-                for (int i = 0; i < _outPackets.size(); i++)
+                for (int i = 0; i < outPackets.size(); i++)
                 {
-                    if (_outPackets[i].second < priority)
+                    if (outPackets[i].second < priority)
                     {
-                        _outPackets.insert(_outPackets.begin() + i, { Packet(MULTIPLE_PACKETS).From(_packetQueue.size()), priority });
+                        outPackets.insert(outPackets.begin() + i, { Packet(MULTIPLE_PACKETS).From(_packetQueue.size()), priority });
                         i++;
                         while (!_packetQueue.empty())
                         {
-                            _outPackets.insert(_outPackets.begin() + i, { std::move(_packetQueue.front()), priority });
+                            outPackets.insert(outPackets.begin() + i, { std::move(_packetQueue.front()), priority });
                             _packetQueue.pop();
                             i++;
                         }
+                        EnableWriteEvents();
                         return;
                     }
                 }
             }
 
-            _outPackets.push_back({ Packet(MULTIPLE_PACKETS).From(_packetQueue.size()), priority });
+            outPackets.push_back({ Packet(MULTIPLE_PACKETS).From(_packetQueue.size()), priority });
             while (!_packetQueue.empty())
             {
-                _outPackets.push_back({ std::move(_packetQueue.front()), priority });
+                outPackets.push_back({ std::move(_packetQueue.front()), priority });
                 _packetQueue.pop();
             }
+            EnableWriteEvents();
         }
 
     private:
+        // _m_outPackets MUST BE LOCKED BEFORE CALLING THIS FUNCTION
+        void EnableWriteEvents()
+        {
+#ifndef _WIN32
+            if (!_writeEventsEnabled)
+            {
+                _writeEventsEnabled = true;
+                _loop->Modify(_socket, EPOLLIN | EPOLLOUT);
+            }
+#endif
+        }
+
+#ifdef _WIN32
         int32_t ReceiveBytes(int8_t* buffer, int byteCount)
         {
             int totalBytesReceived = 0;
@@ -353,42 +497,42 @@ namespace znet
             return totalBytesReceived;
         }
 
-        int32_t SendBytes(int8_t* buffer, int byteCount)
+        // Writes the remaining segments, blocking until done. Returns false on error.
+        bool SendSegments()
         {
-            int totalBytesSent = 0;
-            while (totalBytesSent < byteCount)
+            WSABUF buffers[_MAX_BATCH_FRAMES * 2];
+            while (_segmentIndex < _segments.size())
             {
-                int bytesSent = send(_socket, (char*)buffer + totalBytesSent, byteCount - totalBytesSent, 0);
-                if (bytesSent == SOCKET_ERROR)
+                DWORD bufferCount = 0;
+                for (size_t i = _segmentIndex; i < _segments.size(); i++, bufferCount++)
+                {
+                    size_t offset = i == _segmentIndex ? _segmentOffset : 0;
+                    buffers[bufferCount].buf = (CHAR*)(_segments[i].data + offset);
+                    buffers[bufferCount].len = (ULONG)(_segments[i].size - offset);
+                }
+
+                DWORD bytesSent = 0;
+                if (WSASend(_socket, buffers, bufferCount, &bytesSent, 0, nullptr, nullptr) == SOCKET_ERROR)
                 {
                     if (WSAGetLastError() != WSAEWOULDBLOCK)
                     {
-                        return bytesSent;
+                        return false;
                     }
                     std::this_thread::sleep_for(std::chrono::milliseconds(10));
                     continue;
                 }
-                totalBytesSent += bytesSent;
+                AdvanceSegments(bytesSent);
             }
-            return totalBytesSent;
+            return true;
         }
 
         void HandleIncomingPackets()
         {
-            auto inBuf = std::make_unique<int8_t[]>(_MAX_PACKET_SIZE);
-
-            std::vector<Packet> packetBufferSplit;
-            std::vector<Packet> packetBufferMultiple;
-            int queueSizeSplit = 0;
-            int queueSizeMultiple = 0;
-
+            int32_t header[2];
             while (true)
             {
-                //ZeroMemory(inBuf, _MAX_PACKET_SIZE);
-
-                // Wait for packet prefix which contains the packet size
-                int32_t byteCount = 4;
-                int32_t bytesReceived = ReceiveBytes(inBuf.get(), byteCount);
+                // Wait for packet prefix which contains the packet size and id
+                int32_t bytesReceived = ReceiveBytes((int8_t*)header, sizeof(header));
                 if (bytesReceived == SOCKET_ERROR)
                 {
                     std::cout << "[Socket '" << _socket << "': error on prefix packet (" << WSAGetLastError() << ")]\n";
@@ -400,232 +544,427 @@ namespace znet
                     break;
                 }
 
-                // Wait for packet data
-                byteCount = *(int32_t*)inBuf.get();
-                bytesReceived = ReceiveBytes(inBuf.get(), byteCount);
-                if (bytesReceived == SOCKET_ERROR)
+                int32_t dataSize = header[0] - sizeof(Packet::id);
+                int8_t* data = nullptr;
+                if (header[0] >= (int32_t)sizeof(Packet::id) && header[0] <= (int32_t)_MAX_PACKET_SIZE)
+                    data = BeginFrame(header[1], dataSize);
+                if (!data)
                 {
-                    std::cout << "[Socket '" << _socket << "': error on data packet (" << WSAGetLastError() << ")]\n";
+                    std::cout << "[Socket '" << _socket << "': invalid frame (size " << header[0] << ", id " << header[1] << "), closing]\n";
                     break;
                 }
-                if (bytesReceived == 0)
+
+                // Wait for packet data, directly into the packet memory
+                if (dataSize > 0)
                 {
-                    std::cout << "[Socket '" << _socket << "': data 0 bytes received, closing]\n";
-                    break;
+                    bytesReceived = ReceiveBytes(data, dataSize);
+                    if (bytesReceived == SOCKET_ERROR)
+                    {
+                        std::cout << "[Socket '" << _socket << "': error on data packet (" << WSAGetLastError() << ")]\n";
+                        break;
+                    }
+                    if (bytesReceived == 0)
+                    {
+                        std::cout << "[Socket '" << _socket << "': data 0 bytes received, closing]\n";
+                        break;
+                    }
                 }
 
-                // Extract data
-                int32_t packetSize = byteCount - sizeof(int32_t);
-                auto bytes = std::make_unique<int8_t[]>(packetSize);
-                //std::unique_ptr<int8_t[]> bytes(new int8_t[packetSize]);
-                int32_t packetId = *(int32_t*)inBuf.get();
-                memcpy(bytes.get(), (char*)inBuf.get() + sizeof(int32_t), packetSize);
+                FinishFrame(header[1], dataSize);
+            }
+
+            closesocket(_socket);
+            _socket = SOCKET_ERROR;
+        }
+
+        void HandleOutgoingPackets()
+        {
+            while (true)
+            {
+                if (_socket == SOCKET_ERROR)
+                {
+                    break;
+                }
 
-                // Check for special types
-                if (packetId == SPLIT_PACKET)
+                _m_outPackets.lock();
+                int channel = NextSendChannel();
+                _m_outPackets.unlock();
+                if (channel == -1)
                 {
-                    queueSizeSplit = *(int*)bytes.get();
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
                     continue;
                 }
-                else if (packetId == MULTIPLE_PACKETS)
+
+                BuildFrames(channel);
+                if (!SendSegments())
                 {
-                    if (queueSizeSplit == 0)
-                    {
-                        queueSizeMultiple = *(int*)bytes.get();
-                        continue;
-                    }
+                    std::cout << "[Socket '" << _socket << "': error on send (" << WSAGetLastError() << ")]\n";
+                    break;
                 }
+            }
+
+            closesocket(_socket);
+            _socket = SOCKET_ERROR;
+        }
 
-                Packet packet = Packet(std::move(bytes), packetSize, packetId);
+#else
+        void HandleEvents(uint32_t events)
+        {
+            if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                ReceiveFrames();
+            if (Connected() && (events & EPOLLOUT))
+                SendFrames();
+        }
 
-                // Handle split packets
-                if (queueSizeSplit > 0)
+        // Reads frames until the socket has no more data
+        void ReceiveFrames()
+        {
+            while (true)
+            {
+                // Frames start with the size and id
+                bool receivingHeader = _inData == nullptr;
+                int8_t* buffer = receivingHeader ? (int8_t*)_inHeader : _inData;
+                size_t needed = receivingHeader ? sizeof(_inHeader) : _inDataSize;
+                if (_inBufUsed < needed)
                 {
-                    queueSizeSplit--;
-                    packetBufferSplit.push_back(std::move(packet));
-
-                    // Combine packets
-                    if (queueSizeSplit == 0)
+                    ssize_t bytesReceived = recv(_socket, (char*)buffer + _inBufUsed, needed - _inBufUsed, 0);
+                    if (bytesReceived == SOCKET_ERROR)
                     {
-                        packet = std::move(CombinePackets(packetBufferSplit));
+                        if (WSAGetLastError() == WSAEWOULDBLOCK)
+                            return;
+                        std::cout << "[Socket '" << _socket << "': error on receive (" << WSAGetLastError() << ")]\n";
+                        Close();
+                        return;
                     }
-                    else
+                    if (bytesReceived == 0)
                     {
-                        continue;
+                        std::cout << "[Socket '" << _socket << "': 0 bytes received, closing]\n";
+                        Close();
+                        return;
                     }
+
+                    _inBufUsed += bytesReceived;
+                    if (_inBufUsed < needed)
+                        continue;
                 }
+                _inBufUsed = 0;
 
-                // Handle multiple packets
-                if (queueSizeMultiple > 0)
+                if (receivingHeader)
                 {
-                    queueSizeMultiple--;
-                    packetBufferMultiple.push_back(std::move(packet));
-
-                    // Deposit buffer to packet queue
-                    if (queueSizeMultiple == 0)
+                    int32_t frameSize = _inHeader[0];
+                    if (frameSize >= (int32_t)sizeof(Packet::id) && frameSize <= (int32_t)_MAX_PACKET_SIZE)
                     {
-                        DepositPacketBuffer(packetBufferMultiple);
+                        _inDataSize = frameSize - sizeof(Packet::id);
+                        _inData = BeginFrame(_inHeader[1], (int32_t)_inDataSize);
+                    }
+                    if (!_inData)
+                    {
+                        std::cout << "[Socket '" << _socket << "': invalid frame (size " << frameSize << ", id " << _inHeader[1] << "), closing]\n";
+                        Close();
+                        return;
                     }
-                    continue;
                 }
+                else
+                {
+                    _inData = nullptr;
+                    FinishFrame(_inHeader[1], (int32_t)_inDataSize);
+                }
+            }
+        }
+
+        // Sends frames until the socket buffer is full or there is nothing left
+        void SendFrames()
+        {
+            iovec buffers[_MAX_BATCH_FRAMES * 2];
+            while (true)
+            {
+                if (_segmentIndex == _segments.size() && !PrepareNextBatch())
+                    return;
 
-                if (!_blockPackets)
+                size_t bufferCount = 0;
+                for (size_t i = _segmentIndex; i < _segments.size(); i++, bufferCount++)
                 {
-                    _m_inPackets.lock();
-                    _inPackets.push_back(std::move(packet));
-                    _m_inPackets.unlock();
+                    size_t offset = i == _segmentIndex ? _segmentOffset : 0;
+                    buffers[bufferCount].iov_base = (void*)(_segments[i].data + offset);
+                    buffers[bufferCount].iov_len = _segments[i].size - offset;
                 }
+
+                msghdr message{};
+                message.msg_iov = buffers;
+                message.msg_iovlen = bufferCount;
+                ssize_t bytesSent = sendmsg(_socket, &message, MSG_NOSIGNAL);
+                if (bytesSent == SOCKET_ERROR)
+                {
+                    if (WSAGetLastError() == WSAEWOULDBLOCK)
+                        return;
+                    std::cout << "[Socket '" << _socket << "': error on send (" << WSAGetLastError() << ")]\n";
+                    Close();
+                    return;
+                }
+                AdvanceSegments(bytesSent);
             }
+        }
 
-            closesocket(_socket);
-            _socket = SOCKET_ERROR;
+        // Describes the next frames to send, taking new packets from '_outPackets' when needed.
+        // Returns false (and stops waiting for write events) if there is nothing to send.
+        bool PrepareNextBatch()
+        {
+            int channel;
+            {
+                LOCK_GUARD(lock, _m_outPackets);
+                channel = NextSendChannel();
+                if (channel == -1)
+                {
+                    _writeEventsEnabled = false;
+                    _loop->Modify(_socket, EPOLLIN);
+                    return false;
+                }
+            }
+            BuildFrames(channel);
+            return true;
         }
 
-        void HandleOutgoingPackets()
+        // Closes the socket from the event loop thread
+        void Close()
         {
-            auto outBuf = std::make_unique<int8_t[]>(_MAX_PACKET_SIZE);
-            //auto outBuf = new int8_t[_MAX_PACKET_SIZE];
+            SOCKET socket = _socket.exchange(SOCKET_ERROR);
+            if (socket == SOCKET_ERROR)
+                return;
+            _loop->Remove(socket);
+            closesocket(socket);
+            if (_onDisconnect)
+                _onDisconnect();
+        }
+#endif
 
-            std::vector<Packet> packets;
-            while (true)
+        // Picks the channel of the next frames: control packets go first, interrupted bulk packets
+        // continue afterwards. Takes the next packets out of '_outPackets' when a channel has none left.
+        // Returns -1 if there is nothing to send.
+        // _m_outPackets MUST BE LOCKED BEFORE CALLING THIS FUNCTION
+        int NextSendChannel()
+        {
+            for (int channel = _CHANNEL_COUNT - 1; channel >= 0; channel--)
             {
-                if (_socket == SOCKET_ERROR)
+                _SendState& state = _sendStates[channel];
+                if (state.packetIndex < state.packets.size())
+                    return channel;
+                // The previous packets were fully written, release them
+                state.packets.clear();
+                state.packetIndex = 0;
+                if (!_outPackets[channel].empty())
                 {
-                    break;
+                    TakeOutgoingPackets(channel);
+                    return channel;
                 }
+            }
+            return -1;
+        }
 
-                _m_outPackets.lock();
-                if (_outPackets.empty())
+        // Moves the next packet (and the packets bundled with it) from '_outPackets' to the send state of the channel
+        // _m_outPackets MUST BE LOCKED BEFORE CALLING THIS FUNCTION
+        void TakeOutgoingPackets(int channel)
+        {
+            auto& outPackets = _outPackets[channel];
+            _SendState& state = _sendStates[channel];
+            state.packets.clear();
+            state.packets.push_back(std::move(outPackets.front().first));
+            outPackets.pop_front();
+
+            // Take the bundled packets out together, to prevent any packets getting sent in between
+            if (state.packets[0].id == MULTIPLE_PACKETS)
+            {
+                size_t packetCount = std::min((size_t)state.packets[0].Cast<int32_t>(), outPackets.size());
+                for (size_t i = 0; i < packetCount; i++)
                 {
-                    _m_outPackets.unlock();
-                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    state.packets.push_back(std::move(outPackets.front().first));
+                    outPackets.pop_front();
+                }
+            }
+            state.packetIndex = 0;
+            state.packetOffset = 0;
+            state.splitInfo = state.packets[0].size > _MAX_PACKET_SIZE - (sizeof(int32_t) + sizeof(Packet::id));
+        }
+
+        // Describes up to '_MAX_BATCH_FRAMES' of the next frames of the channel's packets as segments,
+        // preceded by a SWITCH_CHANNEL frame if the previous frames were of another channel.
+        // Packets above the max packet size are preceded by a SPLIT_PACKET frame and sent in parts.
+        void BuildFrames(int channel)
+        {
+            // Prefix contains packet size and id
+            size_t prefixSize = sizeof(int32_t) + sizeof(Packet::id);
+            size_t maxDataSize = _MAX_PACKET_SIZE - prefixSize;
+            _SendState& state = _sendStates[channel];
+
+            _segments.clear();
+            _segmentIndex = 0;
+            _segmentOffset = 0;
+            size_t frame = 0;
+            if (channel != _sendChannel)
+            {
+                int32_t* header = _frameHeaders.data();
+                header[0] = sizeof(Packet::id) + sizeof(int32_t);
+                header[1] = SWITCH_CHANNEL;
+                header[2] = channel;
+                _segments.push_back({ (const int8_t*)header, prefixSize + sizeof(int32_t) });
+                _sendChannel = channel;
+                frame++;
+            }
+
+            for (; frame < _MAX_BATCH_FRAMES && state.packetIndex < state.packets.size(); frame++)
+            {
+                const Packet& packet = state.packets[state.packetIndex];
+                int32_t* header = _frameHeaders.data() + frame * 5;
+                if (state.splitInfo)
+                {
+                    // Info about split packets: part count and total size,
+                    // so the receiver can reassemble them in a single buffer
+                    int64_t packetSize = packet.size;
+                    header[0] = sizeof(Packet::id) + sizeof(int32_t) + sizeof(int64_t);
+                    header[1] = SPLIT_PACKET;
+                    header[2] = (int32_t)ceil(packet.size / (double)maxDataSize);
+                    memcpy(header + 3, &packetSize, sizeof(int64_t));
+                    _segments.push_back({ (const int8_t*)header, prefixSize + sizeof(int32_t) + sizeof(int64_t) });
+                    state.splitInfo = false;
                     continue;
                 }
-                packets.clear();
-                packets.push_back(std::move(_outPackets.front().first));
-                _outPackets.pop_front();
 
-                // If multiple packets specified, take them out of the queue while it is locked,
-                // to prevent any packets getting sent in between
-                if (packets[0].id == MULTIPLE_PACKETS)
+                size_t byteCount = std::min(packet.size - state.packetOffset, maxDataSize);
+                header[0] = (int32_t)(byteCount + sizeof(Packet::id));
+                header[1] = packet.id;
+                _segments.push_back({ (const int8_t*)header, prefixSize });
+                if (byteCount > 0)
+                    _segments.push_back({ packet.Bytes() + state.packetOffset, byteCount });
+
+                state.packetOffset += byteCount;
+                if (state.packetOffset == packet.size)
                 {
-                    int32_t packetCount = packets[0].Cast<int32_t>();
-                    if (packetCount > _outPackets.size())
-                    {
-                        _m_outPackets.unlock();
-                        continue;
-                    }
-                    for (int i = 0; i < packetCount; i++)
-                    {
-                        packets.push_back(std::move(_outPackets.front().first));
-                        _outPackets.pop_front();
-                    }
+                    state.packetIndex++;
+                    state.packetOffset = 0;
+                    if (state.packetIndex < state.packets.size())
+                        state.splitInfo = state.packets[state.packetIndex].size > maxDataSize;
                 }
-                _m_outPackets.unlock();
+            }
+        }
 
-                bool stop = false;
-                for (int i = 0; i < packets.size(); i++)
+        // Moves the write position past 'byteCount' sent bytes (partial writes resume mid-segment)
+        void AdvanceSegments(size_t byteCount)
+        {
+            while (byteCount > 0 && _segmentIndex < _segments.size())
+            {
+                size_t segmentBytesLeft = _segments[_segmentIndex].size - _segmentOffset;
+                if (byteCount < segmentBytesLeft)
                 {
-                    // Prefix contains packet size and id
-                    size_t prefixSize = sizeof(int32_t) + sizeof(Packet::id);
-                    int packetCount = ceil(packets[i].size / (double)(_MAX_PACKET_SIZE - prefixSize));
-                    if (packetCount > 1)
-                    {
-                        // Send info about split packets
-                        int packetSize = 4;
-                        *(int32_t*)(outBuf.get()) = sizeof(Packet::id) + packetSize;
-                        *(int32_t*)(outBuf.get() + 4) = SPLIT_PACKET;
-                        *(int32_t*)(outBuf.get() + 8) = packetCount;
-                        int bytesSent = SendBytes(outBuf.get(), prefixSize + packetSize);
-                        if (bytesSent == SOCKET_ERROR)
-                        {
-                            std::cout << "[Socket '" << _socket << "': error on split info packet (" << WSAGetLastError() << ")]\n";
-                            stop = true;
-                            break;
-                        }
-                        if (bytesSent == 0)
-                        {
-                            std::cout << "[Socket '" << _socket << "': data 0 bytes sent, closing]\n";
-                            stop = true;
-                            break;
-                        }
-                    }
+                    _segmentOffset += byteCount;
+                    return;
+                }
+                byteCount -= segmentBytesLeft;
+                _segmentIndex++;
+                _segmentOffset = 0;
+            }
+        }
 
-                    // Send in parts (if necessary)
-                    int bytesLeft = packets[i].size;
-                    int totalBytesSent = 0;
-                    do
-                    {
-                        int byteCount;
-                        if (bytesLeft > _MAX_PACKET_SIZE - prefixSize)
-                        {
-                            *(int32_t*)(outBuf.get()) = _MAX_PACKET_SIZE - 4;
-                            *(int32_t*)(outBuf.get() + 4) = packets[i].id;
-                            memcpy(outBuf.get() + prefixSize, packets[i].Bytes() + totalBytesSent, _MAX_PACKET_SIZE - prefixSize);
-                            totalBytesSent += _MAX_PACKET_SIZE - prefixSize;
-                            bytesLeft -= _MAX_PACKET_SIZE - prefixSize;
-                            byteCount = _MAX_PACKET_SIZE;
-                        }
-                        else
-                        {
-                            *(int32_t*)(outBuf.get()) = bytesLeft + 4;
-                            *(int32_t*)(outBuf.get() + 4) = packets[i].id;
-                            memcpy(outBuf.get() + prefixSize, packets[i].Bytes() + totalBytesSent, bytesLeft);
-                            byteCount = bytesLeft + prefixSize;
-                            bytesLeft = 0;
-                        }
+        // Returns the memory into which the data of an incoming frame should be received,
+        // nullptr if the frame is invalid. Whole packets get a pooled buffer of their size,
+        // parts of a split packet are placed one after another in a buffer for the whole packet.
+        int8_t* BeginFrame(int32_t packetId, int32_t dataSize)
+        {
+            _ReceiveState& state = _receiveStates[_receiveChannel];
+            if (packetId == SWITCH_CHANNEL || packetId == SPLIT_PACKET || (packetId == MULTIPLE_PACKETS && state.splitPartsLeft == 0))
+            {
+                if (dataSize < (int32_t)sizeof(int32_t) || dataSize > (int32_t)sizeof(state.controlData))
+                    return nullptr;
+                return state.controlData;
+            }
 
-                        int bytesSent = SendBytes(outBuf.get(), byteCount);
-                        if (bytesSent == SOCKET_ERROR)
-                        {
-                            std::cout << "[Socket '" << _socket << "': error on partial packet (" << WSAGetLastError() << ")]\n";
-                            stop = true;
-                            break;
-                        }
-                        if (bytesSent == 0)
-                        {
-                            std::cout << "[Socket '" << _socket << "': data 0 bytes sent, closing]\n";
-                            stop = true;
-                            break;
-                        }
-                    }
-                    while (bytesLeft > 0);
-                }
-                if (stop) break;
+            if (state.splitPartsLeft > 0)
+            {
+                if (state.splitSize + dataSize > state.splitCapacity)
+                    return nullptr;
+                return state.splitBuffer.get() + state.splitSize;
             }
 
-            closesocket(_socket);
-            _socket = SOCKET_ERROR;
+            state.frameBuffer = PacketBufferPool::Instance()->Acquire(dataSize);
+            return state.frameBuffer.get();
         }
 
-        // Combine all packets in the buffer into a single and push it to the main queue
-        Packet CombinePackets(std::vector<Packet>& buffer)
+        // Handles a frame whose data was received into the memory returned by BeginFrame
+        void FinishFrame(int32_t packetId, int32_t dataSize)
         {
-            // Calculate total size
-            size_t combinedSize = 0;
-            for (int i = 0; i < buffer.size(); i++)
+            _ReceiveState& state = _receiveStates[_receiveChannel];
+
+            // Check for special types
+            if (packetId == SWITCH_CHANNEL)
             {
-                combinedSize += buffer[i].View().size;
+                int32_t channel = *(int32_t*)state.controlData;
+                if (channel >= 0 && channel < _CHANNEL_COUNT)
+                    _receiveChannel = channel;
+                return;
             }
+            else if (packetId == SPLIT_PACKET)
+            {
+                int32_t partCount = *(int32_t*)state.controlData;
+                if (partCount <= 0)
+                    return;
 
-            // Allocate memory
-            auto combinedData = std::make_unique<int8_t[]>(combinedSize);
-            //std::unique_ptr<int8_t> combinedData(new int8_t[combinedSize]);
+                // Without the total size, reserve enough for full parts
+                size_t capacity = partCount * (_MAX_PACKET_SIZE - (sizeof(int32_t) + sizeof(Packet::id)));
+                if (dataSize >= (int32_t)(sizeof(int32_t) + sizeof(int64_t)))
+                {
+                    int64_t packetSize;
+                    memcpy(&packetSize, state.controlData + sizeof(int32_t), sizeof(int64_t));
+                    if (packetSize >= 0 && (size_t)packetSize < capacity)
+                        capacity = (size_t)packetSize;
+                }
+                state.splitBuffer = PacketBufferPool::Instance()->Acquire(capacity);
+                state.splitCapacity = capacity;
+                state.splitSize = 0;
+                state.splitPartsLeft = partCount;
+                return;
+            }
+            else if (packetId == MULTIPLE_PACKETS)
+            {
+                if (state.splitPartsLeft == 0)
+                {
+                    state.queueSizeMultiple = *(int*)state.controlData;
+                    return;
+                }
+            }
 
-            // Merge data
-            PacketView packetInfo = buffer[0].View();
-            int currentByte = 0;
-            for (int i = 0; i < buffer.size(); i++)
+            Packet packet;
+            if (state.splitPartsLeft > 0)
             {
-                int packetSize = buffer[i].View().size;
-                memcpy(combinedData.get() + currentByte, buffer[i].Bytes(), packetSize);
-                currentByte += packetSize;
+                // Handle split packets
+                state.splitSize += dataSize;
+                state.splitPartsLeft--;
+                if (state.splitPartsLeft > 0)
+                    return;
+                packet = Packet(std::move(state.splitBuffer), state.splitSize, packetId);
+            }
+            else
+            {
+                packet = Packet(std::move(state.frameBuffer), dataSize, packetId);
             }
 
-            // Clear buffer
-            buffer.clear();
+            // Handle multiple packets
+            if (state.queueSizeMultiple > 0)
+            {
+                state.queueSizeMultiple--;
+                state.packetBufferMultiple.push_back(std::move(packet));
+
+                // Deposit buffer to packet queue
+                if (state.queueSizeMultiple == 0)
+                {
+                    DepositPacketBuffer(state.packetBufferMultiple);
+                }
+                return;
+            }
 
-            return Packet(std::move(combinedData), combinedSize, packetInfo.id);
+            if (!_blockPackets)
+            {
+                _m_inPackets.lock();
+                _inPackets.push_back(std::move(packet));
+                _m_inPackets.unlock();
+            }
         }
 
         // Push all packets in the buffer at once
@@ -775,7 +1114,11 @@ namespace znet
     {
         std::vector<std::unique_ptr<Client>> _connections;
         std::mutex _m_connections;
+#ifdef _WIN32
         std::thread _garbageCollector;
+#else
+        int64_t _garbageCollectorTimer;
+#endif
         bool _canSelfDestruct;
 
     public:
@@ -793,43 +1136,60 @@ namespace znet
         TCPConnectionManager()
         {
             _canSelfDestruct = false;
+#ifdef _WIN32
             _garbageCollector = std::thread(&TCPConnectionManager::CollectGarbage, this);
+#else
+            _garbageCollectorTimer = EventLoop::Instance()->AddTimer(std::chrono::seconds(5), [this]() { CollectGarbageOnce(); });
+#endif
         }
         ~TCPConnectionManager()
         {
+#ifdef _WIN32
             _garbageCollector.detach();
+#else
+            EventLoop::Instance()->RemoveTimer(_garbageCollectorTimer);
+#endif
         }
 
+#ifdef _WIN32
         void CollectGarbage()
         {
             while (true)
             {
-                // Clear connections
-                _m_connections.lock();
-                for (int i = 0; i < _connections.size(); i++)
+                if (CollectGarbageOnce())
+                    return;
+                std::this_thread::sleep_for(std::chrono::seconds(5));
+            }
+        }
+#endif
+
+        // Returns true if the manager deleted itself
+        bool CollectGarbageOnce()
+        {
+            // Clear connections
+            _m_connections.lock();
+            for (int i = 0; i < _connections.size(); i++)
+            {
+                if (_connections[i]->refCount == 0 &&
+                    _connections[i]->connection->PacketCount() == 0 &&
+                    !_connections[i]->connection->Connected())
                 {
-                    if (_connections[i]->refCount == 0 &&
-                        _connections[i]->connection->PacketCount() == 0 &&
-                        !_connections[i]->connection->Connected())
-                    {
-                        _connections.erase(_connections.begin() + i);
-                        i--;
-                    }
+                    _connections.erase(_connections.begin() + i);
+                    i--;
                 }
-                _m_connections.unlock();
+            }
+            _m_connections.unlock();
 
-                // Self destruct
-                if (_canSelfDestruct)
+            // Self destruct
+            if (_canSelfDestruct)
+            {
+                if (_connections.empty())
                 {
-                    if (_connections.empty())
-                    {
-                        delete this;
-                        return;
-                    }
+                    delete this;
+                    return true;
                 }
-
-                std::this_thread::sleep_for(std::chrono::seconds(5));
             }
+            return false;
         }
 
     public:
@@ -880,6 +1240,7 @@ namespace znet
         NetResult(int code)
             : code(code)
         {
+#ifdef _WIN32
             LPTSTR errorText = NULL;
             FormatMessage(
                 FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_IGNORE_INSERTS,
@@ -895,6 +1256,10 @@ namespace znet
                 message = errorText;
                 LocalFree(errorText);
             }
+#else
+            std::string errorText = strerror(code);
+            message = std::wstring(errorText.begin(), errorText.end());
+#endif
         }
         NetResult(std::wstring msg, int code = -1)
             : message(msg), code(code) {}
@@ -913,14 +1278,18 @@ namespace znet
         TCPConnectionManager* _connectionManager;
         std::vector<TCPClientRef> _connections;
         std::mutex _m_connections;
+#ifdef _WIN32
         std::thread _disconnectHandler;
         bool _disconnectHandlerStop;
+#endif
 
         // New connection/disconnection handling
         SOCKET _listeningSocket;
         bool _listening;
+#ifdef _WIN32
         std::thread _newConnectionHandler;
         bool _connectHandlerStop;
+#endif
         std::queue<int64_t> _newConnections;
         std::queue<int64_t> _disconnects;
         std::mutex _m_newConnections;
@@ -963,16 +1332,20 @@ namespace znet
             _listening = false;
             _ID_COUNTER = 0;
             _connectionManager = TCPConnectionManager::Create();
+#ifdef _WIN32
             _disconnectHandlerStop = false;
             _disconnectHandler = std::thread(&TCPServer::HandleDisconnects, this);
+#endif
         }
         ~TCPServer()
         {
             StopServer();
             _connectionManager->AllowSelfDestruct();
+#ifdef _WIN32
             _disconnectHandlerStop = true;
             if (_disconnectHandler.joinable())
                 _disconnectHandler.join();
+#endif
         }
 
         bool Running()
@@ -1019,7 +1392,7 @@ namespace znet
             sockaddr_in hint;
             hint.sin_family = AF_INET;
             hint.sin_port = htons(_port);
-            hint.sin_addr.S_un.S_addr = INADDR_ANY;
+            hint.sin_addr.s_addr = INADDR_ANY;
             if (bind(_listeningSocket, (sockaddr*)&hint, sizeof(hint)) == SOCKET_ERROR)
                 return NetResult(WSAGetLastError());
 
@@ -1027,9 +1400,16 @@ namespace znet
             if (listen(_listeningSocket, SOMAXCONN) == SOCKET_ERROR)
                 return NetResult(WSAGetLastError());
 
+#ifdef _WIN32
             // Start thread
             _connectHandlerStop = false;
             _newConnectionHandler = std::thread(&TCPServer::HandleNewConnections, this);
+#else
+            u_long mode = 1;
+            ioctlsocket(_listeningSocket, FIONBIO, &mode);
+            _listening = true;
+            EventLoop::Instance()->Add(_listeningSocket, EPOLLIN, [this](uint32_t) { AcceptNewConnections(); });
+#endif
 
             return true;
         }
@@ -1039,9 +1419,16 @@ namespace znet
             if (!_running) return;
             if (!_listening) return;
 
+#ifdef _WIN32
             _connectHandlerStop = true;
             if (_newConnectionHandler.joinable())
                 _newConnectionHandler.join();
+#else
+            EventLoop::Instance()->Remove(_listeningSocket);
+            closesocket(_listeningSocket);
+            _listeningSocket = SOCKET_ERROR;
+            _listening = false;
+#endif
         }
 
         size_t NewConnectionCount()
@@ -1117,28 +1504,37 @@ namespace znet
             }
         }
 
+        // Connections are disconnected after unlocking _m_connections,
+        // because on POSIX Disconnect() waits for the event loop, which may be waiting for the lock
+
         void DisconnectUser(int64_t id)
         {
-            LOCK_GUARD(lock, _m_connections);
+            std::vector<TCPClientRef> removed;
+            _m_connections.lock();
             for (auto it = _connections.begin(); it != _connections.end(); it++)
             {
                 if (it->Id() == id)
                 {
-                    it->Get()->Disconnect();
+                    removed.push_back(std::move(*it));
                     _connections.erase(it);
-                    return;
+                    break;
                 }
             }
+            _m_connections.unlock();
+
+            for (auto& connection : removed)
+                connection->Disconnect();
         }
 
         void DisconnectAll()
         {
-            LOCK_GUARD(lock, _m_connections);
-            for (auto it = _connections.begin(); it != _connections.end(); it++)
-            {
-                it->Get()->Disconnect();
-            }
+            _m_connections.lock();
+            std::vector<TCPClientRef> removed = std::move(_connections);
             _connections.clear();
+            _m_connections.unlock();
+
+            for (auto& connection : removed)
+                connection->Disconnect();
         }
         
         /// <summary>
@@ -1147,15 +1543,20 @@ namespace znet
         /// </summary>
         void DisconnectExcess()
         {
-            LOCK_GUARD(lock, _m_connections);
+            std::vector<TCPClientRef> removed;
+            _m_connections.lock();
             if (_connections.size() > _maxConnections)
             {
                 for (int i = _maxConnections; i < _connections.size(); i++)
                 {
-                    _connections[i].Get()->Disconnect();
+                    removed.push_back(std::move(_connections[i]));
                 }
                 _connections.erase(_connections.begin() + _maxConnections, _connections.end());
             }
+            _m_connections.unlock();
+
+            for (auto& connection : removed)
+                connection->Disconnect();
         }
 
         /// <summary>
@@ -1200,6 +1601,29 @@ namespace znet
         }
 
     private:
+        void AddConnection(SOCKET socket, sockaddr_in socketInfo)
+        {
+            if (ConnectionCount() >= _maxConnections)
+            {
+                closesocket(socket);
+                return;
+            }
+
+            //std::unique_ptr<TCPConnection> newConnection(new TCPConnection(socket, socketInfo, _connectionMaxPacketSize));
+            auto newConnection = std::make_unique<TCPConnection>(socket, socketInfo, _connectionMaxPacketSize);
+            int64_t newId = _GetNewID();
+#ifndef _WIN32
+            // Runs on the event loop thread, same as this function, so no events are missed in between
+            newConnection->SetOnDisconnect([this, newId]() { HandleDisconnect(newId); });
+#endif
+            _m_connections.lock();
+            _connections.push_back(_connectionManager->AddClient(std::move(newConnection), newId));
+            _m_connections.unlock();
+            _m_newConnections.lock();
+            _newConnections.push(newId);
+            _m_newConnections.unlock();
+        }
+
         // _m_connections MUST BE LOCKED BEFORE CALLING THIS FUNCTION
         TCPConnection* FindConnection(int64_t id)
         {
@@ -1213,6 +1637,7 @@ namespace znet
             return nullptr;
         }
 
+#ifdef _WIN32
         void HandleNewConnections()
         {
             // Make socket non-blocking
@@ -1240,22 +1665,7 @@ namespace znet
 
                     continue;
                 }
-                if (_connections.size() >= _maxConnections)
-                {
-                    closesocket(socket);
-                    continue;
-                }
-
-                // Add connection
-                //std::unique_ptr<TCPConnection> newConnection(new TCPConnection(socket, socketInfo, _connectionMaxPacketSize));
-                auto newConnection = std::make_unique<TCPConnection>(socket, socketInfo, _connectionMaxPacketSize);
-                int64_t newId = _GetNewID();
-                _m_connections.lock();
-                _connections.push_back(_connectionManager->AddClient(std::move(newConnection), newId));
-                _m_connections.unlock();
-                _m_newConnections.lock();
-                _newConnections.push(newId);
-                _m_newConnections.unlock();
+                AddConnection(socket, socketInfo);
 
                 //char host[NI_MAXHOST];
                 //char service[NI_MAXSERV];
@@ -1316,6 +1726,41 @@ namespace znet
                 }
             }
         }
+#else
+        // Called on the event loop thread
+        void AcceptNewConnections()
+        {
+            while (true)
+            {
+                sockaddr_in socketInfo;
+                socklen_t socketInfoSize = sizeof(socketInfo);
+                SOCKET socket = accept(_listeningSocket, (sockaddr*)&socketInfo, &socketInfoSize);
+                if (socket == SOCKET_ERROR)
+                {
+                    if (WSAGetLastError() != WSAEWOULDBLOCK)
+                        std::cout << "[Accept error: " << WSAGetLastError() << "]" << std::endl;
+                    return;
+                }
+                AddConnection(socket, socketInfo);
+            }
+        }
+
+        // Called on the event loop thread
+        void HandleDisconnect(int64_t id)
+        {
+            LOCK_GUARD(lock1, _m_disconnects);
+            LOCK_GUARD(lock2, _m_connections);
+            for (int i = 0; i < _connections.size(); i++)
+            {
+                if (_connections[i].Id() == id)
+                {
+                    _disconnects.push(id);
+                    _connections.erase(_connections.begin() + i);
+                    return;
+                }
+            }
+        }
+#endif
     };
 
     //////////////////////
@@ -1458,6 +1903,7 @@ namespace znet
             int result = connect(sock, (sockaddr*)&addr, sizeof(addr));
             if (result == SOCKET_ERROR)
             {
+#ifdef _WIN32
                 if (WSAGetLastError() == WSAEWOULDBLOCK)
                 {
                     timeval dur = { 0, 0 };
@@ -1497,6 +1943,30 @@ namespace znet
                         return;
                     }
                 }
+#else
+                if (errno == EINPROGRESS)
+                {
+                    pollfd pfd = { sock, POLLOUT, 0 };
+                    while (!_CONN_THR_STOP)
+                    {
+                        // Short timeout, to check the stop flag
+                        result = poll(&pfd, 1, 10);
+                        if (result > 0)
+                            break;
+                    }
+
+                    int error = 0;
+                    socklen_t errorSize = sizeof(error);
+                    getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &errorSize);
+                    if (_CONN_THR_STOP || error != 0)
+                    {
+                        closesocket(sock);
+                        _connectResult = -1;
+                        _connectFinished = true;
+                        return;
+                    }
+                }
+#endif
                 else
                 {
                     closesocket(sock);
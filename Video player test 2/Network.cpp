@@ -93,6 +93,20 @@ int64_t znet::Network::ThisUserId()
     return -1;
 }
 
+TimePoint znet::Network::SharedTime()
+{
+    if (_networkManager)
+        return _networkManager->SharedTime();
+    return ClockSync::LocalTime();
+}
+
+bool znet::Network::SharedTimeSynced()
+{
+    if (_networkManager)
+        return _networkManager->SharedTimeSynced();
+    return true;
+}
+
 void znet::Network::Send(Packet&& packet, std::vector<int64_t> userIds, int priority)
 {
     if (_networkManager)
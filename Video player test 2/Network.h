@@ -39,6 +39,9 @@ namespace znet
         std::vector<int64_t> UserIds(bool includeSelf = false);
         INetworkManager::User ThisUser();
         int64_t ThisUserId();
+        // See INetworkManager::SharedTime()
+        TimePoint SharedTime();
+        bool SharedTimeSynced();
 
         // Operation functions
 
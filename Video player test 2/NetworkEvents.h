@@ -82,4 +82,9 @@ struct NetworkStatsEvent
     int64_t bytesSent;
     int64_t bytesReceived;
     int64_t latency; // Microseconds
+    // Congestion control of heavy packets, -1 if unknown
+    // (server: window and bandwidth summed over users, round trip of the slowest user)
+    int64_t window; // Bytes
+    int64_t roundTrip; // Microseconds
+    int64_t bandwidth; // Bytes per second
 };
\ No newline at end of file
@@ -0,0 +1,102 @@
+#include "NullAudioSink.h"
+
+NullAudioSink::NullAudioSink(int channels, int sampleRate, Duration period)
+    : _channels(channels), _sampleRate(sampleRate), _period(period)
+{}
+
+NullAudioSink::~NullAudioSink()
+{
+    Close();
+}
+
+int NullAudioSink::Channels() const
+{
+    return _channels;
+}
+
+int NullAudioSink::SampleRate() const
+{
+    return _sampleRate;
+}
+
+bool NullAudioSink::Open(RenderCallback render)
+{
+    _StopThread();
+    _render = std::move(render);
+    _threadStop = false;
+    _thread = std::thread(&NullAudioSink::_SinkThread, this);
+    return true;
+}
+
+void NullAudioSink::Close()
+{
+    _StopThread();
+}
+
+void NullAudioSink::Start()
+{
+    std::lock_guard<std::mutex> lock(_m_render);
+    _running = true;
+}
+
+void NullAudioSink::Stop()
+{
+    std::lock_guard<std::mutex> lock(_m_render);
+    _running = false;
+}
+
+bool NullAudioSink::Running() const
+{
+    return _running;
+}
+
+void NullAudioSink::_StopThread()
+{
+    if (_thread.joinable())
+    {
+        _threadStop = true;
+        _thread.join();
+    }
+    _running = false;
+}
+
+void NullAudioSink::_SinkThread()
+{
+    // Samples are pulled at the rate a device would consume them
+    Clock playbackClock = Clock(0);
+    playbackClock.Stop();
+    int64_t samplesRendered = 0;
+    // Don't try to catch up on more than this after a stall
+    const int64_t maxBacklog = _sampleRate / 4;
+
+    while (!_threadStop)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(_period.GetDuration(MICROSECONDS)));
+
+        std::lock_guard<std::mutex> lock(_m_render);
+        playbackClock.Update();
+        if (_running != !playbackClock.Paused())
+        {
+            if (_running)
+                playbackClock.Start();
+            else
+                playbackClock.Stop();
+        }
+        if (!_running)
+            continue;
+
+        int64_t samplesDue = playbackClock.Now().GetTime(MICROSECONDS) * _sampleRate / 1000000 - samplesRendered;
+        if (samplesDue > maxBacklog)
+        {
+            samplesRendered += samplesDue - maxBacklog;
+            samplesDue = maxBacklog;
+        }
+        if (samplesDue <= 0)
+            continue;
+
+        _buffer.resize((size_t)samplesDue * _channels);
+        _render(_buffer.data(), (int)samplesDue);
+        _Consume(_buffer.data(), (int)samplesDue);
+        samplesRendered += samplesDue;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "IAudioSink.h"
+#include "GameTime.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Consumes audio in real time without playing it, so the player can run
+// on machines without a sound card. Derived sinks can do something with
+// the consumed samples (see WavFileAudioSink).
+class NullAudioSink : public IAudioSink
+{
+    int _channels;
+    int _sampleRate;
+    Duration _period;
+
+    RenderCallback _render;
+    std::thread _thread;
+    std::atomic<bool> _threadStop = false;
+    // Held while rendering, so Stop() can wait for the callback to finish
+    std::mutex _m_render;
+    std::atomic<bool> _running = false;
+
+    std::vector<float> _buffer;
+
+public:
+    NullAudioSink(int channels = 2, int sampleRate = 48000, Duration period = Duration(10, MILLISECONDS));
+    ~NullAudioSink();
+    NullAudioSink(const NullAudioSink&) = delete;
+    NullAudioSink& operator=(const NullAudioSink&) = delete;
+
+    int Channels() const;
+    int SampleRate() const;
+
+    bool Open(RenderCallback render);
+    void Close();
+
+    void Start();
+    void Stop();
+    bool Running() const;
+
+protected:
+    // Called on the sink thread with every rendered block
+    virtual void _Consume(const float* samples, int sampleCount) {}
+
+private:
+    // Not virtual, unlike Close(), so derived sinks can call Open() from their own Open()
+    void _StopThread();
+    void _SinkThread();
+};
\ No newline at end of file
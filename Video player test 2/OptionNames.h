@@ -20,9 +20,17 @@
 #define OPTIONS_DEFAULT_PORT L"defaultPort"
 #define OPTIONS_LAST_PORT L"lastPort"
 #define OPTIONS_MAX_VIDEO_FRAMES L"maxVideoFrames"
-#define OPTIONS_MAX_AUDIO_FRAMES L"maxAudioFrames"
+// In decoded audio chunks; replaces "maxAudioFrames", which counted codec frames
+#define OPTIONS_MAX_AUDIO_CHUNKS L"maxAudioChunks"
 #define OPTIONS_MAX_SUBTITLE_FRAMES L"maxSubtitleFrames"
 #define OPTIONS_MAX_VIDEO_MEMORY L"maxVideoMemory"
 #define OPTIONS_MAX_AUDIO_MEMORY L"maxAudioMemory"
 #define OPTIONS_MAX_SUBTITLE_MEMORY L"maxSubtitleMemory"
+#define OPTIONS_VIDEO_DECODER_THREADS L"videoDecoderThreads"
+#define OPTIONS_AUDIO_DECODER_THREADS L"audioDecoderThreads"
+#define OPTIONS_DECODER_FRAME_THREADING L"decoderFrameThreading"
+#define OPTIONS_DECODER_SLICE_THREADING L"decoderSliceThreading"
+#define OPTIONS_FAST_SEEK_RECOVERY L"fastSeekRecovery"
+#define OPTIONS_AUDIO_OUTPUT L"audioOutput"
+#define OPTIONS_AUDIO_OUTPUT_WAV_FILE L"audioOutputWavFile"
 #define OPTIONS_KEYBINDS L"keybinds"
\ No newline at end of file
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace znet
+{
+    // Recycles packet memory, so receiving doesn't allocate a new buffer for every packet.
+    // Buffers are grouped by size into power of two classes; a buffer returns to the pool
+    // when the last packet referencing it is destroyed.
+    class PacketBufferPool
+    {
+    public:
+        // Zeroed bytes after the requested size of every buffer. Decoders may read past
+        // the end of their input (FFmpeg's AV_INPUT_BUFFER_PADDING_SIZE), this lets
+        // received media data be decoded in place.
+        static constexpr size_t PADDING = 64;
+
+    private:
+        static constexpr size_t _MIN_CLASS_SHIFT = 6; // 64 B
+        static constexpr size_t _MAX_CLASS_SHIFT = 24; // 16 MB
+        // Free memory kept per size class (at least one buffer)
+        static constexpr size_t _MAX_FREE_BYTES_PER_CLASS = 4 * 1024 * 1024;
+
+        struct _SizeClass
+        {
+            std::mutex m_buffers;
+            std::vector<int8_t*> freeBuffers;
+        };
+        std::array<_SizeClass, _MAX_CLASS_SHIFT - _MIN_CLASS_SHIFT + 1> _classes;
+
+        std::atomic<uint64_t> _hits{ 0 };
+        std::atomic<uint64_t> _misses{ 0 };
+
+        PacketBufferPool() {}
+
+    public:
+        // Created on first use and lives until the process exits, since buffers can outlive any owner
+        static PacketBufferPool* Instance()
+        {
+            static PacketBufferPool* instance = new PacketBufferPool();
+            return instance;
+        }
+        PacketBufferPool(const PacketBufferPool&) = delete;
+        PacketBufferPool& operator=(const PacketBufferPool&) = delete;
+
+        // The returned buffer can be larger than 'size', and is followed by PADDING zeroed bytes.
+        // Sizes above 16 MB are not pooled.
+        std::shared_ptr<int8_t[]> Acquire(size_t size)
+        {
+            size_t paddedSize = size + PADDING;
+            size_t shift = _MIN_CLASS_SHIFT;
+            while (shift <= _MAX_CLASS_SHIFT && ((size_t)1 << shift) < paddedSize)
+                shift++;
+            if (shift > _MAX_CLASS_SHIFT)
+            {
+                _misses.fetch_add(1);
+                int8_t* buffer = new int8_t[paddedSize];
+                std::fill_n(buffer + size, PADDING, (int8_t)0);
+                return std::shared_ptr<int8_t[]>(buffer);
+            }
+
+            _SizeClass& sizeClass = _classes[shift - _MIN_CLASS_SHIFT];
+            int8_t* buffer = nullptr;
+            sizeClass.m_buffers.lock();
+            if (!sizeClass.freeBuffers.empty())
+            {
+                buffer = sizeClass.freeBuffers.back();
+                sizeClass.freeBuffers.pop_back();
+            }
+            sizeClass.m_buffers.unlock();
+
+            if (buffer)
+            {
+                _hits.fetch_add(1);
+            }
+            else
+            {
+                // Not using make_unique, because zero-initializing is a waste
+                _misses.fetch_add(1);
+                buffer = new int8_t[(size_t)1 << shift];
+            }
+            std::fill_n(buffer + size, PADDING, (int8_t)0);
+            return std::shared_ptr<int8_t[]>(buffer, [this, shift](int8_t* buffer) { _Return(buffer, shift); });
+        }
+
+        // Number of buffers reused from the pool
+        uint64_t Hits() const
+        {
+            return _hits.load();
+        }
+
+        // Number of buffers that had to be allocated
+        uint64_t Misses() const
+        {
+            return _misses.load();
+        }
+
+    private:
+        void _Return(int8_t* buffer, size_t shift)
+        {
+            _SizeClass& sizeClass = _classes[shift - _MIN_CLASS_SHIFT];
+            size_t maxFreeBuffers = std::max(_MAX_FREE_BYTES_PER_CLASS >> shift, (size_t)1);
+
+            std::unique_lock<std::mutex> lock(sizeClass.m_buffers);
+            if (sizeClass.freeBuffers.size() < maxFreeBuffers)
+            {
+                sizeClass.freeBuffers.push_back(buffer);
+                return;
+            }
+            lock.unlock();
+            delete[] buffer;
+        }
+    };
+}
\ No newline at end of file
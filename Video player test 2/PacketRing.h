@@ -0,0 +1,167 @@
+#pragma once
+
+#include "MediaPacket.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+// Single producer/single consumer ring buffer of media packets.
+//
+// Slot layout (indices grow forever, wrapped with a mask):
+//   [tail, read) - history: packets already handed out, kept until trimmed
+//   [read, head) - unread packets
+//   [head, tail + capacity) - free slots owned by the producer
+//
+// The producer only writes 'head', the consumer only writes 'read' and 'tail',
+// so neither side needs a lock. The only exception is Clear(), which the
+// producer calls on seeks; it briefly excludes the consumer with a pair of flags
+// (consumer calls BeginRead()/EndRead() around every access).
+class PacketRing
+{
+    std::unique_ptr<MediaPacket[]> _slots;
+    size_t _capacity;
+    size_t _mask;
+
+    alignas(64) std::atomic<size_t> _head{ 0 };
+    alignas(64) std::atomic<size_t> _read{ 0 };
+    std::atomic<size_t> _tail{ 0 };
+    std::atomic<size_t> _memoryUsed{ 0 };
+
+    std::atomic<bool> _clearing{ false };
+    std::atomic<bool> _consumerActive{ false };
+
+public:
+    // Capacity is rounded up to a power of 2
+    PacketRing(size_t capacity = 32768)
+    {
+        _capacity = 1;
+        while (_capacity < capacity)
+            _capacity <<= 1;
+        _mask = _capacity - 1;
+        _slots = std::make_unique<MediaPacket[]>(_capacity);
+    }
+    PacketRing(const PacketRing&) = delete;
+    PacketRing& operator=(const PacketRing&) = delete;
+
+    size_t Capacity() const
+    {
+        return _capacity;
+    }
+
+    // Number of unread packets
+    size_t Size() const
+    {
+        size_t read = _read.load();
+        size_t head = _head.load();
+        return head > read ? head - read : 0;
+    }
+
+    // Total payload bytes of stored (unread and history) packets
+    size_t MemoryUsed() const
+    {
+        return _memoryUsed.load();
+    }
+
+    static size_t PacketBytes(const MediaPacket& packet)
+    {
+        if (!packet.flush && packet.Valid())
+            return packet.GetPacket()->size;
+        return 0;
+    }
+
+
+    // PRODUCER
+
+    bool Full() const
+    {
+        return _head.load(std::memory_order_relaxed) - _tail.load(std::memory_order_acquire) >= _capacity;
+    }
+
+    // Moves the packet into the ring. If the ring is full, returns false and leaves the packet untouched.
+    bool Push(MediaPacket& packet)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) >= _capacity)
+            return false;
+
+        _memoryUsed.fetch_add(PacketBytes(packet));
+        _slots[head & _mask] = std::move(packet);
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Removes all packets, including history
+    void Clear()
+    {
+        _clearing.store(true);
+        while (_consumerActive.load())
+            std::this_thread::yield();
+
+        size_t head = _head.load();
+        for (size_t i = _tail.load(); i != head; i++)
+            _slots[i & _mask].Reset();
+        _tail.store(head);
+        _read.store(head);
+        _memoryUsed.store(0);
+
+        _clearing.store(false);
+    }
+
+
+    // CONSUMER
+
+    // Returns false if the producer is clearing the ring. In that case the
+    // ring must not be accessed and EndRead() must not be called.
+    bool BeginRead()
+    {
+        _consumerActive.store(true);
+        if (_clearing.load())
+        {
+            _consumerActive.store(false);
+            return false;
+        }
+        return true;
+    }
+
+    void EndRead()
+    {
+        _consumerActive.store(false);
+    }
+
+    // Returns the next unread packet, or nullptr if there is none
+    MediaPacket* Peek()
+    {
+        size_t read = _read.load(std::memory_order_relaxed);
+        if (read == _head.load(std::memory_order_acquire))
+            return nullptr;
+        return &_slots[read & _mask];
+    }
+
+    // Moves the peeked packet to history
+    void Advance()
+    {
+        _read.store(_read.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    size_t HistorySize() const
+    {
+        return _read.load(std::memory_order_relaxed) - _tail.load(std::memory_order_relaxed);
+    }
+
+    // Slots used by history and unread packets
+    size_t UsedSlots() const
+    {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_relaxed);
+    }
+
+    // Destroys the oldest history packet
+    void TrimOldest()
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        MediaPacket& packet = _slots[tail & _mask];
+        _memoryUsed.fetch_sub(PacketBytes(packet));
+        packet.Reset();
+        _tail.store(tail + 1, std::memory_order_release);
+    }
+};
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+
 namespace znet
 {
     enum class PacketType
@@ -86,6 +88,14 @@ namespace znet
         // Sent then received by the client. Used to measure latency between client and server
         LATENCY_PROBE,
 
+        // Sent by the client with 't0' filled, returned by the server with all fields.
+        // Used to estimate the offset of the client clock from the server clock (see ClockSync)
+        // Contains:
+        //  int64_t - t0, client send time
+        //  int64_t - t1, server receive time
+        //  int64_t - t2, server send time
+        CLOCK_SYNC_PROBE,
+
         // // // // // // // // // // // // // // // // // // //
         // // // // // // // // // // // // // // // // // // //
         // PLAYBACK // // // // // // // // // // // // // // //
@@ -98,6 +108,7 @@ namespace znet
         // Sent by media host to all receivers after pausing, or after receiving the PAUSE_REQUEST packet
         // Contains:
         //  int64_t - pause issuer user id
+        //  int64_t - shared time (see Network::SharedTime) at which to pause, in 'TimePoint' ticks
         PAUSE,
 
         // See PAUSE_REQUEST
@@ -135,6 +146,8 @@ namespace znet
 
         // Sent by the host to everyone when it receives confirmation
         // from all receivers that they recovered
+        // Contains:
+        //  int64_t - shared time at which to resume, in 'TimePoint' ticks
         HOST_SEEK_FINISHED,
 
         // Video packet data
@@ -202,7 +215,10 @@ namespace znet
         // Sent by the receiver when its playback controller sets up its packet receivers
         CONTROLLER_READY,
 
-        // Sent to all receivers when hosts' controller is ready
+        // Sent to all receivers when hosts' controller is ready.
+        // Late joiners (see LATE_JOIN_REQUEST) get it in reply to CONTROLLER_READY, with:
+        //  int64_t - current playback position, in 'TimePoint' ticks
+        //  int8_t - '1': playback is paused
         HOST_CONTROLLER_READY,
 
         // Sent by the receiver after their media player loads
@@ -246,6 +262,7 @@ namespace znet
         // Current receiver playback position
         // Contains:
         //  int64_t - TimePoint ticks
+        //  int64_t - shared time at which the position was taken, in 'TimePoint' ticks
         PLAYBACK_POSITION,
 
         // Sent by the host to synchronize playback
@@ -315,10 +332,12 @@ namespace znet
         // Sent by the server to playback issuer when host denies playback
         PLAYBACK_START_DENIED,
 
-        // Sent by the server to all clients (except host) to begin playback
+        // Sent by the server to all clients (except host) to begin playback,
+        // and to clients which connect while playback is running
         // Contains:
         //  int64_t - mediaId
         //  int64_t - hostId
+        //  (optional) int8_t - '1': playback is already running, join late
         PLAYBACK_START,
 
         // Sent by the receiver when its data provider is ready to receive packets,
@@ -424,5 +443,47 @@ namespace znet
         //  int8_t - new value (0 - deny, 1 - allow)
         //  remaining bytes - string containing the name of the permission
         PERMISSION_CHANGED,
+
+        // // // // // // // // // // // // // // // // // // //
+        // // // // // // // // // // // // // // // // // // //
+        // ADDED // // // // // // // // // // // // // // // //
+        // // // // // // // // // // // // // // // // // // //
+        // // // // // // // // // // // // // // // // // // //
+
+        // Newer packet types go here, so the values of existing ones don't change
+
+        // Sent by the host to gradually correct small playback offsets
+        // Contains:
+        //  double - playback rate (1.0 - normal speed)
+        SYNC_RATE,
+
+        // Sent to the host by a receiver which joins after playback has started.
+        // The host replies with the stream metadata and streams, then sends
+        // packets starting from the keyframe before its playback position
+        LATE_JOIN_REQUEST,
     };
+
+    // Packets sent on the bulk channel (see Channel): media data, and markers which must stay
+    // ordered relative to it. Only these are limited by the congestion window and confirmed
+    // with BYTE_CONFIRMATION, so confirmations arrive in the order the packets were sent.
+    inline bool IsBulkPacket(int32_t id)
+    {
+        switch ((PacketType)id)
+        {
+        case PacketType::SPLIT_PACKET_PART:
+        case PacketType::SEEK_DISCONTINUITY:
+        case PacketType::VIDEO_PACKET:
+        case PacketType::AUDIO_PACKET:
+        case PacketType::SUBTITLE_PACKET:
+        case PacketType::VIDEO_STREAM:
+        case PacketType::AUDIO_STREAM:
+        case PacketType::SUBTITLE_STREAM:
+        case PacketType::ATTACHMENT_STREAM:
+        case PacketType::DATA_STREAM:
+        case PacketType::UNKNOWN_STREAM:
+            return true;
+        default:
+            return false;
+        }
+    }
 }
\ No newline at end of file
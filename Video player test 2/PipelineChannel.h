@@ -0,0 +1,137 @@
+#pragma once
+
+#include "WaitSignal.h"
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+
+struct PipelineChannelStats
+{
+    size_t depth = 0;
+    size_t capacity = 0;
+    size_t peakDepth = 0;
+    uint64_t pushed = 0;
+    uint64_t popped = 0;
+};
+
+// Bounded queue connecting two stages of the decoding pipeline.
+//
+// The capacity is a backpressure threshold: producers check Full() and wait
+// instead of pushing, but Push() itself never fails, because a single input
+// can produce more than one item (e.g. a subtitle packet producing a start
+// and an end frame).
+//
+// Every change of the channel state notifies 'stateChanged' (if provided),
+// which lets a stage sleep until either its input or its output changes.
+template<class T>
+class PipelineChannel
+{
+    std::deque<T> _items;
+    mutable std::mutex _m_items;
+    WaitSignal* _stateChanged;
+
+    std::atomic<size_t> _capacity;
+    std::atomic<size_t> _size{ 0 };
+    std::atomic<size_t> _peakSize{ 0 };
+    std::atomic<uint64_t> _pushed{ 0 };
+    std::atomic<uint64_t> _popped{ 0 };
+
+public:
+    PipelineChannel(size_t capacity, WaitSignal* stateChanged = nullptr)
+        : _stateChanged(stateChanged), _capacity(capacity)
+    {}
+    PipelineChannel(const PipelineChannel&) = delete;
+    PipelineChannel& operator=(const PipelineChannel&) = delete;
+
+    size_t Capacity() const
+    {
+        return _capacity.load();
+    }
+
+    void SetCapacity(size_t capacity)
+    {
+        if (_capacity.exchange(capacity) != capacity)
+            _Notify();
+    }
+
+    size_t Size() const
+    {
+        return _size.load();
+    }
+
+    bool Empty() const
+    {
+        return _size.load() == 0;
+    }
+
+    bool Full() const
+    {
+        return _size.load() >= _capacity.load();
+    }
+
+    void Push(T item)
+    {
+        std::unique_lock<std::mutex> lock(_m_items);
+        _items.push_back(std::move(item));
+        size_t size = _items.size();
+        _size.store(size);
+        lock.unlock();
+
+        _pushed.fetch_add(1);
+        size_t peak = _peakSize.load();
+        while (size > peak && !_peakSize.compare_exchange_weak(peak, size));
+        _Notify();
+    }
+
+    // Returns false if the channel is empty
+    bool TryPop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(_m_items);
+        if (_items.empty())
+            return false;
+        item = std::move(_items.front());
+        _items.pop_front();
+        _size.store(_items.size());
+        lock.unlock();
+
+        _popped.fetch_add(1);
+        _Notify();
+        return true;
+    }
+
+    void Clear()
+    {
+        // Destroy items outside the lock
+        std::deque<T> items;
+        std::unique_lock<std::mutex> lock(_m_items);
+        items.swap(_items);
+        _size.store(0);
+        lock.unlock();
+
+        _Notify();
+    }
+
+    PipelineChannelStats GetStats() const
+    {
+        PipelineChannelStats stats;
+        stats.depth = _size.load();
+        stats.capacity = _capacity.load();
+        stats.peakDepth = _peakSize.load();
+        stats.pushed = _pushed.load();
+        stats.popped = _popped.load();
+        return stats;
+    }
+
+    void ResetPeakDepth()
+    {
+        _peakSize.store(_size.load());
+    }
+
+private:
+    void _Notify()
+    {
+        if (_stateChanged)
+            _stateChanged->Notify();
+    }
+};
\ No newline at end of file
@@ -2,9 +2,13 @@
 #include "App.h"
 
 #include "XAudio2_AudioOutputAdapter.h"
+#include "AudioOutputEngine.h"
+#include "NullAudioSink.h"
+#include "WavFileAudioSink.h"
 #include "Options.h"
 #include "OptionNames.h"
 #include "FloatOptionAdapter.h"
+#include "Functions.h"
 
 Playback::Playback()
 {
@@ -50,9 +54,9 @@ void Playback::Update()
                 _subtitleAdapter = std::make_unique<SubtitleOutputAdapter>();
                 auto audioStream = _dataProvider->CurrentAudioStream();
                 if (audioStream)
-                    _audioAdapter = std::make_unique<XAudio2_AudioOutputAdapter>(audioStream->channels, audioStream->sampleRate);
+                    _audioAdapter = _CreateAudioAdapter(audioStream->channels, audioStream->sampleRate);
                 else
-                    _audioAdapter = std::make_unique<XAudio2_AudioOutputAdapter>();
+                    _audioAdapter = _CreateAudioAdapter(-1, -1);
 
                 // Create media player
                 _player = std::make_unique<MediaPlayer>(_dataProvider.get(), _videoAdapter.get(), _subtitleAdapter.get(), _audioAdapter.get());
@@ -124,6 +128,24 @@ SubtitleOutputAdapter* Playback::SubtitleAdapter() const
     return _subtitleAdapter.get();
 }
 
+std::unique_ptr<IAudioOutputAdapter> Playback::_CreateAudioAdapter(int channelCount, int sampleRate)
+{
+    // "null" and "wav" run without a sound card (headless testing)
+    std::wstring output = Options::Instance()->GetValue(OPTIONS_AUDIO_OUTPUT);
+    if (output == L"null")
+    {
+        return std::make_unique<AudioOutputEngine>(std::make_unique<NullAudioSink>(), channelCount, sampleRate);
+    }
+    else if (output == L"wav")
+    {
+        std::wstring path = Options::Instance()->GetValue(OPTIONS_AUDIO_OUTPUT_WAV_FILE);
+        if (path.empty())
+            path = L"audio_output.wav";
+        return std::make_unique<AudioOutputEngine>(std::make_unique<WavFileAudioSink>(wstring_to_string(path)), channelCount, sampleRate);
+    }
+    return std::make_unique<XAudio2_AudioOutputAdapter>(channelCount, sampleRate);
+}
+
 IAudioOutputAdapter* Playback::AudioAdapter() const
 {
     return _audioAdapter.get();
@@ -37,4 +37,7 @@ private:
     std::unique_ptr<VideoOutputAdapter> _videoAdapter = nullptr;
     std::unique_ptr<SubtitleOutputAdapter> _subtitleAdapter = nullptr;
     std::unique_ptr<IAudioOutputAdapter> _audioAdapter = nullptr;
+
+    // Picks the output from OPTIONS_AUDIO_OUTPUT
+    std::unique_ptr<IAudioOutputAdapter> _CreateAudioAdapter(int channelCount, int sampleRate);
 };
\ No newline at end of file
@@ -1,8 +1,34 @@
 #pragma once
 
+#include "GameTime.h"
+
 #include <cstdint>
+#include <string>
 
 struct InputSourcesChangedEvent
 {
     static const char* _NAME_() { return "input_sources_changed"; }
+};
+
+// Raised periodically by the video and audio decoders
+struct DecoderStatsEvent
+{
+    static const char* _NAME_() { return "decoder_stats"; }
+    std::string decoder;
+    Duration timeInterval;
+    int64_t framesDecoded;
+    int threadCount;
+    // "frame", "slice" or "none"
+    std::string threadType;
+};
+
+// Raised by the video decoder when it reaches the target time after a seek
+struct SeekRecoveryStatsEvent
+{
+    static const char* _NAME_() { return "seek_recovery_stats"; }
+    Duration recoveryTime;
+    // Frames which came out of the decoder during recovery
+    int64_t framesDecoded;
+    // Decoded frames before the target which were never output
+    int64_t framesDropped;
 };
\ No newline at end of file
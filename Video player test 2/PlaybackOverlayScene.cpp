@@ -34,6 +34,8 @@ void PlaybackOverlayScene::_Init(const SceneOptionsBase* options)
     // Init event receivers
     _playlistChangedReceiver = std::make_unique<EventReceiver<PlaylistChangedEvent>>(&App::Instance()->events);
     _networkStatsEventReceiver = std::make_unique<EventReceiver<NetworkStatsEvent>>(&App::Instance()->events);
+    _decoderStatsEventReceiver = std::make_unique<EventReceiver<DecoderStatsEvent>>(&App::Instance()->events);
+    _seekRecoveryStatsEventReceiver = std::make_unique<EventReceiver<SeekRecoveryStatsEvent>>(&App::Instance()->events);
     _permissionsChangedReceiver = std::make_unique<EventReceiver<UserPermissionChangedEvent>>(&App::Instance()->events);
 
     // Set up shortcut handler
@@ -619,6 +621,16 @@ void PlaybackOverlayScene::_Init(const SceneOptionsBase* options)
         App::Instance()->MoveSceneToFront(StartServerScene::StaticName());
     });
 
+    _decoderStatsLabel = Create<zcom::Label>(L"");
+    _decoderStatsLabel->SetBaseSize(500, 30);
+    _decoderStatsLabel->SetOffsetPixels(-30, 0);
+    _decoderStatsLabel->SetHorizontalAlignment(zcom::Alignment::END);
+    _decoderStatsLabel->SetVerticalTextAlignment(zcom::Alignment::CENTER);
+    _decoderStatsLabel->SetHorizontalTextAlignment(zcom::TextAlignment::TRAILING);
+    _decoderStatsLabel->SetFontSize(11.0f);
+    _decoderStatsLabel->SetFontStyle(DWRITE_FONT_STYLE_ITALIC);
+    _decoderStatsLabel->SetFontColor(D2D1::ColorF(0.6f, 0.6f, 0.6f));
+
     // NESTING
 
     _sideMenuPanel->AddItem(_addFileButton.get());
@@ -651,6 +663,7 @@ void PlaybackOverlayScene::_Init(const SceneOptionsBase* options)
     _infoPanel->AddItem(_offlineLabel.get());
     _infoPanel->AddItem(_connectButton.get());
     _infoPanel->AddItem(_startServerButton.get());
+    _infoPanel->AddItem(_decoderStatsLabel.get());
 
     _nonControllerPanel->AddItem(_sideMenuPanel.get());
     _nonControllerPanel->AddItem(_playlistPanel.get());
@@ -735,6 +748,7 @@ void PlaybackOverlayScene::_Uninit()
     _offlineLabel = nullptr;
     _connectButton = nullptr;
     _startServerButton = nullptr;
+    _decoderStatsLabel = nullptr;
 
     _playbackController = nullptr;
 
@@ -851,6 +865,7 @@ void PlaybackOverlayScene::_Update()
     _InvokePlaylistChange();
     _InvokeNetworkPanelChange();
     _UpdateNetworkStats();
+    _UpdateDecoderStats();
     _HandlePermissionChange();
 
     // Files
@@ -2342,6 +2357,51 @@ void PlaybackOverlayScene::_UpdateNetworkStats()
     }
 }
 
+void PlaybackOverlayScene::_UpdateDecoderStats()
+{
+    if (_decoderStatsEventReceiver->EventCount() == 0 && _seekRecoveryStatsEventReceiver->EventCount() == 0)
+        return;
+
+    while (_decoderStatsEventReceiver->EventCount() > 0)
+    {
+        auto ev = _decoderStatsEventReceiver->GetEvent();
+
+        // "video: 59.9 fps, 16 threads (frame)"
+        std::wostringstream ss;
+        ss.setf(std::ios::fixed);
+        ss.precision(1);
+        ss << string_to_wstring(ev.decoder) << L": ";
+        ss << ev.framesDecoded * 1000.0 / ev.timeInterval.GetDuration(MILLISECONDS) << L" fps, ";
+        ss << ev.threadCount << (ev.threadCount == 1 ? L" thread" : L" threads");
+        ss << L" (" << string_to_wstring(ev.threadType) << L")";
+
+        if (ev.decoder == "video")
+            _videoDecoderStats = ss.str();
+        else
+            _audioDecoderStats = ss.str();
+    }
+
+    while (_seekRecoveryStatsEventReceiver->EventCount() > 0)
+    {
+        auto ev = _seekRecoveryStatsEventReceiver->GetEvent();
+
+        // "seek: 420 ms, 24 decoded, 23 dropped"
+        std::wostringstream ss;
+        ss << L"seek: " << ev.recoveryTime.GetDuration(MILLISECONDS) << L" ms, ";
+        ss << ev.framesDecoded << L" decoded, " << ev.framesDropped << L" dropped";
+        _seekRecoveryStats = ss.str();
+    }
+
+    std::wstring text = _videoDecoderStats;
+    if (!text.empty() && !_audioDecoderStats.empty())
+        text += L"    ";
+    text += _audioDecoderStats;
+    if (!text.empty() && !_seekRecoveryStats.empty())
+        text += L"    ";
+    text += _seekRecoveryStats;
+    _decoderStatsLabel->SetText(text);
+}
+
 bool PlaybackOverlayScene::_Online()
 {
     auto clientMgr = APP_NETWORK->GetManager<znet::ClientManager>();
@@ -90,6 +90,7 @@ class PlaybackOverlayScene : public Scene
     std::unique_ptr<zcom::Label> _offlineLabel = nullptr;
     std::unique_ptr<zcom::Button> _connectButton = nullptr;
     std::unique_ptr<zcom::Button> _startServerButton = nullptr;
+    std::unique_ptr<zcom::Label> _decoderStatsLabel = nullptr;
     bool _connectPanelOpen = false;
     bool _startServerPanelOpen = false;
 
@@ -248,6 +249,13 @@ private:
     std::unique_ptr<EventReceiver<NetworkStatsEvent>> _networkStatsEventReceiver = nullptr;
     void _UpdateNetworkStats();
 
+    std::unique_ptr<EventReceiver<DecoderStatsEvent>> _decoderStatsEventReceiver = nullptr;
+    std::wstring _videoDecoderStats;
+    std::wstring _audioDecoderStats;
+    std::unique_ptr<EventReceiver<SeekRecoveryStatsEvent>> _seekRecoveryStatsEventReceiver = nullptr;
+    std::wstring _seekRecoveryStats;
+    void _UpdateDecoderStats();
+
     bool _Online();
 
     // Permissions change handling
@@ -490,6 +490,7 @@ void PlaylistEventHandler_Client::_CheckForStart()
         PacketReader reader = PacketReader(packet.Bytes(), packet.size);
         int64_t mediaId = reader.Get<int64_t>();
         int64_t hostId = reader.Get<int64_t>();
+        bool lateJoin = reader.RemainingBytes() >= sizeof(int8_t) && reader.Get<int8_t>() == 1;
 
         // Find item
         int itemIndex = -1;
@@ -505,7 +506,7 @@ void PlaylistEventHandler_Client::_CheckForStart()
         if (itemIndex != -1)
         {
             App::Instance()->playback.Stop();
-            auto dataProvider = std::make_unique<MediaReceiverDataProvider>(hostId);
+            auto dataProvider = std::make_unique<MediaReceiverDataProvider>(hostId, lateJoin);
             auto controller = std::make_unique<ReceiverPlaybackController>(dataProvider.get(), hostId);
             App::Instance()->playback.Start(std::move(dataProvider), std::move(controller));
             App::Instance()->ReinitScene(PlaybackScene::StaticName(), nullptr);
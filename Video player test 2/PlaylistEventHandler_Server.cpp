@@ -130,6 +130,23 @@ void PlaylistEventHandler_Server::_CheckForPlaylistRequest()
             // Send packet back to request issuer
             APP_NETWORK->Send(znet::Packet(builder.Release(), builder.UsedBytes(), (int)znet::PacketType::PLAYLIST_ITEM_ADD), { userId });
         }
+
+        // Let the issuer join an already running playback
+        if (_playlist->currentlyPlaying != -1)
+        {
+            for (auto& item : _playlist->readyItems)
+            {
+                if (item->GetItemId() != _playlist->currentlyPlaying)
+                    continue;
+                if (item->GetUserId() == userId || item->GetUserId() == MISSING_HOST_ID)
+                    break;
+
+                PacketBuilder builder = PacketBuilder(17);
+                builder.Add(item->GetMediaId()).Add(item->GetUserId()).Add(int8_t(1));
+                APP_NETWORK->Send(znet::Packet(builder.Release(), builder.UsedBytes(), (int)znet::PacketType::PLAYBACK_START), { userId });
+                break;
+            }
+        }
     }
 }
 
@@ -0,0 +1,54 @@
+#pragma once
+
+// Maps the Winsock names used by the network code to their POSIX equivalents,
+// so the same code compiles on both platforms
+
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+
+typedef int SOCKET;
+typedef unsigned long u_long;
+typedef uint16_t WORD;
+
+#define SOCKET_ERROR (-1)
+#define INVALID_SOCKET (-1)
+#define WSAEWOULDBLOCK EWOULDBLOCK
+#define MAKEWORD(low, high) ((WORD)(((uint8_t)(low)) | ((WORD)((uint8_t)(high))) << 8))
+
+struct WSADATA {};
+
+inline int WSAStartup(WORD, WSADATA*)
+{
+    return 0;
+}
+
+inline int WSACleanup()
+{
+    return 0;
+}
+
+inline int WSAGetLastError()
+{
+    // EAGAIN and EWOULDBLOCK may differ, the code only checks for the latter
+    return errno == EAGAIN ? EWOULDBLOCK : errno;
+}
+
+inline int closesocket(SOCKET socket)
+{
+    return close(socket);
+}
+
+inline int ioctlsocket(SOCKET socket, long command, u_long* argument)
+{
+    int value = (int)*argument;
+    return ioctl(socket, command, &value);
+}
\ No newline at end of file
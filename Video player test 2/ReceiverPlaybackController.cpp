@@ -2,6 +2,7 @@
 
 #include "App.h"
 #include "OverlayScene.h"
+#include "PacketBuilder.h"
 
 ReceiverPlaybackController::ReceiverPlaybackController(IMediaDataProvider* dataProvider, int64_t hostId)
     : BasePlaybackController(dataProvider)
@@ -14,6 +15,9 @@ ReceiverPlaybackController::ReceiverPlaybackController(IMediaDataProvider* dataP
     _initiateSeekReceiver = std::make_unique<znet::PacketReceiver>(znet::PacketType::INITIATE_SEEK);
     _hostSeekFinishedReceiver = std::make_unique<znet::PacketReceiver>(znet::PacketType::HOST_SEEK_FINISHED);
     _syncPauseReceiver = std::make_unique<znet::PacketReceiver>(znet::PacketType::SYNC_PAUSE);
+    _syncRateReceiver = std::make_unique<znet::PacketReceiver>(znet::PacketType::SYNC_RATE);
+
+    APP_NETWORK->Send(znet::Packet((int)znet::PacketType::CONTROLLER_READY), { _hostId }, 1);
 }
 
 void ReceiverPlaybackController::Update()
@@ -25,11 +29,16 @@ void ReceiverPlaybackController::Update()
     _CheckForInitiateSeek();
     _CheckForHostSeekFinished();
     _CheckForSyncPause();
+    _CheckForSyncRate();
+
+    _RunScheduledActions();
 
     // Send current playback position
     if ((ztime::Main() - _lastPositionNotification).GetDuration(SECONDS) >= 1)
     {
-        APP_NETWORK->Send(znet::Packet((int)znet::PacketType::PLAYBACK_POSITION).From(_player->TimerPosition().GetTicks()), { _hostId }, 3);
+        PacketBuilder builder = PacketBuilder(2 * sizeof(int64_t));
+        builder.Add(_player->TimerPosition().GetTicks()).Add(_SharedTime().GetTicks());
+        APP_NETWORK->Send(znet::Packet(builder.Release(), builder.UsedBytes(), (int)znet::PacketType::PLAYBACK_POSITION), { _hostId }, 3);
         _lastPositionNotification = ztime::Main();
     }
 
@@ -91,6 +100,20 @@ void ReceiverPlaybackController::_CheckForHostControllerReady()
         auto packetPair = _hostControllerReadyReceiver->GetPacket();
         _hostReady = true;
         std::cout << "Host ready!\n";
+
+        // Sent to late joiners, with the playback position and state to start at
+        if (packetPair.first.size >= sizeof(int64_t) + sizeof(int8_t))
+        {
+            PacketReader reader(packetPair.first.Bytes(), packetPair.first.size);
+            TimePoint position = reader.Get<int64_t>();
+            bool paused = reader.Get<int8_t>() == 1;
+            _player->SetTimerPosition(position);
+            _player->SetTargetSeekTime(position);
+            if (paused)
+                _Pause();
+            else
+                _Play();
+        }
     }
 }
 
@@ -102,10 +125,13 @@ void ReceiverPlaybackController::_CheckForPlay()
     while (_playReceiver->PacketCount() > 0)
     {
         auto packetPair = _playReceiver->GetPacket();
-        _Play();
+        PacketReader reader(packetPair.first.Bytes(), packetPair.first.size);
+        int64_t userId = reader.Get<int64_t>();
+        TimePoint playTime = reader.RemainingBytes() >= sizeof(int64_t) ? TimePoint(reader.Get<int64_t>()) : _SharedTime();
+        _paused = false;
+        _ScheduleAt(playTime, "playpause", [&]() { _Play(); });
 
         // Show notification
-        int64_t userId = packetPair.first.Cast<int64_t>();
         if (userId != APP_NETWORK->ThisUser().id)
         {
             zcom::NotificationInfo ninfo;
@@ -125,10 +151,13 @@ void ReceiverPlaybackController::_CheckForPause()
     while (_pauseReceiver->PacketCount() > 0)
     {
         auto packetPair = _pauseReceiver->GetPacket();
-        _Pause();
+        PacketReader reader(packetPair.first.Bytes(), packetPair.first.size);
+        int64_t userId = reader.Get<int64_t>();
+        TimePoint pauseTime = reader.RemainingBytes() >= sizeof(int64_t) ? TimePoint(reader.Get<int64_t>()) : _SharedTime();
+        _paused = true;
+        _ScheduleAt(pauseTime, "playpause", [&]() { _Pause(); });
 
         // Show notification
-        int64_t userId = packetPair.first.Cast<int64_t>();
         if (userId != APP_NETWORK->ThisUser().id)
         {
             zcom::NotificationInfo ninfo;
@@ -162,6 +191,7 @@ void ReceiverPlaybackController::_CheckForInitiateSeek()
         _timerController.RemoveStop("finished");
         _timerController.RemoveStop("waitseek");
         _timerController.RemoveStop("waitresume");
+        _CancelScheduled("seekresume");
         _loading = true;
         _finished = false;
         _waitingForSeek = false;
@@ -249,10 +279,14 @@ void ReceiverPlaybackController::_CheckForHostSeekFinished()
     while (_hostSeekFinishedReceiver->PacketCount() > 0)
     {
         auto packetPair = _hostSeekFinishedReceiver->GetPacket();
+        TimePoint resumeTime = packetPair.first.size >= sizeof(int64_t) ? TimePoint(packetPair.first.Cast<int64_t>()) : _SharedTime();
 
-        std::cout << "Playback resumed" << std::endl;
-        _timerController.RemoveStop("waitresume");
-        _waitingForResume = false;
+        _ScheduleAt(resumeTime, "seekresume", [&]()
+        {
+            std::cout << "Playback resumed" << std::endl;
+            _timerController.RemoveStop("waitresume");
+            _waitingForResume = false;
+        });
     }
 }
 
@@ -269,6 +303,22 @@ void ReceiverPlaybackController::_CheckForSyncPause()
     }
 }
 
+void ReceiverPlaybackController::_CheckForSyncRate()
+{
+    if (!_syncRateReceiver)
+        return;
+
+    while (_syncRateReceiver->PacketCount() > 0)
+    {
+        auto packetPair = _syncRateReceiver->GetPacket();
+
+        double rate = packetPair.first.Cast<double>();
+        if (rate < 0.9) rate = 0.9;
+        if (rate > 1.1) rate = 1.1;
+        _player->SetPlaybackRate(rate);
+    }
+}
+
 void ReceiverPlaybackController::Play()
 {
     if (!_hostReady)
@@ -16,6 +16,7 @@ protected:
     std::unique_ptr<znet::PacketReceiver> _initiateSeekReceiver;
     std::unique_ptr<znet::PacketReceiver> _hostSeekFinishedReceiver;
     std::unique_ptr<znet::PacketReceiver> _syncPauseReceiver;
+    std::unique_ptr<znet::PacketReceiver> _syncRateReceiver;
 
     TimePoint _lastPositionNotification = 0;
 
@@ -34,6 +35,7 @@ private: // Packet handlers
     void _CheckForInitiateSeek();
     void _CheckForHostSeekFinished();
     void _CheckForSyncPause();
+    void _CheckForSyncRate();
 
 public:
     void Play();
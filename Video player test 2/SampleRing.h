@@ -0,0 +1,130 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+// Single producer/single consumer ring of trivially copyable values
+// (audio samples, clock markers).
+//
+// Positions grow forever and are wrapped with a mask, so they double as
+// running counters (e.g. total samples written/consumed). The producer only
+// writes 'head', the consumer only writes 'tail'. Clear() is the exception
+// and may only be called while neither side is active.
+template<class T>
+class SampleRing
+{
+    std::unique_ptr<T[]> _data;
+    size_t _capacity;
+    size_t _mask;
+
+    alignas(64) std::atomic<size_t> _head{ 0 };
+    alignas(64) std::atomic<size_t> _tail{ 0 };
+
+public:
+    // Capacity is rounded up to a power of 2
+    SampleRing(size_t capacity)
+    {
+        _capacity = 1;
+        while (_capacity < capacity)
+            _capacity <<= 1;
+        _mask = _capacity - 1;
+        _data = std::make_unique<T[]>(_capacity);
+    }
+    SampleRing(const SampleRing&) = delete;
+    SampleRing& operator=(const SampleRing&) = delete;
+
+    size_t Capacity() const
+    {
+        return _capacity;
+    }
+
+    // Number of unread values
+    size_t Size() const
+    {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+    // Total values written
+    size_t WritePosition() const
+    {
+        return _head.load(std::memory_order_acquire);
+    }
+
+    // Total values read (or skipped)
+    size_t ReadPosition() const
+    {
+        return _tail.load(std::memory_order_acquire);
+    }
+
+    // Removes all values. Neither side may be active.
+    void Clear()
+    {
+        _tail.store(_head.load());
+    }
+
+
+    // PRODUCER
+
+    size_t Free() const
+    {
+        return _capacity - (_head.load(std::memory_order_relaxed) - _tail.load(std::memory_order_acquire));
+    }
+
+    // Writes as many values as fit, returns the number written
+    size_t Write(const T* values, size_t count)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+        count = std::min(count, Free());
+        size_t first = std::min(count, _capacity - (head & _mask));
+        std::copy_n(values, first, _data.get() + (head & _mask));
+        std::copy_n(values + first, count - first, _data.get());
+        _head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    // Writes 'count' copies of 'value' (e.g. silence), as many as fit
+    size_t Fill(const T& value, size_t count)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+        count = std::min(count, Free());
+        size_t first = std::min(count, _capacity - (head & _mask));
+        std::fill_n(_data.get() + (head & _mask), first, value);
+        std::fill_n(_data.get(), count - first, value);
+        _head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+
+    // CONSUMER
+
+    // Reads up to 'count' values, returns the number read
+    size_t Read(T* dest, size_t count)
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        count = std::min(count, _head.load(std::memory_order_acquire) - tail);
+        size_t first = std::min(count, _capacity - (tail & _mask));
+        std::copy_n(_data.get() + (tail & _mask), first, dest);
+        std::copy_n(_data.get(), count - first, dest + first);
+        _tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // Returns the next unread value, or nullptr if there is none
+    const T* Peek() const
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire))
+            return nullptr;
+        return &_data[tail & _mask];
+    }
+
+    // Drops up to 'count' values, returns the number dropped
+    size_t Skip(size_t count)
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        count = std::min(count, _head.load(std::memory_order_acquire) - tail);
+        _tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+};
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include "NetworkEvents.h"
 #include "PacketBuilder.h"
 
+#include <algorithm>
+
 znet::ServerManager::ServerManager(uint16_t port, std::string password)
     : _password(password)
 {
@@ -148,6 +150,9 @@ void znet::ServerManager::Send(Packet&& packet, std::vector<int64_t> userIds, in
 
 void znet::ServerManager::_AddPacketsToOutQueue(std::vector<_PacketData> packets, int priority)
 {
+    _outPacketsAdded = true;
+    _cv_outPackets.notify_one();
+
     if (priority != 0)
     {
         for (int i = 0; i < _outPackets.size(); i++)
@@ -171,6 +176,9 @@ void znet::ServerManager::_AddPacketsToOutQueue(std::vector<_PacketData> packets
 
 void znet::ServerManager::_AddPacketToOutQueue(_PacketData packet, int priority)
 {
+    _outPacketsAdded = true;
+    _cv_outPackets.notify_one();
+
     if (priority != 0)
     {
         for (int i = 0; i < _outPackets.size(); i++)
@@ -212,6 +220,8 @@ void znet::ServerManager::SendQueue(std::vector<int64_t> userIds, int priority)
         _packetQueue.clear();
         return;
     }
+    _outPacketsAdded = true;
+    _cv_outPackets.notify_one();
 
     // Send packets
     if (priority != 0)
@@ -316,17 +326,19 @@ void znet::ServerManager::_ManageConnections()
             for (int i = 0; i < _users.size(); i++)
             {
                 auto connection = _server.Connection(_users[i].id);
-                connection->Send(znet::Packet((int)znet::PacketType::KEEP_ALIVE).From(int8_t(0)), std::numeric_limits<int>::max());
+                connection->Send(znet::Packet((int)znet::PacketType::KEEP_ALIVE).From(int8_t(0)), std::numeric_limits<int>::max(), Channel::CONTROL);
             }
         }
 
         _ProcessNewConnections(data);
         _ProcessDisconnects(data);
         _ProcessIncomingPackets(data);
-        _ProcessOutgoingPackets(data);
+        bool packetsSent = _ProcessOutgoingPackets(data);
         _PrintNetworkStats(data);
 
         // Sleep if no immediate work needs to be done
+        if (packetsSent)
+            continue;
         bool packetsIncoming = false;
         for (int i = 0; i < _users.size(); i++)
         {
@@ -339,9 +351,13 @@ void znet::ServerManager::_ManageConnections()
                 break;
             }
         }
-        if (!packetsIncoming && _outPackets.empty())
+        if (!packetsIncoming)
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            // Queued packets which are waiting for confirmations are retried after incoming packets,
+            // new packets wake the thread immediately
+            std::unique_lock<std::mutex> lock(_m_outPackets);
+            _cv_outPackets.wait_for(lock, std::chrono::milliseconds(10), [&]() { return _outPacketsAdded; });
+            _outPacketsAdded = false;
         }
     }
 }
@@ -357,12 +373,12 @@ void znet::ServerManager::_AddNewUser(_ManagerThreadData& data, int64_t newUser)
     for (int i = 0; i < _users.size(); i++)
     {
         TCPClientRef connection = _server.Connection(_users[i].id);
-        connection->Send(Packet((int)PacketType::NEW_USER).From(newUser), 2);
+        connection->Send(Packet((int)PacketType::NEW_USER).From(newUser), 2, Channel::CONTROL);
     }
 
     TCPClientRef connection = _server.Connection(newUser);
     // Send the assigned id to the new user (maximum priority since this packet needs to go first)
-    connection->Send(Packet((int)PacketType::ASSIGNED_USER_ID).From(newUser), std::numeric_limits<int>::max());
+    connection->Send(Packet((int)PacketType::ASSIGNED_USER_ID).From(newUser), std::numeric_limits<int>::max(), Channel::CONTROL);
     // Send existing user ids to new user
     {
         size_t byteCount = sizeof(int64_t) * (_users.size() + 1);
@@ -372,7 +388,7 @@ void znet::ServerManager::_AddNewUser(_ManagerThreadData& data, int64_t newUser)
         {
             ((int64_t*)userIdsBytes.get())[i + 1] = _users[i].id;
         }
-        connection->Send(Packet(std::move(userIdsBytes), byteCount, (int)PacketType::USER_LIST), 2);
+        connection->Send(Packet(std::move(userIdsBytes), byteCount, (int)PacketType::USER_LIST), 2, Channel::CONTROL);
     }
 
     _users.push_back({ newUser });
@@ -388,7 +404,7 @@ void znet::ServerManager::_ProcessNewConnections(_ManagerThreadData& data)
         // Deny connection if server is full
         if (_maxUserCount != -1 && _users.size() >= _maxUserCount)
         {
-            connection->Send(Packet((int)PacketType::ASSIGNED_USER_ID).From(int64_t(-3)), std::numeric_limits<int>::max());
+            connection->Send(Packet((int)PacketType::ASSIGNED_USER_ID).From(int64_t(-3)), std::numeric_limits<int>::max(), Channel::CONTROL);
             continue;
         }
 
@@ -425,7 +441,7 @@ void znet::ServerManager::_ProcessDisconnects(_ManagerThreadData& data)
         for (int i = 0; i < _users.size(); i++)
         {
             TCPClientRef connection = _server.Connection(_users[i].id);
-            connection->Send(Packet((int)PacketType::DISCONNECTED_USER).From(disconnectedUser), 2);
+            connection->Send(Packet((int)PacketType::DISCONNECTED_USER).From(disconnectedUser), 2, Channel::CONTROL);
         }
     }
 }
@@ -448,7 +464,7 @@ void znet::ServerManager::_ProcessIncomingPackets(_ManagerThreadData& data)
         // If the first packet is not the password, disconnect
         if (pack.id != (int32_t)PacketType::PASSWORD)
         {
-            client->Send(Packet((int)PacketType::ASSIGNED_USER_ID).From(int64_t(-1)), std::numeric_limits<int>::max());
+            client->Send(Packet((int)PacketType::ASSIGNED_USER_ID).From(int64_t(-1)), std::numeric_limits<int>::max(), Channel::CONTROL);
             //client->Disconnect();
             _pendingUsers.erase(_pendingUsers.begin() + i);
             continue;
@@ -461,7 +477,7 @@ void znet::ServerManager::_ProcessIncomingPackets(_ManagerThreadData& data)
 
         if (password != _password)
         {
-            client->Send(Packet((int)PacketType::ASSIGNED_USER_ID).From(int64_t(-2)), std::numeric_limits<int>::max());
+            client->Send(Packet((int)PacketType::ASSIGNED_USER_ID).From(int64_t(-2)), std::numeric_limits<int>::max(), Channel::CONTROL);
             // TODO: Close connection (TCPClient needs to send all packets before closing socket, which is not implemented yet)
             //client->Disconnect();
             _pendingUsers.erase(_pendingUsers.begin() + i);
@@ -488,7 +504,7 @@ void znet::ServerManager::_ProcessIncomingPackets(_ManagerThreadData& data)
         // BYTE CONFIRMATION
         if (pack1.id == (int32_t)PacketType::BYTE_CONFIRMATION)
         {
-            _usersData[i].bytesUnconfirmed -= pack1.Cast<size_t>();
+            _usersData[i].congestion.OnConfirmed(pack1.Cast<size_t>(), ClockSync::LocalTime());
             // Increment connection speed counter
             data.bytesSentSinceLastPrint += pack1.Cast<size_t>();
         }
@@ -496,7 +512,18 @@ void znet::ServerManager::_ProcessIncomingPackets(_ManagerThreadData& data)
         else if (pack1.id == (int32_t)PacketType::LATENCY_PROBE)
         {
             // Send packet back
-            client->Send(znet::Packet((int)znet::PacketType::LATENCY_PROBE).From(0), 1024 /* Arbitrarily large priority */);
+            client->Send(znet::Packet((int)znet::PacketType::LATENCY_PROBE).From(0), 1024 /* Arbitrarily large priority */, Channel::CONTROL);
+        }
+        // CLOCK SYNC PROBE
+        else if (pack1.id == (int32_t)PacketType::CLOCK_SYNC_PROBE)
+        {
+            // Shared time is the server clock, see ClockSync
+            TimePoint receiveTime = ClockSync::LocalTime();
+            PacketBuilder builder = PacketBuilder(3 * sizeof(int64_t));
+            builder.Add(pack1.Cast<int64_t>());
+            builder.Add(receiveTime.GetTicks());
+            builder.Add(ClockSync::LocalTime().GetTicks());
+            client->Send(znet::Packet(builder.Release(), builder.UsedBytes(), (int)znet::PacketType::CLOCK_SYNC_PROBE), 1024 /* Arbitrarily large priority */, Channel::CONTROL);
         }
         // DISCONNECT REQUEST
         else if (pack1.id == (int32_t)PacketType::DISCONNECT_REQUEST)
@@ -518,9 +545,12 @@ void znet::ServerManager::_ProcessIncomingPackets(_ManagerThreadData& data)
             data.bytesReceivedSinceLastPrint += pack2.size;
 
             // Send confirmation packet
-            Packet confirmation = Packet((int32_t)PacketType::BYTE_CONFIRMATION);
-            confirmation.From(pack2.size);
-            client->Send(std::move(confirmation), 1);
+            if (IsBulkPacket(pack2.id))
+            {
+                Packet confirmation = Packet((int32_t)PacketType::BYTE_CONFIRMATION);
+                confirmation.From(pack2.size);
+                client->Send(std::move(confirmation), 1, Channel::CONTROL);
+            }
 
             // Create destination vector
             if (pack1.size % sizeof(int64_t) != 0)
@@ -555,110 +585,102 @@ void znet::ServerManager::_ProcessIncomingPackets(_ManagerThreadData& data)
     }
 }
 
-void znet::ServerManager::_ProcessOutgoingPackets(_ManagerThreadData& data)
+bool znet::ServerManager::_ProcessOutgoingPackets(_ManagerThreadData& data)
 {
     std::unique_lock<std::mutex> lock(_m_outPackets);
-    // Loop through packets until 1 is sent
-    for (int i = 0; i < _outPackets.size(); i++)
+    if (_outPackets.empty())
+        return false;
+
+    // Destinations are looked up once per pass
+    struct Destination
     {
-        // Erase packet if no destination is specified
-        if (_outPackets[i].first.userIds.empty())
-        {
-            _outPackets.erase(_outPackets.begin() + i);
-            i--;
-            continue;
-        }
+        int userIndex;
+        TCPClientRef connection;
+    };
+    std::unordered_map<int64_t, int> userIndices;
+    for (int i = 0; i < _users.size(); i++)
+        userIndices[_users[i].id] = i;
+    std::unordered_map<int64_t, Destination> destinations;
+    auto findDestination = [&](int64_t userId) -> Destination*
+    {
+        auto it = destinations.find(userId);
+        if (it == destinations.end())
+        {
+            auto userIt = userIndices.find(userId);
+            if (userIt == userIndices.end())
+                return nullptr;
+            it = destinations.insert({ userId, { userIt->second, _server.Connection(userId) } }).first;
+        }
+        if (!it->second.connection.Valid())
+            return nullptr;
+        return &it->second;
+    };
+
+    // Hand over every packet each destination can take. Once a destination's window is full,
+    // its unconfirmed byte count only grows during the pass, so all of its later bulk packets
+    // stay queued as well and their order is kept.
+    TimePoint now = ClockSync::LocalTime();
+    bool sent = false;
+    for (auto& [packetData, priority] : _outPackets)
+    {
+        PacketView view = packetData.packet.View();
 
-        PacketView view = _outPackets[i].first.packet.View();
-
-        // 'Heavy' packets will be postponed until unconfirmed byte count is below a certain value
-        bool heavyPacket = (
-            view.id == (int32_t)PacketType::SPLIT_PACKET_PART ||
-            view.id == (int32_t)PacketType::VIDEO_PACKET ||
-            view.id == (int32_t)PacketType::AUDIO_PACKET ||
-            view.id == (int32_t)PacketType::SUBTITLE_PACKET ||
-            view.id == (int32_t)PacketType::VIDEO_STREAM ||
-            view.id == (int32_t)PacketType::AUDIO_STREAM ||
-            view.id == (int32_t)PacketType::SUBTITLE_STREAM ||
-            view.id == (int32_t)PacketType::ATTACHMENT_STREAM ||
-            view.id == (int32_t)PacketType::DATA_STREAM ||
-            view.id == (int32_t)PacketType::UNKNOWN_STREAM
+        // Bulk packets will be postponed until the congestion window allows them
+        bool bulkPacket = IsBulkPacket(view.id);
+
+        // Some packet types don't need a prefix
+        bool prefixed = !(
+            view.id == (int32_t)PacketType::USER_DATA
             );
 
-        bool sent = false;
+        // The prefix only depends on the source, so it is built once and shared by all destinations
+        Packet prefix;
+        if (prefixed)
+        {
+            PacketBuilder builder = PacketBuilder(sizeof(int64_t));
+            if (packetData.redirected)
+                builder.Add(packetData.sourceUserId);
+            else
+                builder.Add(int64_t(0));
+            prefix = Packet(builder.Release(), builder.UsedBytes(), (int)PacketType::USER_ID);
+        }
 
         // Go through every destination user id and attempt to send
-        for (int j = 0; j < _outPackets[i].first.userIds.size(); j++)
+        auto& userIds = packetData.userIds;
+        for (int j = 0; j < userIds.size(); j++)
         {
-            // Find user with matching id
-            int userIndex = -1;
-            for (int k = 0; k < _users.size(); k++)
-            {
-                if (_users[k].id == _outPackets[i].first.userIds[j])
-                {
-                    userIndex = k;
-                    break;
-                }
-            }
-            // Remove the invalid destination user id
-            if (userIndex == -1)
-            {
-                _outPackets[i].first.userIds.erase(_outPackets[i].first.userIds.begin() + j);
-                j--;
-                continue;
-            }
-
-            // Get connection object
-            TCPClientRef connection = _server.Connection(_users[userIndex].id);
-            if (!connection.Valid())
+            Destination* destination = findDestination(userIds[j]);
+            // Remove the invalid or unusable destination user id
+            if (!destination)
             {
-                // Remove unusable destination user id
-                _outPackets[i].first.userIds.erase(_outPackets[i].first.userIds.begin() + j);
+                userIds.erase(userIds.begin() + j);
                 j--;
                 continue;
             }
 
-            // Postpone sending heavy packets if unconfirmed byte count exceeds max value
-            if (heavyPacket && _usersData[userIndex].bytesUnconfirmed > data.maxUnconfirmedBytes)
+            // Postpone sending bulk packets if the congestion window is full
+            if (bulkPacket && !_usersData[destination->userIndex].congestion.CanSend(now))
                 continue;
 
-            // Some packet types don't need a prefix
-            bool prefixed = !(
-                view.id == (int32_t)PacketType::USER_DATA
-                );
-
             // Reference and send the packet to the destination user
             if (prefixed)
-            {
-                PacketBuilder builder = PacketBuilder(sizeof(int64_t));
-                if (_outPackets[i].first.redirected)
-                    builder.Add(_outPackets[i].first.sourceUserId);
-                else
-                    builder.Add(int64_t(0));
-                connection->AddToQueue(Packet(builder.Release(), builder.UsedBytes(), (int)PacketType::USER_ID));
-            }
-            connection->AddToQueue(_outPackets[i].first.packet.Reference());
-            connection->SendQueue(_outPackets[i].second);
+                destination->connection->AddToQueue(prefix.Reference());
+            destination->connection->AddToQueue(packetData.packet.Reference());
+            destination->connection->SendQueue(priority, bulkPacket ? Channel::BULK : Channel::CONTROL);
 
-            _usersData[userIndex].bytesUnconfirmed += _outPackets[i].first.packet.size;
+            if (bulkPacket)
+                _usersData[destination->userIndex].congestion.OnSent(view.size, now);
             sent = true;
 
             // Remove destination from list
-            _outPackets[i].first.userIds.erase(_outPackets[i].first.userIds.begin() + j);
+            userIds.erase(userIds.begin() + j);
             j--;
         }
-
-        // If all destinations have been sent to, remove packet from queue
-        if (_outPackets[i].first.userIds.empty())
-        {
-            _outPackets.erase(_outPackets.begin() + i);
-            i--;
-        }
-
-        // Send packets one at a time
-        if (sent) break;
     }
-    lock.unlock();
+
+    // Remove packets which have been sent to all destinations
+    _outPackets.erase(std::remove_if(_outPackets.begin(), _outPackets.end(), [](const std::pair<_PacketData, int>& entry) { return entry.first.userIds.empty(); }), _outPackets.end());
+    return sent;
 }
 
 void znet::ServerManager::_PrintNetworkStats(_ManagerThreadData& data)
@@ -666,7 +688,18 @@ void znet::ServerManager::_PrintNetworkStats(_ManagerThreadData& data)
     Duration timeElapsed = ztime::Main() - data.lastPrintTime;
     if (timeElapsed >= data.printInterval)
     {
-        App::Instance()->events.RaiseEvent(NetworkStatsEvent{ timeElapsed, (int64_t)data.bytesSentSinceLastPrint, (int64_t)data.bytesReceivedSinceLastPrint, -1 });
+        int64_t window = -1;
+        int64_t roundTrip = -1;
+        int64_t bandwidth = -1;
+        for (auto& userData : _usersData)
+        {
+            window = std::max(window, (int64_t)0) + userData.congestion.Window();
+            bandwidth = std::max(bandwidth, (int64_t)0) + userData.congestion.Bandwidth();
+            if (userData.congestion.RoundTrip().GetTicks() >= 0)
+                roundTrip = std::max(roundTrip, userData.congestion.RoundTrip().GetDuration(MICROSECONDS));
+        }
+
+        App::Instance()->events.RaiseEvent(NetworkStatsEvent{ timeElapsed, (int64_t)data.bytesSentSinceLastPrint, (int64_t)data.bytesReceivedSinceLastPrint, -1, window, roundTrip, bandwidth });
 
         data.lastPrintTime = ztime::Main();
         data.bytesSentSinceLastPrint = 0;
@@ -686,56 +719,46 @@ bool znet::ServerManager::_ProcessSplitPackets(_ManagerThreadData& data, Packet&
             size_t packetSize;
         };
         auto headData = pack.Cast<SplitHead>();
-        _usersData[userIndex].splitPackets.push_back({ headData.splitId, headData.packetId, headData.partCount, headData.packetSize });
+        _SplitPacket& split = _usersData[userIndex].splitPackets[headData.splitId];
+        split.packetId = headData.packetId;
+        split.partCount = headData.partCount;
+        split.packetSize = headData.packetSize;
+        split.bytes = PacketBufferPool::Instance()->Acquire(headData.packetSize);
     }
     else if (pack.id == (int)PacketType::SPLIT_PACKET_PART)
     {
         int64_t splitId = pack.Cast<int64_t>();
-        int index = -1;
-        for (int i = 0; i < _usersData[userIndex].splitPackets.size(); i++)
+        auto it = _usersData[userIndex].splitPackets.find(splitId);
+        if (it == _usersData[userIndex].splitPackets.end())
+            return true;
+
+        // Copy the part into place
+        _SplitPacket& split = it->second;
+        size_t partDataOffset = sizeof(int64_t) + sizeof(int32_t);
+        size_t byteCount = pack.size - partDataOffset;
+        if (pack.size < partDataOffset || split.bytesReceived + byteCount > split.packetSize)
         {
-            if (_usersData[userIndex].splitPackets[i].splitId == splitId)
-            {
-                _usersData[userIndex].splitPackets[i].parts.push_back(pack.Reference());
-                index = i;
-                break;
-            }
+            _usersData[userIndex].splitPackets.erase(it);
+            return true;
         }
+        std::copy_n(pack.Bytes() + partDataOffset, byteCount, split.bytes.get() + split.bytesReceived);
+        split.bytesReceived += byteCount;
+        split.partsReceived++;
 
         // Check if all parts received
-        if (index != -1)
+        if (split.partsReceived == split.partCount)
         {
-            if (_usersData[userIndex].splitPackets[index].parts.size() == _usersData[userIndex].splitPackets[index].partCount)
-            {
-                // Combine
-                auto bytes = std::make_unique<int8_t[]>(_usersData[userIndex].splitPackets[index].packetSize);
-                size_t bytePos = 0;
-                size_t partDataOffset = sizeof(int64_t) + sizeof(int32_t);
-                for (auto& part : _usersData[userIndex].splitPackets[index].parts)
-                {
-                    size_t byteCount = part.size - partDataOffset;
-                    std::copy_n(part.Bytes() + partDataOffset, byteCount, bytes.get() + bytePos);
-                    bytePos += byteCount;
-                }
-                Packet combined = Packet(std::move(bytes), _usersData[userIndex].splitPackets[index].packetSize, _usersData[userIndex].splitPackets[index].packetId);
-                _usersData[userIndex].splitPackets.erase(_usersData[userIndex].splitPackets.begin() + index);
+            Packet combined = Packet(std::move(split.bytes), split.bytesReceived, split.packetId);
+            _usersData[userIndex].splitPackets.erase(it);
 
-                // Pass to handler
-                _packetReceivedHandler(std::move(combined), _users[userIndex].id);
-            }
+            // Pass to handler
+            _packetReceivedHandler(std::move(combined), _users[userIndex].id);
         }
     }
     else if (pack.id == (int)PacketType::SPLIT_PACKET_ABORT)
     {
         int64_t splitId = pack.Cast<int64_t>();
-        for (int i = 0; i < _usersData[userIndex].splitPackets.size(); i++)
-        {
-            if (_usersData[userIndex].splitPackets[i].splitId == splitId)
-            {
-                _usersData[userIndex].splitPackets.erase(_usersData[userIndex].splitPackets.begin() + i);
-                break;
-            }
-        }
+        _usersData[userIndex].splitPackets.erase(splitId);
     }
     else
     {
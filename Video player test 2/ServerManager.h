@@ -2,10 +2,14 @@
 
 #include "INetworkManager.h"
 #include "PacketTypes.h"
+#include "CongestionController.h"
 
 #include "FixedQueue.h"
 #include "GameTime.h"
 
+#include <condition_variable>
+#include <unordered_map>
+
 namespace znet
 {
     class ServerManager : public INetworkManager
@@ -47,19 +51,21 @@ namespace znet
             int64_t sourceUserId = -1;
         };
 
+        // Parts are copied into 'bytes' as they arrive
         struct _SplitPacket
         {
-            int64_t splitId;
             int32_t packetId;
             int32_t partCount;
+            int32_t partsReceived = 0;
             size_t packetSize;
-            std::vector<Packet> parts;
+            size_t bytesReceived = 0;
+            std::shared_ptr<int8_t[]> bytes;
         };
 
         struct _UserData
         {
-            int64_t bytesUnconfirmed = 0;
-            std::vector<_SplitPacket> splitPackets;
+            CongestionController congestion;
+            std::unordered_map<int64_t, _SplitPacket> splitPackets; // key - split id
         };
 
         bool _startFailed = false;
@@ -82,13 +88,14 @@ namespace znet
         bool _MANAGEMENT_THR_STOP = false;
         std::deque<std::pair<_PacketData, int>> _outPackets;
         std::mutex _m_outPackets;
+        // Wakes the idle management thread when packets are added to '_outPackets'
+        std::condition_variable _cv_outPackets;
+        bool _outPacketsAdded = false;
         std::deque<_PacketData> _packetQueue;
         int64_t _splitIdCounter = 0;
 
         struct _ManagerThreadData
         {
-            size_t maxUnconfirmedBytes = 250000; // 1 MB
-
             size_t bytesSentSinceLastPrint = 0;
             size_t bytesReceivedSinceLastPrint = 0;
             TimePoint lastPrintTime = ztime::Main();
@@ -110,7 +117,8 @@ namespace znet
         void _ProcessNewConnections(_ManagerThreadData& data);
         void _ProcessDisconnects(_ManagerThreadData& data);
         void _ProcessIncomingPackets(_ManagerThreadData& data);
-        void _ProcessOutgoingPackets(_ManagerThreadData& data);
+        // Returns true if any packet was handed to a connection
+        bool _ProcessOutgoingPackets(_ManagerThreadData& data);
         void _PrintNetworkStats(_ManagerThreadData& data);
         bool _ProcessSplitPackets(_ManagerThreadData& data, Packet& packet, int userIndex);
     };
@@ -586,21 +586,21 @@ void SettingsScene::_ShowAdvancedSettingsTab()
         mainPanel->AddItem(panel.release(), true);
     }
 
-    { // Max buffered audio frames
-        std::wstring optStr = _LoadSavedOption(OPTIONS_MAX_AUDIO_FRAMES);
-        int value = IntOptionAdapter(optStr, 100).Value();
+    { // Max buffered audio chunks
+        std::wstring optStr = _LoadSavedOption(OPTIONS_MAX_AUDIO_CHUNKS);
+        int value = IntOptionAdapter(optStr, 30).Value();
 
         auto panel = Create<zcom::Panel>();
         panel->SetBaseHeight(30);
         panel->SetParentWidthPercent(1.0f);
 
-        auto label = Create<zcom::Label>(L"Audio frame buffer size:");
+        auto label = Create<zcom::Label>(L"Audio chunk buffer size:");
         label->SetBaseSize(INPUT_OFFSET - 30, 30);
         label->SetHorizontalOffsetPixels(15);
         label->SetFontSize(16.0f);
         label->SetVerticalTextAlignment(zcom::Alignment::CENTER);
         label->SetHorizontalTextAlignment(zcom::TextAlignment::LEADING);
-        label->SetHoverText(L"Maximum number of decoded audio frames that can be buffered.\n"
+        label->SetHoverText(L"Maximum number of decoded 80ms audio chunks that can be buffered.\n"
             "Very small values could cause stability issues.\n"
             "Changing this value could be useful in very specific scenarios.");
 
@@ -614,10 +614,10 @@ void SettingsScene::_ShowAdvancedSettingsTab()
         input->SetMaxValue(NumberInputValue(10000));
         input->AddOnValueChanged([&](NumberInputValue newValue)
         {
-            _changedSettings[OPTIONS_MAX_AUDIO_FRAMES] = IntOptionAdapter(newValue.getAsInteger()).ToOptionString();
+            _changedSettings[OPTIONS_MAX_AUDIO_CHUNKS] = IntOptionAdapter(newValue.getAsInteger()).ToOptionString();
         });
 
-        auto frameLabel = Create<zcom::Label>(L"frames");
+        auto frameLabel = Create<zcom::Label>(L"chunks");
         frameLabel->SetBaseSize(80, 30);
         frameLabel->SetHorizontalOffsetPixels(INPUT_OFFSET + INPUT_WIDTH + 10);
         frameLabel->SetFontSize(16.0f);
@@ -814,6 +814,199 @@ void SettingsScene::_ShowAdvancedSettingsTab()
         mainPanel->AddItem(panel.release(), true);
     }
 
+    { // Visual gap
+        auto panel = Create<zcom::EmptyPanel>();
+        panel->SetBaseHeight(15);
+        panel->SetParentWidthPercent(1.0f);
+        mainPanel->AddItem(panel.release(), true);
+    }
+
+    { // Video decoder threads
+        std::wstring optStr = _LoadSavedOption(OPTIONS_VIDEO_DECODER_THREADS);
+        int value = IntOptionAdapter(optStr, 0).Value();
+
+        auto panel = Create<zcom::Panel>();
+        panel->SetBaseHeight(30);
+        panel->SetParentWidthPercent(1.0f);
+
+        auto label = Create<zcom::Label>(L"Video decoder threads:");
+        label->SetBaseSize(INPUT_OFFSET - 30, 30);
+        label->SetHorizontalOffsetPixels(15);
+        label->SetFontSize(16.0f);
+        label->SetVerticalTextAlignment(zcom::Alignment::CENTER);
+        label->SetHorizontalTextAlignment(zcom::TextAlignment::LEADING);
+        label->SetHoverText(L"Number of threads used by the video decoder. 0 picks one thread per CPU core.\n"
+            "Takes effect when the next video stream is opened.");
+
+        auto input = Create<zcom::NumberInput>();
+        input->SetBaseSize(60, 28);
+        input->SetHorizontalOffsetPixels(INPUT_OFFSET);
+        input->SetVerticalAlignment(zcom::Alignment::CENTER);
+        input->SetCornerRounding(5.0f);
+        input->SetValue(NumberInputValue(value));
+        input->SetMinValue(NumberInputValue(0));
+        input->SetMaxValue(NumberInputValue(64));
+        input->AddOnValueChanged([&](NumberInputValue newValue)
+        {
+            _changedSettings[OPTIONS_VIDEO_DECODER_THREADS] = IntOptionAdapter(newValue.getAsInteger()).ToOptionString();
+        });
+
+        auto threadLabel = Create<zcom::Label>(L"threads");
+        threadLabel->SetBaseSize(80, 30);
+        threadLabel->SetHorizontalOffsetPixels(INPUT_OFFSET + INPUT_WIDTH + 10);
+        threadLabel->SetFontSize(16.0f);
+        threadLabel->SetVerticalTextAlignment(zcom::Alignment::CENTER);
+        threadLabel->SetHorizontalTextAlignment(zcom::TextAlignment::LEADING);
+
+        panel->AddItem(label.release(), true);
+        panel->AddItem(input.release(), true);
+        panel->AddItem(threadLabel.release(), true);
+        mainPanel->AddItem(panel.release(), true);
+    }
+
+    { // Audio decoder threads
+        std::wstring optStr = _LoadSavedOption(OPTIONS_AUDIO_DECODER_THREADS);
+        int value = IntOptionAdapter(optStr, 1).Value();
+
+        auto panel = Create<zcom::Panel>();
+        panel->SetBaseHeight(30);
+        panel->SetParentWidthPercent(1.0f);
+
+        auto label = Create<zcom::Label>(L"Audio decoder threads:");
+        label->SetBaseSize(INPUT_OFFSET - 30, 30);
+        label->SetHorizontalOffsetPixels(15);
+        label->SetFontSize(16.0f);
+        label->SetVerticalTextAlignment(zcom::Alignment::CENTER);
+        label->SetHorizontalTextAlignment(zcom::TextAlignment::LEADING);
+        label->SetHoverText(L"Number of threads used by the audio decoder. 0 picks one thread per CPU core.\n"
+            "Audio decoding is rarely demanding, so 1 thread is usually enough.\n"
+            "Takes effect when the next audio stream is opened.");
+
+        auto input = Create<zcom::NumberInput>();
+        input->SetBaseSize(60, 28);
+        input->SetHorizontalOffsetPixels(INPUT_OFFSET);
+        input->SetVerticalAlignment(zcom::Alignment::CENTER);
+        input->SetCornerRounding(5.0f);
+        input->SetValue(NumberInputValue(value));
+        input->SetMinValue(NumberInputValue(0));
+        input->SetMaxValue(NumberInputValue(64));
+        input->AddOnValueChanged([&](NumberInputValue newValue)
+        {
+            _changedSettings[OPTIONS_AUDIO_DECODER_THREADS] = IntOptionAdapter(newValue.getAsInteger()).ToOptionString();
+        });
+
+        auto threadLabel = Create<zcom::Label>(L"threads");
+        threadLabel->SetBaseSize(80, 30);
+        threadLabel->SetHorizontalOffsetPixels(INPUT_OFFSET + INPUT_WIDTH + 10);
+        threadLabel->SetFontSize(16.0f);
+        threadLabel->SetVerticalTextAlignment(zcom::Alignment::CENTER);
+        threadLabel->SetHorizontalTextAlignment(zcom::TextAlignment::LEADING);
+
+        panel->AddItem(label.release(), true);
+        panel->AddItem(input.release(), true);
+        panel->AddItem(threadLabel.release(), true);
+        mainPanel->AddItem(panel.release(), true);
+    }
+
+    { // Decoder frame threading
+        std::wstring optStr = _LoadSavedOption(OPTIONS_DECODER_FRAME_THREADING);
+        bool value = BoolOptionAdapter(optStr, true).Value();
+
+        auto panel = Create<zcom::Panel>();
+        panel->SetBaseHeight(30);
+        panel->SetParentWidthPercent(1.0f);
+
+        auto label = Create<zcom::Label>(L"Decoder frame threading");
+        label->SetBaseSize(300, 30);
+        label->SetHorizontalOffsetPixels(45);
+        label->SetFontSize(16.0f);
+        label->SetVerticalTextAlignment(zcom::Alignment::CENTER);
+        label->SetHorizontalTextAlignment(zcom::TextAlignment::LEADING);
+        label->SetHoverText(L"Allow decoders to decode multiple frames in parallel.\n"
+            "Gives the best speedup, but adds a frame of delay per thread.\n"
+            "Takes effect when the next stream is opened.");
+
+        auto checkbox = Create<zcom::Checkbox>();
+        checkbox->SetBaseSize(20, 20);
+        checkbox->SetHorizontalOffsetPixels(15);
+        checkbox->SetVerticalAlignment(zcom::Alignment::CENTER);
+        checkbox->Checked(value);
+        checkbox->AddOnStateChanged([&](bool newState)
+        {
+            _changedSettings[OPTIONS_DECODER_FRAME_THREADING] = newState ? L"true" : L"false";
+        });
+
+        panel->AddItem(label.release(), true);
+        panel->AddItem(checkbox.release(), true);
+        mainPanel->AddItem(panel.release(), true);
+    }
+
+    { // Decoder slice threading
+        std::wstring optStr = _LoadSavedOption(OPTIONS_DECODER_SLICE_THREADING);
+        bool value = BoolOptionAdapter(optStr, true).Value();
+
+        auto panel = Create<zcom::Panel>();
+        panel->SetBaseHeight(30);
+        panel->SetParentWidthPercent(1.0f);
+
+        auto label = Create<zcom::Label>(L"Decoder slice threading");
+        label->SetBaseSize(300, 30);
+        label->SetHorizontalOffsetPixels(45);
+        label->SetFontSize(16.0f);
+        label->SetVerticalTextAlignment(zcom::Alignment::CENTER);
+        label->SetHorizontalTextAlignment(zcom::TextAlignment::LEADING);
+        label->SetHoverText(L"Allow decoders to split a single frame into parts decoded in parallel.\n"
+            "Only helps if the media was encoded with multiple slices.\n"
+            "Takes effect when the next stream is opened.");
+
+        auto checkbox = Create<zcom::Checkbox>();
+        checkbox->SetBaseSize(20, 20);
+        checkbox->SetHorizontalOffsetPixels(15);
+        checkbox->SetVerticalAlignment(zcom::Alignment::CENTER);
+        checkbox->Checked(value);
+        checkbox->AddOnStateChanged([&](bool newState)
+        {
+            _changedSettings[OPTIONS_DECODER_SLICE_THREADING] = newState ? L"true" : L"false";
+        });
+
+        panel->AddItem(label.release(), true);
+        panel->AddItem(checkbox.release(), true);
+        mainPanel->AddItem(panel.release(), true);
+    }
+
+    { // Fast seek recovery
+        std::wstring optStr = _LoadSavedOption(OPTIONS_FAST_SEEK_RECOVERY);
+        bool value = BoolOptionAdapter(optStr, true).Value();
+
+        auto panel = Create<zcom::Panel>();
+        panel->SetBaseHeight(30);
+        panel->SetParentWidthPercent(1.0f);
+
+        auto label = Create<zcom::Label>(L"Fast seek recovery");
+        label->SetBaseSize(300, 30);
+        label->SetHorizontalOffsetPixels(45);
+        label->SetFontSize(16.0f);
+        label->SetVerticalTextAlignment(zcom::Alignment::CENTER);
+        label->SetHorizontalTextAlignment(zcom::TextAlignment::LEADING);
+        label->SetHoverText(L"After seeking, skip decoding frames which are not needed\n"
+            "to reach the seek position. Greatly speeds up seeking in files\n"
+            "with long distances between keyframes.");
+
+        auto checkbox = Create<zcom::Checkbox>();
+        checkbox->SetBaseSize(20, 20);
+        checkbox->SetHorizontalOffsetPixels(15);
+        checkbox->SetVerticalAlignment(zcom::Alignment::CENTER);
+        checkbox->Checked(value);
+        checkbox->AddOnStateChanged([&](bool newState)
+        {
+            _changedSettings[OPTIONS_FAST_SEEK_RECOVERY] = newState ? L"true" : L"false";
+        });
+
+        panel->AddItem(label.release(), true);
+        panel->AddItem(checkbox.release(), true);
+        mainPanel->AddItem(panel.release(), true);
+    }
+
     _settingsPanel->AddItem(mainPanel.release(), true);
 }
 
@@ -59,9 +59,7 @@ SubtitleDecoder::SubtitleDecoder(const MediaStream& stream)
 
 SubtitleDecoder::~SubtitleDecoder()
 {
-    _decoderThreadStop = true;
-    if (_decoderThread.joinable())
-        _decoderThread.join();
+    _StopDecoding();
     if (_renderingThread.joinable())
         _renderingThread.join();
     avcodec_close(_codecContext);
@@ -117,16 +115,12 @@ void SubtitleDecoder::_DecoderThread()
         }
 
         // If finished, wait for seek command/new packets
-        _m_packets.lock(); // Prevent packet flushing on seek
-        if (_packets.empty())
+        MediaPacket packet;
+        if (!_packets.TryPop(packet))
         {
-            _m_packets.unlock();
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            _WaitForWork();
             continue;
         }
-        MediaPacket packet = std::move(_packets.front());
-        _packets.pop();
-        _m_packets.unlock();
 
         //// Cut UTF-8 characters, because the decoder really doesnt like them for some reason
         //for (int i = 0; i < packet.GetPacket()->size; i++)
@@ -185,8 +179,7 @@ void SubtitleDecoder::_DecoderThread()
 
             avsubtitle_free(&sub);
 
-            std::lock_guard<std::mutex> lock(_m_frames);
-            _frames.push((IMediaFrame*)subFrame);
+            _PushFrame((IMediaFrame*)subFrame);
         }
         else if (_subType == SubtitleType::ASS)
         {
@@ -198,6 +191,9 @@ void SubtitleDecoder::_DecoderThread()
             if (_lastRenderedFrameTime == -1)
                 _lastRenderedFrameTime = TimePoint(timestamp, MICROSECONDS) - _timeBetweenFrames;
             _lastBufferedSubtitleTime = TimePoint(timestamp + duration, MICROSECONDS);
+
+            // Wake the rendering thread
+            _stageSignal.Notify();
         }
         else
         {
@@ -209,9 +205,8 @@ void SubtitleDecoder::_DecoderThread()
             // Create empty frame at the end of display time
             SubtitleFrame_Text* subFrameEnd = new SubtitleFrame_Text(TimePoint(timestamp + duration, MICROSECONDS), L"");
 
-            std::lock_guard<std::mutex> lock(_m_frames);
-            _frames.push((IMediaFrame*)subFrame);
-            _frames.push((IMediaFrame*)subFrameEnd);
+            _PushFrame((IMediaFrame*)subFrame);
+            _PushFrame((IMediaFrame*)subFrameEnd);
         }
 
         //for (int i = 0; i < sub.num_rects; i++)
@@ -282,13 +277,14 @@ void SubtitleDecoder::_RenderingThread()
 {
     while (!_decoderThreadStop)
     {
+        uint64_t sequence = _stageSignal.Sequence();
         if (
-            _frames.size() >= _MAX_FRAME_QUEUE_SIZE ||
+            _frames.Full() ||
             _lastRenderedFrameTime.GetTicks() == -1 ||
             _lastRenderedFrameTime > _lastBufferedSubtitleTime ||
             !_renderer
             ) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            _stageSignal.WaitFor(sequence, Duration(100, MILLISECONDS));
             continue;
         }
 
@@ -311,8 +307,7 @@ void SubtitleDecoder::_RenderingThread()
             if (!img)
             {
                 SubtitleFrame_Image* emptyFrame = new SubtitleFrame_Image(_lastRenderedFrameTime);
-                std::lock_guard<std::mutex> lock2(_m_frames);
-                _frames.push((IMediaFrame*)emptyFrame);
+                _PushFrame((IMediaFrame*)emptyFrame);
             }
             else
             {
@@ -345,8 +340,7 @@ void SubtitleDecoder::_RenderingThread()
                 SubtitleFrame_Image* frame = new SubtitleFrame_Image(_lastRenderedFrameTime);
                 frame->AddRect(finalRect, std::move(data));
 
-                std::lock_guard<std::mutex> lock2(_m_frames);
-                _frames.push((IMediaFrame*)frame);
+                _PushFrame((IMediaFrame*)frame);
             }
         }
 
@@ -433,10 +427,10 @@ void SubtitleDecoder::_LoadOptions()
 
     // Frame buffer size
     optStr = Options::Instance()->GetValue(OPTIONS_MAX_SUBTITLE_FRAMES);
-    _MAX_FRAME_QUEUE_SIZE = IntOptionAdapter(optStr, 10).Value();
+    _frames.SetCapacity(IntOptionAdapter(optStr, 10).Value());
 
     // Packet buffer size
-    _MAX_PACKET_QUEUE_SIZE = 30;
+    _packets.SetCapacity(30);
 }
 
 void SubtitleDecoder::_ResetRenderer()
@@ -458,4 +452,7 @@ void SubtitleDecoder::_ResetRenderer()
         ass_set_frame_size(_renderer, _track->PlayResX, _track->PlayResY);
     }
     ass_set_fonts(_renderer, NULL, "sans-serif", ASS_FONTPROVIDER_AUTODETECT, NULL, 1);
+
+    // Wake the rendering thread
+    _stageSignal.Notify();
 }
\ No newline at end of file
@@ -0,0 +1,210 @@
+// Checks that the SSE2 and AVX2 sample converters match the scalar one bit for bit,
+// then measures them on one second of 96 kHz audio with 2, 6 and 8 channels.
+// Usage: AudioSampleConverterTest [--no-bench]
+
+#include "../AudioSampleConverter.h"
+#include "../CpuFeatures.h"
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavutil/samplefmt.h>
+}
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace
+{
+    constexpr float GUARD = 7.0f;
+    constexpr int GUARD_SAMPLES = 16;
+
+    // Sample data with random contents, laid out like decoder output
+    struct TestFrame
+    {
+        std::vector<std::vector<uint8_t>> buffers;
+        std::vector<uint8_t*> planes;
+        AVFrame frame = {};
+
+        TestFrame(AVSampleFormat format, int channels, int sampleCount, std::mt19937& rng)
+        {
+            bool planar = av_sample_fmt_is_planar(format);
+            int bytesPerSample = av_get_bytes_per_sample(format);
+            int bufferCount = planar ? channels : 1;
+            size_t samplesPerBuffer = planar ? sampleCount : (size_t)sampleCount * channels;
+
+            for (int i = 0; i < bufferCount; i++)
+            {
+                // One spare byte, so empty frames still have a valid pointer
+                buffers.emplace_back(samplesPerBuffer * bytesPerSample + 1);
+                _Fill(buffers.back().data(), format, samplesPerBuffer, rng);
+                planes.push_back(buffers.back().data());
+            }
+
+            frame.format = format;
+            frame.channels = channels;
+            frame.nb_samples = sampleCount;
+            frame.extended_data = planes.data();
+            for (int i = 0; i < bufferCount && i < AV_NUM_DATA_POINTERS; i++)
+                frame.data[i] = planes[i];
+        }
+
+    private:
+        // Float samples include out of range values, exact limits and non-finite values
+        static void _Fill(uint8_t* dest, AVSampleFormat format, size_t count, std::mt19937& rng)
+        {
+            std::uniform_real_distribution<double> range(-1.5, 1.5);
+            for (size_t i = 0; i < count; i++)
+            {
+                switch (av_get_packed_sample_fmt(format))
+                {
+                case AV_SAMPLE_FMT_U8: dest[i] = (uint8_t)rng(); break;
+                case AV_SAMPLE_FMT_S16: ((int16_t*)dest)[i] = (int16_t)rng(); break;
+                case AV_SAMPLE_FMT_S32: ((int32_t*)dest)[i] = (int32_t)rng(); break;
+                case AV_SAMPLE_FMT_FLT: ((float*)dest)[i] = (float)_SpecialOr(range(rng), rng); break;
+                case AV_SAMPLE_FMT_DBL: ((double*)dest)[i] = _SpecialOr(range(rng), rng); break;
+                default: break;
+                }
+            }
+        }
+
+        static double _SpecialOr(double value, std::mt19937& rng)
+        {
+            switch (rng() % 50)
+            {
+            case 0: return std::numeric_limits<double>::quiet_NaN();
+            case 1: return std::numeric_limits<double>::infinity();
+            case 2: return -std::numeric_limits<double>::infinity();
+            case 3: return 1.0;
+            case 4: return -1.0;
+            default: return value;
+            }
+        }
+    };
+
+    std::vector<AudioSampleConverter::Kernel> AvailableKernels()
+    {
+        std::vector<AudioSampleConverter::Kernel> kernels{ AudioSampleConverter::Kernel::SCALAR, AudioSampleConverter::Kernel::SSE2 };
+        if (CpuFeatures::AVX2())
+            kernels.push_back(AudioSampleConverter::Kernel::AVX2);
+        return kernels;
+    }
+
+    // Planes are 'planeStride' samples apart, the space in between must stay untouched
+    std::vector<float> Convert(const AVFrame& frame, AudioSampleConverter::Kernel kernel, int planeStride)
+    {
+        std::vector<float> output((size_t)planeStride * frame.channels + GUARD_SAMPLES, GUARD);
+        AudioSampleConverter::Convert(&frame, output.data(), planeStride, kernel);
+        return output;
+    }
+
+    bool TestBitExact()
+    {
+        const AVSampleFormat formats[] = {
+            AV_SAMPLE_FMT_U8, AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_S32, AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_DBL,
+            AV_SAMPLE_FMT_U8P, AV_SAMPLE_FMT_S16P, AV_SAMPLE_FMT_S32P, AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_DBLP
+        };
+        std::mt19937 rng(1);
+        auto kernels = AvailableKernels();
+        int tests = 0;
+        int failures = 0;
+
+        for (AVSampleFormat format : formats)
+        for (int channels = 1; channels <= 12; channels++)
+        for (int sampleCount : { 0, 1, 7, 8, 9, 15, 16, 17, 255, 256, 257, 1024, 1537 })
+        {
+            TestFrame frame(format, channels, sampleCount, rng);
+            for (int planeStride : { sampleCount, sampleCount + 5 })
+            {
+                std::vector<float> reference = Convert(frame.frame, AudioSampleConverter::Kernel::SCALAR, planeStride);
+
+                // Scalar results follow the documented scaling
+                if (format == AV_SAMPLE_FMT_S16)
+                {
+                    const int16_t* src = (const int16_t*)frame.planes[0];
+                    for (int i = 0; i < sampleCount * channels; i++)
+                    {
+                        if (reference[(size_t)(i % channels) * planeStride + i / channels] != src[i] / 32768.0f)
+                        {
+                            std::printf("FAIL: scalar S16 sample %d, %d channels\n", i, channels);
+                            failures++;
+                            break;
+                        }
+                    }
+                }
+
+                for (auto kernel : kernels)
+                {
+                    tests++;
+                    std::vector<float> output = Convert(frame.frame, kernel, planeStride);
+                    // Compared as bytes, so NaN payloads and signed zeros count too
+                    if (std::memcmp(output.data(), reference.data(), output.size() * sizeof(float)) != 0)
+                    {
+                        std::printf("FAIL: %s (%s, %d channels, %d samples, stride %d)\n",
+                            AudioSampleConverter::KernelName(kernel), av_get_sample_fmt_name(format), channels, sampleCount, planeStride);
+                        failures++;
+                    }
+                    for (int ch = 0; ch < channels; ch++)
+                    {
+                        for (int i = sampleCount; i < planeStride; i++)
+                        {
+                            if (output[(size_t)ch * planeStride + i] != GUARD)
+                            {
+                                std::printf("FAIL: %s wrote between planes (%s, %d channels, %d samples)\n",
+                                    AudioSampleConverter::KernelName(kernel), av_get_sample_fmt_name(format), channels, sampleCount);
+                                failures++;
+                                ch = channels;
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        std::printf("Bit exactness: %d tests, %d failures\n", tests, failures);
+        return failures == 0;
+    }
+
+    void Benchmark()
+    {
+        constexpr int SAMPLE_RATE = 96000;
+        constexpr int REPEATS = 50;
+        std::mt19937 rng(2);
+        std::printf("\nConversion of 1 s of %d Hz audio, ms:\n", SAMPLE_RATE);
+        for (AVSampleFormat format : { AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_S32P, AV_SAMPLE_FMT_S32, AV_SAMPLE_FMT_S16P, AV_SAMPLE_FMT_S16 })
+        {
+            for (int channels : { 2, 6, 8 })
+            {
+                TestFrame frame(format, channels, SAMPLE_RATE, rng);
+                std::vector<float> output((size_t)SAMPLE_RATE * channels);
+
+                std::printf("  %-4s %d ch:", av_get_sample_fmt_name(format), channels);
+                for (auto kernel : AvailableKernels())
+                {
+                    AudioSampleConverter::Convert(&frame.frame, output.data(), SAMPLE_RATE, kernel);
+                    auto start = std::chrono::steady_clock::now();
+                    for (int i = 0; i < REPEATS; i++)
+                        AudioSampleConverter::Convert(&frame.frame, output.data(), SAMPLE_RATE, kernel);
+                    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / REPEATS;
+                    std::printf("  %s %6.3f", AudioSampleConverter::KernelName(kernel), ms);
+                }
+                std::printf("\n");
+            }
+        }
+        std::printf("Selected kernel: %s\n", AudioSampleConverter::KernelName(AudioSampleConverter::BestKernel()));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool ok = TestBitExact();
+    if (!(argc > 1 && std::strcmp(argv[1], "--no-bench") == 0))
+        Benchmark();
+    return ok ? 0 : 1;
+}
\ No newline at end of file
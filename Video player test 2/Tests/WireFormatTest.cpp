@@ -0,0 +1,297 @@
+// Round trip and fuzz tests for the MediaPacket and MediaStream wire format,
+// followed by a serialization throughput benchmark.
+// Usage: WireFormatTest [--no-bench] [fuzz iterations]
+// Build with AddressSanitizer (and UBSan) to catch out of bounds reads in the decoders.
+
+#include "../MediaPacket.h"
+#include "../MediaStream.h"
+#include "../PacketBufferPool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+namespace
+{
+    int failures = 0;
+
+    void Check(bool condition, const char* what)
+    {
+        if (!condition)
+        {
+            std::printf("FAIL: %s\n", what);
+            failures++;
+        }
+    }
+
+    // Packet with recognizable payload and side data
+    MediaPacket MakePacket(int size, int64_t pts, int64_t dts)
+    {
+        AVPacket* packet = av_packet_alloc();
+        av_new_packet(packet, size);
+        for (int i = 0; i < size; i++)
+            packet->data[i] = (uint8_t)i;
+        packet->pts = pts;
+        packet->dts = dts;
+        packet->duration = 1024;
+        packet->stream_index = 1;
+        packet->flags = AV_PKT_FLAG_KEY;
+        uint8_t* sideData = av_packet_new_side_data(packet, AV_PKT_DATA_PALETTE, 5);
+        std::memcpy(sideData, "hello", 5);
+        return MediaPacket(packet);
+    }
+
+    bool SamePacket(const AVPacket* a, const AVPacket* b)
+    {
+        if (!a || !b)
+            return a == b;
+        if (a->pts != b->pts || a->dts != b->dts || a->duration != b->duration)
+            return false;
+        if (a->stream_index != b->stream_index || a->flags != b->flags || a->size != b->size)
+            return false;
+        if (a->size > 0 && std::memcmp(a->data, b->data, a->size) != 0)
+            return false;
+        if (a->side_data_elems != b->side_data_elems)
+            return false;
+        for (int i = 0; i < a->side_data_elems; i++)
+        {
+            if (a->side_data[i].type != b->side_data[i].type || a->side_data[i].size != b->side_data[i].size)
+                return false;
+            if (std::memcmp(a->side_data[i].data, b->side_data[i].data, a->side_data[i].size) != 0)
+                return false;
+        }
+        return true;
+    }
+
+    void TestPacketRoundTrip()
+    {
+        MediaPacket packet = MakePacket(300, 123456789, 123450000);
+        packet.last = true;
+        SerializedData data = packet.Serialize();
+        MediaPacket result;
+        Check(result.Deserialize(data.Copy()) == data.Size(), "packet: whole message consumed");
+        Check(SamePacket(packet.GetPacket(), result.GetPacket()), "packet: fields and data");
+        Check(result.last && !result.flush, "packet: last/flush flags");
+        std::printf("Packet with 300 B payload and 5 B side data: %zu B on the wire\n", data.Size());
+
+        MediaPacket flush(true);
+        SerializedData flushData = flush.Serialize();
+        MediaPacket flushResult;
+        Check(flushResult.Deserialize(flushData.Copy()) == flushData.Size() && flushResult.flush && !flushResult.Valid(), "flush packet");
+
+        // Missing timestamps and negative values
+        for (auto [pts, dts] : { std::pair{ AV_NOPTS_VALUE, (int64_t)-5 }, std::pair{ (int64_t)-3, AV_NOPTS_VALUE }, std::pair{ AV_NOPTS_VALUE, AV_NOPTS_VALUE } })
+        {
+            MediaPacket timestamps = MakePacket(0, pts, dts);
+            MediaPacket timestampsResult;
+            timestampsResult.Deserialize(timestamps.Serialize());
+            Check(SamePacket(timestamps.GetPacket(), timestampsResult.GetPacket()), "packet: missing or negative timestamps");
+        }
+    }
+
+    void TestInPlace()
+    {
+        MediaPacket packet = MakePacket(300, 1000, 1000);
+        size_t capacity = packet.MaxSerializedSize();
+
+        std::shared_ptr<void> owner = znet::PacketBufferPool::Instance()->Acquire(capacity);
+        size_t size = packet.SerializeTo((uchar*)owner.get(), capacity);
+        // The receiver acquires exactly the message size, so the padding starts right after it
+        std::memset((uchar*)owner.get() + size, 0, znet::PacketBufferPool::PADDING);
+        std::weak_ptr<void> weakOwner = owner;
+
+        MediaPacket result;
+        Check(result.DeserializeInPlace((const uchar*)owner.get(), size, owner) == size, "in place: whole message consumed");
+        Check(SamePacket(packet.GetPacket(), result.GetPacket()), "in place: fields and data");
+        const uint8_t* begin = (const uint8_t*)owner.get();
+        Check(result.GetPacket()->data >= begin && result.GetPacket()->data < begin + size, "in place: data not copied");
+        owner.reset();
+        Check(!weakOwner.expired(), "in place: packet keeps the buffer alive");
+        result.Reset();
+        Check(weakOwner.expired(), "in place: buffer released with the packet");
+    }
+
+    MediaStream MakeStream()
+    {
+        AVCodecParameters* params = avcodec_parameters_alloc();
+        params->codec_type = AVMEDIA_TYPE_AUDIO;
+        params->codec_id = (AVCodecID)86018; // AAC
+        params->format = -1;
+        params->bit_rate = 640000;
+        params->sample_rate = 48000;
+        params->channels = 6;
+        params->channel_layout = 0x60F;
+        params->extradata = (uint8_t*)av_mallocz(16 + AV_INPUT_BUFFER_PADDING_SIZE);
+        params->extradata_size = 16;
+        std::memcpy(params->extradata, "0123456789abcdef", 16);
+
+        MediaStream stream(params);
+        avcodec_parameters_free(&params);
+        stream.index = 3;
+        stream.startTime = AV_NOPTS_VALUE;
+        stream.timeBase = { 1, 1000 };
+        stream.type = MediaStreamType::AUDIO;
+        stream.metadata.push_back({ "language", "eng" });
+        return stream;
+    }
+
+    void TestStreamRoundTrip()
+    {
+        MediaStream stream = MakeStream();
+        SerializedData data = stream.Serialize();
+        MediaStream result;
+        Check(result.Deserialize(data.Copy()) == data.Size(), "stream: whole message consumed");
+
+        const AVCodecParameters* a = stream.GetParams();
+        const AVCodecParameters* b = result.GetParams();
+        Check(b && a->codec_id == b->codec_id && a->format == b->format && a->bit_rate == b->bit_rate, "stream: codec parameters");
+        Check(b && a->sample_rate == b->sample_rate && a->channels == b->channels && a->channel_layout == b->channel_layout, "stream: audio parameters");
+        Check(b && b->extradata_size == 16 && std::memcmp(a->extradata, b->extradata, 16) == 0, "stream: extradata");
+        Check(result.index == 3 && result.startTime == AV_NOPTS_VALUE && result.timeBase.num == 1 && result.timeBase.den == 1000, "stream: fields");
+        Check(result.type == MediaStreamType::AUDIO && result.metadata.size() == 1 && result.metadata[0].value == "eng", "stream: type and metadata");
+        std::printf("Audio stream with 16 B extradata: %zu B on the wire\n", data.Size());
+    }
+
+    // Mutated and random messages must be rejected or decoded without touching memory
+    // outside of the message (checked by the sanitizers). Whatever is accepted has to
+    // survive another round trip unchanged.
+    void Fuzz(int iterations)
+    {
+        std::mt19937_64 rng(1);
+        MediaPacket packet = MakePacket(300, 123456789, 123450000);
+        SerializedData packetData = packet.Serialize();
+        MediaStream stream = MakeStream();
+        SerializedData streamData = stream.Serialize();
+        uchar version = packetData.Bytes()[0];
+
+        int accepted = 0;
+        for (int i = 0; i < iterations; i++)
+        {
+            bool packetTarget = (i % 2) == 1;
+            const SerializedData& base = packetTarget ? packetData : streamData;
+
+            size_t size = base.Size();
+            std::unique_ptr<uchar[]> bytes;
+            switch (rng() % 3)
+            {
+            case 0: // Truncated
+                size = rng() % (base.Size() + 1);
+                bytes = std::make_unique<uchar[]>(size + 1);
+                std::memcpy(bytes.get(), base.Bytes(), size);
+                break;
+            case 1: // Bit flips
+                bytes = std::make_unique<uchar[]>(size);
+                std::memcpy(bytes.get(), base.Bytes(), size);
+                for (int flips = 1 + rng() % 4; flips > 0; flips--)
+                    bytes[rng() % size] ^= (uchar)(1 << (rng() % 8));
+                break;
+            default: // Random bytes with a valid version
+                size = rng() % 64;
+                bytes = std::make_unique<uchar[]>(size + 1);
+                for (size_t k = 0; k < size; k++)
+                    bytes[k] = (uchar)rng();
+                if (size > 0)
+                    bytes[0] = version;
+                break;
+            }
+            SerializedData input(size, std::move(bytes));
+
+            if (packetTarget)
+            {
+                MediaPacket result;
+                if (result.Deserialize(input.Copy()) > 0)
+                {
+                    accepted++;
+                    MediaPacket again;
+                    again.Deserialize(result.Serialize());
+                    if (!SamePacket(result.GetPacket(), again.GetPacket()) || result.last != again.last || result.flush != again.flush)
+                    {
+                        std::printf("FAIL: fuzz iteration %d, accepted packet changes on another round trip\n", i);
+                        failures++;
+                    }
+                }
+
+                // Same input through the in place decoder, from a pooled buffer
+                std::shared_ptr<void> owner = znet::PacketBufferPool::Instance()->Acquire(input.Size());
+                if (input.Size() > 0)
+                    std::memcpy(owner.get(), input.Bytes(), input.Size());
+                MediaPacket inPlace;
+                inPlace.DeserializeInPlace((const uchar*)owner.get(), input.Size(), owner);
+            }
+            else
+            {
+                MediaStream result;
+                if (result.Deserialize(std::move(input)) > 0)
+                {
+                    accepted++;
+                    SerializedData first = result.Serialize();
+                    MediaStream again;
+                    again.Deserialize(first.Copy());
+                    SerializedData second = again.Serialize();
+                    if (first.Size() != second.Size() || std::memcmp(first.Bytes(), second.Bytes(), first.Size()) != 0)
+                    {
+                        std::printf("FAIL: fuzz iteration %d, accepted stream changes on another round trip\n", i);
+                        failures++;
+                    }
+                }
+            }
+        }
+        std::printf("Fuzz: %d inputs, %d accepted\n", iterations, accepted);
+    }
+
+    void Benchmark()
+    {
+        constexpr int PACKETS = 1000000;
+        std::printf("\nRound trip throughput:\n");
+        for (int payload : { 400, 50000 })
+        {
+            AVPacket* packet = av_packet_alloc();
+            av_new_packet(packet, payload);
+            std::memset(packet->data, 0x55, payload);
+            packet->pts = packet->dts = 90000000;
+            packet->duration = 1920;
+            packet->flags = AV_PKT_FLAG_KEY;
+            MediaPacket mediaPacket(packet);
+
+            int count = payload > 1000 ? PACKETS / 20 : PACKETS;
+            size_t totalBytes = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < count; i++)
+            {
+                packet->pts += 1920;
+                packet->dts += 1920;
+                SerializedData data = mediaPacket.Serialize();
+                totalBytes += data.Size();
+                MediaPacket result;
+                result.Deserialize(std::move(data));
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::printf("  %6d B payload: %zu B header, %.0f packets/s\n", payload, totalBytes / count - payload, count / seconds);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool bench = true;
+    int iterations = 300000;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--no-bench") == 0)
+            bench = false;
+        else
+            iterations = std::atoi(argv[i]);
+    }
+
+    TestPacketRoundTrip();
+    TestInPlace();
+    TestStreamRoundTrip();
+    Fuzz(iterations);
+    std::printf("%d failures\n", failures);
+    if (bench)
+        Benchmark();
+    return failures == 0 ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,139 @@
+// Checks WorkerPool::ParallelFor, then measures how sliced BGRA conversion
+// scales with the number of threads taking part.
+// Usage: WorkerPoolTest [--no-bench]
+
+#include "../WorkerPool.h"
+#include "../YUVConverter.h"
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+}
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace
+{
+    // Every index must be visited exactly once, for any count
+    bool TestParallelFor()
+    {
+        WorkerPool* pool = WorkerPool::Instance();
+        int failures = 0;
+        for (size_t count = 0; count < 200; count++)
+        {
+            std::unique_ptr<std::atomic<int>[]> visits(new std::atomic<int>[count + 1]());
+            pool->ParallelFor(count, [&](size_t index) { visits[index]++; });
+            for (size_t i = 0; i < count; i++)
+            {
+                if (visits[i] != 1)
+                {
+                    std::printf("FAIL: count %zu, index %zu visited %d times\n", count, i, visits[i].load());
+                    failures++;
+                    break;
+                }
+            }
+        }
+
+        // Several threads submitting at once (the decoder and the renderer can both convert)
+        std::atomic<int> wrongSums = 0;
+        std::vector<std::thread> submitters;
+        for (int t = 0; t < 4; t++)
+        {
+            submitters.push_back(std::thread([&, t]()
+            {
+                for (int round = 0; round < 500; round++)
+                {
+                    size_t count = (round + t) % 33;
+                    std::atomic<size_t> sum = 0;
+                    pool->ParallelFor(count, [&](size_t index) { sum += index + 1; });
+                    if (sum != count * (count + 1) / 2)
+                        wrongSums++;
+                }
+            }));
+        }
+        for (auto& submitter : submitters)
+            submitter.join();
+        if (wrongSums > 0)
+        {
+            std::printf("FAIL: %d wrong results with concurrent submitters\n", wrongSums.load());
+            failures++;
+        }
+
+        std::printf("ParallelFor: %zu worker threads, %d failures\n", pool->ThreadCount(), failures);
+        return failures == 0;
+    }
+
+    // Converts YUV420P frames in 'sliceCount' slices, split the way VideoFrame_YUV does it.
+    // ParallelFor hands out at most 'sliceCount - 1' slices to workers, so this is also the thread count.
+    double FramesPerSecond(const AVFrame& frame, uint8_t* dest, size_t sliceCount)
+    {
+        int sliceHeight = (int)((frame.height + sliceCount - 1) / sliceCount + 1) & ~1;
+        auto convertSlice = [&](size_t index)
+        {
+            int sliceY = (int)index * sliceHeight;
+            int height = std::min(sliceHeight, frame.height - sliceY);
+            if (height > 0)
+                YUVConverter::Convert(&frame, dest, frame.width * 4, sliceY, height, YUVConverter::BestKernel());
+        };
+
+        constexpr int FRAMES = 30;
+        WorkerPool::Instance()->ParallelFor(sliceCount, convertSlice);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < FRAMES; i++)
+            WorkerPool::Instance()->ParallelFor(sliceCount, convertSlice);
+        return FRAMES / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void Benchmark()
+    {
+        std::mt19937 rng(1);
+        size_t maxThreads = WorkerPool::Instance()->ThreadCount() + 1;
+        std::printf("\nYUV420P to BGRA (%s kernel), frames/s by thread count:\n", YUVConverter::KernelName(YUVConverter::BestKernel()));
+        for (auto [width, height] : { std::pair{ 1920, 1080 }, std::pair{ 3840, 2160 }, std::pair{ 7680, 4320 } })
+        {
+            std::vector<uint8_t> planes[3];
+            AVFrame frame = {};
+            frame.format = AV_PIX_FMT_YUV420P;
+            frame.width = width;
+            frame.height = height;
+            frame.linesize[0] = width;
+            frame.linesize[1] = width / 2;
+            frame.linesize[2] = width / 2;
+            planes[0].resize((size_t)width * height);
+            planes[1].resize((size_t)width * height / 4);
+            planes[2].resize((size_t)width * height / 4);
+            for (int i = 0; i < 3; i++)
+            {
+                std::generate(planes[i].begin(), planes[i].end(), [&]() { return (uint8_t)rng(); });
+                frame.data[i] = planes[i].data();
+            }
+            std::vector<uint8_t> output((size_t)width * height * 4);
+
+            std::printf("  %dx%d\n", width, height);
+            double singleThreaded = 0.0;
+            for (size_t threads = 1; threads <= maxThreads; threads++)
+            {
+                double fps = FramesPerSecond(frame, output.data(), threads);
+                if (threads == 1)
+                    singleThreaded = fps;
+                std::printf("    %2zu threads: %8.1f fps (x%.2f)\n", threads, fps, fps / singleThreaded);
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    WorkerPool::Init();
+    bool ok = TestParallelFor();
+    if (!(argc > 1 && std::strcmp(argv[1], "--no-bench") == 0))
+        Benchmark();
+    return ok ? 0 : 1;
+}
\ No newline at end of file
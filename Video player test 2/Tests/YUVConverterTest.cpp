@@ -0,0 +1,187 @@
+// Checks that the vectorized YUV to BGRA kernels match the scalar one bit for bit,
+// then compares their speed with swscale at 1080p and 2160p.
+// Usage: YUVConverterTest [--no-bench]
+
+#include "../YUVConverter.h"
+#include "../CpuFeatures.h"
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+}
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace
+{
+    constexpr uint8_t GUARD = 0xCD;
+    constexpr int GUARD_BYTES = 64;
+
+    // Planes with random contents, laid out like decoder output
+    struct TestImage
+    {
+        std::vector<uint8_t> planes[3];
+        AVFrame frame = {};
+
+        TestImage(AVPixelFormat format, int width, int height, AVColorSpace colorspace, std::mt19937& rng)
+        {
+            int bytesPerSample = format == AV_PIX_FMT_YUV420P10LE ? 2 : 1;
+            int chromaWidth = (width + 1) / 2;
+            int chromaHeight = (height + 1) / 2;
+
+            frame.format = format;
+            frame.width = width;
+            frame.height = height;
+            frame.colorspace = colorspace;
+
+            // Strides padded by an odd sample count, so rows aren't vector aligned
+            frame.linesize[0] = (width + 3) * bytesPerSample;
+            if (format == AV_PIX_FMT_NV12)
+            {
+                frame.linesize[1] = chromaWidth * 2 + 5;
+            }
+            else
+            {
+                frame.linesize[1] = (chromaWidth + 5) * bytesPerSample;
+                frame.linesize[2] = (chromaWidth + 7) * bytesPerSample;
+            }
+            planes[0].resize((size_t)frame.linesize[0] * height);
+            planes[1].resize((size_t)frame.linesize[1] * chromaHeight);
+            planes[2].resize((size_t)frame.linesize[2] * chromaHeight);
+
+            for (auto& plane : planes)
+            {
+                for (size_t i = 0; i < plane.size(); i++)
+                {
+                    plane[i] = (uint8_t)rng();
+                    // Keep 10 bit samples in range
+                    if (bytesPerSample == 2 && (i % 2) == 1)
+                        plane[i] &= 0x03;
+                }
+            }
+            for (int i = 0; i < 3; i++)
+                frame.data[i] = planes[i].empty() ? nullptr : planes[i].data();
+        }
+    };
+
+    std::vector<YUVConverter::Kernel> AvailableKernels()
+    {
+        std::vector<YUVConverter::Kernel> kernels{ YUVConverter::Kernel::SCALAR };
+        if (CpuFeatures::SSE41())
+            kernels.push_back(YUVConverter::Kernel::SSE41);
+        if (CpuFeatures::AVX2())
+            kernels.push_back(YUVConverter::Kernel::AVX2);
+        return kernels;
+    }
+
+    // Converts in 'sliceCount' slices on even rows, like VideoFrame_YUV does
+    std::vector<uint8_t> Convert(const AVFrame& frame, YUVConverter::Kernel kernel, int sliceCount)
+    {
+        int linesize = frame.width * 4;
+        std::vector<uint8_t> output((size_t)linesize * frame.height + GUARD_BYTES, GUARD);
+        int sliceHeight = ((frame.height + sliceCount - 1) / sliceCount + 1) & ~1;
+        for (int sliceY = 0; sliceY < frame.height; sliceY += sliceHeight)
+            YUVConverter::Convert(&frame, output.data(), linesize, sliceY, std::min(sliceHeight, frame.height - sliceY), kernel);
+        return output;
+    }
+
+    bool TestBitExact()
+    {
+        std::mt19937 rng(1);
+        auto kernels = AvailableKernels();
+        int tests = 0;
+        int failures = 0;
+
+        for (AVPixelFormat format : { AV_PIX_FMT_YUV420P, AV_PIX_FMT_NV12, AV_PIX_FMT_YUV420P10LE })
+        for (AVColorSpace colorspace : { AVCOL_SPC_BT470BG, AVCOL_SPC_BT709 })
+        for (int width : { 1, 2, 7, 8, 15, 16, 17, 31, 32, 33, 63, 65, 1920 })
+        for (int height : { 1, 2, 3, 5, 16 })
+        {
+            TestImage image(format, width, height, colorspace, rng);
+            std::vector<uint8_t> reference = Convert(image.frame, YUVConverter::Kernel::SCALAR, 1);
+            for (size_t i = reference.size() - GUARD_BYTES; i < reference.size(); i++)
+            {
+                if (reference[i] != GUARD)
+                {
+                    std::printf("FAIL: scalar kernel wrote past the image (format %d, %dx%d)\n", format, width, height);
+                    failures++;
+                    break;
+                }
+            }
+
+            for (auto kernel : kernels)
+            {
+                for (int sliceCount : { 1, 3 })
+                {
+                    tests++;
+                    if (Convert(image.frame, kernel, sliceCount) != reference)
+                    {
+                        std::printf("FAIL: %s (format %d, colorspace %d, %dx%d, %d slices)\n",
+                            YUVConverter::KernelName(kernel), format, colorspace, width, height, sliceCount);
+                        failures++;
+                    }
+                }
+            }
+        }
+
+        std::printf("Bit exactness: %d tests, %d failures\n", tests, failures);
+        return failures == 0;
+    }
+
+    double MillisecondsPerFrame(int repeats, const std::function<void()>& convert)
+    {
+        convert();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repeats; i++)
+            convert();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / repeats;
+    }
+
+    void Benchmark()
+    {
+        std::mt19937 rng(2);
+        std::printf("\nSingle threaded conversion to BGRA, ms/frame:\n");
+        for (AVPixelFormat format : { AV_PIX_FMT_YUV420P, AV_PIX_FMT_NV12, AV_PIX_FMT_YUV420P10LE })
+        {
+            for (auto [width, height] : { std::pair{ 1920, 1080 }, std::pair{ 3840, 2160 } })
+            {
+                TestImage image(format, width, height, AVCOL_SPC_BT709, rng);
+                std::vector<uint8_t> output((size_t)width * height * 4);
+                uint8_t* dest[4] = { output.data(), nullptr, nullptr, nullptr };
+                int destLinesize[4] = { width * 4, 0, 0, 0 };
+
+                std::printf("  %-12s %4dx%-4d", av_get_pix_fmt_name(format), width, height);
+                SwsContext* context = sws_getContext(width, height, format, width, height, AV_PIX_FMT_BGRA, SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+                if (context)
+                {
+                    double ms = MillisecondsPerFrame(20, [&]() { sws_scale(context, image.frame.data, image.frame.linesize, 0, height, dest, destLinesize); });
+                    std::printf("  swscale %7.2f", ms);
+                    sws_freeContext(context);
+                }
+                for (auto kernel : AvailableKernels())
+                {
+                    double ms = MillisecondsPerFrame(20, [&]() { YUVConverter::Convert(&image.frame, output.data(), width * 4, 0, height, kernel); });
+                    std::printf("  %s %7.2f", YUVConverter::KernelName(kernel), ms);
+                }
+                std::printf("\n");
+            }
+        }
+        std::printf("Selected kernel: %s\n", YUVConverter::KernelName(YUVConverter::BestKernel()));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool ok = TestBitExact();
+    if (!(argc > 1 && std::strcmp(argv[1], "--no-bench") == 0))
+        Benchmark();
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -1,13 +1,15 @@
 #include "VideoDecoder.h"
 //#include "VideoFrame.h"
 
-#include "VideoFrame_BGRA.h"
+#include "VideoFrame_YUV.h"
 
 #include "App.h"
+#include "PlaybackEvents.h"
 
 #include "Options.h"
 #include "OptionNames.h"
 #include "IntOptionAdapter.h"
+#include "BoolOptionAdapter.h"
 
 extern "C"
 {
@@ -18,8 +20,12 @@ extern "C"
 #include <libavutil/hwcontext.h>
 }
 
+#include <algorithm>
+
 VideoDecoder::VideoDecoder(const MediaStream& stream)
 {
+    _framePool = std::make_shared<FrameBufferPool>();
+
     AVCodec* codec = avcodec_find_decoder(stream.GetParams()->codec_id);
     _codecContext = avcodec_alloc_context3(codec);
     avcodec_parameters_to_context(_codecContext, stream.GetParams());
@@ -46,6 +52,12 @@ VideoDecoder::VideoDecoder(const MediaStream& stream)
         }
     }
 
+    // Threading can't be changed on an open codec, so these options apply to newly created decoders
+    int threadCount = IntOptionAdapter(Options::Instance()->GetValue(OPTIONS_VIDEO_DECODER_THREADS), 0).Value();
+    bool frameThreading = BoolOptionAdapter(Options::Instance()->GetValue(OPTIONS_DECODER_FRAME_THREADING), true).Value();
+    bool sliceThreading = BoolOptionAdapter(Options::Instance()->GetValue(OPTIONS_DECODER_SLICE_THREADING), true).Value();
+    _SetupThreading(_codecContext, threadCount, frameThreading, sliceThreading);
+
     avcodec_open2(_codecContext, codec, NULL);
 
     _timebase = stream.timeBase;
@@ -58,36 +70,43 @@ VideoDecoder::VideoDecoder(const MediaStream& stream)
 
 VideoDecoder::~VideoDecoder()
 {
-    _decoderThreadStop = true;
-    if (_decoderThread.joinable())
-        _decoderThread.join();
+    _StopDecoding();
     avcodec_free_context(&_codecContext);
 }
 
-void VideoDecoder::_DecoderThread()
+uint64_t VideoDecoder::FramePoolHits() const
 {
-    AVFrame* frame = av_frame_alloc();
+    return _framePool->Hits();
+}
 
-    SwsContext* swsContext = NULL;
+uint64_t VideoDecoder::FramePoolMisses() const
+{
+    return _framePool->Misses();
+}
 
-    int currentWidth = 0;
-    int currentHeight = 0;
-    uchar* data = nullptr;
-    uchar* dest[4] = { NULL, NULL, NULL, NULL };
-    int destLinesize[4] = { 0, 0, 0, 0 };
-    constexpr size_t PADDING = 64;
+void VideoDecoder::SkipUntil(TimePoint target)
+{
+    _skipTarget = target.GetTicks();
+    _stageSignal.Notify();
+}
 
-    // Codec context might have uninitialized width/height values at this point
-    if (_codecContext->width != 0 && _codecContext->height != 0)
-    {
-        currentWidth = _codecContext->width;
-        currentHeight = _codecContext->height;
-        data = new uchar[currentWidth * currentHeight * 4 + PADDING];
-        dest[0] = data;
-        destLinesize[0] = _codecContext->width * 4;
-    }
+void VideoDecoder::_DecoderThread()
+{
+    AVFrame* frame = av_frame_alloc();
 
-    bool discontinuity = true;
+    // Packet taken from the queue but not yet accepted by the decoder
+    MediaPacket packet;
+    bool packetHeld = false;
+
+    // Post-seek recovery
+    int64_t skipTarget = -1;
+    // Latest frame before the target, output together with the first frame past the target
+    AVFrame* heldFrame = av_frame_alloc();
+    bool frameHeld = false;
+    TimePoint lastRecoveryTimestamp = -1;
+    TimePoint recoveryStart = -1;
+    int64_t recoveryFramesDecoded = 0;
+    int64_t recoveryFramesDropped = 0;
 
     Clock threadClock = Clock(0);
 
@@ -101,61 +120,86 @@ void VideoDecoder::_DecoderThread()
             _lastOptionCheck = threadClock.Now();
             _LoadOptions();
         }
+        _UpdateStats(threadClock.Now(), "video", _codecContext);
 
         // Seek
         if (_decoderThreadFlush)
         {
             // Flush decoder
+            _codecContext->skip_frame = AVDISCARD_DEFAULT;
             avcodec_send_packet(_codecContext, NULL);
             while (avcodec_receive_frame(_codecContext, frame) != AVERROR_EOF);
             avcodec_flush_buffers(_codecContext);
 
             ClearFrames();
             ClearPackets();
+            packet = MediaPacket();
+            packetHeld = false;
+            av_frame_unref(heldFrame);
+            frameHeld = false;
+            skipTarget = -1;
             _decoderThreadFlush = false;
-            discontinuity = true;
             continue;
         }
 
-        // Limit loaded frame count
-        if (_frames.size() >= _MAX_FRAME_QUEUE_SIZE)
+        // Start recovery
+        if (skipTarget != _skipTarget.load())
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-            continue;
+            skipTarget = _skipTarget.load();
+            lastRecoveryTimestamp = -1;
+            recoveryStart = threadClock.Now();
+            recoveryFramesDecoded = 0;
+            recoveryFramesDropped = 0;
         }
 
-        // If finished, wait for seek command/new packets
-        _m_packets.lock(); // Prevent packet flushing on seek
-        if (_packets.empty())
+        // Wait for a packet and free frame space
+        if (_frames.Full() || (!packetHeld && _packets.Empty()))
         {
-            _m_packets.unlock();
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            _WaitForWork(packetHeld);
             continue;
         }
+        if (!packetHeld)
+        {
+            _packets.TryPop(packet);
+            packetHeld = true;
+        }
 
         // If packet is last, immediatelly send it to frame queue
-        if (_packets.front().last)
+        if (packet.last)
         {
-            _packets.pop();
-            _m_packets.unlock();
+            packet = MediaPacket();
+            packetHeld = false;
+
+            if (frameHeld)
+            {
+                VideoFrame_YUV* videoFrame = _WrapFrame(heldFrame);
+                if (videoFrame)
+                    _PushFrame((IMediaFrame*)videoFrame);
+                frameHeld = false;
+            }
 
             IMediaFrame* lastFrame = new IMediaFrame(-1);
             lastFrame->last = true;
-            _m_frames.lock();
-            _frames.push(lastFrame);
-            _m_frames.unlock();
-
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            _PushFrame(lastFrame);
             continue;
         }
 
-        int response = avcodec_send_packet(_codecContext, _packets.front().GetPacket());
+        // Skip non-reference frames until close to the target
+        bool skipNonRef = false;
+        if (skipTarget != -1 && _fastRecovery)
+        {
+            if (lastRecoveryTimestamp.GetTicks() == -1 || lastRecoveryTimestamp < TimePoint(skipTarget) - _nonRefSkipMargin)
+                skipNonRef = true;
+        }
+        _codecContext->skip_frame = skipNonRef ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+
+        int response = avcodec_send_packet(_codecContext, packet.GetPacket());
         if (response != AVERROR(EAGAIN))
         {
-            _packets.pop();
+            packet = MediaPacket();
+            packetHeld = false;
         }
-        _m_packets.unlock();
-        if (response < 0)
+        if (response < 0 && response != AVERROR(EAGAIN))
         {
             printf("Packet decode error %d\n", response);
             continue;
@@ -171,130 +215,131 @@ void VideoDecoder::_DecoderThread()
             printf("Packet decode error %d\n", response);
             continue;
         }
+        _framesDecoded++;
 
-        int err = 0;
-        AVPixelFormat outputFormat = _codecContext->pix_fmt;
-        while (_hwAccelerated && frame->hw_frames_ctx)
+        if (skipTarget != -1 && frame->pts != AV_NOPTS_VALUE)
         {
-            AVPixelFormat* pformats;
-            err = av_hwframe_transfer_get_formats(frame->hw_frames_ctx, AV_HWFRAME_TRANSFER_DIRECTION_FROM, &pformats, 0);
-            if (err < 0)
-                break;
-            std::vector<AVPixelFormat> formats;
-            while (*pformats != AV_PIX_FMT_NONE)
-                formats.push_back(*(pformats++));
-            if (formats.empty())
-            {
-                err = -1;
-                break;
-            }
-
-            // Set up output frame
-            AVFrame* oframe = NULL;
-            outputFormat = formats[0];
-            if (frame->format == outputFormat)
-                break;
-            oframe = av_frame_alloc();
-            if (!oframe)
+            recoveryFramesDecoded++;
+            lastRecoveryTimestamp = TimePoint(av_rescale_q(frame->pts, _timebase, { 1, AV_TIME_BASE }), MICROSECONDS);
+            if (lastRecoveryTimestamp < TimePoint(skipTarget))
             {
-                err = -1;
-                break;
+                // Keep only the latest frame before the target, earlier ones would never be shown
+                if (frameHeld)
+                    recoveryFramesDropped++;
+                av_frame_unref(heldFrame);
+                av_frame_move_ref(heldFrame, frame);
+                frameHeld = true;
+                continue;
             }
-            oframe->format = outputFormat;
 
-            // Move data from hw frame
-            err = av_hwframe_transfer_data(oframe, frame, 0);
-            if (err < 0)
+            // Target reached
+            if (frameHeld)
             {
-                av_frame_free(&oframe);
-                break;
+                VideoFrame_YUV* videoFrame = _WrapFrame(heldFrame);
+                if (videoFrame)
+                    _PushFrame((IMediaFrame*)videoFrame);
+                frameHeld = false;
             }
-            err = av_frame_copy_props(oframe, frame);
 
-            // Swap frame data
-            av_frame_unref(frame);
-            av_frame_move_ref(frame, oframe);
-            av_frame_free(&oframe);
-
-            break;
+            SeekRecoveryStatsEvent ev;
+            ev.recoveryTime = threadClock.Now() - recoveryStart;
+            ev.framesDecoded = recoveryFramesDecoded;
+            ev.framesDropped = recoveryFramesDropped;
+            App::Instance()->events.RaiseEvent(ev);
+
+            // A newer target may have been set in the meantime
+            int64_t expected = skipTarget;
+            _skipTarget.compare_exchange_strong(expected, -1);
+            skipTarget = -1;
+            _codecContext->skip_frame = AVDISCARD_DEFAULT;
         }
-        if (err < 0)
-        {
-            std::cout << "HW error " << err << '\n';
+
+        VideoFrame_YUV* videoFrame = _WrapFrame(frame);
+        if (!videoFrame)
             continue;
-        }
 
-        // Account for variable frame size video
-        if (currentWidth != _codecContext->width || currentHeight != _codecContext->height)
+        _PushFrame((IMediaFrame*)videoFrame);
+    }
+
+    av_frame_free(&heldFrame);
+    av_frame_unref(frame);
+    av_frame_free(&frame);
+}
+
+VideoFrame_YUV* VideoDecoder::_WrapFrame(AVFrame* frame)
+{
+    int err = 0;
+    AVPixelFormat outputFormat = _codecContext->pix_fmt;
+    while (_hwAccelerated && frame->hw_frames_ctx)
+    {
+        AVPixelFormat* pformats;
+        err = av_hwframe_transfer_get_formats(frame->hw_frames_ctx, AV_HWFRAME_TRANSFER_DIRECTION_FROM, &pformats, 0);
+        if (err < 0)
+            break;
+        std::vector<AVPixelFormat> formats;
+        while (*pformats != AV_PIX_FMT_NONE)
+            formats.push_back(*(pformats++));
+        if (formats.empty())
         {
-            currentWidth = _codecContext->width;
-            currentHeight = _codecContext->height;
-            if (data)
-            {
-                delete[] data;
-                data = nullptr;
-            }
-            if (swsContext)
-            {
-                sws_freeContext(swsContext);
-                swsContext = nullptr;
-            }
+            err = -1;
+            break;
         }
 
-        // Deferred destination buffer initialization
-        if (data == nullptr)
+        // Set up output frame
+        AVFrame* oframe = NULL;
+        outputFormat = formats[0];
+        if (frame->format == outputFormat)
+            break;
+        oframe = av_frame_alloc();
+        if (!oframe)
         {
-            data = new uchar[currentWidth * currentHeight * 4 + PADDING];
-            dest[0] = data;
-            destLinesize[0] = _codecContext->width * 4;
+            err = -1;
+            break;
         }
+        oframe->format = outputFormat;
 
-        if (!swsContext)
+        // Move data from hw frame
+        err = av_hwframe_transfer_data(oframe, frame, 0);
+        if (err < 0)
         {
-            swsContext = sws_getContext(
-                _codecContext->width,
-                _codecContext->height,
-                outputFormat,
-                _codecContext->width,
-                _codecContext->height,
-                AV_PIX_FMT_BGRA,
-                SWS_FAST_BILINEAR,
-                NULL,
-                NULL,
-                NULL
-            );
+            av_frame_free(&oframe);
+            break;
         }
-        sws_scale(swsContext, frame->data, frame->linesize, 0, frame->height, dest, destLinesize);
-
-        long long int timestamp = av_rescale_q(frame->pts, _timebase, { 1, AV_TIME_BASE });
-        if (frame->pts == AV_NOPTS_VALUE)
-            timestamp = AV_NOPTS_VALUE;
+        err = av_frame_copy_props(oframe, frame);
 
-        auto pData = std::make_unique<unsigned char[]>(frame->width * frame->height * 4);
-        std::copy_n(data, frame->width * frame->height * 4, pData.get());
-        VideoFrame_BGRA* videoFrame = new VideoFrame_BGRA(TimePoint(timestamp, MICROSECONDS), frame->width, frame->height, std::move(pData));
+        // Swap frame data
+        av_frame_unref(frame);
+        av_frame_move_ref(frame, oframe);
+        av_frame_free(&oframe);
 
-        discontinuity = false;
-
-        _m_frames.lock();
-        _frames.push((IMediaFrame*)videoFrame);
-        _m_frames.unlock();
+        break;
+    }
+    if (err < 0)
+    {
+        std::cout << "HW error " << err << '\n';
+        av_frame_unref(frame);
+        return nullptr;
     }
 
-    delete[] data;
+    long long int timestamp = av_rescale_q(frame->pts, _timebase, { 1, AV_TIME_BASE });
+    if (frame->pts == AV_NOPTS_VALUE)
+        timestamp = AV_NOPTS_VALUE;
 
-    if (swsContext)
-        sws_freeContext(swsContext);
-    av_frame_unref(frame);
-    av_frame_free(&frame);
+    // Hand the decoded planes over to the frame, conversion to BGRA is deferred until it is drawn
+    AVFrame* frameRef = av_frame_alloc();
+    av_frame_move_ref(frameRef, frame);
+    return new VideoFrame_YUV(TimePoint(timestamp, MICROSECONDS), frameRef, _framePool);
 }
 
 void VideoDecoder::_LoadOptions()
 {
     // Frame buffer size
     std::wstring optStr = Options::Instance()->GetValue(OPTIONS_MAX_VIDEO_FRAMES);
-    _MAX_FRAME_QUEUE_SIZE = IntOptionAdapter(optStr, 12).Value();
+    _frames.SetCapacity(IntOptionAdapter(optStr, 12).Value());
 
     // Packet buffer size
-    _MAX_PACKET_QUEUE_SIZE = 30;
+    _packets.SetCapacity(30);
+
+    optStr = Options::Instance()->GetValue(OPTIONS_FAST_SEEK_RECOVERY);
+    _fastRecovery = BoolOptionAdapter(optStr, true).Value();
 }
\ No newline at end of file
@@ -1,8 +1,11 @@
 #pragma once
 
 #include "IMediaDecoder.h"
+#include "FrameBufferPool.h"
 
 struct AVCodecContext;
+struct AVFrame;
+class VideoFrame_YUV;
 
 class VideoDecoder : public IMediaDecoder
 {
@@ -12,6 +15,17 @@ class VideoDecoder : public IMediaDecoder
     bool _hwAccelerated = false;
     AVBufferRef* _hwDeviceCtx = nullptr;
 
+    // Recycles BGRA buffers of presented frames
+    std::shared_ptr<FrameBufferPool> _framePool;
+
+    // Post-seek recovery target (in ticks), -1 if not recovering
+    std::atomic<int64_t> _skipTarget = -1;
+    // Skip non-reference frames while recovering
+    bool _fastRecovery = true;
+    // Non-reference frames are decoded again this long before the target,
+    // so that the frame shown at the target is not replaced by an earlier one
+    Duration _nonRefSkipMargin = Duration(500, MILLISECONDS);
+
     TimePoint _lastOptionCheck = -1;
     Duration _optionCheckInterval = Duration(1, SECONDS);
 
@@ -19,7 +33,19 @@ public:
     VideoDecoder(const MediaStream& stream);
     ~VideoDecoder();
 
+    uint64_t FramePoolHits() const;
+    uint64_t FramePoolMisses() const;
+
+    // Until a frame at or past 'target' is decoded, earlier frames are not output
+    // (except for the last one before the target) and non-reference frames are skipped.
+    // Should be called after Flush().
+    void SkipUntil(TimePoint target);
+
 private:
     void _DecoderThread();
     void _LoadOptions();
+
+    // Downloads hardware frames to system memory and takes over the frame data.
+    // Returns nullptr on failure.
+    VideoFrame_YUV* _WrapFrame(AVFrame* frame);
 };
\ No newline at end of file
@@ -35,6 +35,6 @@ void VideoFrame_BGRA::DrawFrame(Graphics g, ID2D1Bitmap1** targetBitmap)
     {
         bitmap = *targetBitmap;
         D2D1_RECT_U rect = D2D1::RectU(0, 0, _width, _height);
-        bitmap->CopyFromMemory(&rect, _data.get(), _width * 4);
+        bitmap->CopyFromMemory(&rect, _data.Data(), _width * 4);
     }
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "IVideoFrame.h"
+#include "FrameBufferPool.h"
 
 class VideoFrame_BGRA : public IVideoFrame
 {
@@ -8,10 +9,15 @@ public:
     VideoFrame_BGRA(TimePoint timestamp)
         : IVideoFrame(timestamp, -1, -1)
     {
-        _data = nullptr;
     }
     VideoFrame_BGRA(TimePoint timestamp, int width, int height, std::unique_ptr<unsigned char[]> data)
         : IVideoFrame(timestamp, width, height)
+    {
+        _data = FrameBuffer(std::move(data), (size_t)width * height * 4);
+    }
+    // The buffer (usually pooled) is released when the frame is destroyed
+    VideoFrame_BGRA(TimePoint timestamp, int width, int height, FrameBuffer data)
+        : IVideoFrame(timestamp, width, height)
     {
         _data = std::move(data);
     }
@@ -19,5 +25,5 @@ public:
     void DrawFrame(Graphics g, ID2D1Bitmap1** targetBitmap);
 
 protected:
-    std::unique_ptr<unsigned char[]> _data;
+    FrameBuffer _data;
 };
\ No newline at end of file
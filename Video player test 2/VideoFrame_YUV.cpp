@@ -0,0 +1,114 @@
+#include "VideoFrame_YUV.h"
+#include "YUVConverter.h"
+#include "WorkerPool.h"
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+}
+
+#include <algorithm>
+
+namespace
+{
+    // Frames are drawn on the rendering thread, so the scaler context can be
+    // reused between frames instead of being recreated for each of them
+    struct ThreadScaler
+    {
+        SwsContext* context = nullptr;
+        ~ThreadScaler()
+        {
+            if (context)
+                sws_freeContext(context);
+        }
+    };
+    thread_local ThreadScaler threadScaler;
+}
+
+VideoFrame_YUV::VideoFrame_YUV(TimePoint timestamp, AVFrame* frame, std::shared_ptr<FrameBufferPool> bufferPool)
+    : VideoFrame_BGRA(timestamp)
+{
+    _frame = frame;
+    _bufferPool = std::move(bufferPool);
+    _width = frame->width;
+    _height = frame->height;
+}
+
+VideoFrame_YUV::~VideoFrame_YUV()
+{
+    av_frame_free(&_frame);
+}
+
+void VideoFrame_YUV::DrawFrame(Graphics g, ID2D1Bitmap1** targetBitmap)
+{
+    ConvertToBGRA();
+    VideoFrame_BGRA::DrawFrame(g, targetBitmap);
+}
+
+void VideoFrame_YUV::ConvertToBGRA()
+{
+    if (_data || !_frame)
+        return;
+
+    constexpr size_t PADDING = 64;
+    _data = _bufferPool->Acquire((size_t)_width * _height * 4 + PADDING);
+    uint8_t* dest[4] = { _data.Data(), NULL, NULL, NULL };
+    int destLinesize[4] = { _width * 4, 0, 0, 0 };
+
+    // Use vectorized kernels for common formats, swscale for the rest
+    if (YUVConverter::Supported(_frame))
+    {
+        // Large frames are split into horizontal slices converted in parallel
+        constexpr size_t PIXELS_PER_SLICE = 500000;
+        size_t sliceCount = 1;
+        WorkerPool* pool = WorkerPool::Instance();
+        if (pool)
+            sliceCount = std::clamp((size_t)_width * _height / PIXELS_PER_SLICE, (size_t)1, pool->ThreadCount() + 1);
+
+        // Keep slice boundaries on even rows, so chroma rows aren't split
+        int sliceHeight = (int)((_height + sliceCount - 1) / sliceCount + 1) & ~1;
+        auto convertSlice = [&](size_t index)
+        {
+            int sliceY = (int)index * sliceHeight;
+            int height = std::min(sliceHeight, _height - sliceY);
+            if (height > 0)
+                YUVConverter::Convert(_frame, dest[0], destLinesize[0], sliceY, height, YUVConverter::BestKernel());
+        };
+        if (sliceCount > 1)
+            pool->ParallelFor(sliceCount, convertSlice);
+        else
+            convertSlice(0);
+    }
+    else
+    {
+        threadScaler.context = sws_getCachedContext(
+            threadScaler.context,
+            _width,
+            _height,
+            (AVPixelFormat)_frame->format,
+            _width,
+            _height,
+            AV_PIX_FMT_BGRA,
+            SWS_FAST_BILINEAR,
+            NULL,
+            NULL,
+            NULL
+        );
+        sws_scale(threadScaler.context, _frame->data, _frame->linesize, 0, _height, dest, destLinesize);
+    }
+
+    // Planes are no longer needed
+    av_frame_free(&_frame);
+}
+
+size_t VideoFrame_YUV::PlaneBytes() const
+{
+    if (!_frame)
+        return 0;
+
+    size_t bytes = 0;
+    for (int i = 0; i < AV_NUM_DATA_POINTERS && _frame->buf[i]; i++)
+        bytes += _frame->buf[i]->size;
+    return bytes;
+}
\ No newline at end of file
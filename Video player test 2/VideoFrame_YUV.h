@@ -0,0 +1,30 @@
+#pragma once
+
+#include "VideoFrame_BGRA.h"
+
+struct AVFrame;
+
+// Holds the decoder output as is (usually planar YUV) and converts it
+// to BGRA only when the frame is actually drawn. Frames which are dropped
+// (e.g. while catching up after a seek) are never converted.
+class VideoFrame_YUV : public VideoFrame_BGRA
+{
+public:
+    // Takes over the frame reference. The BGRA image is allocated from 'bufferPool'.
+    VideoFrame_YUV(TimePoint timestamp, AVFrame* frame, std::shared_ptr<FrameBufferPool> bufferPool);
+    ~VideoFrame_YUV();
+    VideoFrame_YUV(const VideoFrame_YUV&) = delete;
+    VideoFrame_YUV& operator=(const VideoFrame_YUV&) = delete;
+
+    void DrawFrame(Graphics g, ID2D1Bitmap1** targetBitmap);
+
+    // Does nothing if the frame is already converted
+    void ConvertToBGRA();
+
+    // Bytes held by the decoded planes
+    size_t PlaneBytes() const;
+
+private:
+    AVFrame* _frame;
+    std::shared_ptr<FrameBufferPool> _bufferPool;
+};
\ No newline at end of file
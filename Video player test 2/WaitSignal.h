@@ -0,0 +1,55 @@
+#pragma once
+
+#include "GameTime.h"
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+// A cheap wakeup primitive for lock-free producer/consumer pairs.
+// Notify() only touches the mutex if somebody is actually waiting,
+// so it can be called on every push without slowing the producer down.
+class WaitSignal
+{
+    std::mutex _m_wait;
+    std::condition_variable _cv;
+    std::atomic<int> _waiters{ 0 };
+    std::atomic<uint64_t> _sequence{ 0 };
+
+public:
+    WaitSignal() {}
+    WaitSignal(const WaitSignal&) = delete;
+    WaitSignal& operator=(const WaitSignal&) = delete;
+
+    // Should be read before checking the waited-for condition, and then
+    // passed to WaitFor(), to avoid missing a notification in between
+    uint64_t Sequence() const
+    {
+        return _sequence.load();
+    }
+
+    void Notify()
+    {
+        _sequence.fetch_add(1);
+        if (_waiters.load() > 0)
+        {
+            std::lock_guard<std::mutex> lock(_m_wait);
+            _cv.notify_all();
+        }
+    }
+
+    // Returns true if Notify() was called since 'sequence' was read, false on timeout
+    bool WaitFor(uint64_t sequence, Duration timeout)
+    {
+        _waiters.fetch_add(1);
+        std::unique_lock<std::mutex> lock(_m_wait);
+        bool notified = _cv.wait_for(
+            lock,
+            std::chrono::microseconds(timeout.GetDuration(MICROSECONDS)),
+            [&]() { return _sequence.load() != sequence; }
+        );
+        lock.unlock();
+        _waiters.fetch_sub(1);
+        return notified;
+    }
+};
\ No newline at end of file
@@ -0,0 +1,72 @@
+#include "WavFileAudioSink.h"
+#include "AudioFrame.h"
+
+#include <iostream>
+
+WavFileAudioSink::WavFileAudioSink(std::string path, int channels, int sampleRate)
+    : NullAudioSink(channels, sampleRate), _path(std::move(path))
+{}
+
+WavFileAudioSink::~WavFileAudioSink()
+{
+    // The sink thread must be stopped before members are destroyed
+    Close();
+}
+
+bool WavFileAudioSink::Open(RenderCallback render)
+{
+    Close();
+
+    _file.open(_path, std::ios::binary | std::ios::trunc);
+    if (!_file)
+    {
+        std::cout << "[WavFileAudioSink] Could not open '" << _path << "'" << std::endl;
+        return false;
+    }
+    _dataSize = 0;
+    _WriteHeader();
+
+    return NullAudioSink::Open(std::move(render));
+}
+
+void WavFileAudioSink::Close()
+{
+    NullAudioSink::Close();
+
+    if (_file.is_open())
+    {
+        // Rewrite the header with the final data size
+        _file.seekp(0);
+        _WriteHeader();
+        _file.close();
+    }
+}
+
+void WavFileAudioSink::_Consume(const float* samples, int sampleCount)
+{
+    size_t size = (size_t)sampleCount * Channels() * sizeof(float);
+    _file.write((const char*)samples, size);
+    _dataSize += size;
+}
+
+void WavFileAudioSink::_WriteHeader()
+{
+    // Sizes are capped to what the 32 bit fields can hold
+    uint32_t dataSize = _dataSize < UINT32_MAX - 36 ? (uint32_t)_dataSize : UINT32_MAX - 36;
+
+    WaveHeader header;
+    header.chunkID = 0x46464952;
+    header.chunkSize = 36 + dataSize;
+    header.format = 0x45564157;
+    header.subChunk1ID = 0x20746d66;
+    header.subChunk1Size = 16;
+    header.audioFormat = 3;
+    header.numChannels = Channels();
+    header.sampleRate = SampleRate();
+    header.byteRate = SampleRate() * Channels() * sizeof(float);
+    header.blockAlign = Channels() * sizeof(float);
+    header.bitsPerSample = sizeof(float) * 8;
+    header.subChunk2ID = 0x61746164;
+    header.subChunk2Size = dataSize;
+    _file.write((const char*)&header, sizeof(header));
+}
\ No newline at end of file
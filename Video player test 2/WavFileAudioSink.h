@@ -0,0 +1,28 @@
+#pragma once
+
+#include "NullAudioSink.h"
+
+#include <fstream>
+#include <string>
+
+// Consumes audio in real time and records it to a 32 bit float WAV file.
+// Useful for checking output and sync on machines without a sound card.
+class WavFileAudioSink : public NullAudioSink
+{
+    std::string _path;
+    std::ofstream _file;
+    uint64_t _dataSize = 0;
+
+public:
+    WavFileAudioSink(std::string path, int channels = 2, int sampleRate = 48000);
+    ~WavFileAudioSink();
+
+    bool Open(RenderCallback render);
+    void Close();
+
+protected:
+    void _Consume(const float* samples, int sampleCount);
+
+private:
+    void _WriteHeader();
+};
\ No newline at end of file
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "ISerializable.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+// Compact, architecture independent encoding used by serializable media objects.
+//
+// Integers are written as LEB128 varints (7 bits per byte, low bits first),
+// signed ones zigzag encoded first so small negative values stay short.
+// Byte blocks are prefixed with their varint length.
+class WireWriter
+{
+    std::unique_ptr<uchar[]> _ownedBytes;
+    uchar* _bytes;
+    size_t _capacity;
+    size_t _size = 0;
+    bool _external = false;
+
+public:
+    // Capacity grows as needed, a good estimate avoids reallocating
+    WireWriter(size_t capacity = 64)
+    {
+        _capacity = std::max(capacity, (size_t)16);
+        _ownedBytes = std::make_unique<uchar[]>(_capacity);
+        _bytes = _ownedBytes.get();
+    }
+    // Writes into memory owned by the caller, which can't grow.
+    // Writing past 'capacity' throws std::length_error.
+    WireWriter(uchar* buffer, size_t capacity)
+        : _bytes(buffer), _capacity(capacity), _external(true)
+    {}
+    WireWriter(const WireWriter&) = delete;
+    WireWriter& operator=(const WireWriter&) = delete;
+
+    // Upper bound of the bytes taken by a varint
+    static constexpr size_t MAX_VARINT_SIZE = 10;
+
+    void WriteByte(uint8_t value)
+    {
+        _Reserve(1);
+        _bytes[_size++] = value;
+    }
+
+    void WriteVarint(uint64_t value)
+    {
+        _Reserve(MAX_VARINT_SIZE);
+        while (value >= 0x80)
+        {
+            _bytes[_size++] = (uchar)(value | 0x80);
+            value >>= 7;
+        }
+        _bytes[_size++] = (uchar)value;
+    }
+
+    void WriteSignedVarint(int64_t value)
+    {
+        WriteVarint(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+    }
+
+    void WriteBlock(const void* data, size_t size)
+    {
+        WriteVarint(size);
+        _Reserve(size);
+        if (size > 0)
+            std::memcpy(_bytes + _size, data, size);
+        _size += size;
+    }
+
+    size_t Size() const
+    {
+        return _size;
+    }
+
+    // Only valid for writers which own their memory
+    SerializedData Release()
+    {
+        size_t size = _size;
+        _size = 0;
+        _capacity = 0;
+        _bytes = nullptr;
+        return { size, std::move(_ownedBytes) };
+    }
+
+private:
+    void _Reserve(size_t count)
+    {
+        if (_size + count <= _capacity)
+            return;
+        if (_external)
+            throw std::length_error("Wire buffer too small");
+
+        size_t newCapacity = std::max(_capacity * 2, _size + count);
+        auto newBytes = std::make_unique<uchar[]>(newCapacity);
+        std::copy_n(_bytes, _size, newBytes.get());
+        _ownedBytes = std::move(newBytes);
+        _bytes = _ownedBytes.get();
+        _capacity = newCapacity;
+    }
+};
+
+// Reads data written by WireWriter.
+// Every read throws std::out_of_range if the data is truncated or malformed.
+class WireReader
+{
+    const uchar* _data;
+    size_t _size;
+    size_t _position = 0;
+
+public:
+    WireReader(const uchar* data, size_t size)
+        : _data(data), _size(size)
+    {}
+
+    uint8_t ReadByte()
+    {
+        if (_position >= _size)
+            throw std::out_of_range("Unexpected end of data");
+        return _data[_position++];
+    }
+
+    uint64_t ReadVarint()
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            uint8_t byte = ReadByte();
+            // The 10th byte only has 1 valid bit
+            if (shift == 63 && byte > 1)
+                throw std::out_of_range("Varint overflow");
+            value |= (uint64_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        throw std::out_of_range("Varint too long");
+    }
+
+    int64_t ReadSignedVarint()
+    {
+        uint64_t value = ReadVarint();
+        return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+    }
+
+    // Signed varint which must fit into an int
+    int ReadInt()
+    {
+        int64_t value = ReadSignedVarint();
+        if (value < INT32_MIN || value > INT32_MAX)
+            throw std::out_of_range("Value out of range");
+        return (int)value;
+    }
+
+    // Returns the length of a block and moves past it. 'data' points to the block bytes.
+    size_t ReadBlock(const uchar*& data)
+    {
+        uint64_t size = ReadVarint();
+        if (size > Remaining())
+            throw std::out_of_range("Block exceeds data");
+        data = _data + _position;
+        _position += (size_t)size;
+        return (size_t)size;
+    }
+
+    size_t Position() const
+    {
+        return _position;
+    }
+
+    size_t Remaining() const
+    {
+        return _size - _position;
+    }
+};
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include "WorkerPool.h"
+
+#include <atomic>
+#include <memory>
+
+WorkerPool* WorkerPool::_instance = nullptr;
+
+WorkerPool::WorkerPool(size_t threadCount)
+{
+    for (size_t i = 0; i < threadCount; i++)
+        _workers.push_back(std::thread(&WorkerPool::_WorkerThread, this));
+}
+
+void WorkerPool::Init()
+{
+    if (!_instance)
+    {
+        // Leave one core for the thread that submits the work
+        size_t cores = std::thread::hardware_concurrency();
+        _instance = new WorkerPool(cores > 2 ? cores - 1 : 1);
+    }
+}
+
+WorkerPool* WorkerPool::Instance()
+{
+    return _instance;
+}
+
+size_t WorkerPool::ThreadCount() const
+{
+    return _workers.size();
+}
+
+void WorkerPool::ParallelFor(size_t count, const std::function<void(size_t)>& func)
+{
+    if (count == 0)
+        return;
+    if (count == 1 || _workers.empty())
+    {
+        for (size_t i = 0; i < count; i++)
+            func(i);
+        return;
+    }
+
+    // Shared with workers which may only pick the task up after everything is done
+    struct State
+    {
+        std::atomic<size_t> next{ 0 };
+        std::atomic<size_t> finished{ 0 };
+        size_t count = 0;
+        const std::function<void(size_t)>* func = nullptr;
+        std::mutex m_done;
+        std::condition_variable done;
+    };
+    auto state = std::make_shared<State>();
+    state->count = count;
+    state->func = &func;
+
+    auto work = [](State& s)
+    {
+        size_t index;
+        while ((index = s.next.fetch_add(1)) < s.count)
+        {
+            (*s.func)(index);
+            if (s.finished.fetch_add(1) + 1 == s.count)
+            {
+                std::lock_guard<std::mutex> lock(s.m_done);
+                s.done.notify_all();
+            }
+        }
+    };
+
+    size_t helperCount = std::min(count - 1, _workers.size());
+    std::unique_lock<std::mutex> lock(_m_tasks);
+    for (size_t i = 0; i < helperCount; i++)
+        _tasks.push_back([state, work]() { work(*state); });
+    lock.unlock();
+    _taskAdded.notify_all();
+
+    work(*state);
+
+    std::unique_lock<std::mutex> doneLock(state->m_done);
+    state->done.wait(doneLock, [&]() { return state->finished.load() == count; });
+}
+
+void WorkerPool::_WorkerThread()
+{
+    while (true)
+    {
+        std::unique_lock<std::mutex> lock(_m_tasks);
+        _taskAdded.wait(lock, [&]() { return !_tasks.empty(); });
+        auto task = std::move(_tasks.front());
+        _tasks.pop_front();
+        lock.unlock();
+
+        task();
+    }
+}
\ No newline at end of file
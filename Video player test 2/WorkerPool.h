@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Shared pool of worker threads for splitting CPU heavy work (like frame conversion) into parallel chunks
+class WorkerPool
+{
+    std::vector<std::thread> _workers;
+    std::deque<std::function<void()>> _tasks;
+    std::mutex _m_tasks;
+    std::condition_variable _taskAdded;
+
+private: // Singleton interface
+    WorkerPool(size_t threadCount);
+    static WorkerPool* _instance;
+public:
+    static void Init();
+    static WorkerPool* Instance();
+
+public:
+    size_t ThreadCount() const;
+
+    // Calls 'func' with every index in [0, count) and returns when all calls have finished.
+    // The calling thread takes part in the work, so this never waits on an idle pool.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& func);
+
+private:
+    void _WorkerThread();
+};
\ No newline at end of file
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "IAudioOutputAdapter.h"
+#include "AudioResampler.h"
+#include "FrameBufferPool.h"
+#include "DriftController.h"
 
 #include "GameTime.h"
 #include "FixedQueue.h"
@@ -21,7 +24,8 @@ public:
         int32_t channels;
         int32_t sampleRate;
         size_t dataSize;
-        void* data;
+        // Released (back to the adapter's pool) when the context is deleted
+        FrameBuffer data;
     };
 
     struct Refs
@@ -56,19 +60,22 @@ public:
     void OnBufferEnd(void* pBufferContext)
     {
         auto ctx = (BufferContext*)pBufferContext;
-        for (size_t byte = 0; byte < ctx->dataSize;)
+        const float* samples = (const float*)ctx->data.Data();
+        size_t sampleCount = ctx->dataSize / (sizeof(float) * ctx->channels);
+        for (size_t i = 0; i < sampleCount; i++)
         {
             IAudioOutputAdapter::SampleData data;
-            data.channels = ctx->channels;
+            data.channels = ctx->channels < 8 ? ctx->channels : 8;
             data.sampleRate = ctx->sampleRate;
-            for (int i = 0; i < data.channels; i++)
+            for (int ch = 0; ch < data.channels; ch++)
             {
-                data.data[i] = *(int16_t*)((char*)ctx->data + byte);
-                byte += 2;
+                float value = samples[i * ctx->channels + ch];
+                value = value > -1.0f ? value : -1.0f;
+                value = value < 1.0f ? value : 1.0f;
+                data.data[ch] = (int16_t)(value * 32767.0f);
             }
             _refs._playedSampleQueue.Push(data);
         }
-        delete ctx->data;
         _refs._audioBufferLength -= ctx->sampleDuration;
         delete ctx;
     }
@@ -102,6 +109,13 @@ class XAudio2_AudioOutputAdapter : public IAudioOutputAdapter
     IXAudio2SourceVoice* _sourceVoice = nullptr;
     VoiceCallback _voiceCallback;
     WAVEFORMATEX _wfx = { 0 };
+
+    // Decoded audio is converted to the mastering voice format
+    AudioResampler _resampler;
+    // Resampled audio is written directly to buffers which are submitted to the voice
+    std::shared_ptr<FrameBufferPool> _bufferPool = std::make_shared<FrameBufferPool>(64);
+    int _deviceChannels = 2;
+    int _deviceSampleRate = 48000;
     int64_t _currentSampleTimestamp = 0;
     int64_t _audioBufferLength = 0;
     int64_t _audioBufferEnd = 0;
@@ -114,15 +128,19 @@ class XAudio2_AudioOutputAdapter : public IAudioOutputAdapter
     // Positive - audio ahead
     // Negative - audio behind
     int64_t _playbackOffset = 0;
-    // Values below ~1500us start causing frequent overcorrections
-    // and make the audio sound choppy
-    int64_t _offsetTolerance = 5000; // In microseconds
+    // Small offsets are corrected by adjusting the resampling rate
+    DriftController _driftController = DriftController(0.2, 0.01, 0.05, Duration(2, MILLISECONDS));
+    double _playbackRate = 1.0;
+    // Larger offsets (e.g. after the timer jumps) are corrected by
+    // inserting silence or cutting audio
+    int64_t _offsetTolerance = 200000; // In microseconds
     // Pending offset correction
     // Positive - audio behind (some audio will be cut)
     // Negative - audio ahead (silent padding will be added)
     int64_t _offsetCorrection = 0;
     size_t _cyclesSinceLastCorrection = 0;
 
+    // Source voice format (same as the device)
     int _channelCount = 0;
     int _sampleRate = 0;
 
@@ -150,6 +168,13 @@ public:
         hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
         hr = XAudio2Create(&_XAudio2, 0, XAUDIO2_USE_DEFAULT_PROCESSOR);
         hr = _XAudio2->CreateMasteringVoice(&_masterVoice);
+        if (_masterVoice)
+        {
+            XAUDIO2_VOICE_DETAILS details;
+            _masterVoice->GetVoiceDetails(&details);
+            _deviceChannels = details.InputChannels;
+            _deviceSampleRate = details.InputSampleRate;
+        }
 
         Reset(channelCount, sampleRate);
     }
@@ -159,6 +184,7 @@ public:
         CoUninitialize();
     }
 
+    // The source voice always uses the device format, the input format is taken from the added frames
     void Reset(int channelCount, int sampleRate)
     {
         Pause();
@@ -182,15 +208,17 @@ public:
         _offsetCorrection = 0;
         _cyclesSinceLastCorrection = 0;
 
-        _channelCount = channelCount;
-        _sampleRate = sampleRate;
+        _channelCount = _deviceChannels;
+        _sampleRate = _deviceSampleRate;
+        _resampler.Reset();
+        _driftController.Reset();
 
-        _wfx.wFormatTag = 1;
+        _wfx.wFormatTag = WAVE_FORMAT_IEEE_FLOAT;
         _wfx.nChannels = _channelCount;
         _wfx.nSamplesPerSec = _sampleRate;
-        _wfx.nAvgBytesPerSec = _wfx.nChannels * _wfx.nSamplesPerSec * 2;
-        _wfx.nBlockAlign = _wfx.nChannels * 2;
-        _wfx.wBitsPerSample = 2 * 8;
+        _wfx.nAvgBytesPerSec = _wfx.nChannels * _wfx.nSamplesPerSec * sizeof(float);
+        _wfx.nBlockAlign = _wfx.nChannels * sizeof(float);
+        _wfx.wBitsPerSample = sizeof(float) * 8;
 
         HRESULT hr;
         hr = _XAudio2->CreateSourceVoice(&_sourceVoice, &_wfx, 0, XAUDIO2_DEFAULT_FREQ_RATIO, &_voiceCallback, NULL, NULL);
@@ -202,41 +230,59 @@ public:
 
     void AddRawData(const AudioFrame& frame)
     {
+        if (!_sourceVoice)
+            return;
+
+        // Remix/resample to the voice format
+        if (!_resampler.Configure(frame.GetChannelCount(), frame.GetChannelLayout(), frame.GetSampleRate(), _channelCount, 0, _sampleRate))
+            return;
+
         _cyclesSinceLastCorrection++;
 
         //std::cout << "off: " << _playbackOffset << " | cor: " << _offsetCorrection << std::endl;
 
         int64_t currentOffset = _playbackOffset + _offsetCorrection;
+        bool hardCorrection = std::abs(currentOffset) > _offsetTolerance && _cyclesSinceLastCorrection >= 15;
+
+        // Follow the playback rate, nudged by the drift controller
+        double rate = _playbackRate;
+        if (!hardCorrection && _offsetCorrection == 0)
+            rate *= _driftController.Update(Duration(currentOffset, MICROSECONDS), frame.CalculateDuration());
+        _resampler.SetRateAdjustment(rate);
+
+        size_t bytesPerSample = _channelCount * sizeof(float);
+        int maxOutputSamples = _resampler.MaxOutputSamples(frame.GetSampleCount());
+        FrameBuffer outputBuffer = _bufferPool->AcquireAtLeast(maxOutputSamples * bytesPerSample);
+        int64_t outputSamples = _resampler.Process(frame, (float*)outputBuffer.Data(), maxOutputSamples);
+
         int64_t samplesToCut = 0;
 
-        // Audio is ahead
-        if (currentOffset > _offsetTolerance && _cyclesSinceLastCorrection >= 60)
+        // Audio is far ahead
+        if (hardCorrection && currentOffset > 0)
         {
             _cyclesSinceLastCorrection = 0;
+            _driftController.Reset();
 
-            // Add a silent chunk (up to 100ms)
+            // Add a silent chunk (up to 500ms)
             int64_t chunkDuration = currentOffset;
-            if (chunkDuration > 100000) chunkDuration = 100000;
-            size_t sampleCount = (chunkDuration * (int64_t)frame.GetSampleRate()) / (int64_t)1000000;
-            size_t chunkSize = sampleCount * frame.GetChannelCount() * 2;
+            if (chunkDuration > 500000) chunkDuration = 500000;
+            size_t sampleCount = (chunkDuration * (int64_t)_sampleRate) / (int64_t)1000000;
+            size_t chunkSize = sampleCount * bytesPerSample;
 
-            //18,446,744,073,709,551,615
-            //   614,891,469,123,651,500
-
-            char* dataBytes = new char[chunkSize]();
+            FrameBuffer silence(std::make_unique<unsigned char[]>(chunkSize), chunkSize);
             XAUDIO2_BUFFER buffer = { 0 };
             buffer.AudioBytes = chunkSize;
-            buffer.pAudioData = (BYTE*)dataBytes;
+            buffer.pAudioData = (BYTE*)silence.Data();
             buffer.Flags = XAUDIO2_END_OF_STREAM;
 
             // Setup callback
             VoiceCallback::BufferContext* bCtx = new VoiceCallback::BufferContext();
             bCtx->timestamp = frame.GetTimestamp();
             bCtx->sampleDuration = chunkDuration;
-            bCtx->channels = frame.GetChannelCount();
-            bCtx->sampleRate = frame.GetSampleRate();
+            bCtx->channels = _channelCount;
+            bCtx->sampleRate = _sampleRate;
             bCtx->dataSize = chunkSize;
-            bCtx->data = dataBytes; // Callback will delete this pointer after finishing playback
+            bCtx->data = std::move(silence); // Callback will free this after finishing playback
             int64_t correction = -chunkDuration;
             bCtx->correction = correction;
             // Add correction offset
@@ -247,38 +293,39 @@ public:
 
             std::cout << "[XAudio2_AudioOuptutAdapter] SYNC: Added silent chunk of length " << chunkDuration << "us" << std::endl;
         }
-        // Audio is behind
-        else if (currentOffset < -_offsetTolerance && _cyclesSinceLastCorrection >= 60)
+        // Audio is far behind
+        else if (hardCorrection)
         {
             _cyclesSinceLastCorrection = 0;
+            _driftController.Reset();
 
-            samplesToCut = (-currentOffset * (int64_t)frame.GetSampleRate()) / (int64_t)1000000;
+            samplesToCut = (-currentOffset * (int64_t)_sampleRate) / (int64_t)1000000;
         }
 
-        if (samplesToCut > frame.GetSampleCount())
+        if (samplesToCut > outputSamples)
         {
-            samplesToCut = frame.GetSampleCount();
+            samplesToCut = outputSamples;
         }
-        int64_t sampleDuration = ((int64_t)1000000 * (frame.GetSampleCount() - samplesToCut)) / frame.GetSampleRate();
-        size_t cutBytes = samplesToCut * frame.GetChannelCount() * 2;
+        // The resampler may hold on to the first few samples
+        if (outputSamples - samplesToCut == 0)
+            return;
+        int64_t sampleDuration = ((int64_t)1000000 * (outputSamples - samplesToCut)) / _sampleRate;
+        size_t dataSize = (outputSamples - samplesToCut) * bytesPerSample;
 
-        WaveHeader header = frame.GetHeader();
-        char* dataBytes = new char[header.subChunk2Size - cutBytes];
-        memcpy(dataBytes, frame.GetBytes(), header.subChunk2Size - cutBytes);
         XAUDIO2_BUFFER buffer = { 0 };
-        buffer.AudioBytes = header.subChunk2Size - cutBytes;
-        buffer.pAudioData = (BYTE*)dataBytes;
+        buffer.AudioBytes = dataSize;
+        buffer.pAudioData = (BYTE*)outputBuffer.Data();
         buffer.Flags = XAUDIO2_END_OF_STREAM;
 
         // Setup callback
         VoiceCallback::BufferContext* bCtx = new VoiceCallback::BufferContext();
         bCtx->timestamp = frame.GetTimestamp();
         bCtx->sampleDuration = sampleDuration;
-        bCtx->channels = frame.GetChannelCount();
-        bCtx->sampleRate = frame.GetSampleRate();
-        bCtx->dataSize = header.subChunk2Size - cutBytes;
-        bCtx->data = dataBytes; // Callback will delete this pointer after finishing playback
-        int64_t correction = (samplesToCut * (int64_t)1000000) / frame.GetSampleRate();
+        bCtx->channels = _channelCount;
+        bCtx->sampleRate = _sampleRate;
+        bCtx->dataSize = dataSize;
+        bCtx->data = std::move(outputBuffer); // Callback will return this to the pool after finishing playback
+        int64_t correction = (samplesToCut * (int64_t)1000000) / _sampleRate;
         bCtx->correction = correction;
         // Add correction offset
         _offsetCorrection += correction;
@@ -380,6 +427,13 @@ public:
         }
     }
 
+    void SetPlaybackRate(double rate)
+    {
+        _playbackRate = rate;
+        _playbackTimer.Update();
+        _playbackTimer.SetSpeed(rate);
+    }
+
     void SetBalance(float balance)
     {
         if (!_sourceVoice)
@@ -0,0 +1,349 @@
+#include "YUVConverter.h"
+#include "CpuFeatures.h"
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+}
+
+#include <cstring>
+#include <immintrin.h>
+
+namespace
+{
+    // 8.8 fixed point coefficients for limited range YUV
+    struct Coefficients
+    {
+        int y;
+        int rv;
+        int gu;
+        int gv;
+        int bu;
+    };
+    constexpr Coefficients BT601 = { 298, 409, 100, 208, 516 };
+    constexpr Coefficients BT709 = { 298, 459, 55, 136, 541 };
+
+    inline uint8_t _Clamp(int value)
+    {
+        return value < 0 ? 0 : (value > 255 ? 255 : (uint8_t)value);
+    }
+
+    // Reference implementation, the vector kernels must produce identical output
+    inline void _PixelScalar(int y, int u, int v, uint8_t* out, const Coefficients& c)
+    {
+        int yy = (y - 16) * c.y;
+        u -= 128;
+        v -= 128;
+        out[0] = _Clamp((yy + c.bu * u + 128) >> 8);
+        out[1] = _Clamp((yy - c.gu * u - c.gv * v + 128) >> 8);
+        out[2] = _Clamp((yy + c.rv * v + 128) >> 8);
+        out[3] = 255;
+    }
+
+    struct Row
+    {
+        const uint8_t* y;
+        const uint8_t* u;
+        const uint8_t* v; // Unused for NV12
+    };
+
+
+    // SSE4.1: 4 pixels from 32 bit Y/U/V lanes
+    CPU_TARGET("sse4.1") inline __m128i _Pixels4_SSE41(__m128i y, __m128i u, __m128i v, const Coefficients& c)
+    {
+        const __m128i rounding = _mm_set1_epi32(128);
+        y = _mm_mullo_epi32(_mm_sub_epi32(y, _mm_set1_epi32(16)), _mm_set1_epi32(c.y));
+        u = _mm_sub_epi32(u, rounding);
+        v = _mm_sub_epi32(v, rounding);
+        y = _mm_add_epi32(y, rounding);
+
+        __m128i b = _mm_srai_epi32(_mm_add_epi32(y, _mm_mullo_epi32(u, _mm_set1_epi32(c.bu))), 8);
+        __m128i g = _mm_srai_epi32(_mm_sub_epi32(_mm_sub_epi32(y, _mm_mullo_epi32(u, _mm_set1_epi32(c.gu))), _mm_mullo_epi32(v, _mm_set1_epi32(c.gv))), 8);
+        __m128i r = _mm_srai_epi32(_mm_add_epi32(y, _mm_mullo_epi32(v, _mm_set1_epi32(c.rv))), 8);
+
+        // Saturating packs clamp to [0, 255], then interleave to BGRA
+        __m128i bg = _mm_packs_epi32(b, g);
+        __m128i ra = _mm_packs_epi32(r, _mm_set1_epi32(255));
+        __m128i planar = _mm_packus_epi16(bg, ra);
+        const __m128i interleave = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+        return _mm_shuffle_epi8(planar, interleave);
+    }
+
+    // AVX2: 8 pixels from 32 bit Y/U/V lanes (packs work per 128 bit lane, which keeps pixel order)
+    CPU_TARGET("avx2") inline __m256i _Pixels8_AVX2(__m256i y, __m256i u, __m256i v, const Coefficients& c)
+    {
+        const __m256i rounding = _mm256_set1_epi32(128);
+        y = _mm256_mullo_epi32(_mm256_sub_epi32(y, _mm256_set1_epi32(16)), _mm256_set1_epi32(c.y));
+        u = _mm256_sub_epi32(u, rounding);
+        v = _mm256_sub_epi32(v, rounding);
+        y = _mm256_add_epi32(y, rounding);
+
+        __m256i b = _mm256_srai_epi32(_mm256_add_epi32(y, _mm256_mullo_epi32(u, _mm256_set1_epi32(c.bu))), 8);
+        __m256i g = _mm256_srai_epi32(_mm256_sub_epi32(_mm256_sub_epi32(y, _mm256_mullo_epi32(u, _mm256_set1_epi32(c.gu))), _mm256_mullo_epi32(v, _mm256_set1_epi32(c.gv))), 8);
+        __m256i r = _mm256_srai_epi32(_mm256_add_epi32(y, _mm256_mullo_epi32(v, _mm256_set1_epi32(c.rv))), 8);
+
+        __m256i bg = _mm256_packs_epi32(b, g);
+        __m256i ra = _mm256_packs_epi32(r, _mm256_set1_epi32(255));
+        __m256i planar = _mm256_packus_epi16(bg, ra);
+        const __m256i interleave = _mm256_setr_epi8(
+            0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+            0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15
+        );
+        return _mm256_shuffle_epi8(planar, interleave);
+    }
+
+    inline __m128i _Load32(const uint8_t* src)
+    {
+        int32_t value;
+        memcpy(&value, src, 4);
+        return _mm_cvtsi32_si128(value);
+    }
+
+
+    // Each chroma sample covers 2 horizontal pixels
+    CPU_TARGET("avx2") inline void _Duplicate_AVX2(__m256i values, __m256i* out)
+    {
+        out[0] = _mm256_permutevar8x32_epi32(values, _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3));
+        out[1] = _mm256_permutevar8x32_epi32(values, _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7));
+    }
+
+
+    // Format readers. Each provides:
+    //  Scalar(row, x, y, u, v)   - single pixel
+    //  Load8_SSE41(row, x, ...)  - 8 pixels as two groups of 4 lanes
+    //  Load16_AVX2(row, x, ...)  - 16 pixels as two groups of 8 lanes
+
+    struct FormatYUV420P
+    {
+        static void Scalar(const Row& row, int x, int& y, int& u, int& v)
+        {
+            y = row.y[x];
+            u = row.u[x >> 1];
+            v = row.v[x >> 1];
+        }
+
+        CPU_TARGET("sse4.1") static void Load8_SSE41(const Row& row, int x, __m128i* y, __m128i* u, __m128i* v)
+        {
+            __m128i yb = _mm_loadl_epi64((const __m128i*)(row.y + x));
+            __m128i u32 = _mm_cvtepu8_epi32(_Load32(row.u + (x >> 1)));
+            __m128i v32 = _mm_cvtepu8_epi32(_Load32(row.v + (x >> 1)));
+            y[0] = _mm_cvtepu8_epi32(yb);
+            y[1] = _mm_cvtepu8_epi32(_mm_srli_si128(yb, 4));
+            u[0] = _mm_shuffle_epi32(u32, _MM_SHUFFLE(1, 1, 0, 0));
+            u[1] = _mm_shuffle_epi32(u32, _MM_SHUFFLE(3, 3, 2, 2));
+            v[0] = _mm_shuffle_epi32(v32, _MM_SHUFFLE(1, 1, 0, 0));
+            v[1] = _mm_shuffle_epi32(v32, _MM_SHUFFLE(3, 3, 2, 2));
+        }
+
+        CPU_TARGET("avx2") static void Load16_AVX2(const Row& row, int x, __m256i* y, __m256i* u, __m256i* v)
+        {
+            __m128i yb = _mm_loadu_si128((const __m128i*)(row.y + x));
+            __m256i u32 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(row.u + (x >> 1))));
+            __m256i v32 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(row.v + (x >> 1))));
+            y[0] = _mm256_cvtepu8_epi32(yb);
+            y[1] = _mm256_cvtepu8_epi32(_mm_srli_si128(yb, 8));
+            _Duplicate_AVX2(u32, u);
+            _Duplicate_AVX2(v32, v);
+        }
+    };
+
+    struct FormatNV12
+    {
+        static void Scalar(const Row& row, int x, int& y, int& u, int& v)
+        {
+            y = row.y[x];
+            u = row.u[(x >> 1) * 2];
+            v = row.u[(x >> 1) * 2 + 1];
+        }
+
+        CPU_TARGET("sse4.1") static void Load8_SSE41(const Row& row, int x, __m128i* y, __m128i* u, __m128i* v)
+        {
+            __m128i yb = _mm_loadl_epi64((const __m128i*)(row.y + x));
+            __m128i uv = _mm_loadl_epi64((const __m128i*)(row.u + x));
+            uv = _mm_shuffle_epi8(uv, _mm_setr_epi8(0, 2, 4, 6, 1, 3, 5, 7, -1, -1, -1, -1, -1, -1, -1, -1));
+            __m128i u32 = _mm_cvtepu8_epi32(uv);
+            __m128i v32 = _mm_cvtepu8_epi32(_mm_srli_si128(uv, 4));
+            y[0] = _mm_cvtepu8_epi32(yb);
+            y[1] = _mm_cvtepu8_epi32(_mm_srli_si128(yb, 4));
+            u[0] = _mm_shuffle_epi32(u32, _MM_SHUFFLE(1, 1, 0, 0));
+            u[1] = _mm_shuffle_epi32(u32, _MM_SHUFFLE(3, 3, 2, 2));
+            v[0] = _mm_shuffle_epi32(v32, _MM_SHUFFLE(1, 1, 0, 0));
+            v[1] = _mm_shuffle_epi32(v32, _MM_SHUFFLE(3, 3, 2, 2));
+        }
+
+        CPU_TARGET("avx2") static void Load16_AVX2(const Row& row, int x, __m256i* y, __m256i* u, __m256i* v)
+        {
+            __m128i yb = _mm_loadu_si128((const __m128i*)(row.y + x));
+            __m128i uv = _mm_loadu_si128((const __m128i*)(row.u + x));
+            uv = _mm_shuffle_epi8(uv, _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15));
+            y[0] = _mm256_cvtepu8_epi32(yb);
+            y[1] = _mm256_cvtepu8_epi32(_mm_srli_si128(yb, 8));
+            _Duplicate_AVX2(_mm256_cvtepu8_epi32(uv), u);
+            _Duplicate_AVX2(_mm256_cvtepu8_epi32(_mm_srli_si128(uv, 8)), v);
+        }
+    };
+
+    // 10 bit samples are reduced to 8 bits before conversion
+    struct FormatYUV420P10
+    {
+        static void Scalar(const Row& row, int x, int& y, int& u, int& v)
+        {
+            y = ((const uint16_t*)row.y)[x] >> 2;
+            u = ((const uint16_t*)row.u)[x >> 1] >> 2;
+            v = ((const uint16_t*)row.v)[x >> 1] >> 2;
+        }
+
+        CPU_TARGET("sse4.1") static void Load8_SSE41(const Row& row, int x, __m128i* y, __m128i* u, __m128i* v)
+        {
+            __m128i yw = _mm_loadu_si128((const __m128i*)((const uint16_t*)row.y + x));
+            __m128i u32 = _mm_srli_epi32(_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)((const uint16_t*)row.u + (x >> 1)))), 2);
+            __m128i v32 = _mm_srli_epi32(_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)((const uint16_t*)row.v + (x >> 1)))), 2);
+            y[0] = _mm_srli_epi32(_mm_cvtepu16_epi32(yw), 2);
+            y[1] = _mm_srli_epi32(_mm_cvtepu16_epi32(_mm_srli_si128(yw, 8)), 2);
+            u[0] = _mm_shuffle_epi32(u32, _MM_SHUFFLE(1, 1, 0, 0));
+            u[1] = _mm_shuffle_epi32(u32, _MM_SHUFFLE(3, 3, 2, 2));
+            v[0] = _mm_shuffle_epi32(v32, _MM_SHUFFLE(1, 1, 0, 0));
+            v[1] = _mm_shuffle_epi32(v32, _MM_SHUFFLE(3, 3, 2, 2));
+        }
+
+        CPU_TARGET("avx2") static void Load16_AVX2(const Row& row, int x, __m256i* y, __m256i* u, __m256i* v)
+        {
+            const uint16_t* y16 = (const uint16_t*)row.y + x;
+            __m256i u32 = _mm256_srli_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)((const uint16_t*)row.u + (x >> 1)))), 2);
+            __m256i v32 = _mm256_srli_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)((const uint16_t*)row.v + (x >> 1)))), 2);
+            y[0] = _mm256_srli_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)y16)), 2);
+            y[1] = _mm256_srli_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(y16 + 8))), 2);
+            _Duplicate_AVX2(u32, u);
+            _Duplicate_AVX2(v32, v);
+        }
+    };
+
+
+    template<class Format>
+    void _ConvertRowScalar(const Row& row, uint8_t* dest, int x, int width, const Coefficients& c)
+    {
+        for (; x < width; x++)
+        {
+            int y, u, v;
+            Format::Scalar(row, x, y, u, v);
+            _PixelScalar(y, u, v, dest + x * 4, c);
+        }
+    }
+
+    template<class Format>
+    CPU_TARGET("sse4.1") void _ConvertRowSSE41(const Row& row, uint8_t* dest, int x, int width, const Coefficients& c)
+    {
+        for (; x + 8 <= width; x += 8)
+        {
+            __m128i y[2], u[2], v[2];
+            Format::Load8_SSE41(row, x, y, u, v);
+            _mm_storeu_si128((__m128i*)(dest + x * 4), _Pixels4_SSE41(y[0], u[0], v[0], c));
+            _mm_storeu_si128((__m128i*)(dest + x * 4 + 16), _Pixels4_SSE41(y[1], u[1], v[1], c));
+        }
+        _ConvertRowScalar<Format>(row, dest, x, width, c);
+    }
+
+    template<class Format>
+    CPU_TARGET("avx2") void _ConvertRowAVX2(const Row& row, uint8_t* dest, int width, const Coefficients& c)
+    {
+        int x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            __m256i y[2], u[2], v[2];
+            Format::Load16_AVX2(row, x, y, u, v);
+            _mm256_storeu_si256((__m256i*)(dest + x * 4), _Pixels8_AVX2(y[0], u[0], v[0], c));
+            _mm256_storeu_si256((__m256i*)(dest + x * 4 + 32), _Pixels8_AVX2(y[1], u[1], v[1], c));
+        }
+        _ConvertRowSSE41<Format>(row, dest, x, width, c);
+    }
+
+    template<class Format>
+    void _Convert(const AVFrame* frame, uint8_t* dest, int destLinesize, int sliceY, int sliceHeight, YUVConverter::Kernel kernel, const Coefficients& c)
+    {
+        for (int line = sliceY; line < sliceY + sliceHeight; line++)
+        {
+            Row row;
+            row.y = frame->data[0] + (ptrdiff_t)line * frame->linesize[0];
+            row.u = frame->data[1] + (ptrdiff_t)(line >> 1) * frame->linesize[1];
+            row.v = frame->data[2] ? frame->data[2] + (ptrdiff_t)(line >> 1) * frame->linesize[2] : nullptr;
+            uint8_t* out = dest + (ptrdiff_t)line * destLinesize;
+
+            switch (kernel)
+            {
+            case YUVConverter::Kernel::AVX2:
+                _ConvertRowAVX2<Format>(row, out, frame->width, c);
+                break;
+            case YUVConverter::Kernel::SSE41:
+                _ConvertRowSSE41<Format>(row, out, 0, frame->width, c);
+                break;
+            default:
+                _ConvertRowScalar<Format>(row, out, 0, frame->width, c);
+                break;
+            }
+        }
+    }
+
+    YUVConverter::Kernel _DetectKernel()
+    {
+        bool avx2 = CpuFeatures::AVX2();
+        bool sse41 = CpuFeatures::SSE41();
+
+        if (avx2)
+            return YUVConverter::Kernel::AVX2;
+        if (sse41)
+            return YUVConverter::Kernel::SSE41;
+        return YUVConverter::Kernel::SCALAR;
+    }
+}
+
+YUVConverter::Kernel YUVConverter::BestKernel()
+{
+    static const Kernel kernel = _DetectKernel();
+    return kernel;
+}
+
+const char* YUVConverter::KernelName(Kernel kernel)
+{
+    switch (kernel)
+    {
+    case Kernel::AVX2: return "AVX2";
+    case Kernel::SSE41: return "SSE4.1";
+    default: return "Scalar";
+    }
+}
+
+bool YUVConverter::Supported(const AVFrame* frame)
+{
+    if (frame->color_range == AVCOL_RANGE_JPEG)
+        return false;
+
+    switch (frame->format)
+    {
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_NV12:
+    case AV_PIX_FMT_YUV420P10LE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void YUVConverter::Convert(const AVFrame* frame, uint8_t* dest, int destLinesize, int sliceY, int sliceHeight, Kernel kernel)
+{
+    const Coefficients& c = frame->colorspace == AVCOL_SPC_BT709 ? BT709 : BT601;
+
+    switch (frame->format)
+    {
+    case AV_PIX_FMT_YUV420P:
+        _Convert<FormatYUV420P>(frame, dest, destLinesize, sliceY, sliceHeight, kernel, c);
+        break;
+    case AV_PIX_FMT_NV12:
+        _Convert<FormatNV12>(frame, dest, destLinesize, sliceY, sliceHeight, kernel, c);
+        break;
+    case AV_PIX_FMT_YUV420P10LE:
+        _Convert<FormatYUV420P10>(frame, dest, destLinesize, sliceY, sliceHeight, kernel, c);
+        break;
+    default:
+        break;
+    }
+}
\ No newline at end of file
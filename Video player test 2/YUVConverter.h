@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+
+struct AVFrame;
+
+// Hand-vectorized conversion of common decoder output formats to BGRA.
+// Handles same-size YUV420P, NV12 and YUV420P10LE (limited range, BT.601/BT.709);
+// everything else should go through swscale.
+class YUVConverter
+{
+public:
+    enum class Kernel
+    {
+        SCALAR,
+        SSE41,
+        AVX2
+    };
+
+    // Fastest kernel supported by the CPU (checked once)
+    static Kernel BestKernel();
+    static const char* KernelName(Kernel kernel);
+
+    static bool Supported(const AVFrame* frame);
+
+    // Converts rows [sliceY, sliceY + sliceHeight) of the frame.
+    // 'dest' points to the first row of the whole image, not the slice.
+    // The frame must be Supported().
+    static void Convert(const AVFrame* frame, uint8_t* dest, int destLinesize, int sliceY, int sliceHeight, Kernel kernel);
+};
\ No newline at end of file